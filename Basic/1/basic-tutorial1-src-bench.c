@@ -0,0 +1,190 @@
+/*
+ * File source benchmark: filesrc against the zero-copy mmapsrc.
+ *
+ * Reads a local file through each source, either straight into a fakesink
+ * ("read") or through decodebin into fakesinks ("decode", the access
+ * pattern playbin produces), as fast as possible. Per source and mode one
+ * JSON line is printed with the averages over --repeat runs: read() syscalls
+ * and bytes copied by them (from /proc/self/io), page faults, time and
+ * throughput. The page cache is warm after the first run, drop it between
+ * invocations for cold numbers.
+ *
+ * build: gcc basic-tutorial1-src-bench.c ../../Common/bench-util.c ../../Elements/gstmmapsrc.c \
+ *            -o basic-tutorial1-src-bench \
+ *            $(pkg-config --cflags --libs gstreamer-1.0 gstreamer-base-1.0)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+
+#include "../../Common/bench-util.h"
+#include "../../Elements/gstmmapsrc.h"
+
+#define DEFAULT_REPEAT 3
+
+/* process wide I/O & memory counters */
+typedef struct _Counters {
+	guint64 rchar;		/* bytes read through read() & co */
+	guint64 syscr;		/* read syscalls */
+	guint64 minflt;
+	guint64 majflt;
+	GstClockTime time;
+} Counters;
+
+/* one run of one source */
+typedef struct _BenchRun {
+	guint64 bytes;		/* leaving the source, streaming thread only */
+	Counters start;
+	Counters end;
+} BenchRun;
+
+static void read_counters(Counters *counters) {
+	struct rusage usage;
+	gchar line[128];
+	FILE *io;
+
+	memset(counters, 0, sizeof(*counters));
+	io = fopen("/proc/self/io", "r");
+	if (io != NULL) {
+		while (fgets(line, sizeof(line), io) != NULL) {
+			sscanf(line, "rchar: %" G_GUINT64_FORMAT, &counters->rchar);
+			sscanf(line, "syscr: %" G_GUINT64_FORMAT, &counters->syscr);
+		}
+		fclose(io);
+	}
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		counters->minflt = usage.ru_minflt;
+		counters->majflt = usage.ru_majflt;
+	}
+	counters->time = gst_util_get_timestamp();
+}
+
+static GstPadProbeReturn count_cb(GstPad *pad, GstPadProbeInfo *info, BenchRun *run) {
+	run->bytes += gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info));
+	return GST_PAD_PROBE_OK;
+}
+
+static void pad_added_cb(GstElement *decodebin, GstPad *pad, GstElement *pipeline) {
+	GstElement *sink = gst_element_factory_make("fakesink", NULL);
+	GstPad *sink_pad;
+
+	g_object_set(sink, "sync", FALSE, NULL);
+	gst_bin_add(GST_BIN(pipeline), sink);
+	gst_element_sync_state_with_parent(sink);
+	sink_pad = gst_element_get_static_pad(sink, "sink");
+	gst_pad_link(pad, sink_pad);
+	gst_object_unref(sink_pad);
+}
+
+/* @brief source ! fakesink or source ! decodebin ! fakesinks, till EOS */
+static gboolean run_once(const gchar *source, const gchar *mode, const gchar *location, gint blocksize, BenchRun *run) {
+	GstElement *pipeline, *src, *next;
+	GstPad *pad;
+	gchar *label;
+	gboolean ok;
+
+	pipeline = gst_pipeline_new("bench");
+	src = gst_element_factory_make(source, "source");
+	if (g_strcmp0(mode, "decode") == 0) {
+		next = gst_element_factory_make("decodebin", "decoder");
+		if (next != NULL)
+			g_signal_connect(next, "pad-added", G_CALLBACK(pad_added_cb), pipeline);
+	} else {
+		next = gst_element_factory_make("fakesink", "sink");
+		if (next != NULL)
+			g_object_set(next, "sync", FALSE, NULL);
+	}
+	if (!pipeline || !src || !next) {
+		g_printerr("Not all elements could be created.\n");
+		return FALSE;
+	}
+	g_object_set(src, "location", location, NULL);
+	if (blocksize > 0)
+		g_object_set(src, "blocksize", (guint)blocksize, NULL);
+	gst_bin_add_many(GST_BIN(pipeline), src, next, NULL);
+	gst_element_link(src, next);
+
+	pad = gst_element_get_static_pad(src, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)count_cb, run, NULL);
+	gst_object_unref(pad);
+
+	run->bytes = 0;
+	label = g_strdup_printf("%s %s", source, mode);
+	read_counters(&run->start);
+	ok = bench_run_till_eos(pipeline, label);
+	read_counters(&run->end);
+	g_free(label);
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	gint repeat = DEFAULT_REPEAT, blocksize = 0, s, m, i, failures = 0;
+	gchar *sources_arg = NULL, *modes_arg = NULL;
+	gchar **sources, **modes;
+	GOptionEntry entries[] = {
+		{ "repeat", 'n', 0, G_OPTION_ARG_INT, &repeat, "Runs per source and mode (default 3)", "N" },
+		{ "sources", 's', 0, G_OPTION_ARG_STRING, &sources_arg, "Comma separated sources (default filesrc,mmapsrc)", "LIST" },
+		{ "modes", 'm', 0, G_OPTION_ARG_STRING, &modes_arg, "Comma separated modes (default read,decode)", "LIST" },
+		{ "blocksize", 'b', 0, G_OPTION_ARG_INT, &blocksize, "Push mode buffer size for all sources (default: their own)", "BYTES" },
+		{ NULL }
+	};
+
+	if (!bench_parse_options(&argc, &argv, "FILE - filesrc vs mmapsrc benchmark", entries))
+		return -1;
+
+	if (argc < 2 || repeat <= 0) {
+		g_printerr("Usage: %s [OPTIONS] FILE\n", argv[0]);
+		return -1;
+	}
+	/* only used by name, playbin keeps using filesrc */
+	gst_mmap_src_register(GST_RANK_NONE);
+
+	sources = g_strsplit(sources_arg ? sources_arg : "filesrc,mmapsrc", ",", -1);
+	modes = g_strsplit(modes_arg ? modes_arg : "read,decode", ",", -1);
+	for (m = 0; modes[m] != NULL; m++) {
+		for (s = 0; sources[s] != NULL; s++) {
+			guint64 bytes = 0, copied = 0, syscalls = 0, minflt = 0, majflt = 0;
+			GstClockTime time = 0, best = GST_CLOCK_TIME_NONE;
+			gint ok_runs = 0;
+
+			for (i = 0; i < repeat; i++) {
+				BenchRun run;
+				GstClockTime elapsed;
+
+				if (!run_once(sources[s], modes[m], argv[1], blocksize, &run)) {
+					failures++;
+					continue;
+				}
+				elapsed = run.end.time - run.start.time;
+				bytes += run.bytes;
+				copied += run.end.rchar - run.start.rchar;
+				syscalls += run.end.syscr - run.start.syscr;
+				minflt += run.end.minflt - run.start.minflt;
+				majflt += run.end.majflt - run.start.majflt;
+				time += elapsed;
+				best = MIN(best, elapsed);
+				ok_runs++;
+			}
+			if (ok_runs == 0)
+				continue;
+
+			g_print("{\"source\":\"%s\",\"mode\":\"%s\",\"runs\":%d,\"bytes\":%" G_GUINT64_FORMAT
+					",\"read_syscalls\":%" G_GUINT64_FORMAT ",\"bytes_copied\":%" G_GUINT64_FORMAT
+					",\"minor_faults\":%" G_GUINT64_FORMAT ",\"major_faults\":%" G_GUINT64_FORMAT
+					",\"time_ms\":%.2f,\"mb_per_s\":%.1f,\"best_mb_per_s\":%.1f}\n",
+					sources[s], modes[m], ok_runs, bytes / ok_runs, syscalls / ok_runs, copied / ok_runs,
+					minflt / ok_runs, majflt / ok_runs, (gdouble)time / ok_runs / GST_MSECOND,
+					(gdouble)bytes / (1024 * 1024) / ((gdouble)time / GST_SECOND),
+					(gdouble)bytes / ok_runs / (1024 * 1024) / ((gdouble)best / GST_SECOND));
+		}
+	}
+
+	g_strfreev(sources);
+	g_strfreev(modes);
+	g_free(sources_arg);
+	g_free(modes_arg);
+	return failures ? 1 : 0;
+}
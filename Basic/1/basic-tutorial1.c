@@ -1,20 +1,197 @@
+/*
+ * build: gcc basic-tutorial1.c ../../Common/startup-profiler.c ../../Elements/gstmmapsrc.c -o basic-tutorial1 \
+ *            $(pkg-config --cflags --libs gstreamer-1.0 gstreamer-base-1.0)
+ *
+ * usage: basic-tutorial1 [--mmap] [FILE|URI ...]
+ *        With several entries they are played back to back on one pipeline.
+ *        --mmap reads local files through mmapsrc instead of filesrc.
+ */
 #include <gst/gst.h>
 
+#include "../../Common/startup-profiler.h"
+#include "../../Elements/gstmmapsrc.h"
+
+/* Playlist state, shared between the bus loop and streaming threads */
+typedef struct _Playlist {
+  GstElement *playbin;
+  gchar **uris;
+  gint n_uris;
+  gint current;               /* index of the uri playing (or queued) */
+  gint switch_pending;        /* next uri queued, its segment not seen yet */
+
+  /* audio sink side, only touched from the audio streaming thread */
+  GstSegment segment;
+  gboolean new_track;         /* next buffer is the first of a new track */
+  GstClockTime last_end;      /* running time end of last buffer */
+  GstClockTime last_arrival;  /* wall clock arrival of last buffer */
+} Playlist;
+
+/* Called from a streaming thread when the current uri is almost consumed:
+ * queue the next one so playbin can preroll it before the boundary */
+static void about_to_finish_cb (GstElement *playbin, Playlist *playlist) {
+  gint next = g_atomic_int_get (&playlist->current) + 1;
+
+  if (next >= playlist->n_uris)
+    return;
+
+  g_print ("Queueing track %d: %s\n", next, playlist->uris[next]);
+  g_object_set (playbin, "uri", playlist->uris[next], NULL);
+  g_atomic_int_set (&playlist->current, next);
+  g_atomic_int_set (&playlist->switch_pending, TRUE);
+}
+
+/* Track segments on the audio sink, the one after a switch starts the new track */
+static GstPadProbeReturn event_probe_cb (GstPad *pad, GstPadProbeInfo *info, Playlist *playlist) {
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      gst_segment_init (&playlist->segment, GST_FORMAT_TIME);
+      playlist->last_end = GST_CLOCK_TIME_NONE;
+      break;
+    case GST_EVENT_SEGMENT: {
+      const GstSegment *segment;
+
+      gst_event_parse_segment (event, &segment);
+      if (segment->format == GST_FORMAT_TIME)
+        gst_segment_copy_into (segment, &playlist->segment);
+      if (g_atomic_int_compare_and_exchange (&playlist->switch_pending, TRUE, FALSE))
+        playlist->new_track = TRUE;
+      break;
+    }
+    default:
+      break;
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+/* Measure the hole between the last buffer of a track and the first of the next */
+static GstPadProbeReturn buffer_probe_cb (GstPad *pad, GstPadProbeInfo *info, Playlist *playlist) {
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime ts = GST_BUFFER_PTS (buffer);
+  GstClockTime now = gst_util_get_timestamp ();
+  GstClockTime running;
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts))
+    return GST_PAD_PROBE_OK;
+
+  running = gst_segment_to_running_time (&playlist->segment, GST_FORMAT_TIME, ts);
+  if (!GST_CLOCK_TIME_IS_VALID (running))
+    return GST_PAD_PROBE_OK;
+
+  if (playlist->new_track) {
+    playlist->new_track = FALSE;
+    if (GST_CLOCK_TIME_IS_VALID (playlist->last_end)) {
+      g_print ("Track %d started, gap %.3f ms (buffer arrival gap %.3f ms)\n",
+          g_atomic_int_get (&playlist->current),
+          GST_CLOCK_DIFF (playlist->last_end, running) / 1e6,
+          GST_CLOCK_DIFF (playlist->last_arrival, now) / 1e6);
+    }
+  }
+
+  playlist->last_end = running;
+  if (GST_BUFFER_DURATION_IS_VALID (buffer))
+    playlist->last_end += GST_BUFFER_DURATION (buffer);
+  playlist->last_arrival = now;
+  return GST_PAD_PROBE_OK;
+}
+
+/* Accept plain file names next to uris */
+static gchar *to_uri (const gchar *arg) {
+  GError *err = NULL;
+  gchar *uri;
+
+  if (gst_uri_is_valid (arg))
+    return g_strdup (arg);
+
+  uri = gst_filename_to_uri (arg, &err);
+  if (uri == NULL) {
+    g_printerr ("Bad file name '%s': %s\n", arg, err->message);
+    g_clear_error (&err);
+  }
+  return uri;
+}
+
 int main(int argc, char *argv[]) {
-  GstElement *pipeline;
+  GstElement *pipeline, *audio_sink;
   GstBus *bus;
   GstMessage *msg;
+  GstPad *pad;
+  Playlist playlist = { 0 };
+  gint i;
+  gboolean use_mmap = FALSE;
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GOptionEntry entries[] = {
+    { "mmap", 'm', 0, G_OPTION_ARG_NONE, &use_mmap, "Read local files without copying, through mmapsrc", NULL },
+    { NULL }
+  };
+
+  /* Opt-in startup profiling, see startup-profiler.h */
+  startup_profiler_init ();
+
+  /* Initialize GStreamer, along with our options */
+  ctx = g_option_context_new ("[FILE|URI ...] - playbin playlist tutorial");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Failed to parse options: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return -1;
+  }
+  g_option_context_free (ctx);
+  startup_profiler_mark ("gst_init");
+
+  /* Outrank filesrc, so playbin picks mmapsrc for file:// uris */
+  if (use_mmap && !gst_mmap_src_register (GST_RANK_PRIMARY + 1)) {
+    g_printerr ("Could not register mmapsrc.\n");
+    return -1;
+  }
+
+  /* Collect the playlist, the default single file if nothing given */
+  if (argc > 1) {
+    playlist.uris = g_new0 (gchar *, argc);
+    for (i = 1; i < argc; i++) {
+      playlist.uris[playlist.n_uris] = to_uri (argv[i]);
+      if (playlist.uris[playlist.n_uris] == NULL) {
+        g_strfreev (playlist.uris);
+        return -1;
+      }
+      playlist.n_uris++;
+    }
+  } else {
+    playlist.uris = g_new0 (gchar *, 2);
+    playlist.uris[0] = g_strdup ("file:///home/sagar/1.mp3");
+    playlist.n_uris = 1;
+  }
+  gst_segment_init (&playlist.segment, GST_FORMAT_TIME);
+  playlist.last_end = playlist.last_arrival = GST_CLOCK_TIME_NONE;
 
-  /* Initialize GStreamer */
-  gst_init (&argc, &argv);
+  /* Build the pipeline, one playbin for the whole playlist */
+  pipeline = gst_parse_launch ("playbin", NULL);
+  audio_sink = gst_element_factory_make ("autoaudiosink", "audio-sink");
+  startup_profiler_mark ("pipeline created");
+  if (!pipeline || !audio_sink) {
+    g_printerr ("Not all elements could be created.\n");
+    return -1;
+  }
+  playlist.playbin = pipeline;
+  g_object_set (pipeline, "uri", playlist.uris[0], "audio-sink", audio_sink, NULL);
+  g_signal_connect (pipeline, "about-to-finish", G_CALLBACK (about_to_finish_cb), &playlist);
+  startup_profiler_watch (pipeline);
 
-  /* Build the pipeline */
-  pipeline = gst_parse_launch ("playbin2 uri=file:///home/sagar/1.mp3", NULL);
+  /* Watch what reaches the audio sink to measure gaps between tracks */
+  pad = gst_element_get_static_pad (audio_sink, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      (GstPadProbeCallback) event_probe_cb, &playlist, NULL);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) buffer_probe_cb, &playlist, NULL);
+  gst_object_unref (pad);
 
   /* Start playing */
   gst_element_set_state (pipeline, GST_STATE_PLAYING);
 
-  /* Wait until error or EOS */
+  /* Wait until error or EOS, which only comes after the last track */
   bus = gst_element_get_bus (pipeline);
   msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
 
@@ -24,5 +201,6 @@ int main(int argc, char *argv[]) {
   gst_object_unref (bus);
   gst_element_set_state (pipeline, GST_STATE_NULL);
   gst_object_unref (pipeline);
+  g_strfreev (playlist.uris);
   return 0;
 }
@@ -0,0 +1,240 @@
+/*
+ * Headless throughput benchmark for the basic-tutorial2 pipeline.
+ *
+ * source -> capsfilter -> fakesink (sync=false), run for a fixed buffer
+ * count over a grid of sources, resolutions, formats and patterns. Sources
+ * are videotestsrc and fastvideosrc by default, --static-frame turns on
+ * fastvideosrc's push-by-reference mode. One JSON object is printed per grid
+ * point so results can be diffed between runs.
+ *
+ * Buffer memory allocations are counted through Common/alloc-counter:
+ * "allocations" over the whole run, "allocs_per_frame" from the first buffer
+ * on, what a recycling pool should bring close to zero.
+ *
+ * build: gcc basic-tutorial2-bench.c ../../Common/latency-stats.c ../../Common/alloc-counter.c \
+ *            ../../Common/bench-util.c ../../Elements/gstfastvideosrc.c ../../Elements/simd.c \
+ *            -o basic-tutorial2-bench -lm \
+ *            $(pkg-config --cflags --libs gstreamer-1.0 gstreamer-base-1.0 gstreamer-video-1.0)
+ */
+#include <string.h>
+#include <gst/gst.h>
+
+#include "../../Common/bench-util.h"
+#include "../../Common/latency-stats.h"
+#include "../../Common/alloc-counter.h"
+#include "../../Elements/gstfastvideosrc.h"
+
+/* default grid, overridable from command line */
+#define DEFAULT_SOURCES "videotestsrc,fastvideosrc"
+#define DEFAULT_RESOLUTIONS "320x240,640x480,1280x720,1920x1080,3840x2160"
+#define DEFAULT_FORMATS "I420,YUY2,BGRx"
+#define DEFAULT_PATTERNS "smpte,snow,black,ball"
+#define DEFAULT_BUFFERS 300
+
+/* one source, size, format and pattern; the sink's handoff fills it */
+typedef struct _BenchRun {
+	guint64 frames;		/* buffers seen at sink */
+	guint64 bytes;		/* payload bytes seen at sink */
+	GstClockTime first;	/* arrival of first buffer */
+	GstClockTime last;	/* arrival of last buffer */
+	LatencyStats *interval;	/* time between two buffers arriving at the sink */
+	gint allocated;		/* fastvideosrc buffers-allocated, -1 for other sources */
+	guint64 allocs_first;	/* alloc counter at first buffer */
+	guint64 allocs_last;	/* alloc counter at last buffer */
+	guint64 allocs_total;	/* alloc counter at EOS, reset at start */
+} BenchRun;
+
+/*
+ * @brief fakesink handoff, called for every buffer reaching the sink
+ *        Pipeline has no queues, so the interval between two handoffs is
+ *        the full cost of producing and pushing one buffer.
+ */
+static void handoff_cb(GstElement *sink, GstBuffer *buffer, GstPad *pad, BenchRun *run) {
+	GstClockTime now = gst_util_get_timestamp();
+
+	guint64 allocs = alloc_counter_get_count();
+
+	if (GST_CLOCK_TIME_IS_VALID(run->last)) {
+		latency_stats_add(run->interval, GST_CLOCK_DIFF(run->last, now));
+	} else {
+		run->first = now;
+		run->allocs_first = allocs;
+	}
+	run->last = now;
+	run->allocs_last = allocs;
+	run->frames++;
+	run->bytes += gst_buffer_get_size(buffer);
+}
+
+/*
+ * @brief push n_buffers from one source through the capsfilter
+ * @return FALSE if pipeline couldn't be built or errored out
+ * */
+static gboolean run_once(const gchar *source_name, gboolean static_frame, gint width, gint height, const gchar *format,
+		const gchar *pattern, gint n_buffers, BenchRun *run) {
+	GstElement *pipeline, *source, *filter, *sink;
+	GstCaps *caps;
+	gchar *label;
+	gboolean ok;
+
+	source = gst_element_factory_make(source_name, "source");
+	filter = gst_element_factory_make("capsfilter", "filter");
+	sink = gst_element_factory_make("fakesink", "sink");
+	pipeline = gst_pipeline_new("bench-pipeline");
+
+	if (!pipeline || !source || !filter || !sink) {
+		g_printerr("All elements are not created\n");
+		return FALSE;
+	}
+
+	gst_bin_add_many(GST_BIN(pipeline), source, filter, sink, NULL);
+	if (!gst_element_link_many(source, filter, sink, NULL)) {
+		g_printerr("Element could not be linked.\n");
+		gst_object_unref(pipeline);
+		return FALSE;
+	}
+
+	caps = bench_video_caps(format, width, height);
+	g_object_set(filter, "caps", caps, NULL);
+	gst_caps_unref(caps);
+
+	g_object_set(source, "num-buffers", n_buffers, NULL);
+	gst_util_set_object_arg(G_OBJECT(source), "pattern", pattern);
+	if (static_frame && g_object_class_find_property(G_OBJECT_GET_CLASS(source), "static-frame"))
+		g_object_set(source, "static-frame", TRUE, NULL);
+	/* don't wait on the clock, don't keep last buffer around */
+	g_object_set(sink, "sync", FALSE, "enable-last-sample", FALSE, "signal-handoffs", TRUE, NULL);
+	g_signal_connect(sink, "handoff", G_CALLBACK(handoff_cb), run);
+
+	alloc_counter_reset();
+	label = g_strdup_printf("%s %dx%d %s %s", source_name, width, height, format, pattern);
+	ok = bench_run_till_eos(pipeline, label);
+	g_free(label);
+	run->allocs_total = alloc_counter_get_count();
+
+	run->allocated = -1;
+	if (g_object_class_find_property(G_OBJECT_GET_CLASS(source), "buffers-allocated")) {
+		guint allocated;
+
+		g_object_get(source, "buffers-allocated", &allocated, NULL);
+		run->allocated = allocated;
+	}
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+	return ok;
+}
+
+/* @brief print result of one grid point as a single JSON line */
+static void print_run(const gchar *source, gboolean static_frame, gint width, gint height, const gchar *format,
+		const gchar *pattern, gint n_buffers, BenchRun *run) {
+	gdouble elapsed = 0.0, fps = 0.0, bps = 0.0, allocs_per_frame = 0.0;
+	gchar *interval;
+
+	/* first buffer starts the window, so it isn't counted in the rate */
+	if (run->frames > 1) {
+		allocs_per_frame = (gdouble)(run->allocs_last - run->allocs_first) / (run->frames - 1);
+		elapsed = (gdouble)GST_CLOCK_DIFF(run->first, run->last) / GST_SECOND;
+		if (elapsed > 0.0) {
+			fps = (run->frames - 1) / elapsed;
+			bps = (gdouble)run->bytes * (run->frames - 1) / run->frames / elapsed;
+		}
+	}
+
+	interval = latency_stats_to_json(run->interval);
+	g_print("{\"source\":\"%s\",\"static_frame\":%s,\"resolution\":\"%dx%d\",\"format\":\"%s\",\"pattern\":\"%s\","
+			"\"buffers\":%d,\"frames\":%" G_GUINT64_FORMAT ",\"bytes\":%" G_GUINT64_FORMAT ",\"elapsed_s\":%.6f,"
+			"\"fps\":%.2f,\"bytes_per_sec\":%.0f,\"buffers_allocated\":%d,\"allocations\":%" G_GUINT64_FORMAT ","
+			"\"allocs_per_frame\":%.3f,\"interval\":%s}\n",
+			source, static_frame ? "true" : "false", width, height, format, pattern,
+			n_buffers, run->frames, run->bytes, elapsed, fps, bps, run->allocated, run->allocs_total,
+			allocs_per_frame, interval);
+	g_free(interval);
+}
+
+int main(int argc, char *argv[]) {
+	gint n_buffers = DEFAULT_BUFFERS;
+	gboolean static_frame = FALSE;
+	gchar *sources_arg = NULL, *resolutions_arg = NULL, *formats_arg = NULL, *patterns_arg = NULL;
+	gchar **sources, **resolutions, **fmts, **patterns;
+	gint s, r, f, p, failures = 0;
+	GOptionEntry entries[] = {
+		{ "sources", 's', 0, G_OPTION_ARG_STRING, &sources_arg, "Comma separated sources (default " DEFAULT_SOURCES ")", "LIST" },
+		{ "static-frame", 0, 0, G_OPTION_ARG_NONE, &static_frame, "Push one painted frame by reference (fastvideosrc)", NULL },
+		{ "buffers", 'n', 0, G_OPTION_ARG_INT, &n_buffers, "Buffers per grid point (default 300)", "N" },
+		{ "resolutions", 'r', 0, G_OPTION_ARG_STRING, &resolutions_arg, "Comma separated WxH list (default " DEFAULT_RESOLUTIONS ")", "LIST" },
+		{ "formats", 'f', 0, G_OPTION_ARG_STRING, &formats_arg, "Comma separated formats of " BENCH_VIDEO_FORMATS " (default " DEFAULT_FORMATS ")", "LIST" },
+		{ "patterns", 'p', 0, G_OPTION_ARG_STRING, &patterns_arg, "Comma separated videotestsrc pattern nicks (default " DEFAULT_PATTERNS ")", "LIST" },
+		{ NULL }
+	};
+
+	/* initialize gstreamer, along with our options */
+	if (!bench_parse_options(&argc, &argv, "- test source throughput benchmark", entries))
+		return -1;
+
+	if (n_buffers < 2) {
+		g_printerr("Need at least 2 buffers per grid point\n");
+		return -1;
+	}
+
+	/* only used by name */
+	gst_fast_video_src_register(GST_RANK_NONE);
+	if (!alloc_counter_install()) {
+		g_printerr("Could not install the allocation counter\n");
+		return -1;
+	}
+
+	sources = g_strsplit(sources_arg ? sources_arg : DEFAULT_SOURCES, ",", -1);
+	resolutions = g_strsplit(resolutions_arg ? resolutions_arg : DEFAULT_RESOLUTIONS, ",", -1);
+	fmts = g_strsplit(formats_arg ? formats_arg : DEFAULT_FORMATS, ",", -1);
+	patterns = g_strsplit(patterns_arg ? patterns_arg : DEFAULT_PATTERNS, ",", -1);
+
+	for (f = 0; fmts[f] != NULL; f++) {
+		GstCaps *caps = bench_video_caps(fmts[f], 1, 1);
+
+		if (caps == NULL) {
+			g_printerr("Unknown format '%s'\n", fmts[f]);
+			return -1;
+		}
+		gst_caps_unref(caps);
+	}
+
+	for (r = 0; resolutions[r] != NULL; r++) {
+		gint width, height;
+
+		if (!bench_parse_resolution(resolutions[r], &width, &height)) {
+			g_printerr("Bad resolution '%s'\n", resolutions[r]);
+			failures++;
+			continue;
+		}
+
+		for (f = 0; fmts[f] != NULL; f++) {
+			for (p = 0; patterns[p] != NULL; p++) {
+				for (s = 0; sources[s] != NULL; s++) {
+					BenchRun run;
+
+					memset(&run, 0, sizeof(run));
+					run.first = run.last = GST_CLOCK_TIME_NONE;
+					run.interval = latency_stats_new();
+
+					if (run_once(sources[s], static_frame, width, height, fmts[f], patterns[p], n_buffers, &run)) {
+						print_run(sources[s], static_frame, width, height, fmts[f], patterns[p], n_buffers, &run);
+					} else {
+						failures++;
+					}
+					latency_stats_free(run.interval);
+				}
+			}
+		}
+	}
+
+	g_strfreev(sources);
+	g_strfreev(resolutions);
+	g_strfreev(fmts);
+	g_strfreev(patterns);
+	g_free(sources_arg);
+	g_free(resolutions_arg);
+	g_free(formats_arg);
+	g_free(patterns_arg);
+	return failures ? 1 : 0;
+}
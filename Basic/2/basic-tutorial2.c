@@ -1,20 +1,51 @@
+/*
+ * build: gcc basic-tutorial2.c ../../Common/startup-profiler.c ../../Elements/gstfastvideosrc.c \
+ *            ../../Elements/simd.c -o basic-tutorial2 -lm \
+ *            $(pkg-config --cflags --libs gstreamer-1.0 gstreamer-base-1.0 gstreamer-video-1.0)
+ */
 #include <gst/gst.h>
 
+#include "../../Common/startup-profiler.h"
+#include "../../Elements/gstfastvideosrc.h"
+
 int main(int argc, char* argv[]) {
     GstElement *pipeline, *source, *sink;
     GstBus *bus;
     GstMessage *msg;
     GstStateChangeReturn ret;
+    gboolean fast = FALSE;
+    GOptionContext *ctx;
+    GError *err = NULL;
+    GOptionEntry entries[] = {
+        { "fast", 0, 0, G_OPTION_ARG_NONE, &fast, "Use fastvideosrc instead of videotestsrc", NULL },
+        { NULL }
+    };
 
-    /* initialize gstreamer */
-    gst_init(&argc, &argv);
+    /* opt-in startup profiling, see startup-profiler.h */
+    startup_profiler_init();
 
-    /* create elements */
-    source = gst_element_factory_make("videotestsrc", "source");
+    /* initialize gstreamer, along with our options */
+    ctx = g_option_context_new("- test pattern");
+    g_option_context_add_main_entries(ctx, entries, NULL);
+    g_option_context_add_group(ctx, gst_init_get_option_group());
+    if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+        g_printerr("Failed to parse options: %s\n", err->message);
+        g_clear_error(&err);
+        g_option_context_free(ctx);
+        return -1;
+    }
+    g_option_context_free(ctx);
+    startup_profiler_mark("gst_init");
+
+    /* create elements, fastvideosrc takes the same pattern values */
+    if (fast)
+        gst_fast_video_src_register(GST_RANK_NONE);
+    source = gst_element_factory_make(fast ? "fastvideosrc" : "videotestsrc", "source");
     sink = gst_element_factory_make("autovideosink", "sink");
 
     /* create pipeline */
     pipeline = gst_pipeline_new("test-pipeline");
+    startup_profiler_mark("elements created");
 
     if (!pipeline || !source || !sink) {
         g_printerr("All elements are not created\n");
@@ -29,6 +60,8 @@ int main(int argc, char* argv[]) {
         return -1;
     }
 
+    startup_profiler_watch(pipeline);
+
     /* set source properties */
     g_object_set(source, "pattern", 0, NULL);
 
@@ -0,0 +1,213 @@
+/*
+ * Buffer allocation benchmark for the basic-tutorial3 pipeline on local media.
+ *
+ * uridecodebin -> queue -> converter -> sink for the raw video stream, like
+ * a basic-tutorial3 branch, unsynchronized so the file plays as fast as the
+ * pipeline goes. Buffer memory allocations are counted through
+ * Common/alloc-counter from the first video frame reaching the sink to the
+ * last one: with pools negotiated through the allocation query the decoders
+ * and converters recycle their buffers and the count per frame drops towards
+ * zero. A sink that proposes a pool of its own (e.g. xvimagesink) lets the
+ * converter render straight into sink memory. One JSON line per converter
+ * and sink, averaged over --repeat runs.
+ *
+ * The counter is process wide, so audio and subtitle streams are neither
+ * decoded nor linked: decodebin stops at their encoded caps, and the
+ * demuxer's packets for them are all they add to the video figure.
+ *
+ * build: gcc basic-tutorial3-alloc-bench.c ../../Common/alloc-counter.c ../../Common/bench-util.c \
+ *            ../../Elements/gstfastcolorspace.c ../../Elements/simd.c -o basic-tutorial3-alloc-bench \
+ *            $(pkg-config --cflags --libs gstreamer-1.0 gstreamer-base-1.0 gstreamer-video-1.0)
+ */
+#include <string.h>
+#include <gst/gst.h>
+
+#include "../../Common/alloc-counter.h"
+#include "../../Common/bench-util.h"
+#include "../../Elements/gstfastcolorspace.h"
+
+#define DEFAULT_CONVERTERS "videoconvert,fastcolorspace"
+#define DEFAULT_SINKS "fakesink"
+#define DEFAULT_REPEAT 3
+
+/* one run, video sink side filled from its streaming thread */
+typedef struct _BenchRun {
+	GstElement *pipeline;
+	const gchar *converter;
+	const gchar *sink;
+
+	guint64 frames;		/* video frames at the sink */
+	GstClockTime first;	/* arrival of the first one */
+	GstClockTime last;
+	guint64 allocs_first;	/* alloc counter at the first frame */
+	guint64 allocs_last;
+	guint64 bytes_first;	/* allocated bytes at the first frame */
+	guint64 bytes_last;
+} BenchRun;
+
+static GstPadProbeReturn frame_cb(GstPad *pad, GstPadProbeInfo *info, BenchRun *run) {
+	GstClockTime now = gst_util_get_timestamp();
+
+	run->allocs_last = alloc_counter_get_count();
+	run->bytes_last = alloc_counter_get_bytes();
+	if (run->frames == 0) {
+		run->first = now;
+		run->allocs_first = run->allocs_last;
+		run->bytes_first = run->bytes_last;
+	}
+	run->last = now;
+	run->frames++;
+	return GST_PAD_PROBE_OK;
+}
+
+static GstElement *make_element(const gchar *factory) {
+	GstElement *element = gst_element_factory_make(factory, NULL);
+
+	/* as fast as it goes, nothing waits on the clock */
+	if (element != NULL && g_object_class_find_property(G_OBJECT_GET_CLASS(element), "sync"))
+		g_object_set(element, "sync", FALSE, NULL);
+	return element;
+}
+
+/* @brief don't decode what isn't video, its allocations would count against the video frames */
+static gboolean autoplug_continue_cb(GstElement *bin, GstPad *pad, GstCaps *caps, BenchRun *run) {
+	const gchar *name = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+
+	return !g_str_has_prefix(name, "audio/") && !g_str_has_prefix(name, "text/") &&
+			!g_str_has_prefix(name, "subpicture/");
+}
+
+/* @brief basic-tutorial3 branch with the converter and sink under test, other streams stay unlinked */
+static void pad_added_cb(GstElement *src, GstPad *pad, BenchRun *run) {
+	GstCaps *caps = gst_pad_get_current_caps(pad);
+	gboolean video;
+	GstElement *queue, *convert, *sink;
+	GstPad *sink_pad;
+
+	if (caps == NULL)
+		return;
+	video = g_str_has_prefix(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "video/x-raw");
+	gst_caps_unref(caps);
+	if (!video)
+		return;
+
+	queue = make_element("queue");
+	convert = make_element(run->converter);
+	sink = make_element(run->sink);
+	if (!queue || !convert || !sink) {
+		g_printerr("Couldn't create branch elements\n");
+		return;
+	}
+	gst_bin_add_many(GST_BIN(run->pipeline), queue, convert, sink, NULL);
+	gst_element_link_many(queue, convert, sink, NULL);
+	gst_element_sync_state_with_parent(sink);
+	gst_element_sync_state_with_parent(convert);
+	gst_element_sync_state_with_parent(queue);
+
+	sink_pad = gst_element_get_static_pad(sink, "sink");
+	gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)frame_cb, run, NULL);
+	gst_object_unref(sink_pad);
+
+	sink_pad = gst_element_get_static_pad(queue, "sink");
+	if (GST_PAD_LINK_FAILED(gst_pad_link(pad, sink_pad)))
+		g_printerr("Couldn't link %s\n", GST_PAD_NAME(pad));
+	gst_object_unref(sink_pad);
+}
+
+/* @brief play uri to EOS */
+static gboolean run_once(const gchar *uri, BenchRun *run) {
+	GstElement *source;
+	gchar *label;
+	gboolean ok;
+
+	run->pipeline = gst_pipeline_new("bench");
+	source = gst_element_factory_make("uridecodebin", NULL);
+	if (!run->pipeline || !source) {
+		g_printerr("Not all elements could be created.\n");
+		return FALSE;
+	}
+	gst_bin_add(GST_BIN(run->pipeline), source);
+	g_object_set(source, "uri", uri, NULL);
+	g_signal_connect(source, "autoplug-continue", G_CALLBACK(autoplug_continue_cb), run);
+	g_signal_connect(source, "pad-added", G_CALLBACK(pad_added_cb), run);
+
+	alloc_counter_reset();
+	label = g_strdup_printf("%s/%s", run->converter, run->sink);
+	ok = bench_run_till_eos(run->pipeline, label);
+	g_free(label);
+	gst_element_set_state(run->pipeline, GST_STATE_NULL);
+	gst_object_unref(run->pipeline);
+	return ok && run->frames > 1;
+}
+
+int main(int argc, char *argv[]) {
+	gint repeat = DEFAULT_REPEAT, c, s, i, failures = 0;
+	gchar *converters_arg = NULL, *sinks_arg = NULL, *uri;
+	gchar **converters, **sinks;
+	GOptionEntry entries[] = {
+		{ "repeat", 'n', 0, G_OPTION_ARG_INT, &repeat, "Runs per converter and sink (default 3)", "N" },
+		{ "converters", 'c', 0, G_OPTION_ARG_STRING, &converters_arg, "Comma separated video converters (default " DEFAULT_CONVERTERS ")", "LIST" },
+		{ "sinks", 's', 0, G_OPTION_ARG_STRING, &sinks_arg, "Comma separated video sinks (default " DEFAULT_SINKS ")", "LIST" },
+		{ NULL }
+	};
+
+	if (!bench_parse_options(&argc, &argv, "FILE - buffer allocation benchmark", entries))
+		return -1;
+
+	if (argc < 2 || repeat <= 0) {
+		g_printerr("Usage: %s [OPTIONS] FILE\n", argv[0]);
+		return -1;
+	}
+	uri = bench_uri_from_arg(argv[1]);
+	if (uri == NULL)
+		return -1;
+
+	gst_fast_colorspace_register(GST_RANK_NONE);
+	if (!alloc_counter_install()) {
+		g_printerr("Could not install the allocation counter\n");
+		return -1;
+	}
+
+	converters = g_strsplit(converters_arg ? converters_arg : DEFAULT_CONVERTERS, ",", -1);
+	sinks = g_strsplit(sinks_arg ? sinks_arg : DEFAULT_SINKS, ",", -1);
+	for (s = 0; sinks[s] != NULL; s++) {
+		for (c = 0; converters[c] != NULL; c++) {
+			guint64 frames = 0, allocs = 0, bytes = 0;
+			GstClockTime time = 0;
+			gint ok_runs = 0;
+
+			for (i = 0; i < repeat; i++) {
+				BenchRun run;
+
+				memset(&run, 0, sizeof(run));
+				run.converter = converters[c];
+				run.sink = sinks[s];
+				if (!run_once(uri, &run)) {
+					failures++;
+					continue;
+				}
+				/* the first frame opens the window */
+				frames += run.frames - 1;
+				allocs += run.allocs_last - run.allocs_first;
+				bytes += run.bytes_last - run.bytes_first;
+				time += run.last - run.first;
+				ok_runs++;
+			}
+			if (ok_runs == 0 || frames == 0)
+				continue;
+
+			g_print("{\"converter\":\"%s\",\"sink\":\"%s\",\"runs\":%d,\"frames\":%" G_GUINT64_FORMAT ","
+					"\"fps\":%.1f,\"allocs_per_frame\":%.3f,\"alloc_bytes_per_frame\":%.0f}\n",
+					converters[c], sinks[s], ok_runs, frames / ok_runs,
+					time > 0 ? (gdouble)frames * GST_SECOND / time : 0.0,
+					(gdouble)allocs / frames, (gdouble)bytes / frames);
+		}
+	}
+
+	g_strfreev(converters);
+	g_strfreev(sinks);
+	g_free(converters_arg);
+	g_free(sinks_arg);
+	g_free(uri);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Audio conversion benchmark: audioconvert against fastaudioconvert.
+ *
+ * audiotestsrc -> audioconvert -> capsfilter (input format) -> converter ->
+ * capsfilter (output format) -> fakesink, per converter and conversion. The
+ * first audioconvert only widens the test signal to the input layout. Buffer
+ * probes on both converter pads time every buffer inside the converter,
+ * which converts in the streaming thread. One JSON line per converter and
+ * conversion, with throughput in input frames and samples per second.
+ *
+ * Conversions are IN>OUT, each FORMAT:CHANNELS with FORMAT one of S16, S32
+ * or F32, e.g. "F32:6>S16:2" is a 5.1 float downmix to 16 bit stereo.
+ * Layouts above stereo are fastaudioconvert's defaults for the channel
+ * count, so both converters mix the same channels.
+ *
+ * build: gcc basic-tutorial3-audioconvert-bench.c ../../Common/latency-stats.c ../../Common/bench-util.c \
+ *            ../../Elements/gstfastaudioconvert.c ../../Elements/simd.c \
+ *            -o basic-tutorial3-audioconvert-bench \
+ *            $(pkg-config --cflags --libs gstreamer-1.0 gstreamer-base-1.0 gstreamer-audio-1.0) -lm
+ */
+#include <stdio.h>
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+#include "../../Common/bench-util.h"
+#include "../../Common/latency-stats.h"
+#include "../../Elements/gstfastaudioconvert.h"
+
+#define DEFAULT_CONVERTERS "audioconvert,fastaudioconvert"
+#define DEFAULT_CONVERSIONS "S16:2>F32:2,F32:2>S16:2,S32:2>S16:2,S16:6>S16:2,F32:6>F32:2,F32:8>S16:2,S16:2>S16:1"
+#define DEFAULT_BUFFERS 2000
+#define DEFAULT_FRAMES 1024
+#define RATE 48000
+
+static const struct {
+	const gchar *name;
+	const gchar *caps;
+} formats[] = {
+	{ "S16", "audio/x-raw, format=(string)" GST_AUDIO_NE(S16) ", layout=(string)interleaved" },
+	{ "S32", "audio/x-raw, format=(string)" GST_AUDIO_NE(S32) ", layout=(string)interleaved" },
+	{ "F32", "audio/x-raw, format=(string)" GST_AUDIO_NE(F32) ", layout=(string)interleaved" },
+};
+
+/* one converter at one conversion, the converter's pad probes fill it */
+typedef struct _BenchRun {
+	GstClockTime entered;	/* current buffer entered the converter */
+	LatencyStats *convert;	/* per buffer conversion time */
+} BenchRun;
+
+/* @brief caps for "FORMAT:CHANNELS", NULL if it doesn't parse */
+static GstCaps *spec_caps(const gchar *spec, gint *channels) {
+	gchar name[8];
+	GstCaps *caps;
+	guint64 mask;
+	guint i;
+
+	if (sscanf(spec, "%7[^:]:%d", name, channels) != 2 || *channels < 1 || *channels > GST_FAST_AUDIO_CONVERT_MAX_CHANNELS)
+		return NULL;
+	for (i = 0; i < G_N_ELEMENTS(formats); i++) {
+		if (g_strcmp0(formats[i].name, name) != 0)
+			continue;
+		caps = gst_caps_from_string(formats[i].caps);
+		gst_caps_set_simple(caps,
+				"rate", G_TYPE_INT, RATE,
+				"channels", G_TYPE_INT, *channels,
+				NULL);
+		/* caps need a channel-mask above stereo */
+		if (*channels > 2 && gst_audio_channel_positions_to_mask(gst_fast_audio_convert_default_positions(*channels),
+					*channels, FALSE, &mask))
+			gst_caps_set_simple(caps, "channel-mask", GST_TYPE_BITMASK, mask, NULL);
+		return caps;
+	}
+	return NULL;
+}
+
+static GstPadProbeReturn enter_cb(GstPad *pad, GstPadProbeInfo *info, BenchRun *run) {
+	run->entered = gst_util_get_timestamp();
+	return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn leave_cb(GstPad *pad, GstPadProbeInfo *info, BenchRun *run) {
+	if (GST_CLOCK_TIME_IS_VALID(run->entered))
+		latency_stats_add(run->convert, GST_CLOCK_DIFF(run->entered, gst_util_get_timestamp()));
+	run->entered = GST_CLOCK_TIME_NONE;
+	return GST_PAD_PROBE_OK;
+}
+
+/* @brief push n_buffers of white noise through one conversion */
+static gboolean run_once(const gchar *converter, const gchar *conversion, GstCaps *in_caps, GstCaps *out_caps,
+		gint n_buffers, gint frames, const gchar *simd, BenchRun *run) {
+	GstElement *pipeline, *source, *widen, *in_filter, *convert, *out_filter, *sink;
+	GstPad *pad;
+	gchar *label;
+	gboolean ok;
+
+	pipeline = gst_pipeline_new("bench-pipeline");
+	source = gst_element_factory_make("audiotestsrc", "source");
+	widen = gst_element_factory_make("audioconvert", "widen");
+	in_filter = bench_capsfilter_new(in_caps);
+	convert = gst_element_factory_make(converter, "convert");
+	out_filter = bench_capsfilter_new(out_caps);
+	sink = gst_element_factory_make("fakesink", "sink");
+	if (!pipeline || !source || !widen || !in_filter || !convert || !out_filter || !sink) {
+		g_printerr("Not all elements could be created.\n");
+		return FALSE;
+	}
+
+	gst_bin_add_many(GST_BIN(pipeline), source, widen, in_filter, convert, out_filter, sink, NULL);
+	if (!gst_element_link_many(source, widen, in_filter, convert, out_filter, sink, NULL)) {
+		g_printerr("Elements could not be linked.\n");
+		gst_object_unref(pipeline);
+		return FALSE;
+	}
+
+	/* white noise: full scale, no runs of silence */
+	g_object_set(source, "num-buffers", n_buffers, "samplesperbuffer", frames, NULL);
+	gst_util_set_object_arg(G_OBJECT(source), "wave", "white-noise");
+	g_object_set(sink, "sync", FALSE, NULL);
+	if (simd != NULL && g_object_class_find_property(G_OBJECT_GET_CLASS(convert), "simd"))
+		gst_util_set_object_arg(G_OBJECT(convert), "simd", simd);
+
+	run->entered = GST_CLOCK_TIME_NONE;
+	pad = gst_element_get_static_pad(convert, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)enter_cb, run, NULL);
+	gst_object_unref(pad);
+	pad = gst_element_get_static_pad(convert, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)leave_cb, run, NULL);
+	gst_object_unref(pad);
+
+	label = g_strdup_printf("%s %s", converter, conversion);
+	ok = bench_run_till_eos(pipeline, label);
+	g_free(label);
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	gint n_buffers = DEFAULT_BUFFERS, frames = DEFAULT_FRAMES;
+	gchar *converters_arg = NULL, *conversions_arg = NULL, *simd = NULL;
+	gchar **converters, **conversions;
+	gint c, v, failures = 0;
+	GOptionEntry entries[] = {
+		{ "buffers", 'n', 0, G_OPTION_ARG_INT, &n_buffers, "Buffers per grid point (default 2000)", "N" },
+		{ "frames", 'f', 0, G_OPTION_ARG_INT, &frames, "Frames per buffer (default 1024)", "N" },
+		{ "converters", 'c', 0, G_OPTION_ARG_STRING, &converters_arg, "Comma separated converters (default " DEFAULT_CONVERTERS ")", "LIST" },
+		{ "conversions", 'v', 0, G_OPTION_ARG_STRING, &conversions_arg, "Comma separated IN>OUT conversions, e.g. F32:6>S16:2", "LIST" },
+		{ "simd", 0, 0, G_OPTION_ARG_STRING, &simd, "fastaudioconvert kernels: auto, none, sse2, avx2", "LEVEL" },
+		{ NULL }
+	};
+
+	if (!bench_parse_options(&argc, &argv, "- audio converter benchmark", entries))
+		return -1;
+
+	gst_fast_audio_convert_register(GST_RANK_NONE);
+
+	converters = g_strsplit(converters_arg ? converters_arg : DEFAULT_CONVERTERS, ",", -1);
+	conversions = g_strsplit(conversions_arg ? conversions_arg : DEFAULT_CONVERSIONS, ",", -1);
+
+	for (v = 0; conversions[v] != NULL; v++) {
+		gchar **sides = g_strsplit(conversions[v], ">", 2);
+		GstCaps *in_caps = NULL, *out_caps = NULL;
+		gint in_channels, out_channels;
+
+		if (g_strv_length(sides) == 2) {
+			in_caps = spec_caps(sides[0], &in_channels);
+			out_caps = spec_caps(sides[1], &out_channels);
+		}
+		g_strfreev(sides);
+		if (in_caps == NULL || out_caps == NULL) {
+			g_printerr("Bad conversion '%s'\n", conversions[v]);
+			failures++;
+			if (in_caps)
+				gst_caps_unref(in_caps);
+			if (out_caps)
+				gst_caps_unref(out_caps);
+			continue;
+		}
+
+		for (c = 0; converters[c] != NULL; c++) {
+			BenchRun run;
+			gchar *stats;
+			gdouble mean, frames_per_s;
+
+			run.convert = latency_stats_new();
+			if (!run_once(converters[c], conversions[v], in_caps, out_caps, n_buffers, frames, simd, &run) ||
+					latency_stats_count(run.convert) == 0) {
+				failures++;
+				latency_stats_free(run.convert);
+				continue;
+			}
+
+			mean = latency_stats_mean(run.convert);
+			frames_per_s = mean > 0 ? frames * (gdouble)GST_SECOND / mean : 0.0;
+			stats = latency_stats_to_json(run.convert);
+			g_print("{\"converter\":\"%s\",\"conversion\":\"%s\",\"buffer_frames\":%d,"
+					"\"mframes_per_s\":%.2f,\"msamples_per_s\":%.2f,\"convert\":%s}\n",
+					converters[c], conversions[v], frames,
+					frames_per_s / 1e6, frames_per_s * in_channels / 1e6, stats);
+			g_free(stats);
+			latency_stats_free(run.convert);
+		}
+		gst_caps_unref(in_caps);
+		gst_caps_unref(out_caps);
+	}
+
+	g_strfreev(converters);
+	g_strfreev(conversions);
+	g_free(converters_arg);
+	g_free(conversions_arg);
+	g_free(simd);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * Colorspace conversion benchmark: videoconvert against fastcolorspace.
+ *
+ * videotestsrc -> capsfilter (input format) -> converter -> capsfilter
+ * (output format) -> fakesink, per converter, input format, output format
+ * and resolution. Buffer probes on both converter pads time every frame
+ * inside the converter: it converts in the streaming thread, so the time
+ * between a buffer entering and its result leaving is the conversion. One
+ * JSON line per grid point. "allocs_per_frame" counts buffer memory
+ * allocated per converted frame after the first (Common/alloc-counter), 0
+ * once the converter's output pool recycles.
+ *
+ * Both converters get the same --threads (default one per CPU), so the
+ * numbers compare kernels rather than videoconvert's single thread against
+ * a pool.
+ *
+ * build: gcc basic-tutorial3-colorspace-bench.c ../../Common/latency-stats.c ../../Common/alloc-counter.c \
+ *            ../../Common/bench-util.c ../../Elements/gstfastcolorspace.c ../../Elements/simd.c \
+ *            -o basic-tutorial3-colorspace-bench \
+ *            $(pkg-config --cflags --libs gstreamer-1.0 gstreamer-base-1.0 gstreamer-video-1.0)
+ */
+#include <gst/gst.h>
+
+#include "../../Common/bench-util.h"
+#include "../../Common/latency-stats.h"
+#include "../../Common/alloc-counter.h"
+#include "../../Elements/gstfastcolorspace.h"
+
+#define DEFAULT_CONVERTERS "videoconvert,fastcolorspace"
+#define DEFAULT_INPUTS "I420,NV12,YUY2"
+#define DEFAULT_OUTPUTS "BGRx,RGBx"
+#define DEFAULT_RESOLUTIONS "640x480,1280x720,1920x1080,3840x2160"
+#define DEFAULT_BUFFERS 200
+
+/* one converter at one conversion and size, the converter's pad probes fill it */
+typedef struct _BenchRun {
+	GstClockTime entered;	/* current buffer entered the converter */
+	LatencyStats *convert;	/* per frame conversion time */
+	guint64 allocs_first;	/* alloc counter when the first frame left */
+	guint64 allocs_last;	/* alloc counter when the last frame left */
+} BenchRun;
+
+static GstPadProbeReturn enter_cb(GstPad *pad, GstPadProbeInfo *info, BenchRun *run) {
+	run->entered = gst_util_get_timestamp();
+	return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn leave_cb(GstPad *pad, GstPadProbeInfo *info, BenchRun *run) {
+	run->allocs_last = alloc_counter_get_count();
+	if (latency_stats_count(run->convert) == 0)
+		run->allocs_first = run->allocs_last;
+	if (GST_CLOCK_TIME_IS_VALID(run->entered))
+		latency_stats_add(run->convert, GST_CLOCK_DIFF(run->entered, gst_util_get_timestamp()));
+	run->entered = GST_CLOCK_TIME_NONE;
+	return GST_PAD_PROBE_OK;
+}
+
+static GstElement *make_filter(const gchar *format, gint width, gint height) {
+	GstCaps *caps = bench_video_caps(format, width, height);
+	GstElement *filter = bench_capsfilter_new(caps);
+
+	gst_caps_unref(caps);
+	return filter;
+}
+
+/* @return FALSE after naming the first format bench_video_caps() doesn't know */
+static gboolean known_formats(gchar **formats) {
+	gint i;
+
+	for (i = 0; formats[i] != NULL; i++) {
+		GstCaps *caps = bench_video_caps(formats[i], 1, 1);
+
+		if (caps == NULL) {
+			g_printerr("Unknown format '%s', expected one of " BENCH_VIDEO_FORMATS "\n", formats[i]);
+			return FALSE;
+		}
+		gst_caps_unref(caps);
+	}
+	return TRUE;
+}
+
+/* @brief convert n_buffers of snow from in to out */
+static gboolean run_once(const gchar *converter, const gchar *in, const gchar *out, gint width, gint height,
+		gint n_buffers, gint threads, const gchar *simd, BenchRun *run) {
+	GstElement *pipeline, *source, *in_filter, *convert, *out_filter, *sink;
+	GstPad *pad;
+	gchar *label;
+	gboolean ok;
+
+	pipeline = gst_pipeline_new("bench-pipeline");
+	source = gst_element_factory_make("videotestsrc", "source");
+	in_filter = make_filter(in, width, height);
+	convert = gst_element_factory_make(converter, "convert");
+	out_filter = make_filter(out, width, height);
+	sink = gst_element_factory_make("fakesink", "sink");
+	if (!pipeline || !source || !in_filter || !convert || !out_filter || !sink) {
+		g_printerr("Not all elements could be created.\n");
+		/* none of them is in the pipeline yet */
+		if (pipeline)
+			gst_object_unref(pipeline);
+		if (source)
+			gst_object_unref(source);
+		if (in_filter)
+			gst_object_unref(in_filter);
+		if (convert)
+			gst_object_unref(convert);
+		if (out_filter)
+			gst_object_unref(out_filter);
+		if (sink)
+			gst_object_unref(sink);
+		return FALSE;
+	}
+
+	gst_bin_add_many(GST_BIN(pipeline), source, in_filter, convert, out_filter, sink, NULL);
+	if (!gst_element_link_many(source, in_filter, convert, out_filter, sink, NULL)) {
+		g_printerr("Elements could not be linked.\n");
+		gst_object_unref(pipeline);
+		return FALSE;
+	}
+
+	/* snow: no flat areas a converter could take shortcuts on */
+	g_object_set(source, "num-buffers", n_buffers, NULL);
+	gst_util_set_object_arg(G_OBJECT(source), "pattern", "snow");
+	g_object_set(sink, "sync", FALSE, NULL);
+	/* videoconvert has n-threads since 1.20 */
+	if (g_object_class_find_property(G_OBJECT_GET_CLASS(convert), "n-threads"))
+		g_object_set(convert, "n-threads", (guint)threads, NULL);
+	if (simd != NULL && g_object_class_find_property(G_OBJECT_GET_CLASS(convert), "simd"))
+		gst_util_set_object_arg(G_OBJECT(convert), "simd", simd);
+
+	run->entered = GST_CLOCK_TIME_NONE;
+	pad = gst_element_get_static_pad(convert, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)enter_cb, run, NULL);
+	gst_object_unref(pad);
+	pad = gst_element_get_static_pad(convert, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)leave_cb, run, NULL);
+	gst_object_unref(pad);
+
+	alloc_counter_reset();
+	label = g_strdup_printf("%s %s->%s %dx%d", converter, in, out, width, height);
+	ok = bench_run_till_eos(pipeline, label);
+	g_free(label);
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	gint n_buffers = DEFAULT_BUFFERS, threads = g_get_num_processors();
+	gchar *converters_arg = NULL, *inputs_arg = NULL, *outputs_arg = NULL, *resolutions_arg = NULL, *simd = NULL;
+	gchar **converters, **inputs, **outputs, **resolutions;
+	gint c, i, o, r, failures = 0, status;
+	GOptionEntry entries[] = {
+		{ "buffers", 'n', 0, G_OPTION_ARG_INT, &n_buffers, "Buffers per grid point (default 200)", "N" },
+		{ "converters", 'c', 0, G_OPTION_ARG_STRING, &converters_arg, "Comma separated converters (default " DEFAULT_CONVERTERS ")", "LIST" },
+		{ "inputs", 'i', 0, G_OPTION_ARG_STRING, &inputs_arg, "Comma separated input formats (default " DEFAULT_INPUTS ")", "LIST" },
+		{ "outputs", 'o', 0, G_OPTION_ARG_STRING, &outputs_arg, "Comma separated output formats (default " DEFAULT_OUTPUTS ")", "LIST" },
+		{ "resolutions", 'r', 0, G_OPTION_ARG_STRING, &resolutions_arg, "Comma separated WxH list (default " DEFAULT_RESOLUTIONS ")", "LIST" },
+		{ "threads", 't', 0, G_OPTION_ARG_INT, &threads, "n-threads of every converter (default: one per CPU)", "N" },
+		{ "simd", 0, 0, G_OPTION_ARG_STRING, &simd, "fastcolorspace kernels: auto, none, sse2, sse4.1, avx2", "LEVEL" },
+		{ NULL }
+	};
+
+	if (!bench_parse_options(&argc, &argv, "- colorspace converter benchmark", entries))
+		return -1;
+	if (threads < 1) {
+		g_printerr("Need at least one thread\n");
+		return -1;
+	}
+
+	gst_fast_colorspace_register(GST_RANK_NONE);
+	if (!alloc_counter_install()) {
+		g_printerr("Could not install the allocation counter\n");
+		return -1;
+	}
+
+	converters = g_strsplit(converters_arg ? converters_arg : DEFAULT_CONVERTERS, ",", -1);
+	inputs = g_strsplit(inputs_arg ? inputs_arg : DEFAULT_INPUTS, ",", -1);
+	outputs = g_strsplit(outputs_arg ? outputs_arg : DEFAULT_OUTPUTS, ",", -1);
+	resolutions = g_strsplit(resolutions_arg ? resolutions_arg : DEFAULT_RESOLUTIONS, ",", -1);
+
+	if (!known_formats(inputs) || !known_formats(outputs)) {
+		status = -1;
+		goto out;
+	}
+
+	for (r = 0; resolutions[r] != NULL; r++) {
+		gint width, height;
+
+		if (!bench_parse_resolution(resolutions[r], &width, &height)) {
+			g_printerr("Bad resolution '%s'\n", resolutions[r]);
+			failures++;
+			continue;
+		}
+		for (i = 0; inputs[i] != NULL; i++) {
+			for (o = 0; outputs[o] != NULL; o++) {
+				for (c = 0; converters[c] != NULL; c++) {
+					BenchRun run;
+					gchar *stats;
+					gdouble mean, allocs_per_frame;
+
+					run.convert = latency_stats_new();
+					if (!run_once(converters[c], inputs[i], outputs[o], width, height, n_buffers, threads, simd, &run) ||
+							latency_stats_count(run.convert) == 0) {
+						failures++;
+						latency_stats_free(run.convert);
+						continue;
+					}
+
+					mean = latency_stats_mean(run.convert);
+					allocs_per_frame = latency_stats_count(run.convert) > 1 ?
+						(gdouble)(run.allocs_last - run.allocs_first) / (latency_stats_count(run.convert) - 1) : 0.0;
+					stats = latency_stats_to_json(run.convert);
+					g_print("{\"converter\":\"%s\",\"input\":\"%s\",\"output\":\"%s\",\"resolution\":\"%dx%d\","
+							"\"threads\":%d,\"fps\":%.1f,\"mpixels_per_s\":%.1f,\"allocs_per_frame\":%.3f,\"convert\":%s}\n",
+							converters[c], inputs[i], outputs[o], width, height, threads,
+							mean > 0 ? GST_SECOND / mean : 0.0,
+							mean > 0 ? (gdouble)width * height / mean * 1000 : 0.0, allocs_per_frame, stats);
+					g_free(stats);
+					latency_stats_free(run.convert);
+				}
+			}
+		}
+	}
+
+	status = failures ? 1 : 0;
+
+out:
+	g_strfreev(converters);
+	g_strfreev(inputs);
+	g_strfreev(outputs);
+	g_strfreev(resolutions);
+	g_free(converters_arg);
+	g_free(inputs_arg);
+	g_free(outputs_arg);
+	g_free(resolutions_arg);
+	g_free(simd);
+	return status;
+}
@@ -0,0 +1,249 @@
+/*
+ * Streaming thread scheduling benchmark: render jitter under CPU load, with
+ * and without a Common/sched-policy rule set.
+ *
+ * A live audio source at small buffers feeds queue ! audioconvert !
+ * audioresample ! fakesink (sync), the shape of a basic-tutorial3 branch.
+ * The handoff of the sink measures, per buffer, how late it was rendered
+ * against the pipeline clock and how far the interval to the previous one
+ * strayed from the buffer duration. Four runs, one JSON line each:
+ *   idle           no load, no policy
+ *   load           --load busy threads on every core, no policy
+ *   load+policy    same load on every core, streaming threads under --policy
+ *   load+reserved  same policy, the load threads kept off the CPUs it pins to
+ * load against load+policy is what the policy alone buys; load+reserved adds
+ * reserving its cores, as a real setup would. Without SCHED_FIFO, pinning
+ * next to a busy thread can do worse than no policy at all. The default
+ * policy asks for SCHED_FIFO, which needs CAP_SYS_NICE or an rtprio limit;
+ * "failed" in the policy counters shows when it wasn't granted.
+ *
+ * build: gcc basic-tutorial3-sched-bench.c ../../Common/sched-policy.c ../../Common/latency-stats.c \
+ *            ../../Common/bench-util.c -o basic-tutorial3-sched-bench $(pkg-config --cflags --libs gstreamer-1.0)
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <gst/gst.h>
+
+#include "../../Common/bench-util.h"
+#include "../../Common/sched-policy.h"
+#include "../../Common/latency-stats.h"
+
+#define DEFAULT_SECONDS 10
+#define DEFAULT_POLICY "source=0/fifo:40;convert=0/fifo:40"
+/* 5 ms buffers, an audio sink's usual period */
+#define RATE 48000
+#define SAMPLES_PER_BUFFER 240
+
+#define PIPELINE "audiotestsrc is-live=true wave=white-noise samplesperbuffer=%d ! " \
+		"audio/x-raw,format=S16LE,rate=%d,channels=2 ! queue ! audioconvert ! audioresample ! " \
+		"audio/x-raw,format=F32LE,rate=44100 ! fakesink name=sink sync=true signal-handoffs=true"
+
+typedef struct _BenchData {
+	GstElement *pipeline;
+	LatencyStats *late;	/* render time past the buffer's running time */
+	LatencyStats *jitter;	/* |interval - duration| between renders */
+	GstClockTime last_render;
+} BenchData;
+
+/* burns one core until stop is set */
+typedef struct _Load {
+	gint stop;
+	GThread **threads;
+	guint n_threads;
+	GArray *avoid;		/* gint, CPUs the load threads stay off, NULL for none */
+} Load;
+
+#ifdef __linux__
+/* @brief every CPU this process may run on except avoid, unless that leaves none */
+static void keep_off(GArray *avoid) {
+	cpu_set_t set;
+	guint i;
+
+	if (sched_getaffinity(0, sizeof(set), &set) != 0)
+		return;
+	for (i = 0; i < avoid->len; i++) {
+		if (g_array_index(avoid, gint, i) < CPU_SETSIZE)
+			CPU_CLR(g_array_index(avoid, gint, i), &set);
+	}
+	if (CPU_COUNT(&set) > 0)
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+#endif
+
+static gpointer load_thread(Load *load) {
+	guint32 state = g_random_int();
+	guint64 sum = 0;
+	guint8 *scratch = g_malloc0(1024 * 1024);
+	guint i;
+
+#ifdef __linux__
+	if (load->avoid != NULL && load->avoid->len > 0)
+		keep_off(load->avoid);
+#endif
+	/* arithmetic and cache misses, like a neighbour decoding video */
+	while (!g_atomic_int_get(&load->stop)) {
+		for (i = 0; i < 4096; i++) {
+			state = state * 1664525 + 1013904223;
+			scratch[state % (1024 * 1024)] += (guint8)state;
+			sum += scratch[(state >> 8) % (1024 * 1024)];
+		}
+	}
+	g_free(scratch);
+	return GSIZE_TO_POINTER(sum);
+}
+
+static void load_start(Load *load, guint n_threads, GArray *avoid) {
+	guint i;
+
+	load->stop = FALSE;
+	load->avoid = avoid;
+	load->n_threads = n_threads;
+	load->threads = g_new0(GThread *, n_threads);
+	for (i = 0; i < n_threads; i++)
+		load->threads[i] = g_thread_new("load", (GThreadFunc)load_thread, load);
+}
+
+static void load_stop(Load *load) {
+	guint i;
+
+	g_atomic_int_set(&load->stop, TRUE);
+	for (i = 0; i < load->n_threads; i++)
+		g_thread_join(load->threads[i]);
+	g_free(load->threads);
+	load->threads = NULL;
+	load->n_threads = 0;
+}
+
+/* @brief fakesink handoff, after the clock wait, live PTS are running times */
+static void handoff_cb(GstElement *sink, GstBuffer *buffer, GstPad *pad, BenchData *data) {
+	GstClock *clock;
+	GstClockTime now, latency;
+
+	if (!GST_BUFFER_PTS_IS_VALID(buffer) || (clock = gst_element_get_clock(sink)) == NULL)
+		return;
+	now = gst_clock_get_time(clock) - gst_element_get_base_time(sink);
+	gst_object_unref(clock);
+	latency = gst_pipeline_get_latency(GST_PIPELINE(data->pipeline));
+	if (!GST_CLOCK_TIME_IS_VALID(latency))
+		latency = 0;
+
+	latency_stats_add(data->late, GST_CLOCK_DIFF(GST_BUFFER_PTS(buffer) + latency, now));
+	if (GST_CLOCK_TIME_IS_VALID(data->last_render) && GST_BUFFER_DURATION_IS_VALID(buffer))
+		latency_stats_add(data->jitter, ABS(GST_CLOCK_DIFF(GST_BUFFER_DURATION(buffer), now - data->last_render)));
+	data->last_render = now;
+}
+
+/*
+ * @brief play for seconds and print one JSON line
+ * reserve keeps the load threads off the CPUs the policy pins to
+ * */
+static gboolean run(const gchar *scenario, guint n_load, const gchar *policy_spec, gboolean reserve, gint seconds) {
+	BenchData data;
+	SchedPolicy *policy = NULL;
+	GstElement *sink;
+	GstBus *bus;
+	GstMessage *msg;
+	GError *err = NULL;
+	gchar *description, *late_json, *jitter_json, *policy_json;
+	Load load = { 0 };
+	GArray *pinned = NULL;
+	gboolean ok = TRUE;
+
+	description = g_strdup_printf(PIPELINE, SAMPLES_PER_BUFFER, RATE);
+	data.pipeline = gst_parse_launch(description, &err);
+	g_free(description);
+	if (data.pipeline == NULL) {
+		g_printerr("Pipeline couldn't be built: %s\n", err->message);
+		g_clear_error(&err);
+		return FALSE;
+	}
+	data.late = latency_stats_new();
+	data.jitter = latency_stats_new();
+	data.last_render = GST_CLOCK_TIME_NONE;
+	sink = gst_bin_get_by_name(GST_BIN(data.pipeline), "sink");
+	g_signal_connect(sink, "handoff", G_CALLBACK(handoff_cb), &data);
+	gst_object_unref(sink);
+
+	if (policy_spec != NULL) {
+		policy = sched_policy_new(policy_spec);
+		if (policy == NULL) {
+			ok = FALSE;
+			goto out;
+		}
+		sched_policy_watch(policy, data.pipeline);
+		if (reserve)
+			pinned = sched_policy_get_cpus(policy);
+	}
+	if (n_load > 0)
+		load_start(&load, n_load, pinned);
+
+	bus = gst_element_get_bus(data.pipeline);
+	gst_element_set_state(data.pipeline, GST_STATE_PLAYING);
+	msg = gst_bus_timed_pop_filtered(bus, seconds * GST_SECOND, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+	if (msg != NULL) {
+		if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+			gchar *debug_info;
+
+			gst_message_parse_error(msg, &err, &debug_info);
+			g_printerr("Error received from element %s : %s\n", GST_OBJECT_NAME(msg->src), err->message);
+			g_printerr("Debugging info : %s\n", debug_info ? debug_info : "none");
+			g_clear_error(&err);
+			g_free(debug_info);
+		}
+		gst_message_unref(msg);
+		ok = FALSE;
+	}
+	gst_element_set_state(data.pipeline, GST_STATE_NULL);
+	gst_object_unref(bus);
+	if (n_load > 0)
+		load_stop(&load);
+
+	late_json = latency_stats_to_json(data.late);
+	jitter_json = latency_stats_to_json(data.jitter);
+	policy_json = policy ? sched_policy_to_json(policy) : g_strdup("null");
+	g_print("{\"scenario\":\"%s\",\"load_threads\":%u,\"reserved_cpus\":%u,\"seconds\":%d,\"buffers\":%u,"
+			"\"late\":%s,\"interval_jitter\":%s,\"policy\":%s}\n", scenario, n_load, pinned ? pinned->len : 0,
+			seconds, latency_stats_count(data.late), late_json, jitter_json, policy_json);
+	g_free(late_json);
+	g_free(jitter_json);
+	g_free(policy_json);
+
+out:
+	if (pinned != NULL)
+		g_array_unref(pinned);
+	sched_policy_free(policy);
+	latency_stats_free(data.late);
+	latency_stats_free(data.jitter);
+	gst_object_unref(data.pipeline);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	gint seconds = DEFAULT_SECONDS, n_load = -1;
+	gchar *policy = NULL;
+	gint failures = 0;
+	GOptionEntry entries[] = {
+		{ "seconds", 's', 0, G_OPTION_ARG_INT, &seconds, "Playback per run (default 10)", "S" },
+		{ "load", 'l', 0, G_OPTION_ARG_INT, &n_load, "Busy threads in the loaded runs (default one per core)", "N" },
+		{ "policy", 'p', 0, G_OPTION_ARG_STRING, &policy, "Scheduling rules, " SCHED_POLICY_SYNTAX " (default " DEFAULT_POLICY ")", "RULES" },
+		{ NULL }
+	};
+
+	if (!bench_parse_options(&argc, &argv, "- streaming thread scheduling benchmark", entries))
+		return -1;
+
+	if (n_load < 0)
+		n_load = g_get_num_processors();
+	seconds = MAX(seconds, 1);
+
+	failures += !run("idle", 0, NULL, FALSE, seconds);
+	failures += !run("load", n_load, NULL, FALSE, seconds);
+	failures += !run("load+policy", n_load, policy ? policy : DEFAULT_POLICY, FALSE, seconds);
+	failures += !run("load+reserved", n_load, policy ? policy : DEFAULT_POLICY, TRUE, seconds);
+
+	g_free(policy);
+	return failures > 0 ? 1 : 0;
+}
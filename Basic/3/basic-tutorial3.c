@@ -1,17 +1,48 @@
+/*
+ * build: gcc basic-tutorial3.c ../../Common/startup-profiler.c ../../Common/event-log.c \
+ *            ../../Common/buffering.c ../../Common/latency-tracer.c ../../Common/latency-stats.c \
+ *            ../../Common/sched-policy.c ../../Elements/gstfastcolorspace.c \
+ *            ../../Elements/gstfastaudioconvert.c ../../Elements/simd.c -o basic-tutorial3 \
+ *            $(pkg-config --cflags --libs gstreamer-1.0 gstreamer-base-1.0 gstreamer-video-1.0 gstreamer-audio-1.0) -lm
+ *
+ * usage: basic-tutorial3 [OPTIONS] [URI]
+ */
 #include <gst/gst.h>
 
+#include "../../Common/startup-profiler.h"
+#include "../../Common/event-log.h"
+#include "../../Common/buffering.h"
+#include "../../Common/latency-tracer.h"
+#include "../../Common/sched-policy.h"
+#include "../../Elements/gstfastcolorspace.h"
+#include "../../Elements/gstfastaudioconvert.h"
+
+#define DEFAULT_URI "http://docs.gstreamer.com/media/sintel_trailer-480p.webm"
+
+/* queue defaults, same as the queue element's own */
+#define DEFAULT_QUEUE_MAX_BUFFERS 200
+#define DEFAULT_QUEUE_MAX_BYTES (10 * 1024 * 1024)
+#define DEFAULT_QUEUE_MAX_TIME 1000 /* msec */
+
 /* callback private date */
 typedef struct _CustomData {
 	GstElement *pipeline;
 	GstElement *source;
+	Buffering *buffering;	/* pauses while the network catches up */
 
-	/* Audio SinkMap */
-	GstElement *aconvert;
-	GstElement *asink;
+	/* Branch building blocks, one queue ! convert ! sink per raw stream */
+	const gchar *aconvert;	/* audio converter factory */
+	const gchar *asink;	/* audio sink factory */
+	const gchar *vconvert;	/* video converter factory */
+	const gchar *vsink;	/* video sink factory */
 
-	/* Video SinkMap*/
-	GstElement *vconvert;
-	GstElement *vsink;
+	/* Queue limits of every branch, 0 disables a limit */
+	guint queue_max_buffers;
+	guint queue_max_bytes;
+	guint64 queue_max_time;	/* nsec */
+
+	gint n_audio;	/* audio branches built so far */
+	gint n_video;	/* video branches built so far */
 }CustomData;
 
 /*callback handler*/
@@ -23,47 +54,104 @@ int main(int argc, char* argv[]) {
 	GstMessage *msg;
 	GstStateChangeReturn ret;
 	gboolean terminate = FALSE;
+	gint max_buffers = DEFAULT_QUEUE_MAX_BUFFERS, max_bytes = DEFAULT_QUEUE_MAX_BYTES, max_time = DEFAULT_QUEUE_MAX_TIME;
+	gchar *asink = NULL, *vsink = NULL, *aconvert = NULL, *vconvert = NULL;
+	gint ring_buffer = 0;
+	gboolean trace_latency = FALSE;
+	LatencyTracer *tracer = NULL;
+	gchar *sched = NULL;
+	SchedPolicy *policy = NULL;
+	GOptionContext *ctx;
+	GError *err = NULL;
+	GOptionEntry entries[] = {
+		{ "queue-max-buffers", 0, 0, G_OPTION_ARG_INT, &max_buffers, "Max buffers queued per branch (default 200, 0 = unlimited)", "N" },
+		{ "queue-max-bytes", 0, 0, G_OPTION_ARG_INT, &max_bytes, "Max bytes queued per branch (default 10 MB, 0 = unlimited)", "BYTES" },
+		{ "queue-max-time", 0, 0, G_OPTION_ARG_INT, &max_time, "Max time queued per branch in ms (default 1000, 0 = unlimited)", "MS" },
+		{ "audio-sink", 0, 0, G_OPTION_ARG_STRING, &asink, "Audio sink factory (default autoaudiosink)", "FACTORY" },
+		{ "video-sink", 0, 0, G_OPTION_ARG_STRING, &vsink, "Video sink factory (default autovideosink)", "FACTORY" },
+		{ "audio-convert", 0, 0, G_OPTION_ARG_STRING, &aconvert, "Audio converter factory, e.g. fastaudioconvert (default audioconvert)", "FACTORY" },
+		{ "video-convert", 0, 0, G_OPTION_ARG_STRING, &vconvert, "Video converter factory, e.g. fastcolorspace (default videoconvert)", "FACTORY" },
+		{ "ring-buffer", 0, 0, G_OPTION_ARG_INT, &ring_buffer, "Spool the stream to an on-disk ring buffer of this many MB (default off)", "MB" },
+		{ "trace-latency", 0, 0, G_OPTION_ARG_NONE, &trace_latency, "Measure per element latency and throughput, print them at end-of-stream", NULL },
+		{ "sched", 0, 0, G_OPTION_ARG_STRING, &sched, "Pin and prioritize streaming threads, " SCHED_POLICY_SYNTAX, "RULES" },
+		{ NULL }
+	};
+
+	/*Opt-in startup profiling, see startup-profiler.h*/
+	startup_profiler_init();
+
+	/*Initialize gstreamer, along with our options*/
+	ctx = g_option_context_new("[URI] - dynamic pipeline tutorial");
+	g_option_context_add_main_entries(ctx, entries, NULL);
+	g_option_context_add_group(ctx, gst_init_get_option_group());
+	if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+		g_printerr("Failed to parse options: %s\n", err->message);
+		g_clear_error(&err);
+		g_option_context_free(ctx);
+		return -1;
+	}
+	g_option_context_free(ctx);
+	startup_profiler_mark("gst_init");
+
+	/* binary message log instead of printing every state change, see event-log.h */
+	event_log_open_from_env();
 
-	/*Initialize gstreamer*/
-	gst_init(&argc, &argv);
+	/* by name only, see gstfastaudioconvert.h */
+	gst_fast_audio_convert_register(GST_RANK_NONE);
+	data.aconvert = aconvert ? aconvert : "audioconvert";
+	data.asink = asink ? asink : "autoaudiosink";
+	/* by name only, see gstfastcolorspace.h */
+	gst_fast_colorspace_register(GST_RANK_NONE);
+	data.vconvert = vconvert ? vconvert : "videoconvert";
+	data.vsink = vsink ? vsink : "autovideosink";
+	data.queue_max_buffers = MAX(max_buffers, 0);
+	data.queue_max_bytes = MAX(max_bytes, 0);
+	data.queue_max_time = (guint64)MAX(max_time, 0) * GST_MSECOND;
+	data.n_audio = data.n_video = 0;
 
-	/*create elements*/
+	/*create elements, branches are created as streams show up*/
 	data.source = gst_element_factory_make ("uridecodebin", 0);
-	data.aconvert = gst_element_factory_make("audioconvert", "aconvert");
-	data.asink = gst_element_factory_make("autoaudiosink", "asink");
-	data.vconvert = gst_element_factory_make("ffmpegcolorspace", "vconvert");
-	data.vsink = gst_element_factory_make("autovideosink", "vsink");
 
 	/*and empty pipeline*/
 	data.pipeline = gst_pipeline_new("test-pipeline");
 
-	if (!data.pipeline || !data.source || !data.aconvert || !data.asink) { 
+	if (!data.pipeline || !data.source) { 
 		g_printerr("Elements couldn't be created\n");
 		return -1;
 	}
 
-	if (!data.vconvert || !data.vsink) {
-		g_printerr("VElements couldn't be created\n");
-		return -1;
-	}
+	startup_profiler_mark("elements created");
+	startup_profiler_watch(data.pipeline);
 
-	/* Build pipeline, keep source to be linked later with rest of pipe
-	 * link only rest of bins */
-	gst_bin_add_many(GST_BIN(data.pipeline), data.source, data.aconvert, data.asink, data.vconvert, data.vsink, NULL);
-	if (!gst_element_link(data.aconvert, data.asink) || !gst_element_link(data.vconvert, data.vsink)) {
-		g_printerr("Element couldn't be linked");
-		gst_object_unref(data.pipeline);
-		return -1;
+	/* before any streaming thread starts, see sched-policy.h */
+	if (sched != NULL) {
+		policy = sched_policy_new(sched);
+		if (policy == NULL) {
+			gst_object_unref(data.pipeline);
+			return -1;
+		}
+		sched_policy_watch(policy, data.pipeline);
 	}
 
+	/* Build pipeline, only source for now, pad_added_handler adds the rest */
+	gst_bin_add(GST_BIN(data.pipeline), data.source);
+
 	/* set URI to play */
-	g_object_set(data.source, "uri", "http://docs.gstreamer.com/media/sintel_trailer-480p.webm", NULL);
+	g_object_set(data.source, "uri", argc > 1 ? argv[1] : DEFAULT_URI, NULL);
+
+	/* buffering messages, and optionally a disk cache, see buffering.h */
+	buffering_configure(data.source, (guint64)MAX(ring_buffer, 0) * 1024 * 1024);
+	data.buffering = buffering_new(data.pipeline);
 
 	/* connect the pad_add handler to source */
 	g_signal_connect(data.source, "pad-added", G_CALLBACK(pad_added_handler), &data);
 
+	/* follows uridecodebin's internals and the branches as they are added, see latency-tracer.h */
+	if (trace_latency)
+		tracer = latency_tracer_new(data.pipeline);
+
 	/* start playback so that demux, pad adding and then actual playback happens*/
-	ret = gst_element_set_state(data.pipeline, GST_STATE_PLAYING);
+	ret = buffering_set_state(data.buffering, GST_STATE_PLAYING);
 	if (ret == GST_STATE_CHANGE_FAILURE) {
 		g_printerr("Pipeline couldn't be set in playing state");
 		gst_object_unref(data.pipeline);
@@ -74,19 +162,33 @@ int main(int argc, char* argv[]) {
 	bus = gst_element_get_bus(data.pipeline);
 	do {
 						GstState old_state, new_state, pending_state;
-		msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_STATE_CHANGED | GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+		msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_STATE_CHANGED | GST_MESSAGE_ERROR | GST_MESSAGE_EOS |
+				GST_MESSAGE_BUFFERING | GST_MESSAGE_CLOCK_LOST);
 
 		/* parse message */
 		if (msg != NULL) {
 			GError* err;
 			gchar* debug_info;
 
+			event_log_message(msg);
+			if (tracer)
+				latency_tracer_handle_message(tracer, msg);
+
+			if (buffering_handle_message(data.buffering, msg)) {
+				if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_BUFFERING)
+					g_print("Buffering %3d%%\r", buffering_get_percent(data.buffering));
+				gst_message_unref(msg);
+				continue;
+			}
+
 			switch (GST_MESSAGE_TYPE(msg)) {
 				case GST_MESSAGE_STATE_CHANGED:
 					/*Print state change message from pipeline only - for now*/
 //					if (GST_MESSAGE_SRC(msg) == GST_OBJECT(data.pipeline)) {
+					if (!event_log_enabled()) {
 						gst_message_parse_state_changed(msg, &old_state, &new_state, &pending_state);
 						g_print("%s\tstate changed %s -> %s:\n",GST_MESSAGE_SRC_NAME(msg), gst_element_state_get_name(old_state), gst_element_state_get_name(new_state));
+					}
 //					}
 
 					break;
@@ -106,16 +208,105 @@ int main(int argc, char* argv[]) {
 					g_printerr("Unexpected message, shouldn't be here!");
 					break;
 			}
+			gst_message_unref(msg);
 		}
 	}while (!terminate);
 
+	g_print("Rebuffered %u times, %.1f s stalled\n", buffering_rebuffer_count(data.buffering),
+			(gdouble)buffering_rebuffer_time(data.buffering) / GST_SECOND);
+
 	/*Free resources*/
+	event_log_close();
+	buffering_free(data.buffering);
 	gst_object_unref(bus);
 	gst_element_set_state(data.pipeline, GST_STATE_NULL);
+	latency_tracer_free(tracer);
+	if (policy != NULL)
+		sched_policy_print(policy);
+	sched_policy_free(policy);
 	gst_object_unref(data.pipeline);
+	g_free(asink);
+	g_free(vsink);
+	g_free(aconvert);
+	g_free(vconvert);
+	g_free(sched);
 	return 0;
 }
 
+/*
+ * @brief build queue ! convert ! sink for one stream and add it to the pipeline
+ *        The queue gives every stream its own streaming thread, so conversion
+ *        of different streams runs in parallel.
+ * @return queue sink pad to link the new pad to, NULL on failure
+ * */
+static GstPad *build_branch(CustomData *data, const gchar *kind, gint index, const gchar *convert_name, const gchar *sink_name) {
+	GstElement *queue, *convert, *sink;
+	gchar *name;
+
+	name = g_strdup_printf("%s-queue-%d", kind, index);
+	queue = gst_element_factory_make("queue", name);
+	g_free(name);
+	name = g_strdup_printf("%s-convert-%d", kind, index);
+	convert = gst_element_factory_make(convert_name, name);
+	g_free(name);
+	name = g_strdup_printf("%s-sink-%d", kind, index);
+	sink = gst_element_factory_make(sink_name, name);
+	g_free(name);
+
+	if (!queue || !convert || !sink) {
+		g_printerr(" Couldn't create %s branch elements\n", kind);
+		if (queue)
+			gst_object_unref(queue);
+		if (convert)
+			gst_object_unref(convert);
+		if (sink)
+			gst_object_unref(sink);
+		return NULL;
+	}
+
+	g_object_set(queue,
+			"max-size-buffers", data->queue_max_buffers,
+			"max-size-bytes", data->queue_max_bytes,
+			"max-size-time", data->queue_max_time,
+			NULL);
+
+	gst_bin_add_many(GST_BIN(data->pipeline), queue, convert, sink, NULL);
+	if (!gst_element_link_many(queue, convert, sink, NULL)) {
+		g_printerr(" Couldn't link %s branch\n", kind);
+		gst_bin_remove_many(GST_BIN(data->pipeline), queue, convert, sink, NULL);
+		return NULL;
+	}
+
+	/* Bring the branch up to the pipeline state, downstream first */
+	gst_element_sync_state_with_parent(sink);
+	gst_element_sync_state_with_parent(convert);
+	gst_element_sync_state_with_parent(queue);
+
+	return gst_element_get_static_pad(queue, "sink");
+}
+
+/*
+ * @brief take a branch build_branch() added back out of the pipeline
+ *        An unlinked sink left in the pipeline would never preroll.
+ * */
+static void remove_branch(CustomData *data, const gchar *kind, gint index) {
+	static const gchar *parts[] = { "queue", "convert", "sink" };
+	GstElement *element;
+	gchar *name;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(parts); i++) {
+		name = g_strdup_printf("%s-%s-%d", kind, parts[i], index);
+		element = gst_bin_get_by_name(GST_BIN(data->pipeline), name);
+		g_free(name);
+		if (element == NULL)
+			continue;
+		gst_element_set_state(element, GST_STATE_NULL);
+		gst_bin_remove(GST_BIN(data->pipeline), element);
+		gst_object_unref(element);
+	}
+}
+
 /* callback impl*/
 static void pad_added_handler(GstElement *src, GstPad *new_pad, CustomData *data) {
 	GstPad *sink_pad = NULL; 
@@ -123,26 +314,30 @@ static void pad_added_handler(GstElement *src, GstPad *new_pad, CustomData *data
 	GstCaps *new_pad_caps = NULL;
 	GstStructure *new_pad_struct = NULL;
 	const gchar *new_pad_type = NULL;
+	const gchar *kind;
+	gint index;
 
 	g_print("Received new pad '%s' from '%s':\n", GST_PAD_NAME(new_pad), GST_ELEMENT_NAME(src));
 
 
-	/* check pad type*/
-	new_pad_caps = gst_pad_get_caps(new_pad);
+	/* check pad type, every raw stream gets its own branch*/
+	new_pad_caps = gst_pad_get_current_caps(new_pad);
 	new_pad_struct = gst_caps_get_structure(new_pad_caps, 0);
 	new_pad_type = gst_structure_get_name(new_pad_struct);
 	if (g_str_has_prefix(new_pad_type, "audio/x-raw")) {
-		sink_pad = gst_element_get_static_pad (data->aconvert, "sink");
+		kind = "audio";
+		index = data->n_audio++;
+		sink_pad = build_branch(data, kind, index, data->aconvert, data->asink);
 	} else if (g_str_has_prefix(new_pad_type, "video/x-raw")) {
-		sink_pad = gst_element_get_static_pad (data->vconvert, "sink");
+		kind = "video";
+		index = data->n_video++;
+		sink_pad = build_branch(data, kind, index, data->vconvert, data->vsink);
 	} else {
 		g_print(" It has type '%s' which is not raw audio/video. Ignore!\n", new_pad_type);
 		goto exit;
 	}
 
-	/* If our converter is already linked, exit */
-	if (gst_pad_is_linked(sink_pad)) {
-		g_print(" We are already linked, Ignore!\n");
+	if (sink_pad == NULL) {
 		goto exit;
 	}
 
@@ -150,6 +345,7 @@ static void pad_added_handler(GstElement *src, GstPad *new_pad, CustomData *data
 	ret = gst_pad_link(new_pad, sink_pad);
 	if (GST_PAD_LINK_FAILED(ret)) {
 		g_print(" Type is '%s' link failed.\n", new_pad_type);
+		remove_branch(data, kind, index);
 	} else {
 		g_print(" Successfully linked (type '%s').\n", new_pad_type);
 	}
@@ -159,5 +355,7 @@ exit:
 	if (new_pad_caps != NULL) {
 		gst_caps_unref(new_pad_caps);
 	}
-	gst_object_unref(sink_pad);
+	if (sink_pad != NULL) {
+		gst_object_unref(sink_pad);
+	}
 }
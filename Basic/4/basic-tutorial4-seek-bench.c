@@ -0,0 +1,281 @@
+/*
+ * Seek latency benchmark for the basic-tutorial4 playbin pipeline.
+ *
+ * Plays a local file into synchronized fakesinks and issues N flushing seeks
+ * to random targets per seek mode. For every seek we record the time from
+ * the seek call to ASYNC_DONE and to the first buffer rendered after the
+ * flush, then print one JSON line per mode.
+ *
+ * With --keyframe-index every mode runs twice over the same targets, plain
+ * and through Common/keyframe-index, told apart by the "index" bool. The
+ * indexed line adds "vs_plain_p50_pct", the change of the median latencies
+ * against the plain run, negative when the index made seeks faster. One
+ * more line, "index_load", tells how long building or loading the index took.
+ *
+ * build: gcc basic-tutorial4-seek-bench.c ../../Common/seek-modes.c ../../Common/latency-stats.c \
+ *            ../../Common/keyframe-index.c ../../Common/bench-util.c -o basic-tutorial4-seek-bench \
+ *            $(pkg-config --cflags --libs gstreamer-1.0)
+ */
+#include <string.h>
+#include <gst/gst.h>
+
+#include "../../Common/bench-util.h"
+#include "../../Common/latency-stats.h"
+#include "../../Common/seek-modes.h"
+#include "../../Common/keyframe-index.h"
+
+#define DEFAULT_SEEKS 20
+/* give up on a single seek after this long */
+#define SEEK_TIMEOUT (10 * GST_SECOND)
+
+/* where we are with the seek in flight */
+enum {
+	SEEK_IDLE = 0,
+	SEEK_WAIT_FLUSH,	/* seek issued, old buffers may still show up */
+	SEEK_WAIT_BUFFER,	/* flushed, next buffer is the first one rendered */
+	SEEK_DONE
+};
+
+typedef struct _BenchData {
+	GstElement *playbin;
+	GstElement *watched;	/* sink whose first rendered buffer counts */
+	GstElement *vsink;
+	GstElement *asink;
+
+	GMutex lock;
+	GCond cond;
+	gint seek_state;
+	GstClockTime first_buffer;	/* time first buffer got rendered */
+} BenchData;
+
+/* @brief FLUSH_STOP on the watched sink: buffers from now on are post-seek */
+static GstPadProbeReturn event_probe_cb(GstPad *pad, GstPadProbeInfo *info, BenchData *data) {
+	if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_FLUSH_STOP) {
+		g_mutex_lock(&data->lock);
+		if (data->seek_state == SEEK_WAIT_FLUSH)
+			data->seek_state = SEEK_WAIT_BUFFER;
+		g_mutex_unlock(&data->lock);
+	}
+	return GST_PAD_PROBE_OK;
+}
+
+/* @brief fakesink handoff, called when a buffer is rendered */
+static void handoff_cb(GstElement *sink, GstBuffer *buffer, GstPad *pad, BenchData *data) {
+	if (sink != data->watched)
+		return;
+
+	g_mutex_lock(&data->lock);
+	if (data->seek_state == SEEK_WAIT_BUFFER) {
+		data->first_buffer = gst_util_get_timestamp();
+		data->seek_state = SEEK_DONE;
+		g_cond_signal(&data->cond);
+	}
+	g_mutex_unlock(&data->lock);
+}
+
+/* @brief change of the median from plain to indexed in percent, 0 without samples */
+static gdouble p50_change(LatencyStats *plain, LatencyStats *indexed) {
+	gint64 before;
+
+	if (latency_stats_count(plain) == 0 || latency_stats_count(indexed) == 0)
+		return 0.0;
+	before = latency_stats_percentile(plain, 50);
+	if (before <= 0)
+		return 0.0;
+	return 100.0 * (latency_stats_percentile(indexed, 50) - before) / before;
+}
+
+/*
+ * @brief seek to every target in one mode, pipeline must be PLAYING
+ *        index NULL seeks the plain way.
+ * */
+static gboolean run_mode(BenchData *data, GstBus *bus, SeekMode mode, const gint64 *targets, gint n_seeks,
+		KeyframeIndex *index, LatencyStats *async_done, LatencyStats *first_buffer) {
+	gint i;
+
+	for (i = 0; i < n_seeks; i++) {
+		gint64 target = targets[i];
+		GstClockTime start, done;
+		gboolean rendered;
+		gint64 deadline;
+
+		g_mutex_lock(&data->lock);
+		data->seek_state = SEEK_WAIT_FLUSH;
+		data->first_buffer = GST_CLOCK_TIME_NONE;
+		g_mutex_unlock(&data->lock);
+
+		start = gst_util_get_timestamp();
+		if (!keyframe_index_seek(index, data->playbin, mode, target)) {
+			g_printerr("Seek to %" GST_TIME_FORMAT " failed\n", GST_TIME_ARGS(target));
+			return FALSE;
+		}
+		if (!bench_wait_for(bus, GST_MESSAGE_ASYNC_DONE, SEEK_TIMEOUT))
+			return FALSE;
+		done = gst_util_get_timestamp();
+
+		/* first rendered buffer may come before or after ASYNC_DONE */
+		deadline = g_get_monotonic_time() + SEEK_TIMEOUT / GST_USECOND;
+		g_mutex_lock(&data->lock);
+		while (data->seek_state != SEEK_DONE) {
+			if (!g_cond_wait_until(&data->cond, &data->lock, deadline))
+				break;
+		}
+		rendered = (data->seek_state == SEEK_DONE);
+		data->seek_state = SEEK_IDLE;
+		g_mutex_unlock(&data->lock);
+
+		latency_stats_add(async_done, GST_CLOCK_DIFF(start, done));
+		if (rendered) {
+			latency_stats_add(first_buffer, GST_CLOCK_DIFF(start, data->first_buffer));
+		} else {
+			g_printerr("No buffer rendered after seek to %" GST_TIME_FORMAT "\n", GST_TIME_ARGS(target));
+		}
+	}
+	return TRUE;
+}
+
+int main(int argc, char *argv[]) {
+	BenchData data;
+	GstBus *bus;
+	GstPad *pad;
+	GRand *rand;
+	KeyframeIndex *index = NULL;
+	gint64 duration, *targets;
+	gint n_video = 0, n_seeks = DEFAULT_SEEKS, seed = 0, m, v, i, failures = 0;
+	gboolean use_index = FALSE;
+	gchar *modes_arg = NULL, *uri;
+	gchar **modes;
+	GOptionEntry entries[] = {
+		{ "seeks", 'n', 0, G_OPTION_ARG_INT, &n_seeks, "Seeks per mode (default 20)", "N" },
+		{ "modes", 'm', 0, G_OPTION_ARG_STRING, &modes_arg, "Comma separated seek modes (default: all of " SEEK_MODE_NAMES ")", "LIST" },
+		{ "seed", 0, 0, G_OPTION_ARG_INT, &seed, "Random seed for seek targets (default 0)", "SEED" },
+		{ "keyframe-index", 'k', 0, G_OPTION_ARG_NONE, &use_index, "Also seek through a keyframe index of FILE", NULL },
+		{ NULL }
+	};
+
+	if (!bench_parse_options(&argc, &argv, "FILE - seek latency benchmark", entries))
+		return -1;
+
+	if (argc < 2) {
+		g_printerr("Usage: %s [OPTIONS] FILE\n", argv[0]);
+		return -1;
+	}
+
+	if (use_index) {
+		gchar *path = gst_uri_is_valid(argv[1]) ? g_filename_from_uri(argv[1], NULL, NULL) : g_strdup(argv[1]);
+		GstClockTime start = gst_util_get_timestamp();
+		gboolean cached;
+
+		index = path != NULL ? keyframe_index_get(path, &cached) : NULL;
+		if (index == NULL) {
+			g_printerr("Could not index '%s'\n", argv[1]);
+			g_free(path);
+			return -1;
+		}
+		g_print("{\"index_load\":\"%s\",\"keyframes\":%u,\"time_ms\":%.1f}\n", cached ? "loaded" : "built",
+				keyframe_index_count(index), (gdouble)GST_CLOCK_DIFF(start, gst_util_get_timestamp()) / GST_MSECOND);
+		g_free(path);
+	}
+
+	uri = bench_uri_from_arg(argv[1]);
+	if (uri == NULL)
+		return -1;
+
+	memset(&data, 0, sizeof(data));
+	g_mutex_init(&data.lock);
+	g_cond_init(&data.cond);
+
+	data.playbin = gst_element_factory_make("playbin", "playbin");
+	data.vsink = bench_sync_sink_new("vsink", G_CALLBACK(handoff_cb), &data);
+	data.asink = bench_sync_sink_new("asink", G_CALLBACK(handoff_cb), &data);
+	if (!data.playbin || !data.vsink || !data.asink) {
+		g_printerr("Not all elements could be created.\n");
+		return -1;
+	}
+	g_object_set(data.playbin, "uri", uri, "video-sink", data.vsink, "audio-sink", data.asink, NULL);
+	g_free(uri);
+
+	/* preroll & start playing */
+	bus = gst_element_get_bus(data.playbin);
+	if (gst_element_set_state(data.playbin, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE ||
+			!bench_wait_for(bus, GST_MESSAGE_ASYNC_DONE, SEEK_TIMEOUT)) {
+		g_printerr("Unable to start playback.\n");
+		gst_object_unref(bus);
+		gst_element_set_state(data.playbin, GST_STATE_NULL);
+		gst_object_unref(data.playbin);
+		return -1;
+	}
+
+	if (!gst_element_query_duration(data.playbin, GST_FORMAT_TIME, &duration) || duration <= 0) {
+		g_printerr("Could not query duration, is the file seekable?\n");
+		failures++;
+		goto done;
+	}
+
+	/* first rendered video frame if we have video, audio otherwise */
+	g_object_get(data.playbin, "n-video", &n_video, NULL);
+	data.watched = n_video > 0 ? data.vsink : data.asink;
+	pad = gst_element_get_static_pad(data.watched, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_FLUSH, (GstPadProbeCallback)event_probe_cb, &data, NULL);
+	gst_object_unref(pad);
+
+	rand = g_rand_new_with_seed(seed);
+	targets = g_new(gint64, n_seeks);
+	modes = g_strsplit(modes_arg ? modes_arg : "key-unit,accurate,snap-before,snap-after", ",", -1);
+	for (m = 0; modes[m] != NULL; m++) {
+		SeekMode mode;
+		LatencyStats *plain_async = NULL, *plain_buffer = NULL;
+
+		if (!seek_mode_from_string(modes[m], &mode)) {
+			g_printerr("Unknown seek mode '%s', expected one of: %s\n", modes[m], SEEK_MODE_NAMES);
+			failures++;
+			continue;
+		}
+
+		/* same targets with and without the index */
+		for (i = 0; i < n_seeks; i++)
+			targets[i] = (gint64)g_rand_double_range(rand, 0, (gdouble)duration * 0.9);
+
+		for (v = 0; v < (index != NULL ? 2 : 1); v++) {
+			LatencyStats *async_done = latency_stats_new(), *first_buffer = latency_stats_new();
+			gchar *async_json, *buffer_json;
+
+			if (!run_mode(&data, bus, mode, targets, n_seeks, v ? index : NULL, async_done, first_buffer))
+				failures++;
+
+			async_json = latency_stats_to_json(async_done);
+			buffer_json = latency_stats_to_json(first_buffer);
+			if (v == 0) {
+				g_print("{\"mode\":\"%s\",\"index\":false,\"seeks\":%d,\"async_done\":%s,\"first_buffer\":%s}\n",
+						modes[m], n_seeks, async_json, buffer_json);
+				/* kept to compare the indexed run against */
+				plain_async = async_done;
+				plain_buffer = first_buffer;
+			} else {
+				g_print("{\"mode\":\"%s\",\"index\":true,\"seeks\":%d,\"async_done\":%s,\"first_buffer\":%s,"
+						"\"vs_plain_p50_pct\":{\"async_done\":%.1f,\"first_buffer\":%.1f}}\n",
+						modes[m], n_seeks, async_json, buffer_json,
+						p50_change(plain_async, async_done), p50_change(plain_buffer, first_buffer));
+				latency_stats_free(async_done);
+				latency_stats_free(first_buffer);
+			}
+			g_free(async_json);
+			g_free(buffer_json);
+		}
+		latency_stats_free(plain_async);
+		latency_stats_free(plain_buffer);
+	}
+	g_strfreev(modes);
+	g_free(targets);
+	g_rand_free(rand);
+
+done:
+	keyframe_index_free(index);
+	g_free(modes_arg);
+	gst_object_unref(bus);
+	gst_element_set_state(data.playbin, GST_STATE_NULL);
+	gst_object_unref(data.playbin);
+	g_mutex_clear(&data.lock);
+	g_cond_clear(&data.cond);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * Trick-play benchmark for the basic-tutorial4 playbin pipeline.
+ *
+ * Plays a local file into synchronized fakesinks at each rate of --rates,
+ * switched through Common/trick-mode. Every rate starts from the same spot:
+ * 10% into the file going forward, 90% going backwards. It then plays for
+ * --seconds of wall time while we count the video frames rendered, the
+ * process CPU time (getrusage, all threads) and how far the position moved.
+ * One JSON line per rate:
+ *   fps             video frames rendered per second
+ *   cpu_pct         CPU time over wall time, 100 is one core
+ *   effective_rate  stream time covered per second, negative backwards
+ *   key_units       whether only keyframes were decoded
+ * With --compare the fast rates also run with every frame decoded.
+ *
+ * build: gcc basic-tutorial4-trick-bench.c ../../Common/trick-mode.c ../../Common/bench-util.c \
+ *            -o basic-tutorial4-trick-bench $(pkg-config --cflags --libs gstreamer-1.0)
+ */
+#include <string.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+
+#include "../../Common/bench-util.h"
+#include "../../Common/trick-mode.h"
+
+#define DEFAULT_RATES "1,2,4,8,16,0.5,0.25,-1,-4,-16"
+#define DEFAULT_SECONDS 5
+/* give up on a seek after this long */
+#define SEEK_TIMEOUT (10 * GST_SECOND)
+
+typedef struct _BenchData {
+	GstElement *playbin;
+	GstElement *vsink;
+	gint frames;		/* rendered video frames, atomic */
+} BenchData;
+
+/* @brief fakesink handoff, called when a video buffer is rendered */
+static void handoff_cb(GstElement *sink, GstBuffer *buffer, GstPad *pad, BenchData *data) {
+	g_atomic_int_inc(&data->frames);
+}
+
+/* user + system time of the whole process */
+static GstClockTime cpu_time(void) {
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return GST_TIMEVAL_TO_TIME(usage.ru_utime) + GST_TIMEVAL_TO_TIME(usage.ru_stime);
+}
+
+/*
+ * @brief play at rate for seconds and print the JSON line
+ *        key_units_rate decides on keyframe-only decoding, see trick-mode.h
+ * */
+static gboolean run_rate(BenchData *data, GstBus *bus, gdouble rate, gdouble key_units_rate, gint64 duration,
+		gint seconds) {
+	TrickMode *trick = trick_mode_new(data->playbin, key_units_rate);
+	GstClockTime wall, cpu, deadline;
+	gint64 pos_start = -1, pos_end = -1;
+	gboolean eos = FALSE, flushed, ok = FALSE;
+	gint frames;
+
+	/* start point at 1x, then the rate change from there like a player would do it */
+	if (!trick_mode_seek(trick, rate > 0 ? duration / 10 : duration / 10 * 9) ||
+			!bench_wait_for(bus, GST_MESSAGE_ASYNC_DONE, SEEK_TIMEOUT))
+		goto done;
+	if (!trick_mode_set_rate(trick, rate, &flushed))
+		goto done;
+	/* 1x needs no seek at all and instant rate changes don't preroll again */
+	if (flushed && !bench_wait_for(bus, GST_MESSAGE_ASYNC_DONE, SEEK_TIMEOUT))
+		goto done;
+
+	gst_element_query_position(data->playbin, GST_FORMAT_TIME, &pos_start);
+	g_atomic_int_set(&data->frames, 0);
+	wall = gst_util_get_timestamp();
+	cpu = cpu_time();
+
+	/* the segment may run out before the time is up */
+	deadline = wall + seconds * GST_SECOND;
+	while (!eos) {
+		GstClockTime now = gst_util_get_timestamp();
+		GstMessage *msg;
+
+		if (now >= deadline)
+			break;
+		msg = gst_bus_timed_pop_filtered(bus, deadline - now, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+		if (msg == NULL)
+			break;
+		if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+			g_printerr("Error from %s at %gx\n", GST_OBJECT_NAME(msg->src), rate);
+			gst_message_unref(msg);
+			goto done;
+		}
+		eos = TRUE;
+		gst_message_unref(msg);
+	}
+
+	frames = g_atomic_int_get(&data->frames);
+	cpu = cpu_time() - cpu;
+	wall = gst_util_get_timestamp() - wall;
+	if (!eos)
+		gst_element_query_position(data->playbin, GST_FORMAT_TIME, &pos_end);
+	else
+		pos_end = rate > 0 ? duration : 0;
+
+	g_print("{\"rate\":%g,\"key_units\":%s,\"seconds\":%.2f,\"frames\":%d,\"fps\":%.1f,\"cpu_pct\":%.1f,"
+			"\"effective_rate\":%.2f,\"eos\":%s}\n",
+			rate, trick_mode_is_key_units(trick) ? "true" : "false", (gdouble)wall / GST_SECOND, frames,
+			(gdouble)frames * GST_SECOND / wall, 100.0 * cpu / wall,
+			pos_start >= 0 && pos_end >= 0 ? (gdouble)(pos_end - pos_start) / wall : 0.0,
+			eos ? "true" : "false");
+	ok = TRUE;
+
+done:
+	/* the next rate starts with a 1x seek of its own */
+	trick_mode_free(trick);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	BenchData data;
+	GstBus *bus;
+	gint64 duration;
+	gint seconds = DEFAULT_SECONDS, r, failures = 0;
+	gdouble key_units_rate = TRICK_MODE_KEY_UNITS_RATE;
+	gboolean compare = FALSE;
+	gchar *rates_arg = NULL, *uri;
+	gchar **rates;
+	GOptionEntry entries[] = {
+		{ "rates", 'r', 0, G_OPTION_ARG_STRING, &rates_arg, "Comma separated playback rates (default " DEFAULT_RATES ")", "LIST" },
+		{ "seconds", 't', 0, G_OPTION_ARG_INT, &seconds, "Wall time played per rate (default 5)", "S" },
+		{ "key-units-from", 'k', 0, G_OPTION_ARG_DOUBLE, &key_units_rate, "Decode keyframes only from this rate up (default 4)", "RATE" },
+		{ "compare", 'c', 0, G_OPTION_ARG_NONE, &compare, "Run keyframe-only rates again decoding every frame", NULL },
+		{ NULL }
+	};
+
+	if (!bench_parse_options(&argc, &argv, "FILE - trick-play benchmark", entries))
+		return -1;
+
+	if (argc < 2 || seconds <= 0 || key_units_rate <= 0) {
+		g_printerr("Usage: %s [OPTIONS] FILE\n", argv[0]);
+		return -1;
+	}
+	uri = bench_uri_from_arg(argv[1]);
+	if (uri == NULL)
+		return -1;
+
+	memset(&data, 0, sizeof(data));
+	data.playbin = gst_element_factory_make("playbin", "playbin");
+	data.vsink = bench_sync_sink_new("vsink", G_CALLBACK(handoff_cb), &data);
+	if (!data.playbin || !data.vsink) {
+		g_printerr("Not all elements could be created.\n");
+		return -1;
+	}
+	g_object_set(data.playbin, "uri", uri, "video-sink", data.vsink,
+			"audio-sink", bench_sync_sink_new("asink", NULL, NULL), NULL);
+	g_free(uri);
+
+	/* preroll & start playing */
+	bus = gst_element_get_bus(data.playbin);
+	gst_element_set_state(data.playbin, GST_STATE_PLAYING);
+	if (!bench_wait_for(bus, GST_MESSAGE_ASYNC_DONE, SEEK_TIMEOUT)) {
+		failures++;
+		goto done;
+	}
+	if (!gst_element_query_duration(data.playbin, GST_FORMAT_TIME, &duration) || duration <= 0) {
+		g_printerr("Could not query duration, is the file seekable?\n");
+		failures++;
+		goto done;
+	}
+
+	rates = g_strsplit(rates_arg ? rates_arg : DEFAULT_RATES, ",", -1);
+	for (r = 0; rates[r] != NULL; r++) {
+		gdouble rate = g_ascii_strtod(rates[r], NULL);
+
+		if (rate == 0.0) {
+			g_printerr("Bad rate '%s'\n", rates[r]);
+			failures++;
+			continue;
+		}
+		if (!run_rate(&data, bus, rate, key_units_rate, duration, seconds))
+			failures++;
+		/* the same rate decoding everything, for the CPU it saves */
+		if (compare && ABS(rate) >= key_units_rate && !run_rate(&data, bus, rate, G_MAXDOUBLE, duration, seconds))
+			failures++;
+	}
+	g_strfreev(rates);
+
+done:
+	g_free(rates_arg);
+	gst_object_unref(bus);
+	gst_element_set_state(data.playbin, GST_STATE_NULL);
+	gst_object_unref(data.playbin);
+	return failures ? 1 : 0;
+}
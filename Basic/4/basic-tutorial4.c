@@ -1,82 +1,267 @@
+/*
+ * build: gcc basic-tutorial4.c ../../Common/position-tracker.c ../../Common/seek-modes.c \
+ *            ../../Common/startup-profiler.c ../../Common/event-log.c ../../Common/buffering.c \
+ *            ../../Common/keyframe-index.c ../../Common/trick-mode.c ../../Common/segment-loop.c \
+ *            ../../Common/latency-stats.c ../../Common/qos-stats.c ../../Common/latency-tracer.c \
+ *            -o basic-tutorial4 $(pkg-config --cflags --libs gstreamer-1.0)
+ *
+ * usage: basic-tutorial4 [OPTIONS] [URI]
+ */
 #include <gst/gst.h>
 
+#include "../../Common/position-tracker.h"
+#include "../../Common/seek-modes.h"
+#include "../../Common/startup-profiler.h"
+#include "../../Common/event-log.h"
+#include "../../Common/buffering.h"
+#include "../../Common/keyframe-index.h"
+#include "../../Common/trick-mode.h"
+#include "../../Common/segment-loop.h"
+#include "../../Common/qos-stats.h"
+#include "../../Common/latency-tracer.h"
+
+#define DEFAULT_URI "http://docs.gstreamer.com/media/sintel_trailer-480p.webm"
+
+/* default time between two position updates, in msec */
+#define DEFAULT_POSITION_INTERVAL 100
+
 /* callback data to be passed around */
 typedef struct _CustomData {
-	GstElement* playbin2;
+	GstElement* playbin;
+	PositionTracker *tracker;	/* position/duration without polling */
+	Buffering *buffering;	/* pauses while the network catches up */
+	KeyframeIndex *index;	/* local files only, NULL seeks through the demuxer */
+	TrickMode *trick;	/* rate changes */
+	SegmentLoop *loop;	/* looping forever, NULL plays once */
+	gboolean loop_started;
+	QosStats *qos;		/* dropped frames & lateness, NULL unless dumped */
+	LatencyTracer *tracer;	/* per element latency, NULL unless traced */
 	gboolean playing;	/*is playing? */
 	gboolean terminate;	/*should terminated loop?*/
 	gboolean seek_enabled;	/*does media support seek ?*/
 	gboolean seek_done;	/* have we performed seek already?*/
+	SeekMode seek_mode;	/* flavour of the 10s -> 30s seek */
+	gdouble rate;		/* switched to at 10s instead of seeking, 1.0 seeks */
 	gint64 duration;	/* duration of track, in nsec*/
 } CustomData;
 
 static void handle_message(CustomData* data, GstMessage *msg);
+static void position_cb(gint64 current, gint64 duration, CustomData *data);
 
 int main(int argc, char *argv[]) {
 	CustomData data;
-	GstBus *bus;
+	GstBus *bus = NULL;
 	GstMessage *msg;
 	GstStateChangeReturn ret;
+	gint interval = DEFAULT_POSITION_INTERVAL;
+	gchar *seek_mode = NULL;
+	gint ring_buffer = 0, qos_dump = 0;
+	GstClockTime next_dump = GST_CLOCK_TIME_NONE, timeout;
+	gboolean use_index = FALSE, loop = FALSE, trace_latency = FALSE;
+	gdouble rate = 1.0;
+	GstMessageType loop_messages, qos_messages;
+	const gchar *uri;
+	GOptionContext *ctx;
+	GError *err = NULL;
+	gint status = 0;
+	GOptionEntry entries[] = {
+		{ "position-interval", 'i', 0, G_OPTION_ARG_INT, &interval, "Time between position updates in ms (default 100)", "MS" },
+		{ "seek-mode", 's', 0, G_OPTION_ARG_STRING, &seek_mode, "Seek flavour: " SEEK_MODE_NAMES " (default key-unit)", "MODE" },
+		{ "ring-buffer", 0, 0, G_OPTION_ARG_INT, &ring_buffer, "Spool the stream to an on-disk ring buffer of this many MB (default off)", "MB" },
+		{ "keyframe-index", 'k', 0, G_OPTION_ARG_NONE, &use_index, "Seek through a cached keyframe index (local files)", NULL },
+		{ "loop", 'l', 0, G_OPTION_ARG_NONE, &loop, "Loop the clip gaplessly instead of seeking, until interrupted", NULL },
+		{ "qos-dump", 'q', 0, G_OPTION_ARG_INT, &qos_dump, "Print QoS statistics as JSON every S seconds (default off)", "S" },
+		{ "trace-latency", 't', 0, G_OPTION_ARG_NONE, &trace_latency, "Measure per element latency and throughput, print them at end-of-stream", NULL },
+		{ "rate", 'r', 0, G_OPTION_ARG_DOUBLE, &rate, "Play at this rate from 10s on instead of seeking, negative plays backwards", "RATE" },
+		{ NULL }
+	};
 
 	data.playing = data.terminate = data.seek_enabled = data.seek_done = FALSE;
 	data.duration = GST_CLOCK_TIME_NONE;
+	/* everything the cleanup at the end frees, in case we bail out early */
+	data.playbin = NULL;
+	data.index = NULL;
+	data.buffering = NULL;
+	data.trick = NULL;
+	data.loop = NULL;
+	data.qos = NULL;
+	data.tracer = NULL;
+	data.tracker = NULL;
 
-	/* init gstreamer */
-	gst_init(&argc, &argv);
+	/* opt-in startup profiling, see startup-profiler.h */
+	startup_profiler_init();
 
-	/* create playbin2*/
-	data.playbin2 = gst_element_factory_make("playbin2", "playbin2");
+	/* init gstreamer, along with our options */
+	ctx = g_option_context_new("[URI] - playbin position & seek tutorial");
+	g_option_context_add_main_entries(ctx, entries, NULL);
+	g_option_context_add_group(ctx, gst_init_get_option_group());
+	if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+		g_printerr("Failed to parse options: %s\n", err->message);
+		g_clear_error(&err);
+		g_option_context_free(ctx);
+		return -1;
+	}
+	g_option_context_free(ctx);
+	startup_profiler_mark("gst_init");
+
+	/* binary message log instead of printing state changes, see event-log.h */
+	event_log_open_from_env();
 
-	if (!data.playbin2) {
+	data.seek_mode = SEEK_MODE_KEY_UNIT;
+	if (seek_mode != NULL && !seek_mode_from_string(seek_mode, &data.seek_mode)) {
+		g_printerr("Unknown seek mode '%s', expected one of: %s\n", seek_mode, SEEK_MODE_NAMES);
+		g_free(seek_mode);
+		status = -1;
+		goto out;
+	}
+	g_free(seek_mode);
+	if (rate == 0.0) {
+		g_printerr("Rate must not be 0\n");
+		status = -1;
+		goto out;
+	}
+	data.rate = rate;
+
+	/* create playbin*/
+	data.playbin = gst_element_factory_make("playbin", "playbin");
+	startup_profiler_mark("playbin created");
+
+	if (!data.playbin) {
 		g_printerr("Not all elements could be created.\n");
-		return -1;
+		status = -1;
+		goto out;
 	}
 
 	/* Set URI */
-	g_object_set(data.playbin2, "uri", "http://docs.gstreamer.com/media/sintel_trailer-480p.webm", NULL);
+	uri = argc > 1 ? argv[1] : DEFAULT_URI;
+	g_object_set(data.playbin, "uri", uri, NULL);
+	startup_profiler_watch(data.playbin);
+
+	/* scan the file for keyframes once, later runs load the cached index */
+	if (use_index) {
+		gchar *path = g_filename_from_uri(uri, NULL, NULL);
+		GstClockTime start = gst_util_get_timestamp();
+		gboolean cached = FALSE;
+
+		if (path != NULL)
+			data.index = keyframe_index_get(path, &cached);
+		if (data.index != NULL)
+			g_print("Keyframe index: %u keyframes, %s in %.1f ms\n", keyframe_index_count(data.index),
+					cached ? "loaded" : "built", (gdouble)GST_CLOCK_DIFF(start, gst_util_get_timestamp()) / GST_MSECOND);
+		else
+			g_printerr("No keyframe index for %s, seeking without\n", uri);
+		g_free(path);
+		startup_profiler_mark("keyframe index");
+	}
+
+	/* pause on buffering, optionally seek back into a disk cache, see buffering.h */
+	buffering_configure(data.playbin, (guint64)MAX(ring_buffer, 0) * 1024 * 1024);
+	data.buffering = buffering_new(data.playbin);
+
+	data.trick = trick_mode_new(data.playbin, 0);
+	/* a flushing seek would end segment mode, the loop replaces the 10s seek */
+	data.loop = loop ? segment_loop_new(data.playbin) : NULL;
+	data.loop_started = FALSE;
+	loop_messages = loop ? GST_MESSAGE_SEGMENT_DONE | GST_MESSAGE_ELEMENT : 0;
+	data.seek_done = loop;
+
+	/* headless frame drop monitoring, see qos-stats.h */
+	data.qos = qos_dump > 0 ? qos_stats_new() : NULL;
+	qos_messages = data.qos ? GST_MESSAGE_QOS : 0;
+	if (data.qos)
+		next_dump = gst_util_get_timestamp() + qos_dump * GST_SECOND;
+
+	/* playbin builds its decoders and sinks on the way to PAUSED, the tracer follows, see latency-tracer.h */
+	data.tracer = trace_latency ? latency_tracer_new(data.playbin) : NULL;
+
+	/* Position updates are pushed by the tracker, we only sleep till the next one is due */
+	data.tracker = position_tracker_new(data.playbin, interval * GST_MSECOND, (PositionTrackerFunc)position_cb, &data);
 
 	/* Start playback */
-	ret = gst_element_set_state(data.playbin2, GST_STATE_PLAYING);
-	bus = gst_element_get_bus(data.playbin2);
+	ret = buffering_set_state(data.buffering, GST_STATE_PLAYING);
+	bus = gst_element_get_bus(data.playbin);
 	do {
-		msg = gst_bus_timed_pop_filtered(bus, 100 * GST_MSECOND,
-				GST_MESSAGE_STATE_CHANGED | GST_MESSAGE_ERROR | GST_MESSAGE_EOS | GST_MESSAGE_DURATION);
+		timeout = position_tracker_next_timeout(data.tracker);
+		if (GST_CLOCK_TIME_IS_VALID(next_dump)) {
+			GstClockTime now = gst_util_get_timestamp();
+
+			timeout = MIN(timeout, next_dump > now ? next_dump - now : 0);
+		}
+		msg = gst_bus_timed_pop_filtered(bus, timeout,
+				GST_MESSAGE_STATE_CHANGED | GST_MESSAGE_ERROR | GST_MESSAGE_EOS | GST_MESSAGE_DURATION_CHANGED |
+				GST_MESSAGE_ASYNC_DONE | GST_MESSAGE_BUFFERING | GST_MESSAGE_CLOCK_LOST | GST_MESSAGE_NEW_CLOCK |
+				loop_messages | qos_messages);
 		if (msg != NULL) {
+			position_tracker_handle_message(data.tracker, msg);
 			handle_message(&data, msg);
-		} else {
-			if (data.playing) {
-				GstFormat fmt = GST_FORMAT_TIME;
-				gint64 current = -1;
+		}
+		if (!data.terminate)
+			position_tracker_dispatch(data.tracker);
+		if (GST_CLOCK_TIME_IS_VALID(next_dump) && gst_util_get_timestamp() >= next_dump) {
+			gchar *json = qos_stats_to_json(data.qos);
 
-				/* get current stream position */
-				if (!gst_element_query_position(data.playbin2, &fmt, &current)) {
-					g_printerr("could not query current position.\n");
-				}
+			g_print("\nQoS %s\n", json);
+			g_free(json);
+			next_dump += qos_dump * GST_SECOND;
+		}
+	} while (!data.terminate);
 
-				/* query stream duration, if needed */
-				if (!GST_CLOCK_TIME_IS_VALID(data.duration)) {
-					if (!gst_element_query_duration(data.playbin2, &fmt, &data.duration)) {
-						g_printerr("Could not query current duration.\n");
-					}
-				}
+	g_print("Element queries issued %" G_GUINT64_FORMAT ", saved %" G_GUINT64_FORMAT "\n",
+			position_tracker_queries_issued(data.tracker), position_tracker_queries_saved(data.tracker));
+	g_print("Rebuffered %u times, %.1f s stalled\n", buffering_rebuffer_count(data.buffering),
+			(gdouble)buffering_rebuffer_time(data.buffering) / GST_SECOND);
+	if (data.qos != NULL) {
+		gchar *json = qos_stats_to_json(data.qos);
 
-				g_print("Position %" GST_TIME_FORMAT " / %" GST_TIME_FORMAT "\r", GST_TIME_ARGS(current), GST_TIME_ARGS(data.duration));
+		g_print("QoS %s\n", json);
+		g_free(json);
+	}
+	if (data.loop != NULL) {
+		gchar *gaps = segment_loop_gaps_to_json(data.loop);
 
-				/* If seeking is enabled, and its intended time to seek, do it */
-				if (data.seek_enabled && !data.seek_done && current > 10 * GST_SECOND) {
-					g_print("\nReached 10s, performing seek...\n");
-					gst_element_seek_simple(data.playbin2, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, 30 * GST_SECOND);
-					data.seek_done = TRUE;
-				}
-			}
-		}
-	} while (!data.terminate);
+		g_print("Looped %u times, gaps %s\n", segment_loop_iterations(data.loop), gaps);
+		g_free(gaps);
+	}
 
+out:
 	/* Free Resources */
-	gst_object_unref(bus);
-	gst_element_set_state(data.playbin2, GST_STATE_NULL);
-	gst_object_unref(data.playbin2);
-	return 0;
+	event_log_close();
+	position_tracker_free(data.tracker);
+	buffering_free(data.buffering);
+	keyframe_index_free(data.index);
+	trick_mode_free(data.trick);
+	segment_loop_free(data.loop);
+	qos_stats_free(data.qos);
+	if (bus != NULL)
+		gst_object_unref(bus);
+	if (data.playbin != NULL) {
+		gst_element_set_state(data.playbin, GST_STATE_NULL);
+		latency_tracer_free(data.tracer);
+		gst_object_unref(data.playbin);
+	}
+	return status;
+}
+
+/* @brief called by the position tracker whenever an update is due */
+static void position_cb(gint64 current, gint64 duration, CustomData *data) {
+	data->duration = duration;
+	if (!data->playing)
+		return;
+
+	g_print("Position %" GST_TIME_FORMAT " / %" GST_TIME_FORMAT "\r", GST_TIME_ARGS(current), GST_TIME_ARGS(data->duration));
+
+	/* If seeking is enabled, and its intended time to seek, do it */
+	if (data->seek_enabled && !data->seek_done && current > 10 * GST_SECOND) {
+		if (data->rate != 1.0) {
+			trick_mode_set_rate(data->trick, data->rate, NULL);
+			g_print("\nReached 10s, playing at %gx%s...\n", data->rate,
+					trick_mode_is_key_units(data->trick) ? ", keyframes only" : "");
+		} else {
+			g_print("\nReached 10s, performing %s seek...\n", seek_mode_to_string(data->seek_mode));
+			keyframe_index_seek(data->index, data->playbin, data->seek_mode, 30 * GST_SECOND);
+		}
+		data->seek_done = TRUE;
+	}
 }
 
 static void handle_message(CustomData* data, GstMessage* msg) {
@@ -84,6 +269,38 @@ static void handle_message(CustomData* data, GstMessage* msg) {
 	gchar* debug_info;
 	GstState old_state, new_state;
 	
+	event_log_message(msg);
+	if (data->tracer != NULL)
+		latency_tracer_handle_message(data->tracer, msg);
+	if (data->loop != NULL) {
+		const gchar *kind;
+		gint64 gap;
+
+		switch (segment_loop_handle_message(data->loop, msg)) {
+			case SEGMENT_LOOP_RESTARTED:
+				g_print("\nLoop %u\n", segment_loop_iterations(data->loop));
+				gst_message_unref(msg);
+				return;
+			case SEGMENT_LOOP_GAP:
+				kind = segment_loop_last_gap(data->loop, &gap);
+				g_print("Loop %u: %s gap %.3f ms\n", segment_loop_iterations(data->loop), kind, (gdouble)gap / GST_MSECOND);
+				gst_message_unref(msg);
+				return;
+			default:
+				break;
+		}
+	}
+	if (data->qos != NULL && qos_stats_handle_message(data->qos, msg)) {
+		gst_message_unref(msg);
+		return;
+	}
+	if (buffering_handle_message(data->buffering, msg)) {
+		if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_BUFFERING)
+			g_print("Buffering %3d%%\r", buffering_get_percent(data->buffering));
+		gst_message_unref(msg);
+		return;
+	}
+
 	switch (GST_MESSAGE_TYPE(msg)) {
 		case GST_MESSAGE_ERROR:
 			gst_message_parse_error(msg, &err, &debug_info);
@@ -99,8 +316,9 @@ static void handle_message(CustomData* data, GstMessage* msg) {
 			break;
 		case GST_MESSAGE_STATE_CHANGED:
 			gst_message_parse_state_changed(msg, &old_state, &new_state, NULL);
-			if (GST_MESSAGE_SRC(msg) == GST_OBJECT(data->playbin2)) {
-				g_print("Pipeline state changed : %s -> %s\n", gst_element_state_get_name(old_state), gst_element_state_get_name(new_state));
+			if (GST_MESSAGE_SRC(msg) == GST_OBJECT(data->playbin)) {
+				if (!event_log_enabled())
+					g_print("Pipeline state changed : %s -> %s\n", gst_element_state_get_name(old_state), gst_element_state_get_name(new_state));
 				data->playing = (new_state == GST_STATE_PLAYING);
 
 				if (data->playing) {
@@ -108,10 +326,13 @@ static void handle_message(CustomData* data, GstMessage* msg) {
 					gint64 start, end;
 					query = gst_query_new_seeking(GST_FORMAT_TIME);
 
-					if (gst_element_query (data->playbin2, query)) {
+					if (gst_element_query (data->playbin, query)) {
 						gst_query_parse_seeking(query, NULL, &data->seek_enabled, &start, &end);
 						if (data->seek_enabled) {
 							g_print("Seeking is ENABLED from %" GST_TIME_FORMAT " to %" GST_TIME_FORMAT ".\n", GST_TIME_ARGS(start), GST_TIME_ARGS(end));
+							/* once, later PLAYING transitions (buffering) continue the loop */
+							if (data->loop != NULL && !data->loop_started)
+								data->loop_started = segment_loop_start(data->loop);
 						} else {
 							g_print("Seeking is disabled for this stream.\n");
 						}
@@ -122,9 +343,18 @@ static void handle_message(CustomData* data, GstMessage* msg) {
 				}
 			}
 			break;
-		case GST_MESSAGE_DURATION:
+		case GST_MESSAGE_DURATION_CHANGED:
 			data->duration = GST_CLOCK_TIME_NONE;
 			break;
+		case GST_MESSAGE_ASYNC_DONE:
+			/* preroll/seek finished, position tracker takes care of it */
+			break;
+		case GST_MESSAGE_NEW_CLOCK:
+			/* the position tracker re-anchors on it */
+			break;
+		case GST_MESSAGE_ELEMENT:
+			/* only asked for when looping, the rest isn't ours */
+			break;
 		default:
 			g_printerr("Unexpected message received.\n");
 	}
@@ -1,8 +1,16 @@
+/*
+ * build: gcc basic-tutorial-5.c scrub-engine.c thumbnail-service.c ../../Common/seek-modes.c \
+ *            ../../Common/startup-profiler.c ../../Common/buffering.c ../../Common/qos-stats.c -o basic-tutorial-5 \
+ *            $(pkg-config --cflags --libs gtk+-2.0 gstreamer-1.0 gstreamer-video-1.0 gstreamer-app-1.0)
+ *
+ * usage: basic-tutorial-5 [--ring-buffer MB] [--thumbnail-workers N] [--thumbnail-memory MB] [--thumbnail-disk-cache]
+ *                         [--qos-dump S] [URI]
+ */
 #include <string.h>
 
 #include <gtk/gtk.h>
 #include <gst/gst.h>
-#include <gst/interfaces/xoverlay.h> /* use xoverlay interface of playbin2 - need to look at concept of oop in C */
+#include <gst/video/videooverlay.h> /* use video overlay interface of playbin - need to look at concept of oop in C */
 
 #include <gdk/gdk.h>
 
@@ -12,13 +20,46 @@
 #error "Unsupported platform"
 #endif
 
+#include "scrub-engine.h"
+#include "thumbnail-service.h"
+#include "../../Common/startup-profiler.h"
+#include "../../Common/buffering.h"
+#include "../../Common/qos-stats.h"
+
+#define DEFAULT_URI "http://docs.gstreamer.com/media/sintel_cropped_multilingual.webm"
+
+/* seek bar preview width, in pixels */
+#define THUMBNAIL_WIDTH 160
+
 /* structure to contain all player data, UI components */
 typedef struct _CustomData {
-	GstElement *playbin2; /* only pipeline */
+	GstElement *playbin; /* only pipeline */
 
 	GtkWidget *slider; /* seeking, time update*/
 	GtkWidget *streams_list; /* Text wiget to display stream information */
 	gulong slider_update_signal_id; /* signal id for slider update signal */
+	ScrubEngine *scrub; /* coalesces seeks while the slider is dragged */
+	Buffering *buffering; /* pauses while the network catches up, owns the target state */
+	GtkListStore *streams_store; /* model of streams_list, updated in place */
+	QosStats *qos; /* dropped frames & lateness per element, from QOS messages */
+	GtkListStore *qos_store; /* one row per element, in the order they first reported */
+
+	/* seek bar previews, started once the duration is known */
+	const gchar *uri;
+	ThumbnailService *thumbs;
+	gint thumb_workers; /* -1 disables previews */
+	guint64 thumb_memory; /* LRU budget, bytes */
+	gboolean thumb_disk_cache;
+	GtkWidget *preview_window; /* popup above the slider */
+	GtkWidget *preview_image;
+	gint hover_slot; /* slot under the pointer, -1 if none */
+	gint hover_x, hover_y; /* pointer x, slider top; root coordinates */
+
+	/* Streams whose tags changed since the last update, one bit per stream index.
+	 * Set from streaming threads, consumed in the main thread. */
+	guint dirty_streams[3];
+	gint full_refresh; /* a stream index didn't fit the bitmask */
+	gint update_pending; /* "tags-changed" message posted, not handled yet */
 
 	GstState state; /* Current state of pipeline */
 	gint64 duration; /* total duration of clip */
@@ -28,12 +69,43 @@ typedef struct _CustomData {
 enum {
 	COL_STREAM_NAME = 0,
 	COL_STREAM_DETAILS,
+	COL_STREAM_TYPE, /* hidden, StreamType */
+	COL_STREAM_INDEX, /* hidden, index within type */
 	NUM_COLS
 };
 
+/* QoS table IDs */
+enum {
+	COL_QOS_ELEMENT = 0,
+	COL_QOS_PROCESSED,
+	COL_QOS_DROPPED,
+	COL_QOS_DROP_PCT,
+	COL_QOS_JITTER,
+	COL_QOS_PROPORTION,
+	NUM_QOS_COLS
+};
+
+/* stream kinds, in the order they are listed */
+typedef enum {
+	STREAM_VIDEO = 0,
+	STREAM_AUDIO,
+	STREAM_TEXT,
+	NUM_STREAM_TYPES
+} StreamType;
+
+static const struct {
+	const gchar *name; /* row name prefix */
+	const gchar *count_property; /* number of streams on playbin */
+	const gchar *tags_signal; /* action signal fetching tags */
+} stream_types[NUM_STREAM_TYPES] = {
+	{ "VIDEO", "n-video", "get-video-tags" },
+	{ "AUDIO", "n-audio", "get-audio-tags" },
+	{ "TEXT", "n-text", "get-text-tags" },
+};
+
 /*
  * @brief callback when GTK creates physical window
- *        retrive handle and provide to gstreamer through XOverlay interface
+ *        retrive handle and provide to gstreamer through VideoOverlay interface
  */
 static void realise_cb (GtkWidget *widget, CustomData *data) {
 	GdkWindow *window = gtk_widget_get_window (widget);
@@ -41,7 +113,7 @@ static void realise_cb (GtkWidget *widget, CustomData *data) {
 
 	/* why so serius? */
 	if (!gdk_window_ensure_native (window)) {
-		g_error ("couldn't create native window needed for GstXOverlay!");
+		g_error ("couldn't create native window needed for GstVideoOverlay!");
 	}
 
 	/* get window handle */
@@ -50,32 +122,32 @@ static void realise_cb (GtkWidget *widget, CustomData *data) {
 #else
 #error "Unsupported platform!!"
 #endif
-	/* pass window to xoverlay of playbin2 */
-	gst_x_overlay_set_window_handle(GST_X_OVERLAY (data->playbin2), window_handle);
+	/* pass window to video overlay of playbin */
+	gst_video_overlay_set_window_handle(GST_VIDEO_OVERLAY (data->playbin), window_handle);
 }
 
 /*
  * @brief callback when PLAY button is hit
  * */
 static void play_cb(GtkButton *button, CustomData *data) {
-	gst_element_set_state(data->playbin2, GST_STATE_PLAYING);
+	buffering_set_state(data->buffering, GST_STATE_PLAYING);
 }
 
 /*
  * @brief callback when PAUSE button is hit
  * */
 static void pause_cb(GtkButton *button, CustomData *data) {
-	gst_element_set_state(data->playbin2, GST_STATE_PAUSED);
+	buffering_set_state(data->buffering, GST_STATE_PAUSED);
 }
 
 /*
  * @brief callback when STOP button is hit
  * */
 static void stop_cb(GtkButton *button, CustomData *data) {
-	gst_element_set_state(data->playbin2, GST_STATE_READY);
+	buffering_set_state(data->buffering, GST_STATE_READY);
 }
 
-/* @brief update stream of playbin2 based on stream name*/
+/* @brief update stream of playbin based on stream name*/
 static inline void stream_set(gchar* stream_name, CustomData *data) {
 	gchar *o_brace, *c_brace;
 	gchar *tstr, *property;
@@ -92,10 +164,10 @@ static inline void stream_set(gchar* stream_name, CustomData *data) {
 	property = g_strdup_printf("current-%s", tstr);
 	g_free(tstr);
 
-	g_object_get(data->playbin2, property, &tint, NULL);
+	g_object_get(data->playbin, property, &tint, NULL);
 	if (tint != id) {
 		g_print("Selecting %s : %d.\n", property, id);
-		g_object_set(data->playbin2, property, id, NULL);
+		g_object_set(data->playbin, property, id, NULL);
 	}
 	g_free(property);
 }
@@ -150,11 +222,93 @@ static gboolean expose_cb(GtkWidget* widget, GdkEventExpose *event, CustomData*
 
 /*
  * @brief callback when slider changes its position, perform seek
+ *        seeks are coalesced by the scrub engine, so a fast drag doesn't flood the pipeline
  * */
 static void slider_cb(GtkRange *range, CustomData *data) {
 	gdouble value = gtk_range_get_value(GTK_RANGE(data->slider));
-	gst_element_seek_simple(data->playbin2, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
-			(gint64)(value * GST_SECOND));
+	scrub_engine_seek(data->scrub, (gint64)(value * GST_SECOND));
+}
+
+/*
+ * @brief callback when slider is grabbed, keyframe seeks from now on
+ * */
+static gboolean slider_press_cb(GtkWidget *widget, GdkEventButton *event, CustomData *data) {
+	scrub_engine_begin(data->scrub);
+	return FALSE; /* let GtkRange handle the event too */
+}
+
+/*
+ * @brief callback when slider is released, land exactly where the user left it
+ * */
+static gboolean slider_release_cb(GtkWidget *widget, GdkEventButton *event, CustomData *data) {
+	gdouble value = gtk_range_get_value(GTK_RANGE(data->slider));
+	scrub_engine_end(data->scrub, (gint64)(value * GST_SECOND));
+	return FALSE;
+}
+
+/* @brief GdkPixbuf is done with the pixels, drop our reference */
+static void thumbnail_free_cb (guchar *pixels, Thumbnail *thumb) {
+	thumbnail_unref (thumb);
+}
+
+/*
+ * @brief show thumb in the popup above the pointer, takes the reference
+ *        NULL keeps showing the last one until the right one is decoded
+ * */
+static void show_preview (CustomData *data, Thumbnail *thumb) {
+	GdkPixbuf *pixbuf;
+
+	if (thumb == NULL)
+		return;
+
+	pixbuf = gdk_pixbuf_new_from_data (g_bytes_get_data (thumb->pixels, NULL), GDK_COLORSPACE_RGB, FALSE, 8,
+			thumb->width, thumb->height, thumb->stride, (GdkPixbufDestroyNotify)thumbnail_free_cb, thumb);
+	gtk_image_set_from_pixbuf (GTK_IMAGE (data->preview_image), pixbuf);
+	g_object_unref (pixbuf);
+	gtk_window_move (GTK_WINDOW (data->preview_window), data->hover_x - thumb->width / 2, data->hover_y - thumb->height - 8);
+	gtk_widget_show (data->preview_window);
+}
+
+/*
+ * @brief called by the thumbnail service when a missed slot was decoded
+ * */
+static void thumbnail_ready_cb (Thumbnail *thumb, CustomData *data) {
+	if (thumb->slot == data->hover_slot)
+		show_preview (data, thumbnail_ref (thumb));
+}
+
+/*
+ * @brief callback when the pointer moves over the slider, preview the spot under it
+ * */
+static gboolean slider_motion_cb (GtkWidget *widget, GdkEventMotion *event, CustomData *data) {
+	GtkAllocation allocation;
+	GtkAdjustment *adjustment;
+	gint64 position;
+
+	if (data->thumbs == NULL)
+		return FALSE;
+
+	/* the slider's event window covers its allocation */
+	gtk_widget_get_allocation (widget, &allocation);
+	adjustment = gtk_range_get_adjustment (GTK_RANGE (widget));
+	position = (gint64)(CLAMP (event->x / MAX (allocation.width, 1), 0.0, 1.0) *
+			gtk_adjustment_get_upper (adjustment) * GST_SECOND);
+
+	data->hover_slot = thumbnail_service_slot (data->thumbs, position);
+	data->hover_x = (gint)event->x_root;
+	data->hover_y = (gint)(event->y_root - event->y);
+	show_preview (data, thumbnail_service_lookup (data->thumbs, position));
+	return FALSE;
+}
+
+/*
+ * @brief callback when the pointer leaves the slider, hide the preview
+ * */
+static gboolean slider_leave_cb (GtkWidget *widget, GdkEventCrossing *event, CustomData *data) {
+	data->hover_slot = -1;
+	if (data->preview_window != NULL)
+		gtk_widget_hide (data->preview_window);
+	return FALSE;
 }
 
 /*
@@ -166,6 +320,8 @@ static void create_ui(CustomData *data) {
 	GtkWidget *main_box; /* holds hbox & controls */
 	GtkWidget *main_hbox; /* hold video window & streaminfo widget */
 	GtkWidget *controls; /* hold buttons & slider */
+	GtkWidget *info_box; /* streams & QoS tables side by side */
+	GtkWidget *qos_list; /* QoS per element */
 	GtkWidget *play_button, *pause_button, *stop_button;
 	GtkCellRenderer     *renderer;
 
@@ -189,6 +345,17 @@ static void create_ui(CustomData *data) {
 	data->slider = gtk_hscale_new_with_range(0, 100, 1);
 	gtk_scale_set_draw_value(GTK_SCALE(data->slider), 0);
 	data->slider_update_signal_id = g_signal_connect (G_OBJECT (data->slider), "value-changed", G_CALLBACK (slider_cb), data);
+	g_signal_connect (G_OBJECT (data->slider), "button-press-event", G_CALLBACK (slider_press_cb), data);
+	g_signal_connect (G_OBJECT (data->slider), "button-release-event", G_CALLBACK (slider_release_cb), data);
+	gtk_widget_add_events (data->slider, GDK_POINTER_MOTION_MASK | GDK_LEAVE_NOTIFY_MASK);
+	g_signal_connect (G_OBJECT (data->slider), "motion-notify-event", G_CALLBACK (slider_motion_cb), data);
+	g_signal_connect (G_OBJECT (data->slider), "leave-notify-event", G_CALLBACK (slider_leave_cb), data);
+
+	/* preview popup, shown while hovering the slider */
+	data->preview_window = gtk_window_new (GTK_WINDOW_POPUP);
+	data->preview_image = gtk_image_new ();
+	gtk_container_add (GTK_CONTAINER (data->preview_window), data->preview_image);
+	gtk_widget_show (data->preview_image);
 
 	data->streams_list = gtk_tree_view_new();
 	renderer = gtk_cell_renderer_text_new ();
@@ -200,8 +367,29 @@ static void create_ui(CustomData *data) {
 	gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(data->streams_list),
 			-1, "Stream Details", renderer, "text", COL_STREAM_DETAILS, NULL);
 	g_signal_connect(data->streams_list, "row-activated", G_CALLBACK(stream_select_cb), data);
+	/* model stays for the whole run, rows get updated in place as tags change */
+	data->streams_store = gtk_list_store_new(NUM_COLS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT, G_TYPE_INT);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(data->streams_list), GTK_TREE_MODEL(data->streams_store));
+	g_object_unref(data->streams_store); /* tree view holds it */
 	//gtk_text_view_set_editable (GTK_TEXT_VIEW (data->streams_list), FALSE);
 
+	qos_list = gtk_tree_view_new ();
+	data->qos_store = gtk_list_store_new (NUM_QOS_COLS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+			G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (qos_list), GTK_TREE_MODEL (data->qos_store));
+	g_object_unref (data->qos_store); /* tree view holds it */
+	renderer = gtk_cell_renderer_text_new ();
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (qos_list), -1, "Element", renderer, "text", COL_QOS_ELEMENT, NULL);
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (qos_list), -1, "Processed", renderer, "text", COL_QOS_PROCESSED, NULL);
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (qos_list), -1, "Dropped", renderer, "text", COL_QOS_DROPPED, NULL);
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (qos_list), -1, "Drop %", renderer, "text", COL_QOS_DROP_PCT, NULL);
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (qos_list), -1, "Jitter ms (last/max)", renderer, "text", COL_QOS_JITTER, NULL);
+	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (qos_list), -1, "Proportion", renderer, "text", COL_QOS_PROPORTION, NULL);
+
+	info_box = gtk_hbox_new (FALSE, 0);
+	gtk_box_pack_start (GTK_BOX (info_box), data->streams_list, TRUE, TRUE, 2);
+	gtk_box_pack_start (GTK_BOX (info_box), qos_list, FALSE, FALSE, 2);
+
 	controls = gtk_hbox_new (FALSE, 0);
 	gtk_box_pack_start (GTK_BOX (controls), play_button, FALSE, FALSE, 2);
 	gtk_box_pack_start (GTK_BOX (controls), pause_button, FALSE, FALSE, 2);
@@ -210,7 +398,7 @@ static void create_ui(CustomData *data) {
 
 	main_box = gtk_vbox_new (FALSE, 0);
 	gtk_box_pack_start (GTK_BOX (main_box), video_window, TRUE, TRUE, 0);
-	gtk_box_pack_start (GTK_BOX (main_box), data->streams_list, FALSE, FALSE, 2);
+	gtk_box_pack_start (GTK_BOX (main_box), info_box, FALSE, FALSE, 2);
 	gtk_box_pack_start (GTK_BOX (main_box), controls, FALSE, FALSE, 0);
 	gtk_container_add (GTK_CONTAINER (main_window), main_box);
 	gtk_window_set_default_size (GTK_WINDOW (main_window), 640, 480);
@@ -218,26 +406,61 @@ static void create_ui(CustomData *data) {
 	gtk_widget_show_all (main_window);
 }
 
+/* Bring one row of the QoS table up to date, rows are appended as elements first report */
+static void update_qos_row (const QosElementStats *element, guint index, CustomData *data) {
+	GtkTreeIter iter;
+	gchar processed[32], dropped[32], drop_pct[16], jitter[32], proportion[16];
+
+	if (!gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (data->qos_store), &iter, NULL, index))
+		gtk_list_store_append (data->qos_store, &iter);
+
+	g_snprintf (processed, sizeof (processed), "%" G_GUINT64_FORMAT, element->processed);
+	g_snprintf (dropped, sizeof (dropped), "%" G_GUINT64_FORMAT, element->dropped);
+	g_snprintf (drop_pct, sizeof (drop_pct), "%.1f", qos_stats_drop_percent (element));
+	g_snprintf (jitter, sizeof (jitter), "%.1f / %.1f", (gdouble)element->jitter_last / GST_MSECOND,
+			(gdouble)element->jitter_max / GST_MSECOND);
+	g_snprintf (proportion, sizeof (proportion), "%.2f", element->proportion_last);
+	gtk_list_store_set (data->qos_store, &iter,
+			COL_QOS_ELEMENT, element->name,
+			COL_QOS_PROCESSED, processed,
+			COL_QOS_DROPPED, dropped,
+			COL_QOS_DROP_PCT, drop_pct,
+			COL_QOS_JITTER, jitter,
+			COL_QOS_PROPORTION, proportion,
+			-1);
+}
+
 /* This function is called periodically to refresh the GUI */
 static gboolean refresh_ui (CustomData *data) {
-	GstFormat fmt = GST_FORMAT_TIME;
 	gint64 current = -1;
 
+	/* QoS keeps its last numbers in any state */
+	qos_stats_foreach (data->qos, (QosStatsFunc)update_qos_row, data);
+
 	/* We do not want to update anything unless we are in the PAUSED or PLAYING states */
 	if (data->state < GST_STATE_PAUSED)
 		return TRUE;
 
 	/* If we didn't know it yet, query the stream duration */
 	if (!GST_CLOCK_TIME_IS_VALID (data->duration)) {
-		if (!gst_element_query_duration (data->playbin2, &fmt, &data->duration)) {
+		if (!gst_element_query_duration (data->playbin, GST_FORMAT_TIME, &data->duration)) {
 			g_printerr ("Could not query current duration.\n");
 		} else {
 			/* Set the range of the slider to the clip duration, in SECONDS */
 			gtk_range_set_range (GTK_RANGE (data->slider), 0, (gdouble)data->duration / GST_SECOND);
+
+			/* Previews need the duration to cut the clip into slots, they decode in their own pipelines */
+			if (data->thumbs == NULL && data->thumb_workers >= 0)
+				data->thumbs = thumbnail_service_new (data->uri, data->duration, THUMBNAIL_WIDTH, data->thumb_workers,
+						data->thumb_memory, data->thumb_disk_cache, (ThumbnailReadyFunc)thumbnail_ready_cb, data);
 		}
 	}
 
-	if (gst_element_query_position (data->playbin2, &fmt, &current)) {
+	/* Don't fight the user over the slider while it is dragged */
+	if (scrub_engine_is_dragging (data->scrub))
+		return TRUE;
+
+	if (gst_element_query_position (data->playbin, GST_FORMAT_TIME, &current)) {
 		/* Block the "value-changed" signal, so the slider_cb function is not called
 		 *      * (which would trigger a seek the user has not requested) */
 		g_signal_handler_block (data->slider, data->slider_update_signal_id);
@@ -249,13 +472,32 @@ static gboolean refresh_ui (CustomData *data) {
 	return TRUE;
 }
 
-/* This function is called when new metadata is discovered in the stream */
-static void tags_cb (GstElement *playbin2, gint stream, CustomData *data) {
-	/* We are possibly in a GStreamer working thread, so we notify the main
-	 *    * thread of this event through a message in the bus */
-	gst_element_post_message (playbin2,
-			gst_message_new_application (GST_OBJECT (playbin2),
-				gst_structure_new ("tags-changed", NULL)));
+/* This function is called when new metadata is discovered in the stream.
+ * We are possibly in a GStreamer working thread: flag the stream and notify the
+ * main thread through a message in the bus, unless one is already on its way. */
+static void mark_stream_dirty (GstElement *playbin, StreamType type, gint stream, CustomData *data) {
+	if (stream >= 0 && stream < 32)
+		g_atomic_int_or (&data->dirty_streams[type], 1u << stream);
+	else
+		g_atomic_int_set (&data->full_refresh, TRUE);
+
+	if (g_atomic_int_compare_and_exchange (&data->update_pending, FALSE, TRUE)) {
+		gst_element_post_message (playbin,
+				gst_message_new_application (GST_OBJECT (playbin),
+					gst_structure_new ("tags-changed", NULL)));
+	}
+}
+
+static void video_tags_cb (GstElement *playbin, gint stream, CustomData *data) {
+	mark_stream_dirty (playbin, STREAM_VIDEO, stream, data);
+}
+
+static void audio_tags_cb (GstElement *playbin, gint stream, CustomData *data) {
+	mark_stream_dirty (playbin, STREAM_AUDIO, stream, data);
+}
+
+static void text_tags_cb (GstElement *playbin, gint stream, CustomData *data) {
+	mark_stream_dirty (playbin, STREAM_TEXT, stream, data);
 }
 
 /* This function is called when an error message is posted on the bus */
@@ -271,14 +513,14 @@ static void error_cb (GstBus *bus, GstMessage *msg, CustomData *data) {
 	g_free (debug_info);
 
 	/* Set the pipeline to READY (which stops playback) */
-	gst_element_set_state (data->playbin2, GST_STATE_READY);
+	buffering_set_state (data->buffering, GST_STATE_READY);
 }
 
 /* This function is called when an End-Of-Stream message is posted on the bus.
  *  * We just set the pipeline to READY (which stops playback) */
 static void eos_cb (GstBus *bus, GstMessage *msg, CustomData *data) {
 	g_print ("End-Of-Stream reached.\n");
-	gst_element_set_state (data->playbin2, GST_STATE_READY);
+	buffering_set_state (data->buffering, GST_STATE_READY);
 }
 
 /* This function is called when the pipeline changes states. We use it to
@@ -286,7 +528,8 @@ static void eos_cb (GstBus *bus, GstMessage *msg, CustomData *data) {
 static void state_changed_cb (GstBus *bus, GstMessage *msg, CustomData *data) {
 	GstState old_state, new_state, pending_state;
 	gst_message_parse_state_changed (msg, &old_state, &new_state, &pending_state);
-	if (GST_MESSAGE_SRC (msg) == GST_OBJECT (data->playbin2)) {
+	buffering_handle_message (data->buffering, msg);
+	if (GST_MESSAGE_SRC (msg) == GST_OBJECT (data->playbin)) {
 		data->state = new_state;
 		g_print ("State set to %s\n", gst_element_state_get_name (new_state));
 		if (old_state == GST_STATE_READY && new_state == GST_STATE_PAUSED) {
@@ -296,92 +539,147 @@ static void state_changed_cb (GstBus *bus, GstMessage *msg, CustomData *data) {
 	}
 }
 
-/* Extract metadata from all the streams and write it to the text widget in the GUI */
-static void analyze_streams (CustomData *data) {
-	gint i;
-	GstTagList *tags;
-	gchar *str_name, *str_details;
-	guint rate;
-	gint n_video, n_audio, n_text;
+/* This function is called on buffering and clock-lost messages, the buffering policy decides on the state */
+static void buffering_cb (GstBus *bus, GstMessage *msg, CustomData *data) {
+	buffering_handle_message (data->buffering, msg);
+	if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_BUFFERING)
+		g_print ("Buffering %3d%%\r", buffering_get_percent (data->buffering));
+}
 
-	GtkListStore *store;
+/* This function is called when an element reports lateness or drops frames */
+static void qos_cb (GstBus *bus, GstMessage *msg, CustomData *data) {
+	qos_stats_handle_message (data->qos, msg);
+}
+
+/* This function is called every --qos-dump seconds, for runs nobody watches */
+static gboolean qos_dump_cb (CustomData *data) {
+	gchar *json = qos_stats_to_json (data->qos);
+
+	g_print ("QoS %s\n", json);
+	g_free (json);
+	return TRUE;
+}
+
+/* This function is called when a seek or preroll completes, the scrub engine may issue its trailing seek */
+static void async_done_cb (GstBus *bus, GstMessage *msg, CustomData *data) {
+	scrub_engine_async_done (data->scrub, msg);
+}
+
+/*
+ * @brief find the row of a stream
+ * @return TRUE and its iter if found; FALSE and the position it belongs at otherwise
+ */
+static gboolean find_stream_row (GtkTreeModel *model, StreamType type, gint index, GtkTreeIter *iter, gint *position) {
+	gboolean valid;
+
+	*position = 0;
+	for (valid = gtk_tree_model_get_iter_first (model, iter); valid; valid = gtk_tree_model_iter_next (model, iter)) {
+		gint row_type, row_index;
+
+		gtk_tree_model_get (model, iter, COL_STREAM_TYPE, &row_type, COL_STREAM_INDEX, &row_index, -1);
+		if (row_type == type && row_index == index)
+			return TRUE;
+		if (row_type > type || (row_type == type && row_index > index))
+			return FALSE;
+		(*position)++;
+	}
+	return FALSE;
+}
+
+/* Refresh the row of one stream from its current tags, only touching the model if something changed */
+static void update_stream_row (CustomData *data, StreamType type, gint index) {
+	GtkTreeModel *model = GTK_TREE_MODEL (data->streams_store);
+	GstTagList *tags = NULL;
 	GtkTreeIter iter;
+	gchar *str_name, *str_details, *old_details;
+	gboolean found;
+	gint position;
+
+	/* Retrieve the stream's tags */
+	g_signal_emit_by_name (data->playbin, stream_types[type].tags_signal, index, &tags);
+	found = find_stream_row (model, type, index, &iter, &position);
+	if (!tags) {
+		if (found)
+			gtk_list_store_remove (data->streams_store, &iter);
+		return;
+	}
 
-	store = gtk_list_store_new(NUM_COLS, G_TYPE_STRING, G_TYPE_STRING);
-	/* Read some properties */
-	g_object_get (data->playbin2, "n-video", &n_video, NULL);
-	g_object_get (data->playbin2, "n-audio", &n_audio, NULL);
-	g_object_get (data->playbin2, "n-text", &n_text, NULL);
-
-	for (i = 0; i < n_video; i++) {
-		tags = NULL;
-		/* Retrieve the stream's video tags */
-		g_signal_emit_by_name (data->playbin2, "get-video-tags", i, &tags);
-		if (tags) {
-			str_name = g_strdup_printf("VIDEO[%d]", i);
-			str_details = gst_tag_list_to_string (tags);
-			/*Fill stream details*/
-			gtk_list_store_append (store, &iter);
-			gtk_list_store_set (store, &iter,
-					COL_STREAM_NAME, str_name,
-					COL_STREAM_DETAILS, str_details,
-					-1);
-			g_free(str_name);
-			g_free(str_details);
-			gst_tag_list_free (tags);
-		}
+	str_details = gst_tag_list_to_string (tags);
+	gst_tag_list_unref (tags);
+	if (found) {
+		gtk_tree_model_get (model, &iter, COL_STREAM_DETAILS, &old_details, -1);
+		if (g_strcmp0 (old_details, str_details) != 0)
+			gtk_list_store_set (data->streams_store, &iter, COL_STREAM_DETAILS, str_details, -1);
+		g_free (old_details);
+	} else {
+		/*Fill stream details, keeping VIDEO/AUDIO/TEXT order*/
+		str_name = g_strdup_printf ("%s[%d]", stream_types[type].name, index);
+		gtk_list_store_insert_with_values (data->streams_store, &iter, position,
+				COL_STREAM_NAME, str_name,
+				COL_STREAM_DETAILS, str_details,
+				COL_STREAM_TYPE, type,
+				COL_STREAM_INDEX, index,
+				-1);
+		g_free (str_name);
 	}
+	g_free (str_details);
+}
 
-	for (i = 0; i < n_audio; i++) {
-		tags = NULL;
-		/* Retrieve the stream's audio tags */
-		g_signal_emit_by_name (data->playbin2, "get-audio-tags", i, &tags);
-		if (tags) {
-			str_name = g_strdup_printf("AUDIO[%d]", i);
-			str_details = gst_tag_list_to_string (tags);
-			/*Fill stream details*/
-			gtk_list_store_append (store, &iter);
-			gtk_list_store_set (store, &iter,
-					COL_STREAM_NAME, str_name,
-					COL_STREAM_DETAILS, str_details,
-					-1);
-			g_free(str_name);
-			g_free(str_details);
-			gst_tag_list_free (tags);
-		}
+/* Drop rows of streams playbin doesn't have anymore */
+static void prune_stream_rows (CustomData *data, StreamType type) {
+	GtkTreeModel *model = GTK_TREE_MODEL (data->streams_store);
+	GtkTreeIter iter;
+	gboolean valid;
+	gint n_streams;
+
+	g_object_get (data->playbin, stream_types[type].count_property, &n_streams, NULL);
+	valid = gtk_tree_model_get_iter_first (model, &iter);
+	while (valid) {
+		gint row_type, row_index;
+
+		gtk_tree_model_get (model, &iter, COL_STREAM_TYPE, &row_type, COL_STREAM_INDEX, &row_index, -1);
+		if (row_type == type && row_index >= n_streams)
+			valid = gtk_list_store_remove (data->streams_store, &iter);
+		else
+			valid = gtk_tree_model_iter_next (model, &iter);
 	}
+}
+
+/* Bring the stream info GUI up to date with the streams flagged dirty since last time */
+static void update_streams (CustomData *data) {
+	gboolean full;
+	gint type, i;
+
+	/* Clear the pending flag first: tags changing from here on post a new message */
+	g_atomic_int_set (&data->update_pending, FALSE);
+	full = g_atomic_int_compare_and_exchange (&data->full_refresh, TRUE, FALSE);
 
-	for (i = 0; i < n_text; i++) {
-		tags = NULL;
-		/* Retrieve the stream's subtitle tags */
-		g_signal_emit_by_name (data->playbin2, "get-text-tags", i, &tags);
-		if (tags) {
-			str_name = g_strdup_printf("TEXT[%d]", i);
-			str_details = gst_tag_list_to_string (tags);
-			/*Fill stream details*/
-			gtk_list_store_append (store, &iter);
-			gtk_list_store_set (store, &iter,
-					COL_STREAM_NAME, str_name,
-					COL_STREAM_DETAILS, str_details,
-					-1);
-			g_free(str_name);
-			g_free(str_details);
-			gst_tag_list_free (tags);
+	for (type = 0; type < NUM_STREAM_TYPES; type++) {
+		guint dirty = g_atomic_int_and (&data->dirty_streams[type], 0);
+
+		if (full) {
+			gint n_streams;
+
+			g_object_get (data->playbin, stream_types[type].count_property, &n_streams, NULL);
+			for (i = 0; i < n_streams; i++)
+				update_stream_row (data, type, i);
+		} else {
+			for (i = 0; dirty != 0; i++, dirty >>= 1) {
+				if (dirty & 1)
+					update_stream_row (data, type, i);
+			}
 		}
+		prune_stream_rows (data, type);
 	}
-	GtkTreeModel *tree = GTK_TREE_MODEL (store);
-	gtk_tree_view_set_model (GTK_TREE_VIEW (data->streams_list), tree);
-	g_object_unref (tree);
-
 }
 
 /* This function is called when an "application" message is posted on the bus.
  *  * Here we retrieve the message posted by the tags_cb callback */
 static void application_cb (GstBus *bus, GstMessage *msg, CustomData *data) {
-	if (g_strcmp0 (gst_structure_get_name (msg->structure), "tags-changed") == 0) {
+	if (g_strcmp0 (gst_structure_get_name (gst_message_get_structure (msg)), "tags-changed") == 0) {
 		/* If the message is the "tags-changed" (only one we are currently issuing), update
 		 *      * the stream info GUI */
-		analyze_streams (data);
+		update_streams (data);
 	}
 }
 
@@ -389,61 +687,141 @@ int main(int argc, char *argv[]) {
 	CustomData data;
 	GstStateChangeReturn ret;
 	GstBus *bus;
+	GOptionContext *ctx;
+	GError *err = NULL;
+	gint ring_buffer = 0, thumb_workers = 0, thumb_memory = 16, qos_dump = 0;
+	gboolean thumb_disk_cache = FALSE;
+	GOptionEntry entries[] = {
+		{ "ring-buffer", 0, 0, G_OPTION_ARG_INT, &ring_buffer, "Spool the stream to an on-disk ring buffer of this many MB (default off)", "MB" },
+		{ "thumbnail-workers", 0, 0, G_OPTION_ARG_INT, &thumb_workers, "Seek bar preview decoders, -1 disables previews (default half the cores)", "N" },
+		{ "thumbnail-memory", 0, 0, G_OPTION_ARG_INT, &thumb_memory, "Memory for cached previews in MB (default 16)", "MB" },
+		{ "thumbnail-disk-cache", 0, 0, G_OPTION_ARG_NONE, &thumb_disk_cache, "Keep previews on disk for the next run", NULL },
+		{ "qos-dump", 0, 0, G_OPTION_ARG_INT, &qos_dump, "Print QoS statistics as JSON every S seconds (default off)", "S" },
+		{ NULL }
+	};
+
+	/* Opt-in startup profiling, see startup-profiler.h */
+	startup_profiler_init ();
+
+	/* Our own options first, GTK and GStreamer take theirs from what is left */
+	ctx = g_option_context_new ("[URI] - GTK+ player tutorial");
+	g_option_context_add_main_entries (ctx, entries, NULL);
+	g_option_context_set_ignore_unknown_options (ctx, TRUE);
+	if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+		g_printerr ("Failed to parse options: %s\n", err->message);
+		g_clear_error (&err);
+		g_option_context_free (ctx);
+		return -1;
+	}
+	g_option_context_free (ctx);
 
 	/* Initialize GTK */
 	gtk_init (&argc, &argv);
+	startup_profiler_mark ("gtk_init");
 
 	/* Initialize GStreamer */
 	gst_init (&argc, &argv);
+	startup_profiler_mark ("gst_init");
 
 	/* Initialize our data structure */
 	memset (&data, 0, sizeof (data));
 	data.duration = GST_CLOCK_TIME_NONE;
+	data.uri = argc > 1 ? argv[1] : DEFAULT_URI;
+	data.thumb_workers = MAX (thumb_workers, -1);
+	data.thumb_memory = (guint64)MAX (thumb_memory, 1) * 1024 * 1024;
+	data.thumb_disk_cache = thumb_disk_cache;
+	data.hover_slot = -1;
+	data.qos = qos_stats_new ();
 
 	/* Create the elements */
-	data.playbin2 = gst_element_factory_make ("playbin2", "playbin2");
+	data.playbin = gst_element_factory_make ("playbin", "playbin");
+	startup_profiler_mark ("playbin created");
 
-	if (!data.playbin2) {
+	if (!data.playbin) {
 		g_printerr ("Not all elements could be created.\n");
 		return -1;
 	}
 
 	/* Set the URI to play */
-	g_object_set (data.playbin2, "uri", "http://docs.gstreamer.com/media/sintel_cropped_multilingual.webm", NULL);
+	g_object_set (data.playbin, "uri", data.uri, NULL);
 
-	/* Connect to interesting signals in playbin2 */
-	g_signal_connect (G_OBJECT (data.playbin2), "video-tags-changed", (GCallback) tags_cb, &data);
-	g_signal_connect (G_OBJECT (data.playbin2), "audio-tags-changed", (GCallback) tags_cb, &data);
-	g_signal_connect (G_OBJECT (data.playbin2), "text-tags-changed", (GCallback) tags_cb, &data);
+	/* Pause on buffering, optionally seek back into a disk cache, see buffering.h */
+	buffering_configure (data.playbin, (guint64)MAX (ring_buffer, 0) * 1024 * 1024);
+	data.buffering = buffering_new (data.playbin);
+
+	data.scrub = scrub_engine_new (data.playbin);
+
+	/* Connect to interesting signals in playbin */
+	g_signal_connect (G_OBJECT (data.playbin), "video-tags-changed", (GCallback) video_tags_cb, &data);
+	g_signal_connect (G_OBJECT (data.playbin), "audio-tags-changed", (GCallback) audio_tags_cb, &data);
+	g_signal_connect (G_OBJECT (data.playbin), "text-tags-changed", (GCallback) text_tags_cb, &data);
 
 	/* Create the GUI */
 	create_ui (&data);
+	startup_profiler_mark ("ui created");
+	startup_profiler_watch (data.playbin);
 
 	/* Instruct the bus to emit signals for each received message, and connect to the interesting signals */
-	bus = gst_element_get_bus (data.playbin2);
+	bus = gst_element_get_bus (data.playbin);
 	gst_bus_add_signal_watch (bus);
 	g_signal_connect (G_OBJECT (bus), "message::error", (GCallback)error_cb, &data);
 	g_signal_connect (G_OBJECT (bus), "message::eos", (GCallback)eos_cb, &data);
 	g_signal_connect (G_OBJECT (bus), "message::state-changed", (GCallback)state_changed_cb, &data);
 	g_signal_connect (G_OBJECT (bus), "message::application", (GCallback)application_cb, &data);
+	g_signal_connect (G_OBJECT (bus), "message::async-done", (GCallback)async_done_cb, &data);
+	g_signal_connect (G_OBJECT (bus), "message::buffering", (GCallback)buffering_cb, &data);
+	g_signal_connect (G_OBJECT (bus), "message::clock-lost", (GCallback)buffering_cb, &data);
+	g_signal_connect (G_OBJECT (bus), "message::qos", (GCallback)qos_cb, &data);
 	gst_object_unref (bus);
 
 	/* Start playing */
-	ret = gst_element_set_state (data.playbin2, GST_STATE_PLAYING);
+	ret = buffering_set_state (data.buffering, GST_STATE_PLAYING);
 	if (ret == GST_STATE_CHANGE_FAILURE) {
 		g_printerr ("Unable to set the pipeline to the playing state.\n");
-		gst_object_unref (data.playbin2);
+		gst_object_unref (data.playbin);
 		return -1;
 	}
 
 	/* Register a function that GLib will call every second */
 	g_timeout_add_seconds (1, (GSourceFunc)refresh_ui, &data);
+	if (qos_dump > 0)
+		g_timeout_add_seconds (qos_dump, (GSourceFunc)qos_dump_cb, &data);
 
 	/* Start the GTK main loop. We will not regain control until gtk_main_quit is called. */
 	gtk_main ();
 
+	g_print ("Scrubbing: %" G_GUINT64_FORMAT " seeks issued, %" G_GUINT64_FORMAT " dropped\n",
+			scrub_engine_seeks_issued (data.scrub), scrub_engine_seeks_dropped (data.scrub));
+	g_print ("Rebuffered %u times, %.1f s stalled\n", buffering_rebuffer_count (data.buffering),
+			(gdouble)buffering_rebuffer_time (data.buffering) / GST_SECOND);
+	if (data.thumbs != NULL) {
+		ThumbnailStats stats;
+
+		thumbnail_service_get_stats (data.thumbs, &stats);
+		g_print ("Thumbnails: %" G_GUINT64_FORMAT " lookups, %.0f%% memory hits, %" G_GUINT64_FORMAT " disk hits, "
+				"%" G_GUINT64_FORMAT " evicted, %" G_GUINT64_FORMAT " dropped\n",
+				stats.lookups, stats.lookups ? 100.0 * stats.memory_hits / stats.lookups : 0.0,
+				stats.disk_hits, stats.evicted, stats.dropped);
+		g_print ("Thumbnails: %" G_GUINT64_FORMAT " decoded, %" G_GUINT64_FORMAT " failed, %.1f ms each, "
+				"%.1f/s over %u workers",
+				stats.decoded, stats.failed,
+				stats.decoded ? (gdouble)stats.decode_time / stats.decoded / GST_MSECOND : 0.0,
+				stats.decode_time ? (gdouble)stats.decoded * stats.n_workers * GST_SECOND / stats.decode_time : 0.0,
+				stats.n_workers);
+		if (GST_CLOCK_TIME_IS_VALID (stats.fill_time))
+			g_print (", strip filled in %.1f s", (gdouble)stats.fill_time / GST_SECOND);
+		g_print ("\n");
+	}
+
+	if (qos_dump > 0)
+		qos_dump_cb (&data);
+
 	/* Free resources */
-	gst_element_set_state (data.playbin2, GST_STATE_NULL);
-	gst_object_unref (data.playbin2);
+	qos_stats_free (data.qos);
+	thumbnail_service_free (data.thumbs);
+	scrub_engine_free (data.scrub);
+	buffering_free (data.buffering);
+	gst_element_set_state (data.playbin, GST_STATE_NULL);
+	gst_object_unref (data.playbin);
 	return 0;
 }
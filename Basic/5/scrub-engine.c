@@ -0,0 +1,125 @@
+#include "scrub-engine.h"
+#include "../../Common/seek-modes.h"
+
+/* consider a seek lost if ASYNC_DONE doesn't show up within this, in msec */
+#define SEEK_WATCHDOG_TIMEOUT 1000
+
+struct _ScrubEngine {
+	GstElement *pipeline;
+
+	gboolean dragging;
+	gboolean in_flight;	/* seek issued, waiting for ASYNC_DONE */
+	guint32 seqnum;		/* of the seek in flight, its ASYNC_DONE carries it */
+	guint watchdog_id;	/* GSource id of lost seek watchdog */
+
+	/* trailing seek, collapsed from everything requested while in flight */
+	gboolean has_pending;
+	gint64 pending_position;
+	SeekMode pending_mode;
+
+	guint64 issued;
+	guint64 dropped;
+};
+
+static void issue_seek(ScrubEngine *engine, gint64 position, SeekMode mode);
+
+static void seek_done(ScrubEngine *engine) {
+	engine->in_flight = FALSE;
+	if (engine->watchdog_id != 0) {
+		g_source_remove(engine->watchdog_id);
+		engine->watchdog_id = 0;
+	}
+
+	if (engine->has_pending) {
+		engine->has_pending = FALSE;
+		issue_seek(engine, engine->pending_position, engine->pending_mode);
+	}
+}
+
+/* @brief ASYNC_DONE never came (seek refused downstream?), don't stall scrubbing */
+static gboolean watchdog_cb(ScrubEngine *engine) {
+	engine->watchdog_id = 0;
+	g_printerr("Seek not completed in %d ms, giving up on it.\n", SEEK_WATCHDOG_TIMEOUT);
+	seek_done(engine);
+	return FALSE;
+}
+
+static void issue_seek(ScrubEngine *engine, gint64 position, SeekMode mode) {
+	GstEvent *seek;
+	guint32 seqnum = gst_util_seqnum_next();
+
+	/* tagged, so a late ASYNC_DONE of a seek the watchdog gave up on isn't taken for this one */
+	seek = gst_event_new_seek(1.0, GST_FORMAT_TIME, seek_mode_get_flags(mode),
+			GST_SEEK_TYPE_SET, position, GST_SEEK_TYPE_NONE, GST_CLOCK_TIME_NONE);
+	gst_event_set_seqnum(seek, seqnum);
+	if (!gst_element_send_event(engine->pipeline, seek)) {
+		g_printerr("Seek to %" GST_TIME_FORMAT " failed.\n", GST_TIME_ARGS(position));
+		return;
+	}
+	engine->issued++;
+	engine->in_flight = TRUE;
+	engine->seqnum = seqnum;
+	engine->watchdog_id = g_timeout_add(SEEK_WATCHDOG_TIMEOUT, (GSourceFunc)watchdog_cb, engine);
+}
+
+/* @brief issue now, or replace the trailing seek if one is in flight */
+static void request_seek(ScrubEngine *engine, gint64 position, SeekMode mode) {
+	if (engine->in_flight) {
+		if (engine->has_pending)
+			engine->dropped++;
+		engine->has_pending = TRUE;
+		engine->pending_position = position;
+		engine->pending_mode = mode;
+	} else {
+		issue_seek(engine, position, mode);
+	}
+}
+
+ScrubEngine *scrub_engine_new(GstElement *pipeline) {
+	ScrubEngine *engine = g_new0(ScrubEngine, 1);
+
+	engine->pipeline = gst_object_ref(pipeline);
+	return engine;
+}
+
+void scrub_engine_free(ScrubEngine *engine) {
+	if (engine == NULL)
+		return;
+	if (engine->watchdog_id != 0)
+		g_source_remove(engine->watchdog_id);
+	gst_object_unref(engine->pipeline);
+	g_free(engine);
+}
+
+void scrub_engine_begin(ScrubEngine *engine) {
+	engine->dragging = TRUE;
+}
+
+void scrub_engine_seek(ScrubEngine *engine, gint64 position) {
+	/* not dragging: keyboard or click on the trough, go straight to the spot */
+	request_seek(engine, position, engine->dragging ? SEEK_MODE_KEY_UNIT : SEEK_MODE_ACCURATE);
+}
+
+void scrub_engine_end(ScrubEngine *engine, gint64 position) {
+	if (!engine->dragging)
+		return;
+	engine->dragging = FALSE;
+	request_seek(engine, position, SEEK_MODE_ACCURATE);
+}
+
+gboolean scrub_engine_is_dragging(ScrubEngine *engine) {
+	return engine->dragging;
+}
+
+void scrub_engine_async_done(ScrubEngine *engine, GstMessage *msg) {
+	if (engine->in_flight && gst_message_get_seqnum(msg) == engine->seqnum)
+		seek_done(engine);
+}
+
+guint64 scrub_engine_seeks_issued(ScrubEngine *engine) {
+	return engine->issued;
+}
+
+guint64 scrub_engine_seeks_dropped(ScrubEngine *engine) {
+	return engine->dropped;
+}
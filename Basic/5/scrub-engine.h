@@ -0,0 +1,37 @@
+#ifndef __SCRUB_ENGINE_H__
+#define __SCRUB_ENGINE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Seek coalescing for slider scrubbing.
+ *
+ * At most one seek is in flight; it is considered done on the ASYNC_DONE
+ * carrying its seqnum. Positions requested meanwhile collapse into one
+ * trailing seek, the overwritten ones are counted as dropped. While
+ * dragging, seeks snap to keyframes; ending the drag issues one accurate
+ * seek.
+ *
+ * Not thread safe, meant to be driven from the main loop.
+ */
+typedef struct _ScrubEngine ScrubEngine;
+
+ScrubEngine *scrub_engine_new(GstElement *pipeline);
+void scrub_engine_free(ScrubEngine *engine);
+
+void scrub_engine_begin(ScrubEngine *engine);
+void scrub_engine_seek(ScrubEngine *engine, gint64 position);
+void scrub_engine_end(ScrubEngine *engine, gint64 position);
+gboolean scrub_engine_is_dragging(ScrubEngine *engine);
+
+/* feed ASYNC_DONE messages of the pipeline, others' seqnums are ignored */
+void scrub_engine_async_done(ScrubEngine *engine, GstMessage *msg);
+
+guint64 scrub_engine_seeks_issued(ScrubEngine *engine);
+guint64 scrub_engine_seeks_dropped(ScrubEngine *engine);
+
+G_END_DECLS
+
+#endif /* __SCRUB_ENGINE_H__ */
@@ -0,0 +1,532 @@
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+
+#include "thumbnail-service.h"
+
+/* playbin's GST_PLAY_FLAG_VIDEO, workers decode nothing else */
+#define PLAY_FLAG_VIDEO (1 << 0)
+
+/* a worker gives up on a slot after this */
+#define DECODE_TIMEOUT (5 * GST_SECOND)
+
+/* hover requests kept queued, older ones are dropped */
+#define MAX_URGENT 4
+
+typedef enum {
+	SLOT_EMPTY = 0,
+	SLOT_QUEUED,	/* in the urgent queue */
+	SLOT_BUSY,	/* a worker has it */
+	SLOT_CACHED,
+	SLOT_EVICTED,	/* the background fill had it, only lookup brings it back */
+	SLOT_FAILED
+} SlotState;
+
+/* disk cache file header, followed by height * stride bytes of RGB */
+typedef struct _ThumbnailFileHeader {
+	gchar magic[8];		/* THUMBNAIL_FILE_MAGIC, not NUL terminated */
+	guint32 version;
+	guint32 width;
+	guint32 height;
+	guint32 stride;
+	gint64 position;
+} ThumbnailFileHeader;
+
+typedef struct _Worker {
+	ThumbnailService *service;
+	GThread *thread;
+	GstElement *playbin;	/* created on the first decode */
+	GstElement *sink;
+} Worker;
+
+struct _ThumbnailService {
+	gchar *uri;
+	gint64 duration;
+	gint width;
+	guint64 memory_budget;
+	gchar *disk_dir;	/* NULL without disk cache */
+	ThumbnailReadyFunc func;
+	gpointer user_data;
+
+	GMutex lock;
+	GCond cond;
+	gboolean stopping;
+	gboolean broken;	/* a pipeline couldn't start, no use trying the others */
+	guint8 state[THUMBNAIL_SLOTS];	/* SlotState */
+	gboolean wanted[THUMBNAIL_SLOTS];	/* lookup missed it, tell func */
+	GQueue urgent;		/* slots, most recent hover first */
+
+	/* LRU, most recently used at the head */
+	Thumbnail *cached[THUMBNAIL_SLOTS];
+	GList *lru_link[THUMBNAIL_SLOTS];
+	GQueue lru;
+
+	/* thumbnails for func, handed to the main loop in one idle */
+	GQueue ready;
+	guint ready_id;
+
+	Worker *workers;
+	guint n_workers;
+
+	GstClockTime start;
+	guint tried;		/* slots tried at least once */
+	gboolean seen[THUMBNAIL_SLOTS];
+	ThumbnailStats stats;
+};
+
+Thumbnail *thumbnail_ref(Thumbnail *thumb) {
+	g_atomic_int_inc(&thumb->refcount);
+	return thumb;
+}
+
+void thumbnail_unref(Thumbnail *thumb) {
+	if (thumb == NULL || !g_atomic_int_dec_and_test(&thumb->refcount))
+		return;
+	g_bytes_unref(thumb->pixels);
+	g_free(thumb);
+}
+
+static Thumbnail *thumbnail_new(gint slot, gint64 position, gint width, gint height, gint stride, GBytes *pixels) {
+	Thumbnail *thumb = g_new0(Thumbnail, 1);
+
+	thumb->slot = slot;
+	thumb->position = position;
+	thumb->width = width;
+	thumb->height = height;
+	thumb->stride = stride;
+	thumb->pixels = pixels;
+	thumb->refcount = 1;
+	return thumb;
+}
+
+static gint64 slot_position(ThumbnailService *service, gint slot) {
+	return service->duration / THUMBNAIL_SLOTS * slot;
+}
+
+gint thumbnail_service_slot(ThumbnailService *service, gint64 position) {
+	if (position <= 0)
+		return 0;
+	return (gint)MIN(position / (service->duration / THUMBNAIL_SLOTS), THUMBNAIL_SLOTS - 1);
+}
+
+/* Disk cache */
+
+static gchar *disk_dir_for(const gchar *uri, gint64 duration, gint width) {
+	gchar *path = g_filename_from_uri(uri, NULL, NULL);
+	gchar *key, *hash, *dir;
+	GStatBuf st;
+
+	/* local files also key on size and mtime, so an edited file isn't shown stale */
+	if (path != NULL && g_stat(path, &st) == 0)
+		key = g_strdup_printf("%s\n%d\n%" G_GINT64_FORMAT "\n%" G_GINT64_FORMAT "\n%" G_GINT64_FORMAT,
+				uri, width, duration, (gint64)st.st_size, (gint64)st.st_mtime);
+	else
+		key = g_strdup_printf("%s\n%d\n%" G_GINT64_FORMAT, uri, width, duration);
+	hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+	dir = g_build_filename(g_get_user_cache_dir(), "gst-tutorials", "thumbnails", hash, NULL);
+
+	g_free(hash);
+	g_free(key);
+	g_free(path);
+	return dir;
+}
+
+static gchar *disk_path(ThumbnailService *service, gint slot) {
+	gchar name[16];
+
+	g_snprintf(name, sizeof(name), "%03d.thumb", slot);
+	return g_build_filename(service->disk_dir, name, NULL);
+}
+
+static Thumbnail *disk_load(ThumbnailService *service, gint slot) {
+	ThumbnailFileHeader header;
+	Thumbnail *thumb = NULL;
+	gchar *path = disk_path(service, slot), *contents;
+	gsize length;
+
+	if (!g_file_get_contents(path, &contents, &length, NULL)) {
+		g_free(path);
+		return NULL;
+	}
+	g_free(path);
+
+	if (length >= sizeof(header)) {
+		memcpy(&header, contents, sizeof(header));
+		if (memcmp(header.magic, THUMBNAIL_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+				header.version == THUMBNAIL_FILE_VERSION && header.width > 0 && header.stride >= header.width * 3 &&
+				length - sizeof(header) == (gsize)header.height * header.stride)
+			thumb = thumbnail_new(slot, header.position, header.width, header.height, header.stride,
+					g_bytes_new(contents + sizeof(header), length - sizeof(header)));
+	}
+	g_free(contents);
+	return thumb;
+}
+
+static void disk_save(ThumbnailService *service, Thumbnail *thumb) {
+	ThumbnailFileHeader header;
+	GByteArray *out = g_byte_array_new();
+	gchar *path = disk_path(service, thumb->slot);
+	gsize size;
+	gconstpointer pixels = g_bytes_get_data(thumb->pixels, &size);
+	GError *err = NULL;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, THUMBNAIL_FILE_MAGIC, sizeof(header.magic));
+	header.version = THUMBNAIL_FILE_VERSION;
+	header.width = thumb->width;
+	header.height = thumb->height;
+	header.stride = thumb->stride;
+	header.position = thumb->position;
+	g_byte_array_append(out, (const guint8 *)&header, sizeof(header));
+	g_byte_array_append(out, pixels, size);
+
+	/* renamed into place, a concurrent run never reads half a file */
+	if (!g_file_set_contents(path, (const gchar *)out->data, out->len, &err)) {
+		g_printerr("Thumbnails: could not write %s: %s\n", path, err->message);
+		g_clear_error(&err);
+	}
+	g_byte_array_free(out, TRUE);
+	g_free(path);
+}
+
+/* Decoding, worker threads */
+
+static gboolean worker_start(Worker *worker) {
+	ThumbnailService *service = worker->service;
+	GstCaps *caps;
+	GstBus *bus;
+
+	worker->playbin = gst_element_factory_make("playbin", NULL);
+	worker->sink = gst_element_factory_make("appsink", NULL);
+	if (!worker->playbin || !worker->sink) {
+		g_printerr("Thumbnails: playbin or appsink missing.\n");
+		if (worker->sink)
+			gst_object_unref(gst_object_ref_sink(worker->sink));
+		goto fail;
+	}
+
+	/* playsink scales to this, height follows the aspect ratio */
+	caps = gst_caps_new_simple("video/x-raw", "format", G_TYPE_STRING, "RGB", "width", G_TYPE_INT, service->width,
+			"pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, NULL);
+	g_object_set(worker->sink, "caps", caps, "sync", FALSE, "enable-last-sample", FALSE, NULL);
+	gst_caps_unref(caps);
+	g_object_set(worker->playbin, "uri", service->uri, "video-sink", worker->sink, "flags", PLAY_FLAG_VIDEO, NULL);
+
+	/* nobody reads this bus, don't let messages pile up on it */
+	bus = gst_element_get_bus(worker->playbin);
+	gst_bus_set_flushing(bus, TRUE);
+	gst_object_unref(bus);
+
+	if (gst_element_set_state(worker->playbin, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE ||
+			gst_element_get_state(worker->playbin, NULL, NULL, DECODE_TIMEOUT) != GST_STATE_CHANGE_SUCCESS) {
+		g_printerr("Thumbnails: could not preroll %s\n", service->uri);
+		gst_element_set_state(worker->playbin, GST_STATE_NULL);
+		goto fail;
+	}
+	return TRUE;
+
+fail:
+	if (worker->playbin)
+		gst_object_unref(worker->playbin);
+	worker->playbin = worker->sink = NULL;
+	return FALSE;
+}
+
+static Thumbnail *thumbnail_from_sample(gint slot, GstSample *sample) {
+	GstBuffer *buffer = gst_sample_get_buffer(sample);
+	GstVideoInfo info;
+	GstVideoFrame frame;
+	const GstSegment *segment = gst_sample_get_segment(sample);
+	gint64 position = GST_BUFFER_PTS(buffer);
+	guint8 *pixels;
+	gint stride, row;
+
+	if (!gst_video_info_from_caps(&info, gst_sample_get_caps(sample)) ||
+			!gst_video_frame_map(&frame, &info, buffer, GST_MAP_READ))
+		return NULL;
+
+	/* rows as GdkPixbuf likes them: 4 byte aligned */
+	stride = GST_ROUND_UP_4(GST_VIDEO_INFO_WIDTH(&info) * 3);
+	pixels = g_malloc(stride * GST_VIDEO_INFO_HEIGHT(&info));
+	for (row = 0; row < GST_VIDEO_INFO_HEIGHT(&info); row++)
+		memcpy(pixels + row * stride, (guint8 *)GST_VIDEO_FRAME_PLANE_DATA(&frame, 0) + row * GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0),
+				GST_VIDEO_INFO_WIDTH(&info) * 3);
+	gst_video_frame_unmap(&frame);
+
+	if (segment != NULL && GST_CLOCK_TIME_IS_VALID(position))
+		position = gst_segment_to_stream_time(segment, GST_FORMAT_TIME, position);
+	return thumbnail_new(slot, position, GST_VIDEO_INFO_WIDTH(&info), GST_VIDEO_INFO_HEIGHT(&info), stride,
+			g_bytes_new_take(pixels, stride * GST_VIDEO_INFO_HEIGHT(&info)));
+}
+
+/* @brief the keyframe at or before the slot start, NULL on failure */
+static Thumbnail *worker_decode(Worker *worker, gint slot) {
+	GstSample *sample;
+	Thumbnail *thumb;
+
+	if (!gst_element_seek_simple(worker->playbin, GST_FORMAT_TIME,
+			GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE,
+			slot_position(worker->service, slot)))
+		return NULL;
+	/* the flush dropped the old preroll, the new one is the keyframe */
+	if (gst_element_get_state(worker->playbin, NULL, NULL, DECODE_TIMEOUT) != GST_STATE_CHANGE_SUCCESS)
+		return NULL;
+	sample = gst_app_sink_try_pull_preroll(GST_APP_SINK(worker->sink), DECODE_TIMEOUT);
+	if (sample == NULL)
+		return NULL;
+	thumb = thumbnail_from_sample(slot, sample);
+	gst_sample_unref(sample);
+	return thumb;
+}
+
+/* @brief next slot to work on, hover requests first; -1 to stop */
+static gint next_job(ThumbnailService *service) {
+	gint slot = -1;
+
+	g_mutex_lock(&service->lock);
+	while (!service->stopping && !service->broken) {
+		if (!g_queue_is_empty(&service->urgent)) {
+			slot = GPOINTER_TO_INT(g_queue_pop_head(&service->urgent));
+			break;
+		}
+		/* in order, also picks up hover requests that were dropped */
+		for (slot = 0; slot < THUMBNAIL_SLOTS && service->state[slot] != SLOT_EMPTY; slot++)
+			;
+		if (slot < THUMBNAIL_SLOTS)
+			break;
+		slot = -1;
+		g_cond_wait(&service->cond, &service->lock);
+	}
+	if (slot >= 0)
+		service->state[slot] = SLOT_BUSY;
+	g_mutex_unlock(&service->lock);
+	return slot;
+}
+
+static void cache_evict_tail(ThumbnailService *service) {
+	gint slot = GPOINTER_TO_INT(g_queue_pop_tail(&service->lru));
+	Thumbnail *thumb = service->cached[slot];
+
+	service->stats.memory_bytes -= g_bytes_get_size(thumb->pixels);
+	service->stats.evicted++;
+	service->cached[slot] = NULL;
+	service->lru_link[slot] = NULL;
+	service->state[slot] = SLOT_EVICTED;
+	thumbnail_unref(thumb);
+}
+
+static gboolean ready_cb(ThumbnailService *service) {
+	GQueue ready = G_QUEUE_INIT;
+	Thumbnail *thumb;
+
+	g_mutex_lock(&service->lock);
+	ready = service->ready;
+	g_queue_init(&service->ready);
+	service->ready_id = 0;
+	g_mutex_unlock(&service->lock);
+
+	while ((thumb = g_queue_pop_head(&ready)) != NULL) {
+		service->func(thumb, service->user_data);
+		thumbnail_unref(thumb);
+	}
+	return FALSE;
+}
+
+/* @brief cache the worker's result, NULL on failure; lock held */
+static void finish_job(ThumbnailService *service, gint slot, Thumbnail *thumb) {
+	if (!service->seen[slot]) {
+		service->seen[slot] = TRUE;
+		if (++service->tried == THUMBNAIL_SLOTS)
+			service->stats.fill_time = GST_CLOCK_DIFF(service->start, gst_util_get_timestamp());
+	}
+
+	if (thumb == NULL) {
+		service->state[slot] = SLOT_FAILED;
+		service->stats.failed++;
+		service->wanted[slot] = FALSE;
+		return;
+	}
+
+	service->state[slot] = SLOT_CACHED;
+	service->cached[slot] = thumbnail_ref(thumb);
+	g_queue_push_head(&service->lru, GINT_TO_POINTER(slot));
+	service->lru_link[slot] = service->lru.head;
+	service->stats.memory_bytes += g_bytes_get_size(thumb->pixels);
+	/* the newest one always stays, even over budget */
+	while (service->stats.memory_bytes > service->memory_budget && service->lru.length > 1)
+		cache_evict_tail(service);
+
+	if (service->wanted[slot] && service->func != NULL) {
+		g_queue_push_tail(&service->ready, thumbnail_ref(thumb));
+		if (service->ready_id == 0)
+			service->ready_id = g_idle_add((GSourceFunc)ready_cb, service);
+	}
+	service->wanted[slot] = FALSE;
+}
+
+static gpointer worker_func(Worker *worker) {
+	ThumbnailService *service = worker->service;
+	gint slot;
+
+	while ((slot = next_job(service)) >= 0) {
+		Thumbnail *thumb = NULL;
+		gboolean from_disk = FALSE;
+		GstClockTime start, time = 0;
+
+		if (service->disk_dir != NULL)
+			thumb = disk_load(service, slot);
+		if (thumb != NULL) {
+			from_disk = TRUE;
+		} else if (worker->playbin != NULL || worker_start(worker)) {
+			start = gst_util_get_timestamp();
+			thumb = worker_decode(worker, slot);
+			time = GST_CLOCK_DIFF(start, gst_util_get_timestamp());
+		}
+
+		g_mutex_lock(&service->lock);
+		if (worker->playbin == NULL && !from_disk)
+			service->broken = TRUE;
+		if (from_disk) {
+			service->stats.disk_hits++;
+		} else if (thumb != NULL) {
+			service->stats.decoded++;
+			service->stats.decode_time += time;
+		}
+		finish_job(service, slot, thumb);
+		g_mutex_unlock(&service->lock);
+
+		if (thumb != NULL && !from_disk && service->disk_dir != NULL)
+			disk_save(service, thumb);
+		thumbnail_unref(thumb);
+	}
+
+	if (worker->playbin != NULL) {
+		gst_element_set_state(worker->playbin, GST_STATE_NULL);
+		gst_object_unref(worker->playbin);
+	}
+	return NULL;
+}
+
+/* Main loop side */
+
+ThumbnailService *thumbnail_service_new(const gchar *uri, gint64 duration, gint width, guint n_workers,
+		guint64 memory_bytes, gboolean disk_cache, ThumbnailReadyFunc func, gpointer user_data) {
+	ThumbnailService *service;
+	guint i;
+
+	/* a slot per nsec at least */
+	if (duration < THUMBNAIL_SLOTS || width <= 0)
+		return NULL;
+
+	service = g_new0(ThumbnailService, 1);
+	service->uri = g_strdup(uri);
+	service->duration = duration;
+	service->width = width;
+	service->memory_budget = memory_bytes;
+	service->func = func;
+	service->user_data = user_data;
+	g_mutex_init(&service->lock);
+	g_cond_init(&service->cond);
+	g_queue_init(&service->urgent);
+	g_queue_init(&service->lru);
+	g_queue_init(&service->ready);
+	service->stats.fill_time = GST_CLOCK_TIME_NONE;
+	service->start = gst_util_get_timestamp();
+
+	if (disk_cache) {
+		service->disk_dir = disk_dir_for(uri, duration, width);
+		if (g_mkdir_with_parents(service->disk_dir, 0700) != 0) {
+			g_printerr("Thumbnails: no disk cache, could not create %s\n", service->disk_dir);
+			g_free(service->disk_dir);
+			service->disk_dir = NULL;
+		}
+	}
+
+	/* each decoder may run threads of its own, half the cores leaves room for playback */
+	if (n_workers == 0)
+		n_workers = MAX(g_get_num_processors() / 2, 1);
+	service->n_workers = service->stats.n_workers = n_workers;
+	service->workers = g_new0(Worker, n_workers);
+	for (i = 0; i < n_workers; i++) {
+		gchar name[16];
+
+		g_snprintf(name, sizeof(name), "thumbnailer%u", i);
+		service->workers[i].service = service;
+		service->workers[i].thread = g_thread_new(name, (GThreadFunc)worker_func, &service->workers[i]);
+	}
+	return service;
+}
+
+void thumbnail_service_free(ThumbnailService *service) {
+	Thumbnail *thumb;
+	guint i;
+
+	if (service == NULL)
+		return;
+
+	g_mutex_lock(&service->lock);
+	service->stopping = TRUE;
+	g_cond_broadcast(&service->cond);
+	g_mutex_unlock(&service->lock);
+	/* at most one decode each to wait for */
+	for (i = 0; i < service->n_workers; i++)
+		g_thread_join(service->workers[i].thread);
+
+	if (service->ready_id != 0)
+		g_source_remove(service->ready_id);
+	while ((thumb = g_queue_pop_head(&service->ready)) != NULL)
+		thumbnail_unref(thumb);
+	for (i = 0; i < THUMBNAIL_SLOTS; i++)
+		thumbnail_unref(service->cached[i]);
+	g_queue_clear(&service->lru);
+	g_queue_clear(&service->urgent);
+
+	g_mutex_clear(&service->lock);
+	g_cond_clear(&service->cond);
+	g_free(service->workers);
+	g_free(service->disk_dir);
+	g_free(service->uri);
+	g_free(service);
+}
+
+Thumbnail *thumbnail_service_lookup(ThumbnailService *service, gint64 position) {
+	gint slot = thumbnail_service_slot(service, position);
+	Thumbnail *thumb = NULL;
+
+	g_mutex_lock(&service->lock);
+	service->stats.lookups++;
+	if (service->cached[slot] != NULL) {
+		GList *link = service->lru_link[slot];
+
+		service->stats.memory_hits++;
+		g_queue_unlink(&service->lru, link);
+		g_queue_push_head_link(&service->lru, link);
+		thumb = thumbnail_ref(service->cached[slot]);
+	} else if (service->state[slot] != SLOT_FAILED) {
+		service->wanted[slot] = TRUE;
+		if (service->state[slot] == SLOT_QUEUED)
+			g_queue_remove(&service->urgent, GINT_TO_POINTER(slot));
+		if (service->state[slot] != SLOT_BUSY) {
+			g_queue_push_head(&service->urgent, GINT_TO_POINTER(slot));
+			service->state[slot] = SLOT_QUEUED;
+			/* the pointer moved on, nobody waits for these anymore */
+			while (service->urgent.length > MAX_URGENT) {
+				gint old = GPOINTER_TO_INT(g_queue_pop_tail(&service->urgent));
+
+				service->state[old] = SLOT_EMPTY;
+				service->wanted[old] = FALSE;
+				service->stats.dropped++;
+			}
+			g_cond_signal(&service->cond);
+		}
+	}
+	g_mutex_unlock(&service->lock);
+	return thumb;
+}
+
+void thumbnail_service_get_stats(ThumbnailService *service, ThumbnailStats *stats) {
+	g_mutex_lock(&service->lock);
+	*stats = service->stats;
+	g_mutex_unlock(&service->lock);
+}
@@ -0,0 +1,75 @@
+#ifndef __THUMBNAIL_SERVICE_H__
+#define __THUMBNAIL_SERVICE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Seek bar previews decoded away from the playback pipeline.
+ *
+ * The clip is cut into THUMBNAIL_SLOTS equal slots with one thumbnail each:
+ * the keyframe at or before the slot start, scaled to a fixed width. Worker
+ * threads each own a video-only playbin ending in an appsink. They seek it
+ * KEY_UNIT|SNAP_BEFORE and take the preroll sample, so only keyframes are
+ * ever decoded and the main pipeline is never touched.
+ *
+ * Slots missed by thumbnail_service_lookup() (hovering) go ahead of the
+ * background fill, which walks the whole strip once. Thumbnails live in an
+ * LRU bounded in bytes and, optionally, in a disk cache keyed by uri, width
+ * and duration, so the next run starts from a full strip.
+ *
+ * lookup and the ready callback belong to the main loop, everything else
+ * happens in the workers.
+ */
+#define THUMBNAIL_SLOTS 200
+
+#define THUMBNAIL_FILE_MAGIC "GSTTHMB1"
+#define THUMBNAIL_FILE_VERSION 1
+
+typedef struct _ThumbnailService ThumbnailService;
+
+/* packed RGB, immutable once handed out */
+typedef struct _Thumbnail {
+	gint slot;
+	gint64 position;	/* stream time of the keyframe shown, nsec */
+	gint width;
+	gint height;
+	gint stride;
+	GBytes *pixels;
+	gint refcount;
+} Thumbnail;
+
+/* a slot that missed in lookup became available, thumb is borrowed */
+typedef void (*ThumbnailReadyFunc)(Thumbnail *thumb, gpointer user_data);
+
+typedef struct _ThumbnailStats {
+	guint64 lookups;
+	guint64 memory_hits;
+	guint64 disk_hits;	/* slots a worker found on disk */
+	guint64 decoded;
+	guint64 failed;
+	guint64 evicted;
+	guint64 dropped;	/* hover requests overtaken before a worker got to them */
+	guint64 memory_bytes;	/* in the LRU right now */
+	GstClockTime decode_time;	/* summed over all workers */
+	GstClockTime fill_time;	/* until every slot was tried once, NONE while filling */
+	guint n_workers;
+} ThumbnailStats;
+
+/* n_workers 0 picks half the cores */
+ThumbnailService *thumbnail_service_new(const gchar *uri, gint64 duration, gint width, guint n_workers,
+		guint64 memory_bytes, gboolean disk_cache, ThumbnailReadyFunc func, gpointer user_data);
+void thumbnail_service_free(ThumbnailService *service);
+
+gint thumbnail_service_slot(ThumbnailService *service, gint64 position);
+/* cached thumbnail, or NULL: the slot is queued and func called once it is there */
+Thumbnail *thumbnail_service_lookup(ThumbnailService *service, gint64 position);
+void thumbnail_service_get_stats(ThumbnailService *service, ThumbnailStats *stats);
+
+Thumbnail *thumbnail_ref(Thumbnail *thumb);
+void thumbnail_unref(Thumbnail *thumb);
+
+G_END_DECLS
+
+#endif /* __THUMBNAIL_SERVICE_H__ */
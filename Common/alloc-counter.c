@@ -0,0 +1,95 @@
+#include "alloc-counter.h"
+
+typedef struct _AllocCounter {
+	GstAllocator parent;
+	GstAllocator *sysmem;	/* does the real work */
+} AllocCounter;
+
+typedef struct _AllocCounterClass {
+	GstAllocatorClass parent_class;
+} AllocCounterClass;
+
+static GType alloc_counter_get_type(void);
+G_DEFINE_TYPE(AllocCounter, alloc_counter, GST_TYPE_ALLOCATOR);
+
+G_LOCK_DEFINE_STATIC(counts);
+static guint64 count;
+static guint64 bytes;
+static gboolean installed;
+
+/* @brief count, then let the system allocator do it, memory stays with sysmem */
+static GstMemory *alloc_counter_alloc(GstAllocator *allocator, gsize size, GstAllocationParams *params) {
+	AllocCounter *counter = (AllocCounter *)allocator;
+	GstMemory *memory = gst_allocator_alloc(counter->sysmem, size, params);
+
+	if (memory != NULL) {
+		G_LOCK(counts);
+		count++;
+		bytes += size;
+		G_UNLOCK(counts);
+	}
+	return memory;
+}
+
+/* never called: every memory we hand out belongs to sysmem */
+static void alloc_counter_free(GstAllocator *allocator, GstMemory *memory) {
+	g_warn_if_reached();
+}
+
+static void alloc_counter_finalize(GObject *object) {
+	gst_object_unref(((AllocCounter *)object)->sysmem);
+	G_OBJECT_CLASS(alloc_counter_parent_class)->finalize(object);
+}
+
+static void alloc_counter_class_init(AllocCounterClass *klass) {
+	GstAllocatorClass *allocator_class = GST_ALLOCATOR_CLASS(klass);
+
+	G_OBJECT_CLASS(klass)->finalize = alloc_counter_finalize;
+	allocator_class->alloc = alloc_counter_alloc;
+	allocator_class->free = alloc_counter_free;
+}
+
+static void alloc_counter_init(AllocCounter *counter) {
+	counter->sysmem = gst_allocator_find(GST_ALLOCATOR_SYSMEM);
+}
+
+gboolean alloc_counter_install(void) {
+	GstAllocator *counter;
+
+	if (installed)
+		return TRUE;
+
+	counter = g_object_new(alloc_counter_get_type(), NULL);
+	if (((AllocCounter *)counter)->sysmem == NULL) {
+		gst_object_unref(gst_object_ref_sink(counter));
+		return FALSE;
+	}
+	/* set_default takes our reference, which must not be floating */
+	gst_allocator_set_default(gst_object_ref_sink(counter));
+	installed = TRUE;
+	return TRUE;
+}
+
+void alloc_counter_reset(void) {
+	G_LOCK(counts);
+	count = bytes = 0;
+	G_UNLOCK(counts);
+}
+
+guint64 alloc_counter_get_count(void) {
+	guint64 value;
+
+	G_LOCK(counts);
+	value = count;
+	G_UNLOCK(counts);
+	return value;
+}
+
+guint64 alloc_counter_get_bytes(void) {
+	guint64 value;
+
+	G_LOCK(counts);
+	value = bytes;
+	G_UNLOCK(counts);
+	return value;
+}
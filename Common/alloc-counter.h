@@ -0,0 +1,32 @@
+#ifndef __ALLOC_COUNTER_H__
+#define __ALLOC_COUNTER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Counts buffer memory allocations for the benchmark programs.
+ *
+ * alloc_counter_install() makes a counting allocator the process default.
+ * It hands every request on to the system memory allocator, so the memory
+ * and its lifetime are unchanged; only the number of allocations and their
+ * bytes are recorded. Anything allocating through the default allocator is
+ * seen: gst_buffer_new_allocate(NULL, ...), buffer pools without an
+ * allocator of their own, most elements. Memory wrapped around foreign data
+ * (gst_buffer_new_wrapped_full) and buffers recycled by a pool are not
+ * allocations and don't count.
+ *
+ * Install after gst_init() and before building pipelines. The counters may
+ * be read from any thread.
+ */
+gboolean alloc_counter_install(void);
+void alloc_counter_reset(void);
+
+/* since install or the last reset */
+guint64 alloc_counter_get_count(void);
+guint64 alloc_counter_get_bytes(void);
+
+G_END_DECLS
+
+#endif /* __ALLOC_COUNTER_H__ */
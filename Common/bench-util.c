@@ -0,0 +1,136 @@
+#include <stdio.h>
+
+#include "bench-util.h"
+
+/* raw video formats the benchmarks take by name, keep BENCH_VIDEO_FORMATS in sync */
+static const gchar *video_formats[] = { "I420", "NV12", "YUY2", "BGRx", "RGBx" };
+
+gboolean bench_parse_options(gint *argc, gchar ***argv, const gchar *parameter_string, const GOptionEntry *entries) {
+	GOptionContext *ctx;
+	GError *err = NULL;
+	gboolean ok;
+
+	ctx = g_option_context_new(parameter_string);
+	g_option_context_add_main_entries(ctx, entries, NULL);
+	g_option_context_add_group(ctx, gst_init_get_option_group());
+	ok = g_option_context_parse(ctx, argc, argv, &err);
+	if (!ok) {
+		g_printerr("Failed to parse options: %s\n", err->message);
+		g_clear_error(&err);
+	}
+	g_option_context_free(ctx);
+	return ok;
+}
+
+gchar *bench_uri_from_arg(const gchar *arg) {
+	GError *err = NULL;
+	gchar *uri;
+
+	if (gst_uri_is_valid(arg))
+		return g_strdup(arg);
+
+	uri = gst_filename_to_uri(arg, &err);
+	if (uri == NULL) {
+		g_printerr("Bad file name '%s': %s\n", arg, err->message);
+		g_clear_error(&err);
+	}
+	return uri;
+}
+
+gboolean bench_parse_resolution(const gchar *spec, gint *width, gint *height) {
+	return sscanf(spec, "%dx%d", width, height) == 2 && *width > 0 && *height > 0;
+}
+
+GstElement *bench_sync_sink_new(const gchar *name, GCallback handoff, gpointer user_data) {
+	GstElement *sink = gst_element_factory_make("fakesink", name);
+
+	if (sink == NULL)
+		return NULL;
+
+	/* render against the clock, like a real sink would */
+	g_object_set(sink, "sync", TRUE, NULL);
+	if (handoff != NULL) {
+		g_object_set(sink, "signal-handoffs", TRUE, NULL);
+		g_signal_connect(sink, "handoff", handoff, user_data);
+	}
+	return sink;
+}
+
+GstElement *bench_capsfilter_new(GstCaps *caps) {
+	GstElement *filter = gst_element_factory_make("capsfilter", NULL);
+
+	if (filter != NULL)
+		g_object_set(filter, "caps", caps, NULL);
+	return filter;
+}
+
+GstCaps *bench_video_caps(const gchar *format, gint width, gint height) {
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(video_formats); i++) {
+		if (g_strcmp0(video_formats[i], format) == 0)
+			return gst_caps_new_simple("video/x-raw",
+					"format", G_TYPE_STRING, format,
+					"width", G_TYPE_INT, width,
+					"height", G_TYPE_INT, height,
+					"framerate", GST_TYPE_FRACTION, 30, 1,
+					NULL);
+	}
+	return NULL;
+}
+
+gboolean bench_wait_for(GstBus *bus, GstMessageType types, GstClockTime timeout) {
+	GstMessage *msg;
+	gboolean ok = FALSE;
+
+	msg = gst_bus_timed_pop_filtered(bus, timeout, types | GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+	if (msg == NULL) {
+		g_printerr("Timed out waiting for %s\n", gst_message_type_get_name(types));
+		return FALSE;
+	}
+
+	if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+		GError *err;
+		gchar *debug_info;
+
+		gst_message_parse_error(msg, &err, &debug_info);
+		g_printerr("Error received from element %s : %s\n", GST_OBJECT_NAME(msg->src), err->message);
+		g_printerr("Debugging info : %s\n", debug_info ? debug_info : "none");
+		g_clear_error(&err);
+		g_free(debug_info);
+	} else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS && !(types & GST_MESSAGE_EOS)) {
+		g_printerr("End of stream while waiting for %s\n", gst_message_type_get_name(types));
+	} else {
+		ok = TRUE;
+	}
+	gst_message_unref(msg);
+	return ok;
+}
+
+gboolean bench_run_till_eos(GstElement *pipeline, const gchar *label) {
+	GstBus *bus;
+	GstMessage *msg;
+	gboolean ok = TRUE;
+
+	if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+		g_printerr("%s: unable to start playback\n", label);
+		return FALSE;
+	}
+
+	bus = gst_element_get_bus(pipeline);
+	msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+	if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+		GError *err;
+		gchar *debug_info;
+
+		gst_message_parse_error(msg, &err, &debug_info);
+		g_printerr("%s: error from %s: %s\n", label, GST_OBJECT_NAME(msg->src), err->message);
+		g_printerr("Debugging info : %s\n", debug_info ? debug_info : "none");
+		g_clear_error(&err);
+		g_free(debug_info);
+		ok = FALSE;
+	}
+	gst_message_unref(msg);
+	gst_object_unref(bus);
+	return ok;
+}
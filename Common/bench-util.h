@@ -0,0 +1,39 @@
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Plumbing shared by the benchmark programs: option parsing, sinks and
+ * capsfilters, waiting on the bus. Errors are printed here, callers only
+ * count the failure.
+ */
+
+/* main entries plus GStreamer's own options, initializes GStreamer */
+gboolean bench_parse_options(gint *argc, gchar ***argv, const gchar *parameter_string, const GOptionEntry *entries);
+/* FILE argument as given, or turned into a file:// URI, free with g_free */
+gchar *bench_uri_from_arg(const gchar *arg);
+/* "WxH", both positive */
+gboolean bench_parse_resolution(const gchar *spec, gint *width, gint *height);
+
+/* fakesink rendering against the clock, handoff NULL for none */
+GstElement *bench_sync_sink_new(const gchar *name, GCallback handoff, gpointer user_data);
+/* capsfilter fixed to caps */
+GstElement *bench_capsfilter_new(GstCaps *caps);
+/* raw video caps for a format name at 30 fps, NULL for a format not listed in BENCH_VIDEO_FORMATS */
+GstCaps *bench_video_caps(const gchar *format, gint width, gint height);
+#define BENCH_VIDEO_FORMATS "I420, NV12, YUY2, BGRx, RGBx"
+
+/*
+ * wait for one of types on the bus, EOS counts as a failure unless asked for
+ * @return FALSE on error, EOS or timeout
+ */
+gboolean bench_wait_for(GstBus *bus, GstMessageType types, GstClockTime timeout);
+/* set pipeline PLAYING and wait for EOS, errors are prefixed with label; the caller sets NULL */
+gboolean bench_run_till_eos(GstElement *pipeline, const gchar *label);
+
+G_END_DECLS
+
+#endif /* __BENCH_UTIL_H__ */
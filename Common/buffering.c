@@ -0,0 +1,219 @@
+#include "buffering.h"
+
+/* playbin's GST_PLAY_FLAG_DOWNLOAD, progressive download through queue2 */
+#define PLAY_FLAG_DOWNLOAD (1 << 7)
+
+struct _Buffering {
+	GstElement *pipeline;
+	GstState target;	/* state the application asked for */
+	gboolean is_live;	/* live pipelines don't buffer */
+	gboolean played;	/* reached PLAYING once, later buffering is a rebuffer */
+
+	GHashTable *levels;	/* posting element -> percent, only those below 100 */
+	gboolean buffering;
+	gint percent;		/* least filled queue */
+
+	GstClockTime created;
+	GstClockTime startup_time;
+	GstClockTime buffering_start;	/* of the running rebuffer */
+	guint rebuffers;
+	GstClockTime rebuffer_time;	/* finished rebuffers */
+};
+
+static gboolean has_property(GstElement *element, const gchar *name) {
+	return g_object_class_find_property(G_OBJECT_GET_CLASS(element), name) != NULL;
+}
+
+gboolean buffering_configure(GstElement *element, guint64 ring_buffer_max_size) {
+	/* playbin buffers by itself, uridecodebin only when told */
+	if (has_property(element, "use-buffering"))
+		g_object_set(element, "use-buffering", TRUE, NULL);
+
+	if (ring_buffer_max_size == 0)
+		return TRUE;
+
+	if (has_property(element, "download")) {
+		g_object_set(element, "download", TRUE, NULL);
+	} else if (has_property(element, "flags") && has_property(element, "ring-buffer-max-size")) {
+		gint flags;
+
+		g_object_get(element, "flags", &flags, NULL);
+		g_object_set(element, "flags", flags | PLAY_FLAG_DOWNLOAD, NULL);
+	} else {
+		g_printerr("%s can't download to disk.\n", GST_ELEMENT_NAME(element));
+		return FALSE;
+	}
+
+	/* without a limit queue2 keeps the whole file */
+	if (!has_property(element, "ring-buffer-max-size")) {
+		g_printerr("%s has no ring buffer, downloading the whole stream.\n", GST_ELEMENT_NAME(element));
+		return FALSE;
+	}
+	g_object_set(element, "ring-buffer-max-size", ring_buffer_max_size, NULL);
+	return TRUE;
+}
+
+Buffering *buffering_new(GstElement *pipeline) {
+	Buffering *buffering = g_new0(Buffering, 1);
+
+	buffering->pipeline = gst_object_ref(pipeline);
+	buffering->target = GST_STATE_VOID_PENDING;
+	buffering->levels = g_hash_table_new_full(g_direct_hash, g_direct_equal, gst_object_unref, NULL);
+	buffering->percent = 100;
+	buffering->created = gst_util_get_timestamp();
+	buffering->startup_time = GST_CLOCK_TIME_NONE;
+	return buffering;
+}
+
+void buffering_free(Buffering *buffering) {
+	if (buffering == NULL)
+		return;
+
+	g_hash_table_destroy(buffering->levels);
+	gst_object_unref(buffering->pipeline);
+	g_free(buffering);
+}
+
+/* @brief forget about buffering, e.g. when going back to READY */
+static void reset(Buffering *buffering) {
+	if (buffering->buffering && buffering->played)
+		buffering->rebuffer_time += gst_util_get_timestamp() - buffering->buffering_start;
+	g_hash_table_remove_all(buffering->levels);
+	buffering->buffering = FALSE;
+	buffering->percent = 100;
+}
+
+GstStateChangeReturn buffering_set_state(Buffering *buffering, GstState state) {
+	GstStateChangeReturn ret;
+
+	buffering->target = state;
+	if (state <= GST_STATE_READY) {
+		reset(buffering);
+		buffering->is_live = FALSE;
+	}
+
+	/* keep filling, buffering_handle_message() starts playback */
+	if (buffering->buffering && state == GST_STATE_PLAYING)
+		state = GST_STATE_PAUSED;
+
+	ret = gst_element_set_state(buffering->pipeline, state);
+	if (ret == GST_STATE_CHANGE_NO_PREROLL) {
+		buffering->is_live = TRUE;
+		reset(buffering);
+	}
+	return ret;
+}
+
+static void min_level(gpointer key, gpointer value, gint *percent) {
+	*percent = MIN(*percent, GPOINTER_TO_INT(value));
+}
+
+/*
+ * @brief in DOWNLOAD and TIMESHIFT modes percent is the progress of the whole
+ *        download, waiting for 100% would mean waiting for the entire file.
+ *        Playing on is fine as long as the download is expected to finish
+ *        before playback catches up with it.
+ * */
+static gboolean download_ahead(Buffering *buffering, GstMessage *msg) {
+	GstBufferingMode mode;
+	gint64 left, position, duration;
+
+	gst_message_parse_buffering_stats(msg, &mode, NULL, NULL, &left);
+	if (mode != GST_BUFFERING_DOWNLOAD && mode != GST_BUFFERING_TIMESHIFT)
+		return FALSE;
+
+	/* no estimate yet, or nothing to compare it to */
+	if (left < 0 ||
+			!gst_element_query_position(buffering->pipeline, GST_FORMAT_TIME, &position) ||
+			!gst_element_query_duration(buffering->pipeline, GST_FORMAT_TIME, &duration) ||
+			duration <= position)
+		return FALSE;
+
+	/* left is in msec */
+	return left * GST_MSECOND < duration - position;
+}
+
+static void update_level(Buffering *buffering, GstMessage *msg) {
+	gint percent;
+
+	gst_message_parse_buffering(msg, &percent);
+	if (percent < 100 && !download_ahead(buffering, msg))
+		g_hash_table_insert(buffering->levels, gst_object_ref(GST_MESSAGE_SRC(msg)), GINT_TO_POINTER(percent));
+	else
+		g_hash_table_remove(buffering->levels, GST_MESSAGE_SRC(msg));
+
+	percent = 100;
+	g_hash_table_foreach(buffering->levels, (GHFunc)min_level, &percent);
+	buffering->percent = percent;
+}
+
+gboolean buffering_handle_message(Buffering *buffering, GstMessage *msg) {
+	switch (GST_MESSAGE_TYPE(msg)) {
+		case GST_MESSAGE_BUFFERING:
+			if (buffering->is_live)
+				return TRUE;
+
+			update_level(buffering, msg);
+			if (buffering->percent < 100 && !buffering->buffering) {
+				buffering->buffering = TRUE;
+				buffering->buffering_start = gst_util_get_timestamp();
+				if (buffering->played)
+					buffering->rebuffers++;
+				if (buffering->target == GST_STATE_PLAYING)
+					gst_element_set_state(buffering->pipeline, GST_STATE_PAUSED);
+			} else if (buffering->percent == 100 && buffering->buffering) {
+				buffering->buffering = FALSE;
+				if (buffering->played)
+					buffering->rebuffer_time += gst_util_get_timestamp() - buffering->buffering_start;
+				if (buffering->target == GST_STATE_PLAYING)
+					gst_element_set_state(buffering->pipeline, GST_STATE_PLAYING);
+			}
+			return TRUE;
+		case GST_MESSAGE_CLOCK_LOST:
+			/* pausing for buffering may lose the audio clock, pick a new one */
+			if (buffering->target == GST_STATE_PLAYING && !buffering->buffering) {
+				gst_element_set_state(buffering->pipeline, GST_STATE_PAUSED);
+				gst_element_set_state(buffering->pipeline, GST_STATE_PLAYING);
+			}
+			return TRUE;
+		case GST_MESSAGE_STATE_CHANGED: {
+			GstState new_state;
+
+			if (GST_MESSAGE_SRC(msg) != GST_OBJECT(buffering->pipeline))
+				return FALSE;
+			gst_message_parse_state_changed(msg, NULL, &new_state, NULL);
+			if (new_state == GST_STATE_PLAYING && !buffering->played) {
+				buffering->played = TRUE;
+				buffering->startup_time = gst_util_get_timestamp() - buffering->created;
+			}
+			/* not consumed, the application wants to see state changes too */
+			return FALSE;
+		}
+		default:
+			return FALSE;
+	}
+}
+
+gboolean buffering_is_buffering(Buffering *buffering) {
+	return buffering->buffering;
+}
+
+gint buffering_get_percent(Buffering *buffering) {
+	return buffering->percent;
+}
+
+guint buffering_rebuffer_count(Buffering *buffering) {
+	return buffering->rebuffers;
+}
+
+GstClockTime buffering_rebuffer_time(Buffering *buffering) {
+	GstClockTime time = buffering->rebuffer_time;
+
+	if (buffering->buffering && buffering->played)
+		time += gst_util_get_timestamp() - buffering->buffering_start;
+	return time;
+}
+
+GstClockTime buffering_startup_time(Buffering *buffering) {
+	return buffering->startup_time;
+}
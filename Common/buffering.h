@@ -0,0 +1,54 @@
+#ifndef __BUFFERING_H__
+#define __BUFFERING_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Buffering policy for network playback.
+ *
+ * Keeps the pipeline PAUSED while BUFFERING messages report less than 100%
+ * and returns it to the state the application asked for once the queues
+ * filled up again. Applications request states through
+ * buffering_set_state() instead of gst_element_set_state(), so a pause
+ * pressed while buffering sticks, and feed every BUFFERING and CLOCK_LOST
+ * message to buffering_handle_message(). Live pipelines are left alone.
+ *
+ * buffering_configure() turns on buffering in playbin or uridecodebin and
+ * optionally spools the stream through queue2 into a temporary ring buffer
+ * file of bounded size: ranges already downloaded are read back from disk
+ * when seeking, only gaps go to the network.
+ *
+ * Buffering that starts after playback first reached PLAYING counts as a
+ * rebuffer, the initial fill is part of the startup time instead. With
+ * several queues buffering at once the least filled one decides.
+ *
+ * In DOWNLOAD and TIMESHIFT modes the percentage covers the whole download;
+ * there playback goes on once the estimated download time left is shorter
+ * than the remaining playback time, instead of waiting for 100%.
+ */
+typedef struct _Buffering Buffering;
+
+/* element is playbin or uridecodebin, ring_buffer_max_size in bytes, 0 disables spooling */
+gboolean buffering_configure(GstElement *element, guint64 ring_buffer_max_size);
+
+Buffering *buffering_new(GstElement *pipeline);
+void buffering_free(Buffering *buffering);
+
+GstStateChangeReturn buffering_set_state(Buffering *buffering, GstState state);
+/* @return TRUE if msg was a buffering related message and got handled */
+gboolean buffering_handle_message(Buffering *buffering, GstMessage *msg);
+
+gboolean buffering_is_buffering(Buffering *buffering);
+gint buffering_get_percent(Buffering *buffering);
+
+guint buffering_rebuffer_count(Buffering *buffering);
+/* total time stalled in rebuffers, including a running one */
+GstClockTime buffering_rebuffer_time(Buffering *buffering);
+/* from buffering_new() till playback first started, GST_CLOCK_TIME_NONE before */
+GstClockTime buffering_startup_time(Buffering *buffering);
+
+G_END_DECLS
+
+#endif /* __BUFFERING_H__ */
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "event-log.h"
+
+/* ring size in records, power of two */
+#define RING_SIZE 4096
+/* how often the flusher drains the ring, usec */
+#define FLUSH_INTERVAL 50000
+
+/*
+ * Bounded MPSC ring (Vyukov style): every slot carries a sequence number
+ * telling whether it is free for position pos (seq == pos) or holds the
+ * record written at pos (seq == pos + 1). Positions wrap, only differences
+ * are compared.
+ */
+typedef struct _EventLogSlot {
+	gint seq;
+	EventLogRecord record;
+} EventLogSlot;
+
+static struct {
+	gint enabled;
+	gint stopping;
+	FILE *file;
+	GThread *flusher;
+	gint head;		/* next position producers claim */
+	gint tail;		/* next position the flusher reads, flusher only */
+	gint dropped;
+	EventLogSlot slots[RING_SIZE];
+} event_log;
+
+static gboolean ring_pop(EventLogRecord *record) {
+	EventLogSlot *slot = &event_log.slots[(guint)event_log.tail & (RING_SIZE - 1)];
+	gint seq = g_atomic_int_get(&slot->seq);
+
+	if ((gint)((guint)seq - ((guint)event_log.tail + 1)) != 0)
+		return FALSE; /* empty, or producer still writing */
+
+	*record = slot->record;
+	/* free the slot for the producer one lap ahead */
+	g_atomic_int_set(&slot->seq, (gint)((guint)event_log.tail + RING_SIZE));
+	event_log.tail++;
+	return TRUE;
+}
+
+static void drain(void) {
+	EventLogRecord batch[256];
+	guint n = 0;
+
+	while (ring_pop(&batch[n])) {
+		if (++n == G_N_ELEMENTS(batch)) {
+			fwrite(batch, sizeof(EventLogRecord), n, event_log.file);
+			n = 0;
+		}
+	}
+	if (n > 0)
+		fwrite(batch, sizeof(EventLogRecord), n, event_log.file);
+}
+
+static gpointer flusher_func(gpointer user_data) {
+	while (!g_atomic_int_get(&event_log.stopping)) {
+		drain();
+		fflush(event_log.file);
+		g_usleep(FLUSH_INTERVAL);
+	}
+	drain();
+	return NULL;
+}
+
+gboolean event_log_open(const gchar *path) {
+	EventLogHeader header;
+	GError *err = NULL;
+	guint i;
+
+	if (event_log.enabled)
+		return TRUE;
+
+	event_log.file = fopen(path, "wb");
+	if (event_log.file == NULL) {
+		g_printerr("Could not open event log '%s'.\n", path);
+		return FALSE;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic));
+	header.version = EVENT_LOG_VERSION;
+	header.record_size = sizeof(EventLogRecord);
+	header.wall_start = g_get_real_time();
+	header.mono_start = gst_util_get_timestamp();
+	fwrite(&header, sizeof(header), 1, event_log.file);
+
+	for (i = 0; i < RING_SIZE; i++)
+		event_log.slots[i].seq = i;
+	event_log.head = event_log.tail = event_log.dropped = 0;
+	event_log.stopping = FALSE;
+
+	event_log.flusher = g_thread_try_new("event-log", flusher_func, NULL, &err);
+	if (event_log.flusher == NULL) {
+		g_printerr("Could not start event log flusher: %s\n", err->message);
+		g_clear_error(&err);
+		fclose(event_log.file);
+		event_log.file = NULL;
+		return FALSE;
+	}
+	g_atomic_int_set(&event_log.enabled, TRUE);
+	return TRUE;
+}
+
+gboolean event_log_open_from_env(void) {
+	const gchar *path = g_getenv(EVENT_LOG_ENV);
+
+	if (path == NULL)
+		return FALSE;
+	return event_log_open(path);
+}
+
+void event_log_close(void) {
+	if (!event_log.enabled)
+		return;
+
+	g_atomic_int_set(&event_log.enabled, FALSE);
+	g_atomic_int_set(&event_log.stopping, TRUE);
+	g_thread_join(event_log.flusher);
+	event_log.flusher = NULL;
+	if (event_log.dropped > 0)
+		g_printerr("Event log dropped %d records.\n", event_log.dropped);
+	fclose(event_log.file);
+	event_log.file = NULL;
+}
+
+gboolean event_log_enabled(void) {
+	return g_atomic_int_get(&event_log.enabled);
+}
+
+void event_log_record(guint32 type, const gchar *source, guint16 arg0, guint16 arg1) {
+	EventLogSlot *slot;
+	gint pos;
+
+	if (!g_atomic_int_get(&event_log.enabled))
+		return;
+
+	/* claim a position */
+	pos = g_atomic_int_get(&event_log.head);
+	for (;;) {
+		gint diff;
+
+		slot = &event_log.slots[(guint)pos & (RING_SIZE - 1)];
+		diff = (gint)((guint)g_atomic_int_get(&slot->seq) - (guint)pos);
+		if (diff == 0) {
+			if (g_atomic_int_compare_and_exchange(&event_log.head, pos, (gint)((guint)pos + 1)))
+				break;
+		} else if (diff < 0) {
+			/* flusher is a full lap behind */
+			g_atomic_int_inc(&event_log.dropped);
+			return;
+		}
+		pos = g_atomic_int_get(&event_log.head);
+	}
+
+	slot->record.timestamp = gst_util_get_timestamp();
+	slot->record.type = type;
+	slot->record.arg0 = arg0;
+	slot->record.arg1 = arg1;
+	strncpy(slot->record.source, source ? source : "", EVENT_LOG_SOURCE_LEN);
+	/* publish */
+	g_atomic_int_set(&slot->seq, (gint)((guint)pos + 1));
+}
+
+void event_log_message(GstMessage *msg) {
+	guint16 arg0 = 0, arg1 = 0;
+
+	if (!g_atomic_int_get(&event_log.enabled))
+		return;
+
+	switch (GST_MESSAGE_TYPE(msg)) {
+		case GST_MESSAGE_STATE_CHANGED: {
+			GstState old_state, new_state;
+
+			gst_message_parse_state_changed(msg, &old_state, &new_state, NULL);
+			arg0 = old_state;
+			arg1 = new_state;
+			break;
+		}
+		case GST_MESSAGE_BUFFERING: {
+			gint percent;
+
+			gst_message_parse_buffering(msg, &percent);
+			arg0 = percent;
+			break;
+		}
+		default:
+			break;
+	}
+	event_log_record(GST_MESSAGE_TYPE(msg), GST_MESSAGE_SRC(msg) ? GST_MESSAGE_SRC_NAME(msg) : NULL, arg0, arg1);
+}
+
+guint64 event_log_dropped(void) {
+	return (guint)g_atomic_int_get(&event_log.dropped);
+}
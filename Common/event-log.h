@@ -0,0 +1,56 @@
+#ifndef __EVENT_LOG_H__
+#define __EVENT_LOG_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Binary bus message log.
+ *
+ * Records are pushed into a bounded lock-free ring from any thread and
+ * written out by a background flusher thread, so logging a message costs a
+ * few atomics and a 32 byte copy instead of formatting text under the stdout
+ * lock. When the ring is full records are dropped and counted, producers
+ * never block. Tools/event-log-decode turns a log file back into text.
+ *
+ * One log per process. All calls are no-ops while no log is open.
+ */
+
+#define EVENT_LOG_ENV "TUTORIAL_EVENT_LOG"
+#define EVENT_LOG_MAGIC "GSTEVLG1"
+#define EVENT_LOG_VERSION 1
+#define EVENT_LOG_SOURCE_LEN 16
+
+/* file header, followed by EventLogRecords till end of file */
+typedef struct _EventLogHeader {
+	gchar magic[8];		/* EVENT_LOG_MAGIC, not NUL terminated */
+	guint32 version;
+	guint32 record_size;	/* sizeof(EventLogRecord) */
+	gint64 wall_start;	/* g_get_real_time() at open, usec */
+	guint64 mono_start;	/* gst_util_get_timestamp() at open, nsec */
+} EventLogHeader;
+
+typedef struct _EventLogRecord {
+	guint64 timestamp;	/* gst_util_get_timestamp(), nsec */
+	guint32 type;		/* GstMessageType */
+	guint16 arg0;		/* STATE_CHANGED: old state, BUFFERING: percent */
+	guint16 arg1;		/* STATE_CHANGED: new state */
+	gchar source[EVENT_LOG_SOURCE_LEN];	/* source object name, truncated, NUL padded */
+} EventLogRecord;
+
+gboolean event_log_open(const gchar *path);
+/* open the file named by EVENT_LOG_ENV, if set */
+gboolean event_log_open_from_env(void);
+void event_log_close(void);
+gboolean event_log_enabled(void);
+
+void event_log_message(GstMessage *msg);
+void event_log_record(guint32 type, const gchar *source, guint16 arg0, guint16 arg1);
+
+/* records lost to a full ring since open */
+guint64 event_log_dropped(void);
+
+G_END_DECLS
+
+#endif /* __EVENT_LOG_H__ */
@@ -0,0 +1,438 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "keyframe-index.h"
+
+/* bytes read ahead from a keyframe before seeking to it */
+#define PREFETCH_BYTES (1024 * 1024)
+
+typedef struct _KeyframeEntry {
+	gint64 time;		/* stream time, nsec */
+	guint64 offset;		/* source read position when the keyframe came out */
+} KeyframeEntry;
+
+/* sidecar file header, followed by count entries as varint deltas */
+typedef struct _KeyframeIndexHeader {
+	gchar magic[8];		/* KEYFRAME_INDEX_MAGIC, not NUL terminated */
+	guint32 version;
+	guint32 count;
+	guint64 size;		/* of the indexed file */
+	gint64 mtime;		/* of the indexed file, sec */
+} KeyframeIndexHeader;
+
+struct _KeyframeIndex {
+	gchar *path;
+	gchar *cache_path;
+	guint64 size;
+	gint64 mtime;
+	GArray *entries;	/* KeyframeEntry, ascending time */
+	gint fd;		/* for prefetching, opened on first seek */
+};
+
+/* one build pass, probes run in the streaming threads */
+typedef struct _IndexBuild {
+	GstElement *pipeline;
+	GMutex lock;
+	guint64 read_offset;	/* start of the last block the source handed out */
+	gboolean have_video;	/* first video stream got its probe */
+	GstSegment segment;	/* of the indexed stream */
+	GArray *entries;
+} IndexBuild;
+
+static gchar *cache_path_for(const gchar *path) {
+	gchar *absolute = g_canonicalize_filename(path, NULL);
+	gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, absolute, -1);
+	gchar *name = g_strconcat(hash, ".kfi", NULL);
+	gchar *cache_path = g_build_filename(g_get_user_cache_dir(), "gst-tutorials", "keyframes", name, NULL);
+
+	g_free(name);
+	g_free(hash);
+	g_free(absolute);
+	return cache_path;
+}
+
+static KeyframeIndex *index_new(const gchar *path, const GStatBuf *st) {
+	KeyframeIndex *index = g_new0(KeyframeIndex, 1);
+
+	index->path = g_strdup(path);
+	index->cache_path = cache_path_for(path);
+	index->size = st->st_size;
+	index->mtime = st->st_mtime;
+	index->entries = g_array_new(FALSE, FALSE, sizeof(KeyframeEntry));
+	index->fd = -1;
+	return index;
+}
+
+void keyframe_index_free(KeyframeIndex *index) {
+	if (index == NULL)
+		return;
+
+	if (index->fd >= 0)
+		close(index->fd);
+	g_array_free(index->entries, TRUE);
+	g_free(index->cache_path);
+	g_free(index->path);
+	g_free(index);
+}
+
+guint keyframe_index_count(KeyframeIndex *index) {
+	return index->entries->len;
+}
+
+/* Building */
+
+static GstPadProbeReturn read_cb(GstPad *pad, GstPadProbeInfo *info, IndexBuild *build) {
+	GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+	if (GST_BUFFER_OFFSET_IS_VALID(buffer)) {
+		g_mutex_lock(&build->lock);
+		build->read_offset = GST_BUFFER_OFFSET(buffer);
+		g_mutex_unlock(&build->lock);
+	}
+	return GST_PAD_PROBE_OK;
+}
+
+/* @brief record keyframes of the indexed stream, in stream time */
+static GstPadProbeReturn keyframe_cb(GstPad *pad, GstPadProbeInfo *info, IndexBuild *build) {
+	GstBuffer *buffer;
+	KeyframeEntry entry;
+	GstClockTime ts;
+
+	if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+		GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+
+		if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT) {
+			const GstSegment *segment;
+
+			gst_event_parse_segment(event, &segment);
+			if (segment->format == GST_FORMAT_TIME)
+				gst_segment_copy_into(segment, &build->segment);
+		}
+		return GST_PAD_PROBE_OK;
+	}
+
+	buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT))
+		return GST_PAD_PROBE_OK;
+	ts = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) : GST_BUFFER_DTS(buffer);
+	if (!GST_CLOCK_TIME_IS_VALID(ts))
+		return GST_PAD_PROBE_OK;
+	ts = gst_segment_to_stream_time(&build->segment, GST_FORMAT_TIME, ts);
+	if (!GST_CLOCK_TIME_IS_VALID(ts))
+		return GST_PAD_PROBE_OK;
+
+	/* keep it sorted, repeated timestamps add nothing */
+	if (build->entries->len > 0 && (gint64)ts <= g_array_index(build->entries, KeyframeEntry, build->entries->len - 1).time)
+		return GST_PAD_PROBE_OK;
+
+	entry.time = ts;
+	g_mutex_lock(&build->lock);
+	entry.offset = build->read_offset;
+	g_mutex_unlock(&build->lock);
+	g_array_append_val(build->entries, entry);
+	return GST_PAD_PROBE_OK;
+}
+
+/* @brief every parsed stream goes to a fakesink, the first video one gets indexed */
+static void pad_added_cb(GstElement *parse, GstPad *pad, IndexBuild *build) {
+	GstElement *sink = gst_element_factory_make("fakesink", NULL);
+	GstCaps *caps = gst_pad_query_caps(pad, NULL);
+	GstPad *sink_pad;
+	gboolean video;
+
+	video = !gst_caps_is_empty(caps) && g_str_has_prefix(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "video/");
+	gst_caps_unref(caps);
+	if (sink == NULL)
+		return;
+
+	g_object_set(sink, "sync", FALSE, NULL);
+	gst_bin_add(GST_BIN(build->pipeline), sink);
+	gst_element_sync_state_with_parent(sink);
+	sink_pad = gst_element_get_static_pad(sink, "sink");
+	if (video && !build->have_video) {
+		build->have_video = TRUE;
+		gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+				(GstPadProbeCallback)keyframe_cb, build, NULL);
+	}
+	if (GST_PAD_LINK_FAILED(gst_pad_link(pad, sink_pad)))
+		g_printerr("Keyframe index: couldn't link %s\n", GST_PAD_NAME(pad));
+	gst_object_unref(sink_pad);
+}
+
+KeyframeIndex *keyframe_index_build(const gchar *path) {
+	IndexBuild build;
+	GstElement *source, *parse;
+	KeyframeIndex *index = NULL;
+	GStatBuf st;
+	GstBus *bus;
+	GstMessage *msg;
+	GstPad *pad;
+
+	if (g_stat(path, &st) != 0) {
+		g_printerr("Keyframe index: could not stat '%s'.\n", path);
+		return NULL;
+	}
+
+	memset(&build, 0, sizeof(build));
+	g_mutex_init(&build.lock);
+	gst_segment_init(&build.segment, GST_FORMAT_TIME);
+	build.entries = g_array_new(FALSE, FALSE, sizeof(KeyframeEntry));
+
+	/* parse only: demuxers and parsers flag keyframes, nothing gets decoded */
+	build.pipeline = gst_pipeline_new("keyframe-index");
+	source = gst_element_factory_make("filesrc", NULL);
+	parse = gst_element_factory_make("parsebin", NULL);
+	if (!build.pipeline || !source || !parse) {
+		g_printerr("Keyframe index: not all elements could be created.\n");
+		goto done;
+	}
+	g_object_set(source, "location", path, NULL);
+	gst_bin_add_many(GST_BIN(build.pipeline), source, parse, NULL);
+	gst_element_link(source, parse);
+	g_signal_connect(parse, "pad-added", G_CALLBACK(pad_added_cb), &build);
+
+	/* push or pull, the source pad sees every block */
+	pad = gst_element_get_static_pad(source, "src");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback)read_cb, &build, NULL);
+	gst_object_unref(pad);
+
+	bus = gst_element_get_bus(build.pipeline);
+	gst_element_set_state(build.pipeline, GST_STATE_PLAYING);
+	msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+	/* streaming threads are gone after this, entries are ours */
+	gst_element_set_state(build.pipeline, GST_STATE_NULL);
+	if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+		GError *err;
+		gchar *debug_info;
+
+		gst_message_parse_error(msg, &err, &debug_info);
+		g_printerr("Keyframe index: error from %s: %s\n", GST_OBJECT_NAME(msg->src), err->message);
+		g_clear_error(&err);
+		g_free(debug_info);
+	} else if (!build.have_video || build.entries->len == 0) {
+		g_printerr("Keyframe index: no video keyframes in '%s'.\n", path);
+	} else {
+		index = index_new(path, &st);
+		g_array_free(index->entries, TRUE);
+		index->entries = build.entries;
+		build.entries = NULL;
+	}
+	gst_message_unref(msg);
+	gst_object_unref(bus);
+
+done:
+	if (build.pipeline != NULL)
+		gst_object_unref(build.pipeline);
+	if (build.entries != NULL)
+		g_array_free(build.entries, TRUE);
+	g_mutex_clear(&build.lock);
+	return index;
+}
+
+/* Sidecar file */
+
+static void put_varint(GByteArray *out, guint64 value) {
+	guint8 byte;
+
+	do {
+		byte = value & 0x7f;
+		value >>= 7;
+		if (value != 0)
+			byte |= 0x80;
+		g_byte_array_append(out, &byte, 1);
+	} while (value != 0);
+}
+
+static gboolean get_varint(const guint8 **data, const guint8 *end, guint64 *value) {
+	guint shift = 0;
+
+	*value = 0;
+	while (*data < end && shift < 64) {
+		guint8 byte = *(*data)++;
+
+		*value |= (guint64)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return TRUE;
+		shift += 7;
+	}
+	return FALSE;
+}
+
+/* offsets can go backwards between keyframes, zigzag keeps small steps small */
+static guint64 zigzag(gint64 value) {
+	return ((guint64)value << 1) ^ (guint64)(value >> 63);
+}
+
+static gint64 unzigzag(guint64 value) {
+	return (gint64)(value >> 1) ^ -(gint64)(value & 1);
+}
+
+gboolean keyframe_index_save(KeyframeIndex *index) {
+	KeyframeIndexHeader header;
+	GByteArray *out = g_byte_array_new();
+	gint64 prev_time = 0, prev_offset = 0;
+	GError *err = NULL;
+	gchar *dir;
+	gboolean ok;
+	guint i;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, KEYFRAME_INDEX_MAGIC, sizeof(header.magic));
+	header.version = KEYFRAME_INDEX_VERSION;
+	header.count = index->entries->len;
+	header.size = index->size;
+	header.mtime = index->mtime;
+	g_byte_array_append(out, (const guint8 *)&header, sizeof(header));
+
+	/* times ascend, so their deltas are unsigned */
+	for (i = 0; i < index->entries->len; i++) {
+		KeyframeEntry *entry = &g_array_index(index->entries, KeyframeEntry, i);
+
+		put_varint(out, entry->time - prev_time);
+		put_varint(out, zigzag((gint64)entry->offset - prev_offset));
+		prev_time = entry->time;
+		prev_offset = entry->offset;
+	}
+
+	dir = g_path_get_dirname(index->cache_path);
+	g_mkdir_with_parents(dir, 0700);
+	g_free(dir);
+	/* written to a temporary file and renamed, readers never see half an index */
+	ok = g_file_set_contents(index->cache_path, (const gchar *)out->data, out->len, &err);
+	if (!ok) {
+		g_printerr("Keyframe index: could not write %s: %s\n", index->cache_path, err->message);
+		g_clear_error(&err);
+	}
+	g_byte_array_free(out, TRUE);
+	return ok;
+}
+
+KeyframeIndex *keyframe_index_load(const gchar *path) {
+	KeyframeIndexHeader header;
+	KeyframeIndex *index;
+	const guint8 *data, *end;
+	gint64 time = 0, offset = 0;
+	gchar *contents, *cache_path;
+	gsize length;
+	GStatBuf st;
+	guint i;
+
+	if (g_stat(path, &st) != 0)
+		return NULL;
+	cache_path = cache_path_for(path);
+	if (!g_file_get_contents(cache_path, &contents, &length, NULL)) {
+		g_free(cache_path);
+		return NULL;
+	}
+	g_free(cache_path);
+
+	if (length < sizeof(header))
+		goto stale;
+	memcpy(&header, contents, sizeof(header));
+	if (memcmp(header.magic, KEYFRAME_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+			header.version != KEYFRAME_INDEX_VERSION ||
+			header.size != (guint64)st.st_size || header.mtime != (gint64)st.st_mtime)
+		goto stale;
+
+	index = index_new(path, &st);
+	data = (const guint8 *)contents + sizeof(header);
+	end = (const guint8 *)contents + length;
+	for (i = 0; i < header.count; i++) {
+		KeyframeEntry entry;
+		guint64 time_delta, offset_delta;
+
+		if (!get_varint(&data, end, &time_delta) || !get_varint(&data, end, &offset_delta)) {
+			keyframe_index_free(index);
+			goto stale;
+		}
+		time += time_delta;
+		offset += unzigzag(offset_delta);
+		entry.time = time;
+		entry.offset = offset;
+		g_array_append_val(index->entries, entry);
+	}
+	g_free(contents);
+	return index;
+
+stale:
+	g_free(contents);
+	return NULL;
+}
+
+KeyframeIndex *keyframe_index_get(const gchar *path, gboolean *cached) {
+	KeyframeIndex *index = keyframe_index_load(path);
+
+	if (cached != NULL)
+		*cached = index != NULL;
+	if (index != NULL)
+		return index;
+
+	index = keyframe_index_build(path);
+	if (index != NULL)
+		keyframe_index_save(index);
+	return index;
+}
+
+/* Seeking */
+
+gboolean keyframe_index_lookup(KeyframeIndex *index, SeekMode mode, gint64 target, gint64 *time, guint64 *offset) {
+	const KeyframeEntry *entries = (const KeyframeEntry *)index->entries->data;
+	const KeyframeEntry *before, *after, *pick;
+	guint lo = 0, hi = index->entries->len;
+
+	if (hi == 0)
+		return FALSE;
+
+	/* lo: first keyframe after target */
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (entries[mid].time <= target)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	before = lo > 0 ? &entries[lo - 1] : &entries[0];
+	after = lo < index->entries->len ? &entries[lo] : &entries[index->entries->len - 1];
+	if (before->time == target)
+		after = before;
+
+	switch (mode) {
+		case SEEK_MODE_SNAP_AFTER:
+			pick = after;
+			break;
+		case SEEK_MODE_KEY_UNIT:
+			pick = target - before->time <= after->time - target ? before : after;
+			break;
+		default:
+			/* accurate decodes from the keyframe before */
+			pick = before;
+			break;
+	}
+	if (time != NULL)
+		*time = pick->time;
+	if (offset != NULL)
+		*offset = pick->offset;
+	return TRUE;
+}
+
+gboolean keyframe_index_seek(KeyframeIndex *index, GstElement *element, SeekMode mode, gint64 target) {
+	gint64 time;
+	guint64 offset;
+
+	if (index == NULL || !keyframe_index_lookup(index, mode, target, &time, &offset))
+		return seek_mode_seek(element, mode, target);
+
+	/* the demuxer reads from here first, have it in memory by then */
+	if (index->fd < 0)
+		index->fd = g_open(index->path, O_RDONLY, 0);
+	if (index->fd >= 0)
+		posix_fadvise(index->fd, offset, PREFETCH_BYTES, POSIX_FADV_WILLNEED);
+
+	if (mode == SEEK_MODE_ACCURATE)
+		return seek_mode_seek(element, mode, target);
+	/* a keyframe already: nothing left to snap to or decode up to, land exactly there */
+	return gst_element_seek_simple(element, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, time);
+}
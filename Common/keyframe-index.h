@@ -0,0 +1,52 @@
+#ifndef __KEYFRAME_INDEX_H__
+#define __KEYFRAME_INDEX_H__
+
+#include <gst/gst.h>
+
+#include "seek-modes.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Persistent keyframe index for local files.
+ *
+ * keyframe_index_build() makes one pass over a file without decoding it
+ * (filesrc ! parsebin ! fakesinks) and records the stream time of every
+ * video keyframe, with the byte position the source was reading at when
+ * the demuxer put it out. The index is cached in a compact sidecar file in
+ * the user cache directory, keyed by path and checked against the file's
+ * mtime and size, so keyframe_index_get() only scans a file once.
+ *
+ * keyframe_index_seek() turns a seek mode and target into the keyframe the
+ * mode would land on, prefetches the bytes around it into the page cache
+ * and seeks to exactly that time, so no frames before it are decoded and
+ * dropped. The seek is still a TIME seek, the demuxer maps it to a byte
+ * position with its own index as usual; the recorded offsets aren't
+ * guaranteed to be where a keyframe starts, so they only drive the
+ * prefetch. What this saves depends on the container and on the state of
+ * the page cache, basic-tutorial4-seek-bench measures it against plain
+ * seeks. ACCURATE seeks are passed through unchanged after the prefetch.
+ */
+#define KEYFRAME_INDEX_MAGIC "GSTKFIX1"
+#define KEYFRAME_INDEX_VERSION 1
+
+typedef struct _KeyframeIndex KeyframeIndex;
+
+/* NULL if the file has no video or couldn't be read */
+KeyframeIndex *keyframe_index_build(const gchar *path);
+/* cached index, NULL if there is none or the file changed since */
+KeyframeIndex *keyframe_index_load(const gchar *path);
+gboolean keyframe_index_save(KeyframeIndex *index);
+/* load, or build and save; cached tells which one happened, may be NULL */
+KeyframeIndex *keyframe_index_get(const gchar *path, gboolean *cached);
+void keyframe_index_free(KeyframeIndex *index);
+
+guint keyframe_index_count(KeyframeIndex *index);
+/* keyframe mode would land on for target, FALSE if there is none */
+gboolean keyframe_index_lookup(KeyframeIndex *index, SeekMode mode, gint64 target, gint64 *time, guint64 *offset);
+/* flushing seek on element, falls back to seek_mode_seek() when the index has no answer */
+gboolean keyframe_index_seek(KeyframeIndex *index, GstElement *element, SeekMode mode, gint64 target);
+
+G_END_DECLS
+
+#endif /* __KEYFRAME_INDEX_H__ */
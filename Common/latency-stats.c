@@ -0,0 +1,98 @@
+#include "latency-stats.h"
+
+struct _LatencyStats {
+	GArray *samples;	/* gint64, nsec */
+	gboolean sorted;	/* samples are in ascending order */
+	gint64 sum;
+};
+
+LatencyStats *latency_stats_new(void) {
+	LatencyStats *stats = g_new0(LatencyStats, 1);
+
+	stats->samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+	stats->sorted = TRUE;
+	return stats;
+}
+
+void latency_stats_free(LatencyStats *stats) {
+	if (stats == NULL)
+		return;
+	g_array_free(stats->samples, TRUE);
+	g_free(stats);
+}
+
+void latency_stats_reset(LatencyStats *stats) {
+	g_array_set_size(stats->samples, 0);
+	stats->sorted = TRUE;
+	stats->sum = 0;
+}
+
+void latency_stats_add(LatencyStats *stats, gint64 sample_ns) {
+	g_array_append_val(stats->samples, sample_ns);
+	stats->sum += sample_ns;
+	stats->sorted = FALSE;
+}
+
+static gint compare_samples(gconstpointer a, gconstpointer b) {
+	gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+	return (x > y) - (x < y);
+}
+
+/* sort lazily, percentiles are only asked for once a run is over */
+static void ensure_sorted(LatencyStats *stats) {
+	if (!stats->sorted) {
+		g_array_sort(stats->samples, compare_samples);
+		stats->sorted = TRUE;
+	}
+}
+
+guint latency_stats_count(LatencyStats *stats) {
+	return stats->samples->len;
+}
+
+gint64 latency_stats_min(LatencyStats *stats) {
+	return latency_stats_percentile(stats, 0.0);
+}
+
+gint64 latency_stats_max(LatencyStats *stats) {
+	return latency_stats_percentile(stats, 100.0);
+}
+
+gdouble latency_stats_mean(LatencyStats *stats) {
+	if (stats->samples->len == 0)
+		return 0.0;
+	return (gdouble)stats->sum / stats->samples->len;
+}
+
+guint64 latency_stats_rank(guint64 count, gdouble pct) {
+	gdouble exact;
+	guint64 rank;
+
+	if (count == 0)
+		return 0;
+	/* multiply first: pct * count / 100 is exact whenever the rank is whole */
+	exact = CLAMP(pct, 0.0, 100.0) * count / 100.0;
+	rank = (guint64)exact;
+	if (rank < exact)
+		rank++;
+	return CLAMP(rank, 1, count);
+}
+
+gint64 latency_stats_percentile(LatencyStats *stats, gdouble pct) {
+	if (stats->samples->len == 0)
+		return 0;
+	ensure_sorted(stats);
+	return g_array_index(stats->samples, gint64, latency_stats_rank(stats->samples->len, pct) - 1);
+}
+
+gchar *latency_stats_to_json(LatencyStats *stats) {
+	return g_strdup_printf("{\"count\":%u,\"min_us\":%.3f,\"p50_us\":%.3f,\"p90_us\":%.3f,"
+			"\"p99_us\":%.3f,\"max_us\":%.3f,\"mean_us\":%.3f}",
+			latency_stats_count(stats),
+			latency_stats_min(stats) / 1000.0,
+			latency_stats_percentile(stats, 50.0) / 1000.0,
+			latency_stats_percentile(stats, 90.0) / 1000.0,
+			latency_stats_percentile(stats, 99.0) / 1000.0,
+			latency_stats_max(stats) / 1000.0,
+			latency_stats_mean(stats) / 1000.0);
+}
@@ -0,0 +1,38 @@
+#ifndef __LATENCY_STATS_H__
+#define __LATENCY_STATS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Sample collector for latency/interval measurements shared by the
+ * benchmark programs. Samples are in nanoseconds (GstClockTime units),
+ * reported in microseconds.
+ * Not thread safe - callers serialize access themselves.
+ */
+typedef struct _LatencyStats LatencyStats;
+
+LatencyStats *latency_stats_new(void);
+void latency_stats_free(LatencyStats *stats);
+void latency_stats_reset(LatencyStats *stats);
+
+void latency_stats_add(LatencyStats *stats, gint64 sample_ns);
+
+guint latency_stats_count(LatencyStats *stats);
+gint64 latency_stats_min(LatencyStats *stats);
+gint64 latency_stats_max(LatencyStats *stats);
+gdouble latency_stats_mean(LatencyStats *stats);
+/* nearest-rank percentile, pct in [0, 100] */
+gint64 latency_stats_percentile(LatencyStats *stats, gdouble pct);
+/* the nearest rank itself, ceil(pct / 100 * count) in [1, count], for callers
+ * keeping their own sorted samples or histogram; 0 if count is 0 */
+guint64 latency_stats_rank(guint64 count, gdouble pct);
+
+/* {"count":..,"min_us":..,"p50_us":..,"p90_us":..,"p99_us":..,"max_us":..,"mean_us":..}
+ * free with g_free */
+gchar *latency_stats_to_json(LatencyStats *stats);
+
+G_END_DECLS
+
+#endif /* __LATENCY_STATS_H__ */
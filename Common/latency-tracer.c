@@ -0,0 +1,396 @@
+#include "latency-tracer.h"
+#include "latency-stats.h"
+
+/* inputs remembered per element for matching outputs by PTS */
+#define INPUT_RING 32
+
+/* marks pads already probed */
+#define PAD_QUARK_NAME "latency-tracer"
+
+typedef struct _InputStamp {
+	GstClockTime pts;
+	GstClockTime time;	/* arrival, NONE once matched */
+} InputStamp;
+
+typedef struct _ElementTrace {
+	GstElement *element;
+	gchar *name;
+	gulong pad_added_id;
+
+	/* written from streaming threads */
+	GMutex lock;
+	InputStamp inputs[INPUT_RING];
+	guint next_input;
+	GstClockTime last_in;
+
+	guint64 in_buffers;
+	guint64 out_buffers;
+	guint64 out_bytes;
+	GstClockTime first_out;
+	GstClockTime last_out;
+
+	guint64 latency_count;
+	GstClockTime latency_sum;
+	GstClockTime latency_max;
+	guint64 latency_hist[LATENCY_TRACER_BUCKETS];
+	guint64 interval_hist[LATENCY_TRACER_BUCKETS];
+} ElementTrace;
+
+typedef struct _PadProbe {
+	GstPad *pad;
+	gulong id;
+} PadProbe;
+
+struct _LatencyTracer {
+	GstElement *pipeline;
+	gulong element_added_id;
+	gboolean reported;
+
+	/* elements come and go from streaming threads */
+	GMutex lock;
+	GPtrArray *traces;	/* ElementTrace, discovery order */
+	GArray *probes;		/* PadProbe */
+};
+
+static GQuark pad_quark;
+
+static guint bucket(GstClockTime value) {
+	return value == 0 ? 0 : MIN(g_bit_storage(value) - 1, LATENCY_TRACER_BUCKETS - 1);
+}
+
+/* Probes, streaming threads */
+
+static GstPadProbeReturn sink_probe_cb(GstPad *pad, GstPadProbeInfo *info, ElementTrace *trace) {
+	GstClockTime now = gst_util_get_timestamp();
+	GstBuffer *buffer;
+	guint n = 1;
+
+	if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+		GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+
+		n = gst_buffer_list_length(list);
+		buffer = n > 0 ? gst_buffer_list_get(list, 0) : NULL;
+	} else {
+		buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	}
+
+	g_mutex_lock(&trace->lock);
+	if (buffer != NULL && GST_BUFFER_PTS_IS_VALID(buffer)) {
+		trace->inputs[trace->next_input].pts = GST_BUFFER_PTS(buffer);
+		trace->inputs[trace->next_input].time = now;
+		trace->next_input = (trace->next_input + 1) % INPUT_RING;
+	}
+	trace->last_in = now;
+	trace->in_buffers += n;
+	g_mutex_unlock(&trace->lock);
+	return GST_PAD_PROBE_OK;
+}
+
+/* @brief arrival of the input that became buffer, lock held */
+static GstClockTime match_input(ElementTrace *trace, GstBuffer *buffer) {
+	guint i;
+
+	if (buffer != NULL && GST_BUFFER_PTS_IS_VALID(buffer)) {
+		/* newest first, a reordering decoder outputs recent inputs */
+		for (i = 1; i <= INPUT_RING; i++) {
+			InputStamp *stamp = &trace->inputs[(trace->next_input + INPUT_RING - i) % INPUT_RING];
+
+			if (GST_CLOCK_TIME_IS_VALID(stamp->time) && stamp->pts == GST_BUFFER_PTS(buffer)) {
+				GstClockTime time = stamp->time;
+
+				stamp->time = GST_CLOCK_TIME_NONE;
+				return time;
+			}
+		}
+	}
+	return trace->last_in;
+}
+
+static GstPadProbeReturn src_probe_cb(GstPad *pad, GstPadProbeInfo *info, ElementTrace *trace) {
+	GstClockTime now = gst_util_get_timestamp(), in;
+	GstBuffer *buffer;
+	gsize size;
+	guint n = 1;
+
+	if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+		GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+
+		n = gst_buffer_list_length(list);
+		buffer = n > 0 ? gst_buffer_list_get(list, 0) : NULL;
+		size = gst_buffer_list_calculate_size(list);
+	} else {
+		buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+		size = gst_buffer_get_size(buffer);
+	}
+
+	g_mutex_lock(&trace->lock);
+	in = match_input(trace, buffer);
+	if (GST_CLOCK_TIME_IS_VALID(in) && now >= in) {
+		GstClockTime latency = now - in;
+
+		trace->latency_hist[bucket(latency)]++;
+		trace->latency_count++;
+		trace->latency_sum += latency;
+		trace->latency_max = MAX(trace->latency_max, latency);
+	}
+	if (GST_CLOCK_TIME_IS_VALID(trace->last_out))
+		trace->interval_hist[bucket(now - trace->last_out)]++;
+	else
+		trace->first_out = now;
+	trace->last_out = now;
+	trace->out_buffers += n;
+	trace->out_bytes += size;
+	g_mutex_unlock(&trace->lock);
+	return GST_PAD_PROBE_OK;
+}
+
+/* Following the pipeline */
+
+static void attach_pad(LatencyTracer *tracer, ElementTrace *trace, GstPad *pad) {
+	PadProbe probe;
+	GstPadProbeCallback callback;
+
+	g_mutex_lock(&tracer->lock);
+	/* pad-added may race with iterating the pads we already had */
+	if (g_object_get_qdata(G_OBJECT(pad), pad_quark) != NULL) {
+		g_mutex_unlock(&tracer->lock);
+		return;
+	}
+	g_object_set_qdata(G_OBJECT(pad), pad_quark, tracer);
+
+	callback = GST_PAD_IS_SINK(pad) ? (GstPadProbeCallback)sink_probe_cb : (GstPadProbeCallback)src_probe_cb;
+	probe.pad = gst_object_ref(pad);
+	probe.id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST, callback, trace, NULL);
+	g_array_append_val(tracer->probes, probe);
+	g_mutex_unlock(&tracer->lock);
+}
+
+static void pad_added_cb(GstElement *element, GstPad *pad, LatencyTracer *tracer) {
+	ElementTrace *trace = g_object_get_qdata(G_OBJECT(element), pad_quark);
+
+	if (trace != NULL)
+		attach_pad(tracer, trace, pad);
+}
+
+static void attach_element(LatencyTracer *tracer, GstElement *element) {
+	ElementTrace *trace;
+	GstIterator *it;
+	GValue item = G_VALUE_INIT;
+	gboolean done = FALSE;
+	guint i;
+
+	if (GST_IS_BIN(element))
+		return;
+
+	g_mutex_lock(&tracer->lock);
+	if (g_object_get_qdata(G_OBJECT(element), pad_quark) != NULL) {
+		g_mutex_unlock(&tracer->lock);
+		return;
+	}
+	trace = g_new0(ElementTrace, 1);
+	trace->element = gst_object_ref(element);
+	trace->name = gst_object_get_name(GST_OBJECT(element));
+	g_mutex_init(&trace->lock);
+	trace->last_in = trace->first_out = trace->last_out = GST_CLOCK_TIME_NONE;
+	for (i = 0; i < INPUT_RING; i++)
+		trace->inputs[i].time = GST_CLOCK_TIME_NONE;
+	g_object_set_qdata(G_OBJECT(element), pad_quark, trace);
+	g_ptr_array_add(tracer->traces, trace);
+	g_mutex_unlock(&tracer->lock);
+
+	/* dynamic pads from now on, then the ones it already has */
+	trace->pad_added_id = g_signal_connect(element, "pad-added", G_CALLBACK(pad_added_cb), tracer);
+	it = gst_element_iterate_pads(element);
+	while (!done) {
+		switch (gst_iterator_next(it, &item)) {
+			case GST_ITERATOR_OK:
+				attach_pad(tracer, trace, g_value_get_object(&item));
+				g_value_reset(&item);
+				break;
+			case GST_ITERATOR_RESYNC:
+				/* pads already probed are skipped */
+				gst_iterator_resync(it);
+				break;
+			default:
+				done = TRUE;
+				break;
+		}
+	}
+	g_value_unset(&item);
+	gst_iterator_free(it);
+}
+
+static void element_added_cb(GstBin *bin, GstBin *sub_bin, GstElement *element, LatencyTracer *tracer) {
+	attach_element(tracer, element);
+}
+
+static void trace_free(ElementTrace *trace) {
+	g_signal_handler_disconnect(trace->element, trace->pad_added_id);
+	g_object_set_qdata(G_OBJECT(trace->element), pad_quark, NULL);
+	gst_object_unref(trace->element);
+	g_mutex_clear(&trace->lock);
+	g_free(trace->name);
+	g_free(trace);
+}
+
+LatencyTracer *latency_tracer_new(GstElement *pipeline) {
+	LatencyTracer *tracer;
+	GstIterator *it;
+	GValue item = G_VALUE_INIT;
+	gboolean done = FALSE;
+
+	g_return_val_if_fail(GST_IS_BIN(pipeline), NULL);
+	if (pad_quark == 0)
+		pad_quark = g_quark_from_static_string(PAD_QUARK_NAME);
+
+	tracer = g_new0(LatencyTracer, 1);
+	tracer->pipeline = gst_object_ref(pipeline);
+	g_mutex_init(&tracer->lock);
+	tracer->traces = g_ptr_array_new_with_free_func((GDestroyNotify)trace_free);
+	tracer->probes = g_array_new(FALSE, FALSE, sizeof(PadProbe));
+
+	/* anything added later, at any depth, then what is there already */
+	tracer->element_added_id = g_signal_connect(pipeline, "deep-element-added", G_CALLBACK(element_added_cb), tracer);
+	it = gst_bin_iterate_recurse(GST_BIN(pipeline));
+	while (!done) {
+		switch (gst_iterator_next(it, &item)) {
+			case GST_ITERATOR_OK:
+				attach_element(tracer, g_value_get_object(&item));
+				g_value_reset(&item);
+				break;
+			case GST_ITERATOR_RESYNC:
+				gst_iterator_resync(it);
+				break;
+			default:
+				done = TRUE;
+				break;
+		}
+	}
+	g_value_unset(&item);
+	gst_iterator_free(it);
+	return tracer;
+}
+
+void latency_tracer_free(LatencyTracer *tracer) {
+	guint i;
+
+	if (tracer == NULL)
+		return;
+
+	g_signal_handler_disconnect(tracer->pipeline, tracer->element_added_id);
+	for (i = 0; i < tracer->probes->len; i++) {
+		PadProbe *probe = &g_array_index(tracer->probes, PadProbe, i);
+
+		gst_pad_remove_probe(probe->pad, probe->id);
+		g_object_set_qdata(G_OBJECT(probe->pad), pad_quark, NULL);
+		gst_object_unref(probe->pad);
+	}
+	g_array_free(tracer->probes, TRUE);
+	g_ptr_array_free(tracer->traces, TRUE);
+	g_mutex_clear(&tracer->lock);
+	gst_object_unref(tracer->pipeline);
+	g_free(tracer);
+}
+
+/* Reporting */
+
+/* @brief upper bound of the bucket holding the pct percentile */
+static GstClockTime hist_percentile(const guint64 *hist, guint64 count, gdouble pct) {
+	guint64 rank = latency_stats_rank(count, pct), seen = 0;
+	guint i;
+
+	for (i = 0; i < LATENCY_TRACER_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= rank)
+			return G_GUINT64_CONSTANT(1) << (i + 1);
+	}
+	return 0;
+}
+
+void latency_tracer_handle_message(LatencyTracer *tracer, GstMessage *msg) {
+	if (tracer->reported || GST_MESSAGE_TYPE(msg) != GST_MESSAGE_EOS || GST_MESSAGE_SRC(msg) != GST_OBJECT(tracer->pipeline))
+		return;
+	tracer->reported = TRUE;
+	latency_tracer_print(tracer);
+}
+
+void latency_tracer_print(LatencyTracer *tracer) {
+	guint i;
+
+	g_print("%-32s %10s %10s %9s %9s %10s %10s %10s\n", "element", "in", "out", "out/s", "MB/s",
+			"p50 us", "p99 us", "max us");
+	g_mutex_lock(&tracer->lock);
+	for (i = 0; i < tracer->traces->len; i++) {
+		ElementTrace *trace = g_ptr_array_index(tracer->traces, i);
+		GstClockTime span;
+
+		g_mutex_lock(&trace->lock);
+		if (trace->in_buffers == 0 && trace->out_buffers == 0) {
+			g_mutex_unlock(&trace->lock);
+			continue;
+		}
+		span = trace->out_buffers > 1 ? trace->last_out - trace->first_out : 0;
+		g_print("%-32s %10" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT " %9.1f %9.2f", trace->name,
+				trace->in_buffers, trace->out_buffers,
+				span > 0 ? (gdouble)(trace->out_buffers - 1) * GST_SECOND / span : 0.0,
+				span > 0 ? (gdouble)trace->out_bytes * GST_SECOND / span / (1024 * 1024) : 0.0);
+		if (trace->latency_count > 0)
+			g_print(" %10.1f %10.1f %10.1f\n",
+					(gdouble)hist_percentile(trace->latency_hist, trace->latency_count, 50) / GST_USECOND,
+					(gdouble)hist_percentile(trace->latency_hist, trace->latency_count, 99) / GST_USECOND,
+					(gdouble)trace->latency_max / GST_USECOND);
+		else
+			g_print(" %10s %10s %10s\n", "-", "-", "-");
+		g_mutex_unlock(&trace->lock);
+	}
+	g_mutex_unlock(&tracer->lock);
+}
+
+static void append_hist(GString *json, const gchar *key, const guint64 *hist) {
+	gboolean first = TRUE;
+	guint i;
+
+	g_string_append_printf(json, ",\"%s\":[", key);
+	for (i = 0; i < LATENCY_TRACER_BUCKETS; i++) {
+		if (hist[i] == 0)
+			continue;
+		g_string_append_printf(json, "%s[%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT "]", first ? "" : ",",
+				G_GUINT64_CONSTANT(1) << (i + 1), hist[i]);
+		first = FALSE;
+	}
+	g_string_append_c(json, ']');
+}
+
+gchar *latency_tracer_to_json(LatencyTracer *tracer) {
+	GString *json = g_string_new("{\"elements\":[");
+	gboolean first = TRUE;
+	guint i;
+
+	g_mutex_lock(&tracer->lock);
+	for (i = 0; i < tracer->traces->len; i++) {
+		ElementTrace *trace = g_ptr_array_index(tracer->traces, i);
+		GstClockTime span;
+
+		g_mutex_lock(&trace->lock);
+		if (trace->in_buffers == 0 && trace->out_buffers == 0) {
+			g_mutex_unlock(&trace->lock);
+			continue;
+		}
+		span = trace->out_buffers > 1 ? trace->last_out - trace->first_out : 0;
+		g_string_append_printf(json, "%s{\"element\":\"%s\",\"in\":%" G_GUINT64_FORMAT ",\"out\":%" G_GUINT64_FORMAT
+				",\"out_per_s\":%.1f,\"out_bytes\":%" G_GUINT64_FORMAT ",\"latency_mean_us\":%.1f"
+				",\"latency_max_us\":%.1f",
+				first ? "" : ",", trace->name, trace->in_buffers, trace->out_buffers,
+				span > 0 ? (gdouble)(trace->out_buffers - 1) * GST_SECOND / span : 0.0, trace->out_bytes,
+				trace->latency_count ? (gdouble)trace->latency_sum / trace->latency_count / GST_USECOND : 0.0,
+				(gdouble)trace->latency_max / GST_USECOND);
+		append_hist(json, "latency_hist", trace->latency_hist);
+		append_hist(json, "interval_hist", trace->interval_hist);
+		g_string_append_c(json, '}');
+		g_mutex_unlock(&trace->lock);
+		first = FALSE;
+	}
+	g_mutex_unlock(&tracer->lock);
+	g_string_append(json, "]}");
+	return g_string_free(json, FALSE);
+}
@@ -0,0 +1,49 @@
+#ifndef __LATENCY_TRACER_H__
+#define __LATENCY_TRACER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Per element processing latency and throughput from buffer probes.
+ *
+ * latency_tracer_new() probes every pad of every element in the pipeline,
+ * in nested bins too, and follows the pipeline as it grows: elements added
+ * later (decodebin internals, branches built in a pad-added handler) and
+ * pads they add are picked up as they appear. Bins themselves are skipped,
+ * their ghost pads would count buffers twice.
+ *
+ * A buffer entering a sink pad is stamped with its arrival time. When a
+ * buffer leaves a src pad of the same element it is matched to the input
+ * with the same PTS, so decoders and queues are measured per frame. Outputs
+ * without a matching input (demuxers, parsers) count from the latest input.
+ * For elements handing buffers on in the same thread this is the time spent
+ * in the element; for a queue it is the time a buffer sat in it.
+ *
+ * Latencies and the intervals between outputs go into log2 histograms
+ * (bucket i holds [2^i, 2^(i+1)) nsec), so a probe costs a timestamp, an
+ * uncontended lock and a few increments.
+ *
+ * latency_tracer_handle_message() prints the report when the pipeline
+ * reaches EOS.
+ */
+#define LATENCY_TRACER_BUCKETS 48
+
+typedef struct _LatencyTracer LatencyTracer;
+
+LatencyTracer *latency_tracer_new(GstElement *pipeline);
+/* call before the pipeline goes away, removes all probes */
+void latency_tracer_free(LatencyTracer *tracer);
+
+/* prints the report on EOS of the pipeline, doesn't consume msg */
+void latency_tracer_handle_message(LatencyTracer *tracer, GstMessage *msg);
+
+/* one line per element that saw buffers, in the order they were found */
+void latency_tracer_print(LatencyTracer *tracer);
+/* {"elements":[{"element":..,"latency_hist":[[upper_ns,count],...],...},...]} free with g_free */
+gchar *latency_tracer_to_json(LatencyTracer *tracer);
+
+G_END_DECLS
+
+#endif /* __LATENCY_TRACER_H__ */
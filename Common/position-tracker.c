@@ -0,0 +1,322 @@
+#include "position-tracker.h"
+
+struct _PositionTracker {
+	GstElement *pipeline;
+	GstClockTime interval;		/* minimum time between two updates */
+	PositionTrackerFunc func;
+	gpointer user_data;
+
+	/* sink pad we derive position from */
+	GstPad *pad;
+	gulong buffer_probe_id;
+	gulong event_probe_id;
+
+	/* protects segment, have_segment & last_position, written from the streaming thread */
+	GMutex lock;
+	GstSegment segment;
+	gboolean have_segment;
+	gint64 last_position;		/* stream time of last buffer reaching the sink */
+
+	/* only touched from the bus loop */
+	GstClock *clock;
+	gboolean playing;
+	gboolean update_pending;	/* push one update asap, e.g. after preroll or seek */
+	GstClockTime next_update;
+	gint64 duration;
+
+	guint64 queries_issued;
+	guint64 queries_saved;
+};
+
+/*
+ * @brief find the leaf sink to watch
+ *        Prefer the one providing the clock (normally the audio sink),
+ *        that is the one pacing playback.
+ */
+static GstPad *find_sink_pad(GstElement *pipeline) {
+	GstIterator *it;
+	GValue item = G_VALUE_INIT;
+	GstElement *best = NULL;
+	GstPad *pad = NULL;
+	gboolean done = FALSE;
+
+	if (!GST_IS_BIN(pipeline))
+		return NULL;
+
+	it = gst_bin_iterate_recurse(GST_BIN(pipeline));
+	while (!done) {
+		switch (gst_iterator_next(it, &item)) {
+			case GST_ITERATOR_OK: {
+				GstElement *element = g_value_get_object(&item);
+
+				if (!GST_IS_BIN(element) && GST_OBJECT_FLAG_IS_SET(element, GST_ELEMENT_FLAG_SINK)) {
+					if (best == NULL || (gst_element_provides_clock(element) && !gst_element_provides_clock(best))) {
+						gst_object_replace((GstObject **)&best, GST_OBJECT(element));
+					}
+				}
+				g_value_reset(&item);
+				break;
+			}
+			case GST_ITERATOR_RESYNC:
+				gst_object_replace((GstObject **)&best, NULL);
+				gst_iterator_resync(it);
+				break;
+			default:
+				done = TRUE;
+				break;
+		}
+	}
+	g_value_unset(&item);
+	gst_iterator_free(it);
+
+	if (best != NULL) {
+		pad = gst_element_get_static_pad(best, "sink");
+		gst_object_unref(best);
+	}
+	return pad;
+}
+
+/* @brief track segment on the sink pad, runs in streaming thread */
+static GstPadProbeReturn event_probe_cb(GstPad *pad, GstPadProbeInfo *info, PositionTracker *tracker) {
+	GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+
+	switch (GST_EVENT_TYPE(event)) {
+		case GST_EVENT_FLUSH_STOP:
+			g_mutex_lock(&tracker->lock);
+			gst_segment_init(&tracker->segment, GST_FORMAT_TIME);
+			tracker->have_segment = FALSE;
+			tracker->last_position = GST_CLOCK_TIME_NONE;
+			g_mutex_unlock(&tracker->lock);
+			break;
+		case GST_EVENT_SEGMENT: {
+			const GstSegment *segment;
+
+			gst_event_parse_segment(event, &segment);
+			if (segment->format == GST_FORMAT_TIME) {
+				g_mutex_lock(&tracker->lock);
+				gst_segment_copy_into(segment, &tracker->segment);
+				tracker->have_segment = TRUE;
+				g_mutex_unlock(&tracker->lock);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	return GST_PAD_PROBE_OK;
+}
+
+/* @brief remember where the last buffer was, runs in streaming thread */
+static GstPadProbeReturn buffer_probe_cb(GstPad *pad, GstPadProbeInfo *info, PositionTracker *tracker) {
+	GstClockTime ts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+
+	if (GST_CLOCK_TIME_IS_VALID(ts)) {
+		g_mutex_lock(&tracker->lock);
+		if (tracker->have_segment) {
+			gint64 stream_time = gst_segment_to_stream_time(&tracker->segment, GST_FORMAT_TIME, ts);
+			if (stream_time >= 0)
+				tracker->last_position = stream_time;
+		}
+		g_mutex_unlock(&tracker->lock);
+	}
+	return GST_PAD_PROBE_OK;
+}
+
+static void attach_probes(PositionTracker *tracker) {
+	tracker->pad = find_sink_pad(tracker->pipeline);
+	if (tracker->pad == NULL)
+		return;
+
+	tracker->event_probe_id = gst_pad_add_probe(tracker->pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+			(GstPadProbeCallback)event_probe_cb, tracker, NULL);
+	tracker->buffer_probe_id = gst_pad_add_probe(tracker->pad, GST_PAD_PROBE_TYPE_BUFFER,
+			(GstPadProbeCallback)buffer_probe_cb, tracker, NULL);
+}
+
+/*
+ * @brief position from clock & segment, -1 if it can't be derived
+ *        running time = clock time - base time, mapped back through the segment
+ *        and clamped to its ends
+ */
+static gint64 estimate_position(PositionTracker *tracker) {
+	gint64 position = -1;
+
+	g_mutex_lock(&tracker->lock);
+	if (tracker->have_segment) {
+		GstSegment *seg = &tracker->segment;
+
+		if (tracker->playing && tracker->clock != NULL && seg->format == GST_FORMAT_TIME) {
+			GstClockTime now = gst_clock_get_time(tracker->clock);
+			gint64 running = GST_CLOCK_DIFF(gst_element_get_base_time(tracker->pipeline), now);
+
+			if (running >= (gint64)seg->base) {
+				gint64 elapsed = (gint64)((running - seg->base) * ABS(seg->rate));
+				gint64 pos;
+
+				if (seg->rate > 0.0) {
+					pos = seg->start + seg->offset + elapsed;
+					if (GST_CLOCK_TIME_IS_VALID(seg->stop) && pos > (gint64)seg->stop)
+						pos = seg->stop;
+				} else if (GST_CLOCK_TIME_IS_VALID(seg->stop)) {
+					pos = MAX((gint64)(seg->stop - seg->offset) - elapsed, (gint64)seg->start);
+				} else {
+					pos = -1;
+				}
+				if (pos >= 0)
+					position = gst_segment_to_stream_time(seg, GST_FORMAT_TIME, pos);
+			}
+		}
+		/* not running or clock not usable yet: last prerolled/rendered buffer */
+		if (position < 0 && tracker->last_position >= 0)
+			position = tracker->last_position;
+	}
+	g_mutex_unlock(&tracker->lock);
+	return position;
+}
+
+PositionTracker *position_tracker_new(GstElement *pipeline, GstClockTime interval,
+		PositionTrackerFunc func, gpointer user_data) {
+	PositionTracker *tracker = g_new0(PositionTracker, 1);
+
+	tracker->pipeline = gst_object_ref(pipeline);
+	tracker->interval = interval;
+	tracker->func = func;
+	tracker->user_data = user_data;
+	g_mutex_init(&tracker->lock);
+	gst_segment_init(&tracker->segment, GST_FORMAT_TIME);
+	tracker->last_position = GST_CLOCK_TIME_NONE;
+	tracker->next_update = GST_CLOCK_TIME_NONE;
+	tracker->duration = GST_CLOCK_TIME_NONE;
+	return tracker;
+}
+
+void position_tracker_free(PositionTracker *tracker) {
+	if (tracker == NULL)
+		return;
+
+	if (tracker->pad != NULL) {
+		gst_pad_remove_probe(tracker->pad, tracker->event_probe_id);
+		gst_pad_remove_probe(tracker->pad, tracker->buffer_probe_id);
+		gst_object_unref(tracker->pad);
+	}
+	if (tracker->clock != NULL)
+		gst_object_unref(tracker->clock);
+	gst_object_unref(tracker->pipeline);
+	g_mutex_clear(&tracker->lock);
+	g_free(tracker);
+}
+
+void position_tracker_handle_message(PositionTracker *tracker, GstMessage *msg) {
+	switch (GST_MESSAGE_TYPE(msg)) {
+		case GST_MESSAGE_STATE_CHANGED: {
+			GstState old_state, new_state;
+
+			if (GST_MESSAGE_SRC(msg) != GST_OBJECT(tracker->pipeline))
+				break;
+
+			gst_message_parse_state_changed(msg, &old_state, &new_state, NULL);
+			/* sinks are in place once we prerolled */
+			if (new_state >= GST_STATE_PAUSED && tracker->pad == NULL)
+				attach_probes(tracker);
+
+			tracker->playing = (new_state == GST_STATE_PLAYING);
+			if (tracker->playing) {
+				if (tracker->clock != NULL)
+					gst_object_unref(tracker->clock);
+				tracker->clock = gst_element_get_clock(tracker->pipeline);
+				tracker->next_update = gst_util_get_timestamp();
+			} else if (new_state == GST_STATE_PAUSED) {
+				tracker->update_pending = TRUE;
+			}
+			break;
+		}
+		case GST_MESSAGE_ASYNC_DONE:
+			/* seek or preroll finished, position jumped */
+			tracker->update_pending = TRUE;
+			break;
+		case GST_MESSAGE_DURATION_CHANGED:
+			tracker->duration = GST_CLOCK_TIME_NONE;
+			break;
+		case GST_MESSAGE_CLOCK_LOST:
+			/* the old clock's time means nothing to the next one, fall back to
+			 * the last buffer till PLAYING picks up the new clock */
+			if (tracker->clock != NULL) {
+				gst_object_unref(tracker->clock);
+				tracker->clock = NULL;
+			}
+			tracker->update_pending = TRUE;
+			break;
+		case GST_MESSAGE_NEW_CLOCK:
+			if (tracker->playing) {
+				if (tracker->clock != NULL)
+					gst_object_unref(tracker->clock);
+				tracker->clock = gst_element_get_clock(tracker->pipeline);
+				tracker->update_pending = TRUE;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+GstClockTime position_tracker_next_timeout(PositionTracker *tracker) {
+	GstClockTime now;
+
+	if (tracker->update_pending)
+		return 0;
+	if (!tracker->playing || !GST_CLOCK_TIME_IS_VALID(tracker->next_update))
+		return GST_CLOCK_TIME_NONE;
+
+	now = gst_util_get_timestamp();
+	return tracker->next_update > now ? tracker->next_update - now : 0;
+}
+
+void position_tracker_dispatch(PositionTracker *tracker) {
+	GstClockTime now;
+
+	if (!tracker->playing && !tracker->update_pending)
+		return;
+
+	now = gst_util_get_timestamp();
+	if (!tracker->update_pending && GST_CLOCK_TIME_IS_VALID(tracker->next_update) && now < tracker->next_update)
+		return;
+
+	tracker->update_pending = FALSE;
+	tracker->next_update = now + tracker->interval;
+	if (tracker->func != NULL) {
+		tracker->func(position_tracker_get_position(tracker),
+				position_tracker_get_duration(tracker), tracker->user_data);
+	}
+}
+
+gint64 position_tracker_get_position(PositionTracker *tracker) {
+	gint64 position = estimate_position(tracker);
+
+	if (position >= 0) {
+		tracker->queries_saved++;
+	} else {
+		tracker->queries_issued++;
+		if (!gst_element_query_position(tracker->pipeline, GST_FORMAT_TIME, &position))
+			position = GST_CLOCK_TIME_NONE;
+	}
+	return position;
+}
+
+gint64 position_tracker_get_duration(PositionTracker *tracker) {
+	if (GST_CLOCK_TIME_IS_VALID(tracker->duration)) {
+		tracker->queries_saved++;
+	} else {
+		tracker->queries_issued++;
+		if (!gst_element_query_duration(tracker->pipeline, GST_FORMAT_TIME, &tracker->duration))
+			tracker->duration = GST_CLOCK_TIME_NONE;
+	}
+	return tracker->duration;
+}
+
+guint64 position_tracker_queries_issued(PositionTracker *tracker) {
+	return tracker->queries_issued;
+}
+
+guint64 position_tracker_queries_saved(PositionTracker *tracker) {
+	return tracker->queries_saved;
+}
@@ -0,0 +1,45 @@
+#ifndef __POSITION_TRACKER_H__
+#define __POSITION_TRACKER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Position/duration reporting without polling the element tree.
+ *
+ * Duration is queried once and cached until a DURATION_CHANGED message
+ * invalidates it. Position is derived from the pipeline clock and the segment seen on
+ * one sink pad (PLAYING), or from the last buffer timestamp on that pad
+ * (PAUSED). Element queries are only issued as a fallback, e.g. before the
+ * sink has seen its first segment. After CLOCK_LOST the position comes from
+ * the last buffer until the pipeline is PLAYING on its new clock.
+ *
+ * The bus loop feeds every message to position_tracker_handle_message(),
+ * blocks at most position_tracker_next_timeout() and then calls
+ * position_tracker_dispatch(), which invokes the consumer callback when an
+ * update is due.
+ */
+typedef struct _PositionTracker PositionTracker;
+
+/* position & duration in nsec, GST_CLOCK_TIME_NONE if unknown */
+typedef void (*PositionTrackerFunc)(gint64 position, gint64 duration, gpointer user_data);
+
+PositionTracker *position_tracker_new(GstElement *pipeline, GstClockTime interval,
+		PositionTrackerFunc func, gpointer user_data);
+void position_tracker_free(PositionTracker *tracker);
+
+void position_tracker_handle_message(PositionTracker *tracker, GstMessage *msg);
+GstClockTime position_tracker_next_timeout(PositionTracker *tracker);
+void position_tracker_dispatch(PositionTracker *tracker);
+
+gint64 position_tracker_get_position(PositionTracker *tracker);
+gint64 position_tracker_get_duration(PositionTracker *tracker);
+
+/* position & duration queries actually issued, and avoided compared to polling */
+guint64 position_tracker_queries_issued(PositionTracker *tracker);
+guint64 position_tracker_queries_saved(PositionTracker *tracker);
+
+G_END_DECLS
+
+#endif /* __POSITION_TRACKER_H__ */
@@ -0,0 +1,137 @@
+#include "qos-stats.h"
+
+struct _QosStats {
+	GPtrArray *elements;	/* QosElementStats, first report first */
+	GHashTable *by_path;	/* path -> QosElementStats */
+	GstClockTime start;	/* creation or reset */
+};
+
+static void element_free(QosElementStats *element) {
+	g_free(element->path);
+	g_free(element->name);
+	g_free(element);
+}
+
+QosStats *qos_stats_new(void) {
+	QosStats *stats = g_new0(QosStats, 1);
+
+	stats->elements = g_ptr_array_new_with_free_func((GDestroyNotify)element_free);
+	stats->by_path = g_hash_table_new(g_str_hash, g_str_equal);
+	stats->start = gst_util_get_timestamp();
+	return stats;
+}
+
+void qos_stats_free(QosStats *stats) {
+	if (stats == NULL)
+		return;
+	g_hash_table_destroy(stats->by_path);
+	g_ptr_array_free(stats->elements, TRUE);
+	g_free(stats);
+}
+
+void qos_stats_reset(QosStats *stats) {
+	g_hash_table_remove_all(stats->by_path);
+	g_ptr_array_set_size(stats->elements, 0);
+	stats->start = gst_util_get_timestamp();
+}
+
+gboolean qos_stats_handle_message(QosStats *stats, GstMessage *msg) {
+	QosElementStats *element;
+	gchar *path;
+	gboolean live;
+	guint64 running_time, stream_time, timestamp, duration, processed, dropped;
+	gint64 jitter;
+	gdouble proportion;
+	gint quality;
+	GstFormat format;
+
+	if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_QOS || GST_MESSAGE_SRC(msg) == NULL)
+		return FALSE;
+
+	path = gst_object_get_path_string(GST_MESSAGE_SRC(msg));
+	element = g_hash_table_lookup(stats->by_path, path);
+	if (element == NULL) {
+		element = g_new0(QosElementStats, 1);
+		element->path = path;
+		element->name = g_strdup(GST_MESSAGE_SRC_NAME(msg));
+		element->jitter_max = G_MININT64;
+		g_ptr_array_add(stats->elements, element);
+		g_hash_table_insert(stats->by_path, element->path, element);
+	} else {
+		g_free(path);
+	}
+
+	gst_message_parse_qos(msg, &live, &running_time, &stream_time, &timestamp, &duration);
+	gst_message_parse_qos_values(msg, &jitter, &proportion, &quality);
+	gst_message_parse_qos_stats(msg, &format, &processed, &dropped);
+
+	element->live = live;
+	element->messages++;
+	element->jitter_last = jitter;
+	element->jitter_max = MAX(element->jitter_max, jitter);
+	element->jitter_sum += jitter;
+	element->proportion_last = proportion;
+	element->proportion_max = MAX(element->proportion_max, proportion);
+	/* the element's own running counters, -1 if it doesn't keep them */
+	if (format != GST_FORMAT_UNDEFINED) {
+		element->format = format;
+		if (processed != (guint64)-1)
+			element->processed = processed;
+		if (dropped != (guint64)-1)
+			element->dropped = dropped;
+	}
+	return TRUE;
+}
+
+guint qos_stats_count(QosStats *stats) {
+	return stats->elements->len;
+}
+
+void qos_stats_foreach(QosStats *stats, QosStatsFunc func, gpointer user_data) {
+	guint i;
+
+	for (i = 0; i < stats->elements->len; i++)
+		func(g_ptr_array_index(stats->elements, i), i, user_data);
+}
+
+gdouble qos_stats_drop_percent(const QosElementStats *element) {
+	guint64 total = element->processed + element->dropped;
+
+	return total > 0 ? 100.0 * element->dropped / total : 0.0;
+}
+
+guint64 qos_stats_total_dropped(QosStats *stats) {
+	guint64 dropped = 0;
+	guint i;
+
+	for (i = 0; i < stats->elements->len; i++) {
+		QosElementStats *element = g_ptr_array_index(stats->elements, i);
+
+		if (element->format == GST_FORMAT_BUFFERS)
+			dropped += element->dropped;
+	}
+	return dropped;
+}
+
+gchar *qos_stats_to_json(QosStats *stats) {
+	GString *json = g_string_new(NULL);
+	guint i;
+
+	g_string_append_printf(json, "{\"time_ms\":%" G_GINT64_FORMAT ",\"elements\":[",
+			GST_CLOCK_DIFF(stats->start, gst_util_get_timestamp()) / GST_MSECOND);
+	for (i = 0; i < stats->elements->len; i++) {
+		QosElementStats *element = g_ptr_array_index(stats->elements, i);
+
+		g_string_append_printf(json, "%s{\"element\":\"%s\",\"format\":\"%s\",\"processed\":%" G_GUINT64_FORMAT
+				",\"dropped\":%" G_GUINT64_FORMAT ",\"drop_pct\":%.2f,\"messages\":%" G_GUINT64_FORMAT
+				",\"jitter_us\":{\"last\":%" G_GINT64_FORMAT ",\"max\":%" G_GINT64_FORMAT ",\"mean\":%.1f}"
+				",\"proportion\":{\"last\":%.3f,\"max\":%.3f},\"live\":%s}",
+				i > 0 ? "," : "", element->path, gst_format_get_name(element->format),
+				element->processed, element->dropped, qos_stats_drop_percent(element), element->messages,
+				element->jitter_last / 1000, element->jitter_max / 1000,
+				(gdouble)element->jitter_sum / element->messages / 1000,
+				element->proportion_last, element->proportion_max, element->live ? "true" : "false");
+	}
+	g_string_append(json, "]}");
+	return g_string_free(json, FALSE);
+}
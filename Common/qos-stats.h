@@ -0,0 +1,61 @@
+#ifndef __QOS_STATS_H__
+#define __QOS_STATS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Frame drop and lateness statistics from QoS messages.
+ *
+ * Sinks post a QOS message when they drop a late buffer, or, in live
+ * pipelines, on every buffer. Elements upstream that skip work because of
+ * QoS events (decoders, videorate) post one too. Feed every bus message to
+ * qos_stats_handle_message(). It keeps, per posting element:
+ *   - the element's own processed and dropped counters, in the units it
+ *     reports (buffers for video, samples for most audio)
+ *   - jitter: how late the buffer was, last, worst and mean
+ *   - proportion: how much faster upstream should go, last and worst
+ *
+ * Elements are listed in the order they first reported. Only touched from
+ * the thread handling the bus, no locking.
+ */
+typedef struct _QosStats QosStats;
+
+typedef struct _QosElementStats {
+	gchar *path;		/* gst_object_get_path_string() of the element */
+	gchar *name;
+	GstFormat format;	/* of processed/dropped */
+	guint64 processed;
+	guint64 dropped;
+	guint64 messages;
+	gint64 jitter_last;	/* nsec, positive is late */
+	gint64 jitter_max;
+	gint64 jitter_sum;
+	gdouble proportion_last;
+	gdouble proportion_max;
+	gboolean live;
+} QosElementStats;
+
+typedef void (*QosStatsFunc)(const QosElementStats *element, guint index, gpointer user_data);
+
+QosStats *qos_stats_new(void);
+void qos_stats_free(QosStats *stats);
+void qos_stats_reset(QosStats *stats);
+
+/* @return TRUE if msg was a QOS message */
+gboolean qos_stats_handle_message(QosStats *stats, GstMessage *msg);
+
+guint qos_stats_count(QosStats *stats);
+void qos_stats_foreach(QosStats *stats, QosStatsFunc func, gpointer user_data);
+/* dropped / (processed + dropped) of one element, in percent */
+gdouble qos_stats_drop_percent(const QosElementStats *element);
+/* summed over all elements reporting buffers */
+guint64 qos_stats_total_dropped(QosStats *stats);
+
+/* {"time_ms":..,"elements":[{"element":..,"processed":..,...},...]} free with g_free */
+gchar *qos_stats_to_json(QosStats *stats);
+
+G_END_DECLS
+
+#endif /* __QOS_STATS_H__ */
@@ -0,0 +1,413 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <string.h>
+
+#include "sched-policy.h"
+
+#define MAX_CPUS 1024
+/* pads followed downstream of a queue, or through ghost pads */
+#define MAX_HOPS 8
+
+typedef struct _SchedRule {
+	gboolean set;
+	gchar *cpus_spec;	/* as given, for reports */
+	GArray *cpus;		/* gint, empty keeps affinity */
+	gint fifo;		/* SCHED_FIFO priority, 0 keeps SCHED_OTHER */
+	gboolean renice;
+	gint nice;
+
+	/* from streaming threads */
+	gint threads;
+	gint failed;
+	gint warned;
+} SchedRule;
+
+struct _SchedPolicy {
+	SchedRule rules[SCHED_ROLE_COUNT];
+	GArray *default_cpus;	/* gint, what threads get back on leaving */
+	gint default_nice;
+
+	GstBus *bus;
+	gulong status_id;
+};
+
+/* role + 1 the current thread entered with, 0 for none: owners can be relinked before they leave */
+static GPrivate entered_role;
+
+static const gchar *role_names[SCHED_ROLE_COUNT] = {
+	"source", "decode", "convert", "sink", "audio-sink", "other"
+};
+
+const gchar *sched_role_to_string(SchedRole role) {
+	return role < SCHED_ROLE_COUNT ? role_names[role] : "unknown";
+}
+
+/* Applying rules, streaming threads */
+
+#ifdef __linux__
+static gint set_affinity(GArray *cpus) {
+	cpu_set_t set;
+	guint i;
+
+	CPU_ZERO(&set);
+	for (i = 0; i < cpus->len; i++)
+		CPU_SET(g_array_index(cpus, gint, i), &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static gint set_fifo(gint priority) {
+	struct sched_param param = { 0 };
+
+	param.sched_priority = priority;
+	return pthread_setschedparam(pthread_self(), priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+}
+
+/* @brief nice is per thread on Linux, by thread id */
+static gint set_nice(gint nice) {
+	return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) == 0 ? 0 : errno;
+}
+
+static void enter(SchedPolicy *policy, SchedRole role) {
+	SchedRule *rule = &policy->rules[role];
+	const gchar *what = NULL;
+	gint error = 0;
+
+	if (rule->cpus->len > 0 && (error = set_affinity(rule->cpus)) != 0)
+		what = "affinity";
+	else if (rule->fifo > 0 && (error = set_fifo(rule->fifo)) != 0)
+		what = "SCHED_FIFO";
+	else if (rule->renice && (error = set_nice(rule->nice)) != 0)
+		what = "nice";
+
+	if (what == NULL) {
+		g_atomic_int_inc(&rule->threads);
+		return;
+	}
+	g_atomic_int_inc(&rule->failed);
+	if (g_atomic_int_compare_and_exchange(&rule->warned, FALSE, TRUE))
+		g_printerr("Scheduling policy: %s for %s threads failed: %s\n", what, role_names[role], g_strerror(error));
+}
+
+/* @brief back to what the process started with, pooled threads run other tasks next */
+static void leave(SchedPolicy *policy, SchedRole role) {
+	SchedRule *rule = &policy->rules[role];
+
+	if (rule->cpus->len > 0 && policy->default_cpus->len > 0)
+		set_affinity(policy->default_cpus);
+	if (rule->fifo > 0)
+		set_fifo(0);
+	if (rule->renice)
+		set_nice(policy->default_nice);
+}
+#endif
+
+/* Roles */
+
+/* @return TRUE if the element class tells the role */
+static gboolean klass_role(GstElement *element, SchedRole *role) {
+	const gchar *klass = gst_element_get_metadata(element, GST_ELEMENT_METADATA_KLASS);
+
+	if (klass == NULL)
+		return FALSE;
+	if (strstr(klass, "Sink"))
+		*role = strstr(klass, "Audio") ? SCHED_ROLE_AUDIO_SINK : SCHED_ROLE_SINK;
+	else if (strstr(klass, "Source"))
+		*role = SCHED_ROLE_SOURCE;
+	else if (strstr(klass, "Decoder") || strstr(klass, "Demuxer") || strstr(klass, "Parser") || strstr(klass, "Depayloader"))
+		*role = SCHED_ROLE_DECODE;
+	else if (strstr(klass, "Converter") || strstr(klass, "Filter") || strstr(klass, "Effect") || strstr(klass, "Scaler"))
+		*role = SCHED_ROLE_CONVERT;
+	else
+		return FALSE;
+	return TRUE;
+}
+
+/* @brief element behind the first src pad, through ghost pads in and out of bins */
+static GstElement *downstream(GstElement *element) {
+	GstPad *pad = NULL, *peer, *next;
+	GstElement *found = NULL;
+	guint hops;
+
+	GST_OBJECT_LOCK(element);
+	if (element->srcpads != NULL)
+		pad = gst_object_ref(element->srcpads->data);
+	GST_OBJECT_UNLOCK(element);
+	if (pad == NULL)
+		return NULL;
+
+	peer = gst_pad_get_peer(pad);
+	gst_object_unref(pad);
+	for (hops = 0; peer != NULL && GST_IS_PROXY_PAD(peer) && hops < MAX_HOPS; hops++) {
+		if (GST_IS_GHOST_PAD(peer)) {
+			next = gst_ghost_pad_get_target(GST_GHOST_PAD(peer));
+		} else {
+			/* internal pad of a ghost src pad, leaving the bin */
+			GstProxyPad *ghost = gst_proxy_pad_get_internal(GST_PROXY_PAD(peer));
+
+			next = ghost != NULL ? gst_pad_get_peer(GST_PAD(ghost)) : NULL;
+			if (ghost != NULL)
+				gst_object_unref(ghost);
+		}
+		gst_object_unref(peer);
+		peer = next;
+	}
+	if (peer != NULL) {
+		found = gst_pad_get_parent_element(peer);
+		gst_object_unref(peer);
+	}
+	return found;
+}
+
+static SchedRole classify(GstElement *element, guint depth) {
+	SchedRole role = SCHED_ROLE_OTHER;
+	GstObject *parent;
+	GstElement *next;
+
+	if (klass_role(element, &role))
+		return role;
+
+	/* queues: what their thread pushes into */
+	if (depth < MAX_HOPS && (next = downstream(element)) != NULL) {
+		role = classify(next, depth + 1);
+		gst_object_unref(next);
+		if (role != SCHED_ROLE_OTHER)
+			return role;
+	}
+
+	/* still unlinked, the enclosing bin tells, e.g. decodebin's multiqueue */
+	parent = gst_object_get_parent(GST_OBJECT(element));
+	while (parent != NULL && GST_IS_ELEMENT(parent) && !klass_role(GST_ELEMENT(parent), &role)) {
+		GstObject *up = gst_object_get_parent(parent);
+
+		gst_object_unref(parent);
+		parent = up;
+	}
+	if (parent != NULL)
+		gst_object_unref(parent);
+	return role;
+}
+
+/* @brief sync-message, from the thread that starts or stops */
+static void stream_status_cb(GstBus *bus, GstMessage *msg, SchedPolicy *policy) {
+	GstStreamStatusType type;
+	GstElement *owner;
+	SchedRole role;
+
+	gst_message_parse_stream_status(msg, &type, &owner);
+	if (type == GST_STREAM_STATUS_TYPE_ENTER && owner != NULL) {
+		role = classify(owner, 0);
+		if (!policy->rules[role].set) {
+			g_private_set(&entered_role, NULL);
+			return;
+		}
+		g_private_set(&entered_role, GINT_TO_POINTER(role + 1));
+#ifdef __linux__
+		enter(policy, role);
+#endif
+	} else if (type == GST_STREAM_STATUS_TYPE_LEAVE) {
+		/* undo what ENTER did, classifying again could pick another role */
+		gint entered = GPOINTER_TO_INT(g_private_get(&entered_role));
+
+		if (entered == 0)
+			return;
+		g_private_set(&entered_role, NULL);
+#ifdef __linux__
+		leave(policy, entered - 1);
+#endif
+	}
+}
+
+/* Setup */
+
+static gboolean parse_cpus(const gchar *spec, GArray *cpus) {
+	gchar **items = g_strsplit(spec, ",", -1);
+	gboolean ok = TRUE;
+	guint i;
+
+	for (i = 0; ok && items[i] != NULL; i++) {
+		gchar **range;
+		gint64 first, last;
+		gint cpu;
+
+		if (*g_strstrip(items[i]) == '\0')
+			continue;
+		range = g_strsplit(items[i], "-", 2);
+		ok = g_ascii_string_to_signed(range[0], 10, 0, MAX_CPUS - 1, &first, NULL);
+		last = first;
+		if (ok && range[1] != NULL)
+			ok = g_ascii_string_to_signed(range[1], 10, first, MAX_CPUS - 1, &last, NULL);
+		for (cpu = first; ok && cpu <= last; cpu++)
+			g_array_append_val(cpus, cpu);
+		g_strfreev(range);
+	}
+	g_strfreev(items);
+	return ok;
+}
+
+/* @brief "ROLE=CPUS[/fifo:PRIO|/nice:N]" into its rule */
+static gboolean parse_rule(SchedPolicy *policy, const gchar *entry) {
+	gchar **kv = g_strsplit(entry, "=", 2), **parts = NULL;
+	SchedRule *rule = NULL;
+	gboolean ok = FALSE;
+	gint64 value;
+	guint i;
+
+	for (i = 0; kv[1] != NULL && i < SCHED_ROLE_COUNT; i++) {
+		if (g_strcmp0(g_strstrip(kv[0]), role_names[i]) == 0)
+			rule = &policy->rules[i];
+	}
+	if (rule == NULL || rule->set)
+		goto out;
+
+	parts = g_strsplit(kv[1], "/", -1);
+	if (!parse_cpus(parts[0], rule->cpus))
+		goto out;
+	rule->cpus_spec = g_strdup(g_strstrip(parts[0]));
+	for (i = 1; parts[i] != NULL; i++) {
+		if (g_str_has_prefix(parts[i], "fifo:") &&
+				g_ascii_string_to_signed(parts[i] + 5, 10, 1, 99, &value, NULL)) {
+			rule->fifo = value;
+		} else if (g_str_has_prefix(parts[i], "nice:") &&
+				g_ascii_string_to_signed(parts[i] + 5, 10, -20, 19, &value, NULL)) {
+			rule->renice = TRUE;
+			rule->nice = value;
+		} else {
+			goto out;
+		}
+	}
+	rule->set = ok = TRUE;
+out:
+	g_strfreev(parts);
+	g_strfreev(kv);
+	return ok;
+}
+
+SchedPolicy *sched_policy_new(const gchar *spec) {
+	SchedPolicy *policy = g_new0(SchedPolicy, 1);
+	gchar **entries;
+	guint i;
+
+	for (i = 0; i < SCHED_ROLE_COUNT; i++)
+		policy->rules[i].cpus = g_array_new(FALSE, FALSE, sizeof(gint));
+	policy->default_cpus = g_array_new(FALSE, FALSE, sizeof(gint));
+
+	entries = g_strsplit(spec, ";", -1);
+	for (i = 0; entries[i] != NULL; i++) {
+		if (*g_strstrip(entries[i]) == '\0')
+			continue;
+		if (!parse_rule(policy, entries[i])) {
+			g_printerr("Scheduling policy: can't use '%s', expected " SCHED_POLICY_SYNTAX "\n", entries[i]);
+			g_strfreev(entries);
+			sched_policy_free(policy);
+			return NULL;
+		}
+	}
+	g_strfreev(entries);
+
+#ifdef __linux__
+	{
+		cpu_set_t set;
+		gint cpu;
+
+		/* what the threads inherited, before we pin any of them */
+		if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+			for (cpu = 0; cpu < CPU_SETSIZE && cpu < MAX_CPUS; cpu++) {
+				if (CPU_ISSET(cpu, &set))
+					g_array_append_val(policy->default_cpus, cpu);
+			}
+		}
+		policy->default_nice = getpriority(PRIO_PROCESS, 0);
+	}
+#endif
+	return policy;
+}
+
+void sched_policy_free(SchedPolicy *policy) {
+	guint i;
+
+	if (policy == NULL)
+		return;
+
+	if (policy->bus != NULL) {
+		g_signal_handler_disconnect(policy->bus, policy->status_id);
+		gst_bus_disable_sync_message_emission(policy->bus);
+		gst_object_unref(policy->bus);
+	}
+	for (i = 0; i < SCHED_ROLE_COUNT; i++) {
+		g_array_free(policy->rules[i].cpus, TRUE);
+		g_free(policy->rules[i].cpus_spec);
+	}
+	g_array_free(policy->default_cpus, TRUE);
+	g_free(policy);
+}
+
+void sched_policy_watch(SchedPolicy *policy, GstElement *pipeline) {
+	g_return_if_fail(policy->bus == NULL);
+
+#ifdef __linux__
+	/* alongside whatever sync handler is installed, and the startup profiler's listener */
+	policy->bus = gst_element_get_bus(pipeline);
+	gst_bus_enable_sync_message_emission(policy->bus);
+	policy->status_id = g_signal_connect(policy->bus, "sync-message::stream-status", G_CALLBACK(stream_status_cb), policy);
+#else
+	g_printerr("Scheduling policy: not supported on this platform, ignored.\n");
+#endif
+}
+
+GArray *sched_policy_get_cpus(SchedPolicy *policy) {
+	GArray *cpus = g_array_new(FALSE, FALSE, sizeof(gint));
+	gboolean pinned[MAX_CPUS] = { FALSE };
+	guint i, j;
+	gint cpu;
+
+	for (i = 0; i < SCHED_ROLE_COUNT; i++) {
+		for (j = 0; policy->rules[i].set && j < policy->rules[i].cpus->len; j++)
+			pinned[g_array_index(policy->rules[i].cpus, gint, j)] = TRUE;
+	}
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		if (pinned[cpu])
+			g_array_append_val(cpus, cpu);
+	}
+	return cpus;
+}
+
+/* Reporting */
+
+void sched_policy_print(SchedPolicy *policy) {
+	guint i;
+
+	for (i = 0; i < SCHED_ROLE_COUNT; i++) {
+		SchedRule *rule = &policy->rules[i];
+
+		if (!rule->set)
+			continue;
+		g_print("Scheduling %-10s cpus %-8s %-8s %d threads, %d failed\n", role_names[i],
+				rule->cpus->len > 0 ? rule->cpus_spec : "any",
+				rule->fifo > 0 ? "fifo" : rule->renice ? "nice" : "-",
+				g_atomic_int_get(&rule->threads), g_atomic_int_get(&rule->failed));
+	}
+}
+
+gchar *sched_policy_to_json(SchedPolicy *policy) {
+	GString *json = g_string_new("{");
+	guint i;
+
+	for (i = 0; i < SCHED_ROLE_COUNT; i++) {
+		SchedRule *rule = &policy->rules[i];
+
+		if (!rule->set)
+			continue;
+		g_string_append_printf(json, "%s\"%s\":{\"cpus\":\"%s\",\"fifo\":%d,\"nice\":%d,\"threads\":%d,\"failed\":%d}",
+				json->len > 1 ? "," : "", role_names[i], rule->cpus_spec, rule->fifo, rule->renice ? rule->nice : 0,
+				g_atomic_int_get(&rule->threads), g_atomic_int_get(&rule->failed));
+	}
+	g_string_append_c(json, '}');
+	return g_string_free(json, FALSE);
+}
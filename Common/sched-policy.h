@@ -0,0 +1,63 @@
+#ifndef __SCHED_POLICY_H__
+#define __SCHED_POLICY_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * CPU affinity and priority for streaming threads.
+ *
+ * Every streaming thread (pad tasks, audio sink ring buffer threads) posts a
+ * STREAM_STATUS message from inside the thread when it starts and when it
+ * stops. sched_policy_watch() catches them synchronously and gives the
+ * thread the rule of its role, then undoes that same rule when it leaves, as
+ * pooled threads get reused for other tasks.
+ *
+ * The role comes from the element class of the task's owner. Queues and
+ * multiqueues drive whatever is downstream of them, so they take the role of
+ * the first non-queue element after them, or of the bin they sit in
+ * (decodebin) while still unlinked.
+ *
+ * Rules are given as "ROLE=CPUS[/fifo:PRIO|/nice:N];...", e.g.
+ *   "decode=2-3;convert=2-3;audio-sink=1/fifo:40"
+ * CPUS is a list like "0,2-3" and may be empty to only change priority.
+ * SCHED_FIFO needs CAP_SYS_NICE or an rtprio limit, negative nice values
+ * need the same; failures are counted and reported once per role.
+ *
+ * Uses sync-message emission instead of a bus sync handler, so it works
+ * next to startup_profiler_watch(). Linux only, elsewhere nothing happens.
+ */
+typedef enum {
+	SCHED_ROLE_SOURCE,
+	SCHED_ROLE_DECODE,
+	SCHED_ROLE_CONVERT,
+	SCHED_ROLE_SINK,
+	SCHED_ROLE_AUDIO_SINK,
+	SCHED_ROLE_OTHER,
+	SCHED_ROLE_COUNT
+} SchedRole;
+
+#define SCHED_POLICY_SYNTAX "ROLE=CPUS[/fifo:PRIO|/nice:N];... with ROLE one of source, decode, convert, sink, audio-sink, other"
+
+typedef struct _SchedPolicy SchedPolicy;
+
+/* @return NULL if spec doesn't parse, reason printed */
+SchedPolicy *sched_policy_new(const gchar *spec);
+/* the pipeline must be in NULL by now */
+void sched_policy_free(SchedPolicy *policy);
+
+void sched_policy_watch(SchedPolicy *policy, GstElement *pipeline);
+
+const gchar *sched_role_to_string(SchedRole role);
+/* CPUs any rule pins to, gint ascending, free with g_array_unref */
+GArray *sched_policy_get_cpus(SchedPolicy *policy);
+
+/* threads given their rule and failures, per role with a rule */
+void sched_policy_print(SchedPolicy *policy);
+/* {"decode":{"cpus":"2-3","fifo":0,"nice":0,"threads":..,"failed":..},...} free with g_free */
+gchar *sched_policy_to_json(SchedPolicy *policy);
+
+G_END_DECLS
+
+#endif /* __SCHED_POLICY_H__ */
@@ -0,0 +1,37 @@
+#include "seek-modes.h"
+
+static const struct {
+	const gchar *name;
+	GstSeekFlags flags;
+} seek_modes[SEEK_MODE_LAST] = {
+	{ "key-unit", GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT },
+	{ "accurate", GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE },
+	{ "snap-before", GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE },
+	{ "snap-after", GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_AFTER },
+};
+
+gboolean seek_mode_from_string(const gchar *str, SeekMode *mode) {
+	gint i;
+
+	for (i = 0; i < SEEK_MODE_LAST; i++) {
+		if (g_strcmp0(seek_modes[i].name, str) == 0) {
+			*mode = (SeekMode)i;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+const gchar *seek_mode_to_string(SeekMode mode) {
+	g_return_val_if_fail(mode < SEEK_MODE_LAST, NULL);
+	return seek_modes[mode].name;
+}
+
+GstSeekFlags seek_mode_get_flags(SeekMode mode) {
+	g_return_val_if_fail(mode < SEEK_MODE_LAST, GST_SEEK_FLAG_FLUSH);
+	return seek_modes[mode].flags;
+}
+
+gboolean seek_mode_seek(GstElement *element, SeekMode mode, gint64 position) {
+	return gst_element_seek_simple(element, GST_FORMAT_TIME, seek_mode_get_flags(mode), position);
+}
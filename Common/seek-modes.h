@@ -0,0 +1,31 @@
+#ifndef __SEEK_MODES_H__
+#define __SEEK_MODES_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Named seek flavours, so programs can pick one per use case from the
+ * command line. All of them are flushing seeks.
+ */
+typedef enum {
+	SEEK_MODE_KEY_UNIT = 0,	/* nearest keyframe, cheapest */
+	SEEK_MODE_ACCURATE,	/* exact position, decodes from previous keyframe */
+	SEEK_MODE_SNAP_BEFORE,	/* keyframe at or before target */
+	SEEK_MODE_SNAP_AFTER,	/* keyframe at or after target */
+	SEEK_MODE_LAST
+} SeekMode;
+
+#define SEEK_MODE_NAMES "key-unit, accurate, snap-before, snap-after"
+
+gboolean seek_mode_from_string(const gchar *str, SeekMode *mode);
+const gchar *seek_mode_to_string(SeekMode mode);
+GstSeekFlags seek_mode_get_flags(SeekMode mode);
+
+/* gst_element_seek_simple() in TIME format with the flags of mode */
+gboolean seek_mode_seek(GstElement *element, SeekMode mode, gint64 position);
+
+G_END_DECLS
+
+#endif /* __SEEK_MODES_H__ */
@@ -0,0 +1,254 @@
+#include "segment-loop.h"
+#include "latency-stats.h"
+
+/* element message the sink probes post at a boundary */
+#define GAP_MESSAGE "segment-loop-gap"
+
+typedef struct _SinkWatch {
+	SegmentLoop *loop;
+	GstElement *sink;
+	GstPad *pad;
+	gulong probe_id;
+
+	/* streaming thread only */
+	const gchar *kind;	/* from caps */
+	GstSegment segment;
+	GstClockTime last_end;	/* running time the last buffer ended at, NONE after a flush */
+	gboolean boundary;	/* new segment without a flush, next buffer starts an iteration */
+} SinkWatch;
+
+struct _SegmentLoop {
+	GstElement *pipeline;
+	GPtrArray *watches;	/* SinkWatch */
+
+	/* only touched from the bus loop */
+	guint iterations;
+	GHashTable *gaps;	/* media kind -> LatencyStats */
+	const gchar *last_kind;
+	gint64 last_gap;
+};
+
+static void watch_free(SinkWatch *watch) {
+	gst_pad_remove_probe(watch->pad, watch->probe_id);
+	gst_object_unref(watch->pad);
+	gst_object_unref(watch->sink);
+	g_free(watch);
+}
+
+SegmentLoop *segment_loop_new(GstElement *pipeline) {
+	SegmentLoop *loop = g_new0(SegmentLoop, 1);
+
+	loop->pipeline = gst_object_ref(pipeline);
+	loop->watches = g_ptr_array_new_with_free_func((GDestroyNotify)watch_free);
+	loop->gaps = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)latency_stats_free);
+	return loop;
+}
+
+void segment_loop_free(SegmentLoop *loop) {
+	if (loop == NULL)
+		return;
+	g_ptr_array_free(loop->watches, TRUE);
+	g_hash_table_destroy(loop->gaps);
+	gst_object_unref(loop->pipeline);
+	g_free(loop);
+}
+
+/* @brief how far past its render time running_time reached the sink, by the pipeline clock */
+static gint64 lateness(SinkWatch *watch, GstClockTime running_time) {
+	GstClock *clock;
+	GstClockTime now, latency = 0;
+
+	if (GST_STATE(watch->sink) != GST_STATE_PLAYING || (clock = gst_element_get_clock(watch->sink)) == NULL)
+		return 0;
+	now = gst_clock_get_time(clock);
+	gst_object_unref(clock);
+	if (GST_IS_PIPELINE(watch->loop->pipeline))
+		latency = gst_pipeline_get_latency(GST_PIPELINE(watch->loop->pipeline));
+	if (!GST_CLOCK_TIME_IS_VALID(latency))
+		latency = 0;
+	return GST_CLOCK_DIFF(running_time + latency, now - gst_element_get_base_time(watch->sink));
+}
+
+/* @brief follow segments and flushes, measure the first buffer of each iteration */
+static GstPadProbeReturn probe_cb(GstPad *pad, GstPadProbeInfo *info, SinkWatch *watch) {
+	GstBuffer *buffer;
+	GstClockTime running_time;
+
+	if (info->type & (GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH)) {
+		GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+
+		switch (GST_EVENT_TYPE(event)) {
+			case GST_EVENT_FLUSH_STOP:
+				watch->last_end = GST_CLOCK_TIME_NONE;
+				watch->boundary = FALSE;
+				break;
+			case GST_EVENT_SEGMENT: {
+				const GstSegment *segment;
+
+				gst_event_parse_segment(event, &segment);
+				gst_segment_copy_into(segment, &watch->segment);
+				watch->boundary = GST_CLOCK_TIME_IS_VALID(watch->last_end);
+				break;
+			}
+			case GST_EVENT_CAPS: {
+				GstCaps *caps;
+				const gchar *name;
+
+				gst_event_parse_caps(event, &caps);
+				name = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+				watch->kind = g_str_has_prefix(name, "video/") ? "video" :
+						g_str_has_prefix(name, "audio/") ? "audio" : "other";
+				break;
+			}
+			default:
+				break;
+		}
+		return GST_PAD_PROBE_OK;
+	}
+
+	buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	if (watch->segment.format != GST_FORMAT_TIME || !GST_BUFFER_PTS_IS_VALID(buffer))
+		return GST_PAD_PROBE_OK;
+	running_time = gst_segment_to_running_time(&watch->segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+	if (!GST_CLOCK_TIME_IS_VALID(running_time))
+		return GST_PAD_PROBE_OK;
+
+	if (watch->boundary) {
+		GstStructure *s;
+
+		watch->boundary = FALSE;
+		s = gst_structure_new(GAP_MESSAGE,
+				"kind", G_TYPE_STRING, watch->kind ? watch->kind : "other",
+				"timeline", G_TYPE_INT64, GST_CLOCK_DIFF(watch->last_end, running_time),
+				"late", G_TYPE_INT64, lateness(watch, running_time), NULL);
+		gst_element_post_message(watch->sink, gst_message_new_element(GST_OBJECT(watch->sink), s));
+	}
+	watch->last_end = running_time + (GST_BUFFER_DURATION_IS_VALID(buffer) ? GST_BUFFER_DURATION(buffer) : 0);
+	return GST_PAD_PROBE_OK;
+}
+
+/* @brief probe every leaf sink of the pipeline */
+static void watch_sinks(SegmentLoop *loop) {
+	GstIterator *it;
+	GValue item = G_VALUE_INIT;
+	gboolean done = FALSE;
+
+	g_ptr_array_set_size(loop->watches, 0);
+	if (!GST_IS_BIN(loop->pipeline))
+		return;
+
+	it = gst_bin_iterate_recurse(GST_BIN(loop->pipeline));
+	while (!done) {
+		switch (gst_iterator_next(it, &item)) {
+			case GST_ITERATOR_OK: {
+				GstElement *element = g_value_get_object(&item);
+				GstPad *pad;
+
+				if (!GST_IS_BIN(element) && GST_OBJECT_FLAG_IS_SET(element, GST_ELEMENT_FLAG_SINK) &&
+						(pad = gst_element_get_static_pad(element, "sink")) != NULL) {
+					SinkWatch *watch = g_new0(SinkWatch, 1);
+
+					watch->loop = loop;
+					watch->sink = gst_object_ref(element);
+					watch->pad = pad;
+					watch->last_end = GST_CLOCK_TIME_NONE;
+					gst_segment_init(&watch->segment, GST_FORMAT_UNDEFINED);
+					watch->probe_id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+							GST_PAD_PROBE_TYPE_EVENT_FLUSH, (GstPadProbeCallback)probe_cb, watch, NULL);
+					g_ptr_array_add(loop->watches, watch);
+				}
+				g_value_reset(&item);
+				break;
+			}
+			case GST_ITERATOR_RESYNC:
+				g_ptr_array_set_size(loop->watches, 0);
+				gst_iterator_resync(it);
+				break;
+			default:
+				done = TRUE;
+				break;
+		}
+	}
+	g_value_unset(&item);
+	gst_iterator_free(it);
+}
+
+gboolean segment_loop_start(SegmentLoop *loop) {
+	/* sinks are there once prerolled, watch them before the flush resets them */
+	watch_sinks(loop);
+	if (loop->watches->len == 0)
+		g_printerr("Segment loop: no sinks found, gaps won't be measured.\n");
+
+	if (!gst_element_seek(loop->pipeline, 1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_SEGMENT,
+			GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_SET, GST_CLOCK_TIME_NONE)) {
+		g_printerr("Segment loop: segment seek refused.\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+SegmentLoopEvent segment_loop_handle_message(SegmentLoop *loop, GstMessage *msg) {
+	const GstStructure *s;
+
+	switch (GST_MESSAGE_TYPE(msg)) {
+		case GST_MESSAGE_SEGMENT_DONE:
+			if (GST_MESSAGE_SRC(msg) != GST_OBJECT(loop->pipeline))
+				return SEGMENT_LOOP_NONE;
+			/* no flush: the next iteration goes out right behind this one */
+			if (!gst_element_seek(loop->pipeline, 1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_SEGMENT,
+					GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_SET, GST_CLOCK_TIME_NONE))
+				g_printerr("Segment loop: seek back to the start refused.\n");
+			loop->iterations++;
+			return SEGMENT_LOOP_RESTARTED;
+		case GST_MESSAGE_ELEMENT:
+			s = gst_message_get_structure(msg);
+			if (s == NULL || !gst_structure_has_name(s, GAP_MESSAGE)) {
+				return SEGMENT_LOOP_NONE;
+			} else {
+				const gchar *kind = gst_structure_get_string(s, "kind");
+				LatencyStats *stats;
+				gint64 timeline = 0, late = 0;
+
+				gst_structure_get_int64(s, "timeline", &timeline);
+				gst_structure_get_int64(s, "late", &late);
+				loop->last_gap = MAX(MAX(timeline, late), 0);
+				/* kind strings are static in the probe, but the message copies them */
+				loop->last_kind = g_intern_string(kind);
+				stats = g_hash_table_lookup(loop->gaps, loop->last_kind);
+				if (stats == NULL) {
+					stats = latency_stats_new();
+					g_hash_table_insert(loop->gaps, (gpointer)loop->last_kind, stats);
+				}
+				latency_stats_add(stats, loop->last_gap);
+				return SEGMENT_LOOP_GAP;
+			}
+		default:
+			return SEGMENT_LOOP_NONE;
+	}
+}
+
+guint segment_loop_iterations(SegmentLoop *loop) {
+	return loop->iterations;
+}
+
+const gchar *segment_loop_last_gap(SegmentLoop *loop, gint64 *gap) {
+	if (gap != NULL)
+		*gap = loop->last_gap;
+	return loop->last_kind;
+}
+
+gchar *segment_loop_gaps_to_json(SegmentLoop *loop) {
+	GString *json = g_string_new("{");
+	GHashTableIter iter;
+	gpointer kind, stats;
+
+	g_hash_table_iter_init(&iter, loop->gaps);
+	while (g_hash_table_iter_next(&iter, &kind, &stats)) {
+		gchar *stats_json = latency_stats_to_json(stats);
+
+		g_string_append_printf(json, "%s\"%s\":%s", json->len > 1 ? "," : "", (const gchar *)kind, stats_json);
+		g_free(stats_json);
+	}
+	g_string_append_c(json, '}');
+	return g_string_free(json, FALSE);
+}
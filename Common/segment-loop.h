@@ -0,0 +1,51 @@
+#ifndef __SEGMENT_LOOP_H__
+#define __SEGMENT_LOOP_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Gapless looping through segment seeks.
+ *
+ * segment_loop_start() issues one flushing SEGMENT seek to the start. From
+ * then on the pipeline posts SEGMENT_DONE instead of EOS, and
+ * segment_loop_handle_message() answers each one with a non-flushing
+ * SEGMENT seek back to the start. The demuxer queues the next iteration
+ * right behind the last one, and the sinks see one continuous running time:
+ * nothing flushes, nothing prerolls again.
+ *
+ * The gap at every loop boundary is measured on each leaf sink from the
+ * streaming thread and reported back on the bus, so it is handed out by
+ * segment_loop_handle_message() too. The gap is the larger of:
+ *   - the hole in running time between the last buffer of one iteration
+ *     and the first of the next, and
+ *   - how late that first buffer reached the sink against the pipeline
+ *     clock, i.e. the sink had nothing to show.
+ *
+ * A flushing seek from anywhere else ends segment mode; start again.
+ */
+typedef struct _SegmentLoop SegmentLoop;
+
+typedef enum {
+	SEGMENT_LOOP_NONE = 0,	/* not ours, handle it yourself */
+	SEGMENT_LOOP_RESTARTED,	/* SEGMENT_DONE, the next iteration is queued */
+	SEGMENT_LOOP_GAP	/* a boundary was measured, see segment_loop_last_gap() */
+} SegmentLoopEvent;
+
+SegmentLoop *segment_loop_new(GstElement *pipeline);
+void segment_loop_free(SegmentLoop *loop);
+
+/* pipeline prerolled, PAUSED or PLAYING */
+gboolean segment_loop_start(SegmentLoop *loop);
+SegmentLoopEvent segment_loop_handle_message(SegmentLoop *loop, GstMessage *msg);
+
+guint segment_loop_iterations(SegmentLoop *loop);
+/* last boundary: media kind ("video", "audio", ...) and gap in nsec */
+const gchar *segment_loop_last_gap(SegmentLoop *loop, gint64 *gap);
+/* {"video":{latency stats},...} per media kind, free with g_free */
+gchar *segment_loop_gaps_to_json(SegmentLoop *loop);
+
+G_END_DECLS
+
+#endif /* __SEGMENT_LOOP_H__ */
@@ -0,0 +1,160 @@
+#include "startup-profiler.h"
+
+#define STARTUP_PROFILER_ENV "TUTORIAL_STARTUP_PROFILE"
+
+typedef struct _StartupMark {
+	gchar *phase;
+	gint64 time;	/* monotonic, usec */
+} StartupMark;
+
+/* one profiler per process, marks may come from streaming threads */
+static struct {
+	gboolean enabled;
+	gboolean reported;
+	gint64 start;
+	GMutex lock;
+	GArray *marks;	/* StartupMark */
+	GstElement *pipeline;	/* not reffed, only compared against */
+} profiler;
+
+/* first buffer watch on one sink, owned by the sink as object data */
+typedef struct _SinkProbe {
+	gint armed;	/* until the first buffer showed up */
+	gchar *phase;
+} SinkProbe;
+
+static const gchar *probe_key = "startup-profiler-probe";
+
+static void sink_probe_free(SinkProbe *probe) {
+	g_free(probe->phase);
+	g_free(probe);
+}
+
+void startup_profiler_init(void) {
+	if (g_getenv(STARTUP_PROFILER_ENV) == NULL)
+		return;
+
+	profiler.marks = g_array_new(FALSE, FALSE, sizeof(StartupMark));
+	profiler.start = g_get_monotonic_time();
+	profiler.enabled = TRUE;
+}
+
+void startup_profiler_mark(const gchar *phase) {
+	StartupMark mark;
+
+	if (!profiler.enabled)
+		return;
+
+	mark.phase = g_strdup(phase);
+	mark.time = g_get_monotonic_time();
+	g_mutex_lock(&profiler.lock);
+	g_array_append_val(profiler.marks, mark);
+	g_mutex_unlock(&profiler.lock);
+}
+
+/* @brief first buffer at a sink, runs in streaming thread */
+static GstPadProbeReturn first_buffer_cb(GstPad *pad, GstPadProbeInfo *info, SinkProbe *probe) {
+	/* one shot, the probe removes itself */
+	if (g_atomic_int_compare_and_exchange(&probe->armed, TRUE, FALSE))
+		startup_profiler_mark(probe->phase);
+	return GST_PAD_PROBE_REMOVE;
+}
+
+static void probe_sink(GstElement *sink) {
+	SinkProbe *probe;
+	GstPad *pad;
+
+	if (g_object_get_data(G_OBJECT(sink), probe_key) != NULL)
+		return;
+
+	pad = gst_element_get_static_pad(sink, "sink");
+	if (pad == NULL)
+		return;
+
+	probe = g_new(SinkProbe, 1);
+	probe->armed = TRUE;
+	probe->phase = g_strdup_printf("first buffer at %s", GST_ELEMENT_NAME(sink));
+	g_object_set_data_full(G_OBJECT(sink), probe_key, probe, (GDestroyNotify)sink_probe_free);
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+			(GstPadProbeCallback)first_buffer_cb, probe, NULL);
+	gst_object_unref(pad);
+}
+
+/* @brief sync-message, sees every message as it is posted, from the posting thread */
+static void sync_message_cb(GstBus *bus, GstMessage *msg, gpointer user_data) {
+	GstObject *src = GST_MESSAGE_SRC(msg);
+
+	switch (GST_MESSAGE_TYPE(msg)) {
+		case GST_MESSAGE_STATE_CHANGED: {
+			GstState old_state, new_state;
+
+			gst_message_parse_state_changed(msg, &old_state, &new_state, NULL);
+			if (src == GST_OBJECT(profiler.pipeline)) {
+				gchar *phase = g_strdup_printf("pipeline %s -> %s",
+						gst_element_state_get_name(old_state), gst_element_state_get_name(new_state));
+				startup_profiler_mark(phase);
+				g_free(phase);
+
+				if (new_state == GST_STATE_PLAYING)
+					startup_profiler_report();
+			} else if (GST_IS_ELEMENT(src) && !GST_IS_BIN(src) &&
+					GST_OBJECT_FLAG_IS_SET(src, GST_ELEMENT_FLAG_SINK) && new_state == GST_STATE_READY) {
+				/* sinks may be autoplugged late, catch them as they come up */
+				probe_sink(GST_ELEMENT(src));
+			}
+			break;
+		}
+		case GST_MESSAGE_ASYNC_DONE:
+			if (src == GST_OBJECT(profiler.pipeline))
+				startup_profiler_mark("preroll done");
+			break;
+		default:
+			break;
+	}
+}
+
+void startup_profiler_watch(GstElement *pipeline) {
+	GstBus *bus;
+
+	if (!profiler.enabled)
+		return;
+
+	profiler.pipeline = pipeline;
+	bus = gst_element_get_bus(pipeline);
+	/* the signal, not gst_bus_set_sync_handler(), leaves the bus's one sync handler to the app */
+	gst_bus_enable_sync_message_emission(bus);
+	g_signal_connect(bus, "sync-message", G_CALLBACK(sync_message_cb), NULL);
+	gst_object_unref(bus);
+}
+
+static gint compare_marks(gconstpointer a, gconstpointer b) {
+	gint64 x = ((const StartupMark *)a)->time, y = ((const StartupMark *)b)->time;
+	return (x > y) - (x < y);
+}
+
+void startup_profiler_report(void) {
+	gint64 prev;
+	guint i;
+
+	if (!profiler.enabled)
+		return;
+
+	g_mutex_lock(&profiler.lock);
+	if (profiler.reported) {
+		g_mutex_unlock(&profiler.lock);
+		return;
+	}
+	profiler.reported = TRUE;
+
+	g_array_sort(profiler.marks, compare_marks);
+	g_print("Startup profile (ms since start, delta to previous phase):\n");
+	prev = profiler.start;
+	for (i = 0; i < profiler.marks->len; i++) {
+		StartupMark *mark = &g_array_index(profiler.marks, StartupMark, i);
+
+		g_print("  %9.3f  %+9.3f  %s\n", (mark->time - profiler.start) / 1000.0,
+				(mark->time - prev) / 1000.0, mark->phase);
+		prev = mark->time;
+	}
+	g_mutex_unlock(&profiler.lock);
+}
@@ -0,0 +1,29 @@
+#ifndef __STARTUP_PROFILER_H__
+#define __STARTUP_PROFILER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Time-to-first-frame profiler.
+ *
+ * Call startup_profiler_init() first thing in main(); it is a no-op unless
+ * TUTORIAL_STARTUP_PROFILE is set in the environment, so the other calls can
+ * stay in the code unconditionally. startup_profiler_mark() timestamps named
+ * phases (gst_init, element creation, ...), startup_profiler_watch() adds the
+ * pipeline's state transitions, preroll and the first buffer reaching each
+ * sink. The phase breakdown is printed once the pipeline first reaches
+ * PLAYING, or on startup_profiler_report().
+ *
+ * watch() listens to the bus's "sync-message" signal, any sync handler the
+ * application installs still gets every message.
+ */
+void startup_profiler_init(void);
+void startup_profiler_mark(const gchar *phase);
+void startup_profiler_watch(GstElement *pipeline);
+void startup_profiler_report(void);
+
+G_END_DECLS
+
+#endif /* __STARTUP_PROFILER_H__ */
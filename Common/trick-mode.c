@@ -0,0 +1,123 @@
+#include "trick-mode.h"
+
+struct _TrickMode {
+	GstElement *pipeline;
+	gdouble key_units_rate;
+	gdouble rate;
+
+	guint64 seeks;
+	guint64 instant_seeks;
+};
+
+TrickMode *trick_mode_new(GstElement *pipeline, gdouble key_units_rate) {
+	TrickMode *trick = g_new0(TrickMode, 1);
+
+	trick->pipeline = gst_object_ref(pipeline);
+	trick->key_units_rate = key_units_rate > 0 ? key_units_rate : TRICK_MODE_KEY_UNITS_RATE;
+	trick->rate = 1.0;
+	return trick;
+}
+
+void trick_mode_free(TrickMode *trick) {
+	if (trick == NULL)
+		return;
+	gst_object_unref(trick->pipeline);
+	g_free(trick);
+}
+
+GstSeekFlags trick_mode_get_flags(TrickMode *trick, gdouble rate) {
+	GstSeekFlags flags = GST_SEEK_FLAG_NONE;
+
+	if (rate == 1.0)
+		return flags;
+
+	/* reverse audio is rarely supported and fast audio is noise, slow motion keeps it */
+	if (rate < 0 || rate > 1.0)
+		flags |= GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_TRICKMODE_NO_AUDIO;
+	if (ABS(rate) >= trick->key_units_rate)
+		flags |= GST_SEEK_FLAG_TRICKMODE_KEY_UNITS;
+	return flags;
+}
+
+#if GST_CHECK_VERSION(1, 18, 0)
+/* @brief new rate from the running position on, nothing is flushed */
+static gboolean instant_rate_change(TrickMode *trick, gdouble rate) {
+	/* same direction and flags only, the segment itself stays */
+	if ((rate < 0) != (trick->rate < 0) || trick_mode_get_flags(trick, rate) != trick_mode_get_flags(trick, trick->rate))
+		return FALSE;
+
+	/* the demuxer turns it into a multiplier on the running segment */
+	return gst_element_seek(trick->pipeline, rate, GST_FORMAT_TIME,
+			GST_SEEK_FLAG_INSTANT_RATE_CHANGE | trick_mode_get_flags(trick, rate),
+			GST_SEEK_TYPE_NONE, 0, GST_SEEK_TYPE_NONE, 0);
+}
+#endif
+
+/* @brief flushing seek at rate: from position to the end, or from position back to the start */
+static gboolean rate_seek(TrickMode *trick, gdouble rate, gint64 position) {
+	GstSeekFlags flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE | trick_mode_get_flags(trick, rate);
+	gboolean ok;
+
+	if (rate > 0)
+		ok = gst_element_seek(trick->pipeline, rate, GST_FORMAT_TIME, flags,
+				GST_SEEK_TYPE_SET, position, GST_SEEK_TYPE_SET, GST_CLOCK_TIME_NONE);
+	else
+		ok = gst_element_seek(trick->pipeline, rate, GST_FORMAT_TIME, flags,
+				GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_SET, position);
+	if (ok)
+		trick->seeks++;
+	return ok;
+}
+
+gboolean trick_mode_set_rate(TrickMode *trick, gdouble rate, gboolean *flushed) {
+	gint64 position;
+
+	g_return_val_if_fail(rate != 0.0, FALSE);
+	if (flushed != NULL)
+		*flushed = FALSE;
+	if (rate == trick->rate)
+		return TRUE;
+
+#if GST_CHECK_VERSION(1, 18, 0)
+	if (instant_rate_change(trick, rate)) {
+		trick->rate = rate;
+		trick->seeks++;
+		trick->instant_seeks++;
+		return TRUE;
+	}
+#endif
+
+	if (!gst_element_query_position(trick->pipeline, GST_FORMAT_TIME, &position)) {
+		g_printerr("Could not query position for the rate change.\n");
+		return FALSE;
+	}
+
+	if (!rate_seek(trick, rate, position)) {
+		g_printerr("Rate change to %gx refused.\n", rate);
+		return FALSE;
+	}
+	trick->rate = rate;
+	if (flushed != NULL)
+		*flushed = TRUE;
+	return TRUE;
+}
+
+gdouble trick_mode_get_rate(TrickMode *trick) {
+	return trick->rate;
+}
+
+gboolean trick_mode_seek(TrickMode *trick, gint64 position) {
+	return rate_seek(trick, trick->rate, position);
+}
+
+gboolean trick_mode_is_key_units(TrickMode *trick) {
+	return (trick_mode_get_flags(trick, trick->rate) & GST_SEEK_FLAG_TRICKMODE_KEY_UNITS) != 0;
+}
+
+guint64 trick_mode_seeks(TrickMode *trick) {
+	return trick->seeks;
+}
+
+guint64 trick_mode_instant_seeks(TrickMode *trick) {
+	return trick->instant_seeks;
+}
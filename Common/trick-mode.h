@@ -0,0 +1,54 @@
+#ifndef __TRICK_MODE_H__
+#define __TRICK_MODE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Fast forward, slow motion and reverse playback through rate-changing
+ * seeks.
+ *
+ * trick_mode_set_rate() restarts the segment at the current position with
+ * the new rate: forward to the end of the stream, or backwards to its
+ * start. Fast forward and reverse leave the audio out, slow motion keeps
+ * it. From key_units_rate up, in either direction, the seek also asks for
+ * keyframes only. Decoders then skip every frame in between, so the decode
+ * cost follows the file's keyframe interval instead of growing with the
+ * rate.
+ *
+ * trick_mode_seek() is a flushing seek that keeps the current rate.
+ *
+ * A rate change that keeps the direction and the seek flags is tried as
+ * an instant rate change first, which needs no flush (GStreamer >= 1.18).
+ */
+#define TRICK_MODE_KEY_UNITS_RATE 4.0
+
+typedef struct _TrickMode TrickMode;
+
+/* key_units_rate <= 0 picks TRICK_MODE_KEY_UNITS_RATE */
+TrickMode *trick_mode_new(GstElement *pipeline, gdouble key_units_rate);
+void trick_mode_free(TrickMode *trick);
+
+/*
+ * rate must not be 0
+ * @return FALSE if refused; flushed, if not NULL, tells whether a flushing
+ *         seek went out, the only case with a new preroll and ASYNC_DONE
+ */
+gboolean trick_mode_set_rate(TrickMode *trick, gdouble rate, gboolean *flushed);
+gdouble trick_mode_get_rate(TrickMode *trick);
+/* to position, keeping rate and direction */
+gboolean trick_mode_seek(TrickMode *trick, gint64 position);
+/* keyframes only at the current rate */
+gboolean trick_mode_is_key_units(TrickMode *trick);
+
+/* seek flags used for rate, without the flush */
+GstSeekFlags trick_mode_get_flags(TrickMode *trick, gdouble rate);
+
+/* seeks issued, and how many of them were instant rate changes */
+guint64 trick_mode_seeks(TrickMode *trick);
+guint64 trick_mode_instant_seeks(TrickMode *trick);
+
+G_END_DECLS
+
+#endif /* __TRICK_MODE_H__ */
@@ -0,0 +1,640 @@
+#include <math.h>
+#include <string.h>
+#include <gst/audio/audio.h>
+
+#include "gstfastaudioconvert.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(gst_fast_audio_convert_debug);
+#define GST_CAT_DEFAULT gst_fast_audio_convert_debug
+
+#define MAX_CHANNELS GST_FAST_AUDIO_CONVERT_MAX_CHANNELS
+#define CHUNK GST_FAST_AUDIO_CONVERT_CHUNK
+
+/* largest float below 2^31, the S32 clamp */
+#define S32_MAX_FLOAT 2147483520.0f
+
+enum {
+	PROP_0,
+	PROP_SIMD
+};
+
+#define FORMATS "{ " GST_AUDIO_NE(S16) ", " GST_AUDIO_NE(S32) ", " GST_AUDIO_NE(F32) " }"
+#define FORMATS_CAPS \
+	"audio/x-raw, format=(string)" FORMATS ", rate=(int)[1, MAX], channels=(int)[1, 8], layout=(string)interleaved"
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink",
+		GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS(FORMATS_CAPS));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src",
+		GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS(FORMATS_CAPS));
+
+/* layouts assumed when caps carry no channel-mask */
+static const GstAudioChannelPosition default_positions[MAX_CHANNELS][MAX_CHANNELS] = {
+	{ GST_AUDIO_CHANNEL_POSITION_MONO },
+	{ GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT, GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT },
+	{ GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT, GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT,
+		GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER },
+	{ GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT, GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT,
+		GST_AUDIO_CHANNEL_POSITION_REAR_LEFT, GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT },
+	{ GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT, GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT,
+		GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER, GST_AUDIO_CHANNEL_POSITION_REAR_LEFT,
+		GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT },
+	{ GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT, GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT,
+		GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER, GST_AUDIO_CHANNEL_POSITION_LFE1,
+		GST_AUDIO_CHANNEL_POSITION_REAR_LEFT, GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT },
+	{ GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT, GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT,
+		GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER, GST_AUDIO_CHANNEL_POSITION_LFE1,
+		GST_AUDIO_CHANNEL_POSITION_REAR_LEFT, GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT,
+		GST_AUDIO_CHANNEL_POSITION_REAR_CENTER },
+	{ GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT, GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT,
+		GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER, GST_AUDIO_CHANNEL_POSITION_LFE1,
+		GST_AUDIO_CHANNEL_POSITION_REAR_LEFT, GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT,
+		GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT, GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT },
+};
+
+const GstAudioChannelPosition *gst_fast_audio_convert_default_positions(gint channels) {
+	g_return_val_if_fail(channels >= 1 && channels <= MAX_CHANNELS, NULL);
+	return default_positions[channels - 1];
+}
+
+/* Kernels */
+
+/* n samples to F32 */
+typedef void (*UnpackFunc)(gfloat *dst, const guint8 *src, gint n);
+/* n F32 samples to the output format, clamped */
+typedef void (*PackFunc)(guint8 *dst, const gfloat *src, gint n);
+/* frames of in_channels to frames of out_channels */
+typedef void (*MixFunc)(gfloat *dst, const gfloat *src, gint frames, gint in_channels, gint out_channels,
+		const gfloat (*matrix)[MAX_CHANNELS]);
+
+/*
+ * The SIMD kernels do the same float operations in the same order and round
+ * like lrintf, so all instruction sets produce identical samples.
+ */
+static void s16_to_f32_c(gfloat *dst, const guint8 *src, gint n) {
+	const gint16 *s = (const gint16 *)src;
+	gint i;
+
+	for (i = 0; i < n; i++)
+		dst[i] = (gfloat)s[i] * (1.0f / 32768.0f);
+}
+
+static void s32_to_f32_c(gfloat *dst, const guint8 *src, gint n) {
+	const gint32 *s = (const gint32 *)src;
+	gint i;
+
+	for (i = 0; i < n; i++)
+		dst[i] = (gfloat)s[i] * (1.0f / 2147483648.0f);
+}
+
+static void f32_to_s16_c(guint8 *dst, const gfloat *src, gint n) {
+	gint16 *d = (gint16 *)dst;
+	gint i;
+
+	for (i = 0; i < n; i++)
+		d[i] = (gint16)lrintf(CLAMP(src[i] * 32768.0f, -32768.0f, 32767.0f));
+}
+
+static void f32_to_s32_c(guint8 *dst, const gfloat *src, gint n) {
+	gint32 *d = (gint32 *)dst;
+	gint i;
+
+	for (i = 0; i < n; i++)
+		d[i] = (gint32)lrintf(CLAMP(src[i] * 2147483648.0f, -2147483648.0f, S32_MAX_FLOAT));
+}
+
+static void mix_c(gfloat *dst, const gfloat *src, gint frames, gint in_channels, gint out_channels,
+		const gfloat (*matrix)[MAX_CHANNELS]) {
+	gint f, i, o;
+
+	for (f = 0; f < frames; f++) {
+		const gfloat *in = src + f * in_channels;
+
+		for (o = 0; o < out_channels; o++) {
+			gfloat acc = 0.0f;
+
+			for (i = 0; i < in_channels; i++)
+				acc += in[i] * matrix[o][i];
+			dst[f * out_channels + o] = acc;
+		}
+	}
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET("sse2") static void s16_to_f32_sse2(gfloat *dst, const guint8 *src, gint n) {
+	const gint16 *s = (const gint16 *)src;
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	gint i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+		/* sign extend: the sample lands in the high half, shift it down */
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+	s16_to_f32_c(dst + i, (const guint8 *)(s + i), n - i);
+}
+
+SIMD_TARGET("sse2") static void s32_to_f32_sse2(gfloat *dst, const guint8 *src, gint n) {
+	const gint32 *s = (const gint32 *)src;
+	const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+	gint i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(s + i))), scale));
+	s32_to_f32_c(dst + i, (const guint8 *)(s + i), n - i);
+}
+
+SIMD_TARGET("sse2") static void f32_to_s16_sse2(guint8 *dst, const gfloat *src, gint n) {
+	gint16 *d = (gint16 *)dst;
+	const __m128 scale = _mm_set1_ps(32768.0f), lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f);
+	gint i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m128i a = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi));
+		__m128i b = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lo), hi));
+
+		_mm_storeu_si128((__m128i *)(d + i), _mm_packs_epi32(a, b));
+	}
+	f32_to_s16_c((guint8 *)(d + i), src + i, n - i);
+}
+
+SIMD_TARGET("sse2") static void f32_to_s32_sse2(guint8 *dst, const gfloat *src, gint n) {
+	gint32 *d = (gint32 *)dst;
+	const __m128 scale = _mm_set1_ps(2147483648.0f), lo = _mm_set1_ps(-2147483648.0f), hi = _mm_set1_ps(S32_MAX_FLOAT);
+	gint i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+		_mm_storeu_si128((__m128i *)(d + i),
+				_mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi)));
+	f32_to_s32_c((guint8 *)(d + i), src + i, n - i);
+}
+
+/* @brief 4 frames at a time into mono or stereo, other layouts in C */
+SIMD_TARGET("sse2") static void mix_sse2(gfloat *dst, const gfloat *src, gint frames, gint in_channels, gint out_channels,
+		const gfloat (*matrix)[MAX_CHANNELS]) {
+	gint f = 0, i;
+
+	if (out_channels <= 2) {
+		for (; f + 4 <= frames; f += 4) {
+			const gfloat *s = src + f * in_channels;
+			__m128 l = _mm_setzero_ps(), r = _mm_setzero_ps();
+
+			for (i = 0; i < in_channels; i++) {
+				/* channel i of the 4 frames */
+				__m128 x = _mm_set_ps(s[3 * in_channels + i], s[2 * in_channels + i], s[in_channels + i], s[i]);
+
+				l = _mm_add_ps(l, _mm_mul_ps(x, _mm_set1_ps(matrix[0][i])));
+				if (out_channels == 2)
+					r = _mm_add_ps(r, _mm_mul_ps(x, _mm_set1_ps(matrix[1][i])));
+			}
+			if (out_channels == 2) {
+				_mm_storeu_ps(dst + f * 2, _mm_unpacklo_ps(l, r));
+				_mm_storeu_ps(dst + f * 2 + 4, _mm_unpackhi_ps(l, r));
+			} else {
+				_mm_storeu_ps(dst + f, l);
+			}
+		}
+	}
+	mix_c(dst + f * out_channels, src + f * in_channels, frames - f, in_channels, out_channels, matrix);
+}
+
+SIMD_TARGET("avx2") static void s16_to_f32_avx2(gfloat *dst, const guint8 *src, gint n) {
+	const gint16 *s = (const gint16 *)src;
+	const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+	gint i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(s + i)));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(s + i + 8)));
+
+		_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+		_mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+	}
+	s16_to_f32_sse2(dst + i, (const guint8 *)(s + i), n - i);
+}
+
+SIMD_TARGET("avx2") static void s32_to_f32_avx2(gfloat *dst, const guint8 *src, gint n) {
+	const gint32 *s = (const gint32 *)src;
+	const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+	gint i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(s + i))), scale));
+	s32_to_f32_sse2(dst + i, (const guint8 *)(s + i), n - i);
+}
+
+SIMD_TARGET("avx2") static void f32_to_s16_avx2(guint8 *dst, const gfloat *src, gint n) {
+	gint16 *d = (gint16 *)dst;
+	const __m256 scale = _mm256_set1_ps(32768.0f), lo = _mm256_set1_ps(-32768.0f), hi = _mm256_set1_ps(32767.0f);
+	gint i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m256i a = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lo), hi));
+		__m256i b = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), lo), hi));
+
+		/* the pack works per 128 bit lane, 0xd8 restores sample order */
+		_mm256_storeu_si256((__m256i *)(d + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8));
+	}
+	f32_to_s16_sse2((guint8 *)(d + i), src + i, n - i);
+}
+
+SIMD_TARGET("avx2") static void f32_to_s32_avx2(guint8 *dst, const gfloat *src, gint n) {
+	gint32 *d = (gint32 *)dst;
+	const __m256 scale = _mm256_set1_ps(2147483648.0f), lo = _mm256_set1_ps(-2147483648.0f);
+	const __m256 hi = _mm256_set1_ps(S32_MAX_FLOAT);
+	gint i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+		_mm256_storeu_si256((__m256i *)(d + i),
+				_mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lo), hi)));
+	f32_to_s32_sse2((guint8 *)(d + i), src + i, n - i);
+}
+
+/* @brief 8 frames at a time into mono or stereo, channels gathered across frames */
+SIMD_TARGET("avx2") static void mix_avx2(gfloat *dst, const gfloat *src, gint frames, gint in_channels, gint out_channels,
+		const gfloat (*matrix)[MAX_CHANNELS]) {
+	gint f = 0, i;
+
+	if (out_channels <= 2) {
+		const __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(in_channels));
+
+		for (; f + 8 <= frames; f += 8) {
+			const gfloat *s = src + f * in_channels;
+			__m256 l = _mm256_setzero_ps(), r = _mm256_setzero_ps();
+
+			for (i = 0; i < in_channels; i++) {
+				__m256 x = _mm256_i32gather_ps(s + i, index, 4);
+
+				l = _mm256_add_ps(l, _mm256_mul_ps(x, _mm256_set1_ps(matrix[0][i])));
+				if (out_channels == 2)
+					r = _mm256_add_ps(r, _mm256_mul_ps(x, _mm256_set1_ps(matrix[1][i])));
+			}
+			if (out_channels == 2) {
+				__m256 lo = _mm256_unpacklo_ps(l, r), hi = _mm256_unpackhi_ps(l, r);
+
+				_mm256_storeu_ps(dst + f * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+				_mm256_storeu_ps(dst + f * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+			} else {
+				_mm256_storeu_ps(dst + f, l);
+			}
+		}
+	}
+	mix_sse2(dst + f * out_channels, src + f * in_channels, frames - f, in_channels, out_channels, matrix);
+}
+
+#endif /* SIMD_X86 */
+
+typedef struct {
+	SimdLevel level;
+	UnpackFunc unpack[2];	/* S16, S32 */
+	PackFunc pack[2];
+	MixFunc mix;
+} Kernels;
+
+static const Kernels kernels_c = { SIMD_NONE, { s16_to_f32_c, s32_to_f32_c }, { f32_to_s16_c, f32_to_s32_c }, mix_c };
+#ifdef SIMD_X86
+static const Kernels kernels_sse2 = {
+	SIMD_SSE2, { s16_to_f32_sse2, s32_to_f32_sse2 }, { f32_to_s16_sse2, f32_to_s32_sse2 }, mix_sse2
+};
+static const Kernels kernels_avx2 = {
+	SIMD_AVX2, { s16_to_f32_avx2, s32_to_f32_avx2 }, { f32_to_s16_avx2, f32_to_s32_avx2 }, mix_avx2
+};
+#endif
+
+static const Kernels *select_kernels(SimdLevel requested) {
+#ifdef SIMD_X86
+	SimdLevel level = simd_resolve(requested);
+
+	if (level >= SIMD_AVX2)
+		return &kernels_avx2;
+	if (level >= SIMD_SSE2)
+		return &kernels_sse2;
+#endif
+	return &kernels_c;
+}
+
+/* Downmix */
+
+/* @brief where one input channel goes in a stereo mix */
+static void stereo_gains(GstAudioChannelPosition position, gfloat *left, gfloat *right) {
+	*left = *right = 0.0f;
+	switch (position) {
+		case GST_AUDIO_CHANNEL_POSITION_MONO:
+			*left = *right = 1.0f;
+			break;
+		case GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT:
+		case GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT_OF_CENTER:
+			*left = 1.0f;
+			break;
+		case GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT:
+		case GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT_OF_CENTER:
+			*right = 1.0f;
+			break;
+		case GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER:
+			*left = *right = (gfloat)M_SQRT1_2;
+			break;
+		case GST_AUDIO_CHANNEL_POSITION_REAR_LEFT:
+		case GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT:
+			*left = (gfloat)M_SQRT1_2;
+			break;
+		case GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT:
+		case GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT:
+			*right = (gfloat)M_SQRT1_2;
+			break;
+		case GST_AUDIO_CHANNEL_POSITION_REAR_CENTER:
+			*left = *right = 0.5f;
+			break;
+		default:
+			/* LFE and anything unknown is dropped */
+			break;
+	}
+}
+
+static void build_matrix(GstFastAudioConvert *convert, const GstAudioChannelPosition *positions) {
+	gfloat peak = 0.0f;
+	gint i, o;
+
+	memset(convert->matrix, 0, sizeof(convert->matrix));
+	for (i = 0; i < convert->in_channels; i++) {
+		gfloat left, right;
+
+		stereo_gains(positions[i], &left, &right);
+		if (convert->out_channels == 2) {
+			convert->matrix[0][i] = left;
+			convert->matrix[1][i] = right;
+		} else {
+			convert->matrix[0][i] = (left + right) / 2;
+		}
+	}
+
+	/* scale so no output channel can exceed full scale */
+	for (o = 0; o < convert->out_channels; o++) {
+		gfloat sum = 0.0f;
+
+		for (i = 0; i < convert->in_channels; i++)
+			sum += convert->matrix[o][i];
+		peak = MAX(peak, sum);
+	}
+	if (peak > 1.0f) {
+		for (o = 0; o < convert->out_channels; o++) {
+			for (i = 0; i < convert->in_channels; i++)
+				convert->matrix[o][i] /= peak;
+		}
+	}
+}
+
+/* Element */
+
+#define gst_fast_audio_convert_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE(GstFastAudioConvert, gst_fast_audio_convert, GST_TYPE_BASE_TRANSFORM,
+		GST_DEBUG_CATEGORY_INIT(gst_fast_audio_convert_debug, "fastaudioconvert", 0, "fastaudioconvert element"));
+
+static void gst_fast_audio_convert_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec) {
+	GstFastAudioConvert *convert = GST_FAST_AUDIO_CONVERT(object);
+
+	switch (prop_id) {
+		case PROP_SIMD:
+			GST_OBJECT_LOCK(convert);
+			convert->simd = g_value_get_enum(value);
+			GST_OBJECT_UNLOCK(convert);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+static void gst_fast_audio_convert_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+	GstFastAudioConvert *convert = GST_FAST_AUDIO_CONVERT(object);
+
+	switch (prop_id) {
+		case PROP_SIMD:
+			GST_OBJECT_LOCK(convert);
+			g_value_set_enum(value, convert->simd);
+			GST_OBJECT_UNLOCK(convert);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+/*
+ * @brief from with all three formats and a channel count or range
+ *        keep_mask carries the layout over when the count is unchanged.
+ */
+static GstCaps *other_formats(const GstStructure *from, gint min_channels, gint max_channels, gboolean keep_mask) {
+	GstStructure *structure = gst_structure_copy(from);
+	GstCaps *formats = gst_caps_from_string("audio/x-raw, format=(string)" FORMATS);
+
+	gst_structure_set_value(structure, "format", gst_structure_get_value(gst_caps_get_structure(formats, 0), "format"));
+	gst_caps_unref(formats);
+	if (min_channels == max_channels)
+		gst_structure_set(structure, "channels", G_TYPE_INT, min_channels, NULL);
+	else
+		gst_structure_set(structure, "channels", GST_TYPE_INT_RANGE, min_channels, max_channels, NULL);
+	if (!keep_mask)
+		gst_structure_remove_field(structure, "channel-mask");
+	return gst_caps_new_full(structure, NULL);
+}
+
+/*
+ * @brief same caps first, so passthrough wins when both sides can do it,
+ *        then every format with the same layout, stereo or mono downstream
+ *        and any layout upstream of stereo or mono
+ */
+static GstCaps *gst_fast_audio_convert_transform_caps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps,
+		GstCaps *filter) {
+	GstCaps *result = gst_caps_new_empty();
+	guint i;
+
+	for (i = 0; i < gst_caps_get_size(caps); i++) {
+		GstStructure *structure = gst_caps_get_structure(caps, i);
+		gint channels = 0;
+
+		result = gst_caps_merge_structure(result, gst_structure_copy(structure));
+		gst_structure_get_int(structure, "channels", &channels);
+		if (channels > 2) {
+			result = gst_caps_merge(result, other_formats(structure, channels, channels, TRUE));
+			if (direction == GST_PAD_SINK)
+				result = gst_caps_merge(result, other_formats(structure, 1, 2, FALSE));
+		} else if (channels > 0 && direction == GST_PAD_SINK) {
+			result = gst_caps_merge(result, other_formats(structure, 1, 2, FALSE));
+		} else {
+			result = gst_caps_merge(result, other_formats(structure, 1, MAX_CHANNELS, FALSE));
+		}
+	}
+	if (filter != NULL) {
+		GstCaps *intersection = gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+
+		gst_caps_unref(result);
+		result = intersection;
+	}
+	GST_LOG_OBJECT(trans, "%" GST_PTR_FORMAT " -> %" GST_PTR_FORMAT, caps, result);
+	return result;
+}
+
+static gboolean parse_caps(GstCaps *caps, GstAudioInfo *info, GstFastAudioFormat *format) {
+	if (!gst_audio_info_from_caps(info, caps) || GST_AUDIO_INFO_CHANNELS(info) > MAX_CHANNELS ||
+			GST_AUDIO_INFO_LAYOUT(info) != GST_AUDIO_LAYOUT_INTERLEAVED)
+		return FALSE;
+
+	switch (GST_AUDIO_INFO_FORMAT(info)) {
+		case GST_AUDIO_NE(S16):
+			*format = GST_FAST_AUDIO_S16;
+			return TRUE;
+		case GST_AUDIO_NE(S32):
+			*format = GST_FAST_AUDIO_S32;
+			return TRUE;
+		case GST_AUDIO_NE(F32):
+			*format = GST_FAST_AUDIO_F32;
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+static gboolean gst_fast_audio_convert_set_caps(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps) {
+	GstFastAudioConvert *convert = GST_FAST_AUDIO_CONVERT(trans);
+	GstFastAudioFormat in_format, out_format;
+	GstAudioInfo in_info, out_info;
+	gint in_channels, out_channels;
+
+	if (!parse_caps(incaps, &in_info, &in_format) || !parse_caps(outcaps, &out_info, &out_format))
+		return FALSE;
+	in_channels = GST_AUDIO_INFO_CHANNELS(&in_info);
+	out_channels = GST_AUDIO_INFO_CHANNELS(&out_info);
+	if (GST_AUDIO_INFO_RATE(&in_info) != GST_AUDIO_INFO_RATE(&out_info) ||
+			(out_channels != in_channels && out_channels > 2)) {
+		GST_DEBUG_OBJECT(convert, "unsupported: %" GST_PTR_FORMAT " -> %" GST_PTR_FORMAT, incaps, outcaps);
+		return FALSE;
+	}
+
+	convert->in_format = in_format;
+	convert->out_format = out_format;
+	convert->in_channels = in_channels;
+	convert->out_channels = out_channels;
+	convert->mix = in_channels != out_channels;
+	if (convert->mix) {
+		build_matrix(convert, GST_AUDIO_INFO_IS_UNPOSITIONED(&in_info) ?
+				default_positions[in_channels - 1] : in_info.position);
+	}
+	gst_base_transform_set_passthrough(trans, !convert->mix && in_format == out_format);
+
+	GST_DEBUG_OBJECT(convert, "format %d -> %d, %d -> %d channels", in_format, out_format, in_channels, out_channels);
+	return TRUE;
+}
+
+static gboolean gst_fast_audio_convert_get_unit_size(GstBaseTransform *trans, GstCaps *caps, gsize *size) {
+	GstAudioInfo info;
+
+	if (!gst_audio_info_from_caps(&info, caps))
+		return FALSE;
+	*size = GST_AUDIO_INFO_BPF(&info);
+	return TRUE;
+}
+
+static gint sample_size(GstFastAudioFormat format) {
+	return format == GST_FAST_AUDIO_S16 ? 2 : 4;
+}
+
+/*
+ * @brief unpack -> mix -> pack, a chunk at a time
+ *        F32 skips its unpack or pack, the mix writes straight into F32 output.
+ */
+static GstFlowReturn gst_fast_audio_convert_transform(GstBaseTransform *trans, GstBuffer *inbuf, GstBuffer *outbuf) {
+	GstFastAudioConvert *convert = GST_FAST_AUDIO_CONVERT(trans);
+	gint in_frame = sample_size(convert->in_format) * convert->in_channels;
+	gint out_frame = sample_size(convert->out_format) * convert->out_channels;
+	const Kernels *kernels;
+	GstMapInfo in_map, out_map;
+	SimdLevel simd;
+	gint frames, done, n;
+
+	GST_OBJECT_LOCK(convert);
+	simd = convert->simd;
+	GST_OBJECT_UNLOCK(convert);
+	kernels = select_kernels(simd);
+
+	if (!gst_buffer_map(inbuf, &in_map, GST_MAP_READ))
+		goto map_failed;
+	if (!gst_buffer_map(outbuf, &out_map, GST_MAP_WRITE)) {
+		gst_buffer_unmap(inbuf, &in_map);
+		goto map_failed;
+	}
+	frames = MIN(in_map.size / in_frame, out_map.size / out_frame);
+
+	for (done = 0; done < frames; done += n) {
+		const guint8 *in = in_map.data + done * in_frame;
+		guint8 *out = out_map.data + done * out_frame;
+		const gfloat *samples;
+
+		n = MIN(frames - done, CHUNK);
+		if (convert->in_format == GST_FAST_AUDIO_F32) {
+			samples = (const gfloat *)in;
+		} else {
+			/* no mix into F32: unpacking is all there is to do */
+			gfloat *unpacked = !convert->mix && convert->out_format == GST_FAST_AUDIO_F32 ? (gfloat *)out : convert->unpacked;
+
+			kernels->unpack[convert->in_format](unpacked, in, n * convert->in_channels);
+			samples = unpacked;
+		}
+		if (convert->mix) {
+			gfloat *mixed = convert->out_format == GST_FAST_AUDIO_F32 ? (gfloat *)out : convert->mixed;
+
+			kernels->mix(mixed, samples, n, convert->in_channels, convert->out_channels,
+					(const gfloat (*)[MAX_CHANNELS])convert->matrix);
+			samples = mixed;
+		}
+		if (convert->out_format != GST_FAST_AUDIO_F32)
+			kernels->pack[convert->out_format](out, samples, n * convert->out_channels);
+	}
+	gst_buffer_unmap(outbuf, &out_map);
+	gst_buffer_unmap(inbuf, &in_map);
+	return GST_FLOW_OK;
+
+map_failed:
+	GST_ELEMENT_ERROR(convert, STREAM, FAILED, (NULL), ("Could not map buffers"));
+	return GST_FLOW_ERROR;
+}
+
+static void gst_fast_audio_convert_class_init(GstFastAudioConvertClass *klass) {
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+	gobject_class->set_property = gst_fast_audio_convert_set_property;
+	gobject_class->get_property = gst_fast_audio_convert_get_property;
+
+	g_object_class_install_property(gobject_class, PROP_SIMD,
+			g_param_spec_enum("simd", "SIMD", "Instruction set of the conversion kernels",
+				SIMD_TYPE_LEVEL, SIMD_AUTO, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	gst_element_class_set_static_metadata(element_class, "Fast audio converter", "Filter/Converter/Audio",
+			"Converts S16/S32/F32 samples and mixes down to stereo or mono, mono up to stereo, with SIMD kernels", "GStreamer tutorials");
+	gst_element_class_add_static_pad_template(element_class, &sink_template);
+	gst_element_class_add_static_pad_template(element_class, &src_template);
+
+	trans_class->transform_caps = GST_DEBUG_FUNCPTR(gst_fast_audio_convert_transform_caps);
+	trans_class->set_caps = GST_DEBUG_FUNCPTR(gst_fast_audio_convert_set_caps);
+	trans_class->get_unit_size = GST_DEBUG_FUNCPTR(gst_fast_audio_convert_get_unit_size);
+	trans_class->transform = GST_DEBUG_FUNCPTR(gst_fast_audio_convert_transform);
+	trans_class->passthrough_on_same_caps = TRUE;
+}
+
+static void gst_fast_audio_convert_init(GstFastAudioConvert *convert) {
+	convert->simd = SIMD_AUTO;
+}
+
+gboolean gst_fast_audio_convert_register(guint rank) {
+	return gst_element_register(NULL, "fastaudioconvert", rank, GST_TYPE_FAST_AUDIO_CONVERT);
+}
@@ -0,0 +1,80 @@
+#ifndef __GST_FAST_AUDIO_CONVERT_H__
+#define __GST_FAST_AUDIO_CONVERT_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include <gst/audio/audio.h>
+
+#include "simd.h"
+
+G_BEGIN_DECLS
+
+/*
+ * fastaudioconvert: sample format conversion and downmix for playback branches.
+ *
+ * Converts between native endian S16, S32 and F32 and mixes any layout of up
+ * to 8 channels down to stereo or mono, with SSE2/AVX2 kernels picked at
+ * runtime (see simd.h). Samples go through F32: the input is unpacked, mixed
+ * and packed again in chunks small enough to stay in L1.
+ *
+ * Downmix follows ITU-R BS.775: center and surrounds at -3 dB, LFE dropped,
+ * the matrix scaled so a full scale input can't clip. The one upmix is mono
+ * to stereo, the channel copied to both sides at full level. Same channel
+ * counts on both sides are assumed to share the layout, identical caps pass
+ * through. Caps without a channel-mask get the usual layout for their
+ * channel count, see gst_fast_audio_convert_default_positions().
+ * Resampling and other sample formats are left to audioconvert/audioresample.
+ */
+
+#define GST_TYPE_FAST_AUDIO_CONVERT (gst_fast_audio_convert_get_type())
+#define GST_FAST_AUDIO_CONVERT(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_FAST_AUDIO_CONVERT, GstFastAudioConvert))
+#define GST_FAST_AUDIO_CONVERT_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_FAST_AUDIO_CONVERT, GstFastAudioConvertClass))
+#define GST_IS_FAST_AUDIO_CONVERT(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_FAST_AUDIO_CONVERT))
+
+#define GST_FAST_AUDIO_CONVERT_MAX_CHANNELS 8
+/* frames converted per step */
+#define GST_FAST_AUDIO_CONVERT_CHUNK 256
+
+typedef struct _GstFastAudioConvert GstFastAudioConvert;
+typedef struct _GstFastAudioConvertClass GstFastAudioConvertClass;
+
+typedef enum {
+	GST_FAST_AUDIO_S16,
+	GST_FAST_AUDIO_S32,
+	GST_FAST_AUDIO_F32
+} GstFastAudioFormat;
+
+struct _GstFastAudioConvert {
+	GstBaseTransform parent;
+
+	/* properties, object lock */
+	SimdLevel simd;
+
+	/* negotiated conversion */
+	GstFastAudioFormat in_format;
+	GstFastAudioFormat out_format;
+	gint in_channels;
+	gint out_channels;
+	gboolean mix;
+	gfloat matrix[GST_FAST_AUDIO_CONVERT_MAX_CHANNELS][GST_FAST_AUDIO_CONVERT_MAX_CHANNELS];	/* [out][in] */
+
+	/* streaming thread only */
+	gfloat unpacked[GST_FAST_AUDIO_CONVERT_CHUNK * GST_FAST_AUDIO_CONVERT_MAX_CHANNELS];
+	gfloat mixed[GST_FAST_AUDIO_CONVERT_CHUNK * GST_FAST_AUDIO_CONVERT_MAX_CHANNELS];
+};
+
+struct _GstFastAudioConvertClass {
+	GstBaseTransformClass parent_class;
+};
+
+GType gst_fast_audio_convert_get_type(void);
+
+/* layout assumed for channels (1 to GST_FAST_AUDIO_CONVERT_MAX_CHANNELS) when caps carry no channel-mask */
+const GstAudioChannelPosition *gst_fast_audio_convert_default_positions(gint channels);
+
+/* make "fastaudioconvert" available to this process */
+gboolean gst_fast_audio_convert_register(guint rank);
+
+G_END_DECLS
+
+#endif /* __GST_FAST_AUDIO_CONVERT_H__ */
@@ -0,0 +1,702 @@
+#include <string.h>
+
+#include "gstfastcolorspace.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(gst_fast_colorspace_debug);
+#define GST_CAT_DEFAULT gst_fast_colorspace_debug
+
+/* bands smaller than this cost more to hand out than to convert */
+#define MIN_SLICE_ROWS 32
+
+enum {
+	PROP_0,
+	PROP_N_THREADS,
+	PROP_SIMD
+};
+
+#define YUV_FORMATS "{ I420, NV12, YUY2 }"
+#define RGB_FORMATS "{ BGRx, RGBx }"
+#define ALL_CAPS GST_VIDEO_CAPS_MAKE("{ I420, NV12, YUY2, BGRx, RGBx }")
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink",
+		GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS(ALL_CAPS));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src",
+		GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS(ALL_CAPS));
+
+/* limited range YUV to RGB, in 1/64: y (plus 1/128, see put_pixel), v->r, u->g, v->g, u->b */
+static const gint16 bt601[5] = { 74, 102, 25, 52, 129 };
+static const gint16 bt709[5] = { 74, 115, 14, 34, 135 };
+
+/* Kernels */
+
+/*
+ * The SIMD kernels do the same 16 bit fixed point math with saturating adds.
+ * Saturation only happens where the result clamps to 0 or 255 anyway, so all
+ * instruction sets produce identical pixels.
+ */
+static inline void put_pixel(guint8 *dst, gint y, gint u, gint v, const gint16 *k, gboolean rgbx) {
+	/* 74.5 / 64 = 1.164, white at 255 */
+	gint ys = (y - 16) * k[0] + ((y - 16) >> 1) + 32;
+	gint r = (ys + (v - 128) * k[1]) >> 6;
+	gint g = (ys - (u - 128) * k[2] - (v - 128) * k[3]) >> 6;
+	gint b = (ys + (u - 128) * k[4]) >> 6;
+
+	dst[0] = CLAMP(rgbx ? r : b, 0, 255);
+	dst[1] = CLAMP(g, 0, 255);
+	dst[2] = CLAMP(rgbx ? b : r, 0, 255);
+	dst[3] = 0xff;
+}
+
+static void i420_row_c(guint8 *dst, const guint8 *y, const guint8 *u, const guint8 *v, gint width, const gint16 *k, gboolean rgbx) {
+	gint x;
+
+	for (x = 0; x < width; x++)
+		put_pixel(dst + x * 4, y[x], u[x / 2], v[x / 2], k, rgbx);
+}
+
+static void nv12_row_c(guint8 *dst, const guint8 *y, const guint8 *uv, const guint8 *unused, gint width, const gint16 *k, gboolean rgbx) {
+	gint x;
+
+	for (x = 0; x < width; x++)
+		put_pixel(dst + x * 4, y[x], uv[x / 2 * 2], uv[x / 2 * 2 + 1], k, rgbx);
+}
+
+static void yuy2_row_c(guint8 *dst, const guint8 *yuy2, const guint8 *unused_u, const guint8 *unused_v, gint width, const gint16 *k, gboolean rgbx) {
+	gint x;
+
+	for (x = 0; x < width; x++)
+		put_pixel(dst + x * 4, yuy2[x * 2], yuy2[x / 2 * 4 + 1], yuy2[x / 2 * 4 + 3], k, rgbx);
+}
+
+#ifdef SIMD_X86
+
+typedef struct {
+	__m128i y, rv, gu, gv, bu;
+} Coefs128;
+
+SIMD_TARGET("sse2") static inline void load_coefs128(Coefs128 *c, const gint16 *k) {
+	c->y = _mm_set1_epi16(k[0]);
+	c->rv = _mm_set1_epi16(k[1]);
+	c->gu = _mm_set1_epi16(k[2]);
+	c->gv = _mm_set1_epi16(k[3]);
+	c->bu = _mm_set1_epi16(k[4]);
+}
+
+/* @brief 16 pixels from 16 bit luma (two halves) and 8 chroma pairs, SSE2 only so every level shares it */
+SIMD_TARGET("sse2") static inline void convert16_sse2(guint8 *dst, __m128i y_lo, __m128i y_hi, __m128i u, __m128i v,
+		const Coefs128 *c, gboolean rgbx) {
+	const __m128i c128 = _mm_set1_epi16(128), c16 = _mm_set1_epi16(16), round = _mm_set1_epi16(32), ff = _mm_set1_epi8(-1);
+	__m128i rv, guv, bu, r, g, b, bg_lo, bg_hi, ra_lo, ra_hi;
+
+	u = _mm_sub_epi16(u, c128);
+	v = _mm_sub_epi16(v, c128);
+	rv = _mm_mullo_epi16(v, c->rv);
+	guv = _mm_adds_epi16(_mm_mullo_epi16(u, c->gu), _mm_mullo_epi16(v, c->gv));
+	bu = _mm_mullo_epi16(u, c->bu);
+	y_lo = _mm_sub_epi16(y_lo, c16);
+	y_hi = _mm_sub_epi16(y_hi, c16);
+	y_lo = _mm_adds_epi16(_mm_add_epi16(_mm_mullo_epi16(y_lo, c->y), _mm_srai_epi16(y_lo, 1)), round);
+	y_hi = _mm_adds_epi16(_mm_add_epi16(_mm_mullo_epi16(y_hi, c->y), _mm_srai_epi16(y_hi, 1)), round);
+
+	/* one chroma sample per pixel pair */
+	r = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(y_lo, _mm_unpacklo_epi16(rv, rv)), 6),
+			_mm_srai_epi16(_mm_adds_epi16(y_hi, _mm_unpackhi_epi16(rv, rv)), 6));
+	g = _mm_packus_epi16(_mm_srai_epi16(_mm_subs_epi16(y_lo, _mm_unpacklo_epi16(guv, guv)), 6),
+			_mm_srai_epi16(_mm_subs_epi16(y_hi, _mm_unpackhi_epi16(guv, guv)), 6));
+	b = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(y_lo, _mm_unpacklo_epi16(bu, bu)), 6),
+			_mm_srai_epi16(_mm_adds_epi16(y_hi, _mm_unpackhi_epi16(bu, bu)), 6));
+	if (rgbx) {
+		__m128i t = r;
+
+		r = b;
+		b = t;
+	}
+
+	bg_lo = _mm_unpacklo_epi8(b, g);
+	bg_hi = _mm_unpackhi_epi8(b, g);
+	ra_lo = _mm_unpacklo_epi8(r, ff);
+	ra_hi = _mm_unpackhi_epi8(r, ff);
+	_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(bg_lo, ra_lo));
+	_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(bg_lo, ra_lo));
+	_mm_storeu_si128((__m128i *)(dst + 32), _mm_unpacklo_epi16(bg_hi, ra_hi));
+	_mm_storeu_si128((__m128i *)(dst + 48), _mm_unpackhi_epi16(bg_hi, ra_hi));
+}
+
+/* SSE2 widens with unpacks against zero where SSE4.1 has pmovzx */
+SIMD_TARGET("sse2") static void i420_row_sse2(guint8 *dst, const guint8 *y, const guint8 *u, const guint8 *v, gint width,
+		const gint16 *k, gboolean rgbx) {
+	const __m128i zero = _mm_setzero_si128();
+	Coefs128 c;
+	gint x;
+
+	load_coefs128(&c, k);
+	for (x = 0; x + 16 <= width; x += 16) {
+		__m128i yy = _mm_loadu_si128((const __m128i *)(y + x));
+
+		convert16_sse2(dst + x * 4, _mm_unpacklo_epi8(yy, zero), _mm_unpackhi_epi8(yy, zero),
+				_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(u + x / 2)), zero),
+				_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(v + x / 2)), zero), &c, rgbx);
+	}
+	i420_row_c(dst + x * 4, y + x, u + x / 2, v + x / 2, width - x, k, rgbx);
+}
+
+SIMD_TARGET("sse2") static void nv12_row_sse2(guint8 *dst, const guint8 *y, const guint8 *uv, const guint8 *unused, gint width,
+		const gint16 *k, gboolean rgbx) {
+	const __m128i zero = _mm_setzero_si128(), low = _mm_set1_epi16(0xff);
+	Coefs128 c;
+	gint x;
+
+	load_coefs128(&c, k);
+	for (x = 0; x + 16 <= width; x += 16) {
+		__m128i yy = _mm_loadu_si128((const __m128i *)(y + x));
+		__m128i cc = _mm_loadu_si128((const __m128i *)(uv + x));
+
+		convert16_sse2(dst + x * 4, _mm_unpacklo_epi8(yy, zero), _mm_unpackhi_epi8(yy, zero),
+				_mm_and_si128(cc, low), _mm_srli_epi16(cc, 8), &c, rgbx);
+	}
+	nv12_row_c(dst + x * 4, y + x, uv + x, NULL, width - x, k, rgbx);
+}
+
+SIMD_TARGET("sse2") static void yuy2_row_sse2(guint8 *dst, const guint8 *yuy2, const guint8 *unused_u, const guint8 *unused_v,
+		gint width, const gint16 *k, gboolean rgbx) {
+	const __m128i low = _mm_set1_epi16(0xff), low32 = _mm_set1_epi32(0xffff);
+	Coefs128 c;
+	gint x;
+
+	load_coefs128(&c, k);
+	for (x = 0; x + 16 <= width; x += 16) {
+		__m128i w0 = _mm_loadu_si128((const __m128i *)(yuy2 + x * 2));
+		__m128i w1 = _mm_loadu_si128((const __m128i *)(yuy2 + x * 2 + 16));
+		/* u | v << 16 per pixel pair */
+		__m128i c0 = _mm_srli_epi16(w0, 8), c1 = _mm_srli_epi16(w1, 8);
+
+		/* chroma is below 256, the signed pack can't saturate */
+		convert16_sse2(dst + x * 4, _mm_and_si128(w0, low), _mm_and_si128(w1, low),
+				_mm_packs_epi32(_mm_and_si128(c0, low32), _mm_and_si128(c1, low32)),
+				_mm_packs_epi32(_mm_srli_epi32(c0, 16), _mm_srli_epi32(c1, 16)), &c, rgbx);
+	}
+	yuy2_row_c(dst + x * 4, yuy2 + x * 2, NULL, NULL, width - x, k, rgbx);
+}
+
+SIMD_TARGET("sse4.1") static void i420_row_sse41(guint8 *dst, const guint8 *y, const guint8 *u, const guint8 *v, gint width,
+		const gint16 *k, gboolean rgbx) {
+	Coefs128 c;
+	gint x;
+
+	load_coefs128(&c, k);
+	for (x = 0; x + 16 <= width; x += 16) {
+		__m128i yy = _mm_loadu_si128((const __m128i *)(y + x));
+
+		convert16_sse2(dst + x * 4, _mm_cvtepu8_epi16(yy), _mm_cvtepu8_epi16(_mm_srli_si128(yy, 8)),
+				_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(u + x / 2))),
+				_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *)(v + x / 2))), &c, rgbx);
+	}
+	i420_row_c(dst + x * 4, y + x, u + x / 2, v + x / 2, width - x, k, rgbx);
+}
+
+SIMD_TARGET("sse4.1") static void nv12_row_sse41(guint8 *dst, const guint8 *y, const guint8 *uv, const guint8 *unused, gint width,
+		const gint16 *k, gboolean rgbx) {
+	const __m128i low = _mm_set1_epi16(0xff);
+	Coefs128 c;
+	gint x;
+
+	load_coefs128(&c, k);
+	for (x = 0; x + 16 <= width; x += 16) {
+		__m128i yy = _mm_loadu_si128((const __m128i *)(y + x));
+		__m128i cc = _mm_loadu_si128((const __m128i *)(uv + x));
+
+		convert16_sse2(dst + x * 4, _mm_cvtepu8_epi16(yy), _mm_cvtepu8_epi16(_mm_srli_si128(yy, 8)),
+				_mm_and_si128(cc, low), _mm_srli_epi16(cc, 8), &c, rgbx);
+	}
+	nv12_row_c(dst + x * 4, y + x, uv + x, NULL, width - x, k, rgbx);
+}
+
+SIMD_TARGET("sse4.1") static void yuy2_row_sse41(guint8 *dst, const guint8 *yuy2, const guint8 *unused_u, const guint8 *unused_v,
+		gint width, const gint16 *k, gboolean rgbx) {
+	const __m128i low = _mm_set1_epi16(0xff), low32 = _mm_set1_epi32(0xffff);
+	Coefs128 c;
+	gint x;
+
+	load_coefs128(&c, k);
+	for (x = 0; x + 16 <= width; x += 16) {
+		__m128i w0 = _mm_loadu_si128((const __m128i *)(yuy2 + x * 2));
+		__m128i w1 = _mm_loadu_si128((const __m128i *)(yuy2 + x * 2 + 16));
+		/* u | v << 16 per pixel pair */
+		__m128i c0 = _mm_srli_epi16(w0, 8), c1 = _mm_srli_epi16(w1, 8);
+
+		convert16_sse2(dst + x * 4, _mm_and_si128(w0, low), _mm_and_si128(w1, low),
+				_mm_packus_epi32(_mm_and_si128(c0, low32), _mm_and_si128(c1, low32)),
+				_mm_packus_epi32(_mm_srli_epi32(c0, 16), _mm_srli_epi32(c1, 16)), &c, rgbx);
+	}
+	yuy2_row_c(dst + x * 4, yuy2 + x * 2, NULL, NULL, width - x, k, rgbx);
+}
+
+typedef struct {
+	__m256i y, rv, gu, gv, bu;
+} Coefs256;
+
+SIMD_TARGET("avx2") static inline void load_coefs256(Coefs256 *c, const gint16 *k) {
+	c->y = _mm256_set1_epi16(k[0]);
+	c->rv = _mm256_set1_epi16(k[1]);
+	c->gu = _mm256_set1_epi16(k[2]);
+	c->gv = _mm256_set1_epi16(k[3]);
+	c->bu = _mm256_set1_epi16(k[4]);
+}
+
+/*
+ * @brief 32 pixels from 16 bit luma (two halves) and 16 chroma pairs, all in pixel order
+ *        AVX2 unpacks and packs work within 128 bit lanes: chroma is permuted
+ *        so doubling it lines up with the luma halves, the output is put back
+ *        in pixel order by the final cross lane permutes.
+ */
+SIMD_TARGET("avx2") static inline void convert32_avx2(guint8 *dst, __m256i y_lo, __m256i y_hi, __m256i u, __m256i v,
+		const Coefs256 *c, gboolean rgbx) {
+	const __m256i c128 = _mm256_set1_epi16(128), c16 = _mm256_set1_epi16(16), round = _mm256_set1_epi16(32);
+	const __m256i ff = _mm256_set1_epi8(-1);
+	__m256i rv, guv, bu, r, g, b, bg_lo, bg_hi, ra_lo, ra_hi, p0, p1, p2, p3;
+
+	u = _mm256_sub_epi16(u, c128);
+	v = _mm256_sub_epi16(v, c128);
+	rv = _mm256_permute4x64_epi64(_mm256_mullo_epi16(v, c->rv), 0xd8);
+	guv = _mm256_permute4x64_epi64(_mm256_adds_epi16(_mm256_mullo_epi16(u, c->gu), _mm256_mullo_epi16(v, c->gv)), 0xd8);
+	bu = _mm256_permute4x64_epi64(_mm256_mullo_epi16(u, c->bu), 0xd8);
+	y_lo = _mm256_sub_epi16(y_lo, c16);
+	y_hi = _mm256_sub_epi16(y_hi, c16);
+	y_lo = _mm256_adds_epi16(_mm256_add_epi16(_mm256_mullo_epi16(y_lo, c->y), _mm256_srai_epi16(y_lo, 1)), round);
+	y_hi = _mm256_adds_epi16(_mm256_add_epi16(_mm256_mullo_epi16(y_hi, c->y), _mm256_srai_epi16(y_hi, 1)), round);
+
+	r = _mm256_packus_epi16(_mm256_srai_epi16(_mm256_adds_epi16(y_lo, _mm256_unpacklo_epi16(rv, rv)), 6),
+			_mm256_srai_epi16(_mm256_adds_epi16(y_hi, _mm256_unpackhi_epi16(rv, rv)), 6));
+	g = _mm256_packus_epi16(_mm256_srai_epi16(_mm256_subs_epi16(y_lo, _mm256_unpacklo_epi16(guv, guv)), 6),
+			_mm256_srai_epi16(_mm256_subs_epi16(y_hi, _mm256_unpackhi_epi16(guv, guv)), 6));
+	b = _mm256_packus_epi16(_mm256_srai_epi16(_mm256_adds_epi16(y_lo, _mm256_unpacklo_epi16(bu, bu)), 6),
+			_mm256_srai_epi16(_mm256_adds_epi16(y_hi, _mm256_unpackhi_epi16(bu, bu)), 6));
+	if (rgbx) {
+		__m256i t = r;
+
+		r = b;
+		b = t;
+	}
+
+	bg_lo = _mm256_unpacklo_epi8(b, g);
+	bg_hi = _mm256_unpackhi_epi8(b, g);
+	ra_lo = _mm256_unpacklo_epi8(r, ff);
+	ra_hi = _mm256_unpackhi_epi8(r, ff);
+	p0 = _mm256_unpacklo_epi16(bg_lo, ra_lo);
+	p1 = _mm256_unpackhi_epi16(bg_lo, ra_lo);
+	p2 = _mm256_unpacklo_epi16(bg_hi, ra_hi);
+	p3 = _mm256_unpackhi_epi16(bg_hi, ra_hi);
+	_mm256_storeu_si256((__m256i *)dst, _mm256_permute2x128_si256(p0, p1, 0x20));
+	_mm256_storeu_si256((__m256i *)(dst + 32), _mm256_permute2x128_si256(p0, p1, 0x31));
+	_mm256_storeu_si256((__m256i *)(dst + 64), _mm256_permute2x128_si256(p2, p3, 0x20));
+	_mm256_storeu_si256((__m256i *)(dst + 96), _mm256_permute2x128_si256(p2, p3, 0x31));
+}
+
+SIMD_TARGET("avx2") static void i420_row_avx2(guint8 *dst, const guint8 *y, const guint8 *u, const guint8 *v, gint width,
+		const gint16 *k, gboolean rgbx) {
+	Coefs256 c;
+	gint x;
+
+	load_coefs256(&c, k);
+	for (x = 0; x + 32 <= width; x += 32) {
+		__m256i yy = _mm256_loadu_si256((const __m256i *)(y + x));
+
+		convert32_avx2(dst + x * 4, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(yy)),
+				_mm256_cvtepu8_epi16(_mm256_extracti128_si256(yy, 1)),
+				_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(u + x / 2))),
+				_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(v + x / 2))), &c, rgbx);
+	}
+	i420_row_sse41(dst + x * 4, y + x, u + x / 2, v + x / 2, width - x, k, rgbx);
+}
+
+SIMD_TARGET("avx2") static void nv12_row_avx2(guint8 *dst, const guint8 *y, const guint8 *uv, const guint8 *unused, gint width,
+		const gint16 *k, gboolean rgbx) {
+	const __m256i low = _mm256_set1_epi16(0xff);
+	Coefs256 c;
+	gint x;
+
+	load_coefs256(&c, k);
+	for (x = 0; x + 32 <= width; x += 32) {
+		__m256i yy = _mm256_loadu_si256((const __m256i *)(y + x));
+		__m256i cc = _mm256_loadu_si256((const __m256i *)(uv + x));
+
+		convert32_avx2(dst + x * 4, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(yy)),
+				_mm256_cvtepu8_epi16(_mm256_extracti128_si256(yy, 1)),
+				_mm256_and_si256(cc, low), _mm256_srli_epi16(cc, 8), &c, rgbx);
+	}
+	nv12_row_sse41(dst + x * 4, y + x, uv + x, NULL, width - x, k, rgbx);
+}
+
+SIMD_TARGET("avx2") static void yuy2_row_avx2(guint8 *dst, const guint8 *yuy2, const guint8 *unused_u, const guint8 *unused_v,
+		gint width, const gint16 *k, gboolean rgbx) {
+	const __m256i low = _mm256_set1_epi16(0xff), low32 = _mm256_set1_epi32(0xffff);
+	Coefs256 c;
+	gint x;
+
+	load_coefs256(&c, k);
+	for (x = 0; x + 32 <= width; x += 32) {
+		__m256i w0 = _mm256_loadu_si256((const __m256i *)(yuy2 + x * 2));
+		__m256i w1 = _mm256_loadu_si256((const __m256i *)(yuy2 + x * 2 + 32));
+		__m256i c0 = _mm256_srli_epi16(w0, 8), c1 = _mm256_srli_epi16(w1, 8);
+		/* the 32 bit packs interleave lanes, 0xd8 puts the pairs back in order */
+		__m256i u = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_and_si256(c0, low32), _mm256_and_si256(c1, low32)), 0xd8);
+		__m256i v = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_srli_epi32(c0, 16), _mm256_srli_epi32(c1, 16)), 0xd8);
+
+		convert32_avx2(dst + x * 4, _mm256_and_si256(w0, low), _mm256_and_si256(w1, low), u, v, &c, rgbx);
+	}
+	yuy2_row_sse41(dst + x * 4, yuy2 + x * 2, NULL, NULL, width - x, k, rgbx);
+}
+
+#endif /* SIMD_X86 */
+
+/* row functions per input format */
+typedef struct {
+	SimdLevel level;
+	GstFastColorspaceRowFunc i420;
+	GstFastColorspaceRowFunc nv12;
+	GstFastColorspaceRowFunc yuy2;
+} Kernels;
+
+static const Kernels kernels_c = { SIMD_NONE, i420_row_c, nv12_row_c, yuy2_row_c };
+#ifdef SIMD_X86
+static const Kernels kernels_sse2 = { SIMD_SSE2, i420_row_sse2, nv12_row_sse2, yuy2_row_sse2 };
+static const Kernels kernels_sse41 = { SIMD_SSE41, i420_row_sse41, nv12_row_sse41, yuy2_row_sse41 };
+static const Kernels kernels_avx2 = { SIMD_AVX2, i420_row_avx2, nv12_row_avx2, yuy2_row_avx2 };
+#endif
+
+static const Kernels *select_kernels(SimdLevel requested) {
+#ifdef SIMD_X86
+	SimdLevel level = simd_resolve(requested);
+
+	if (level >= SIMD_AVX2)
+		return &kernels_avx2;
+	if (level >= SIMD_SSE41)
+		return &kernels_sse41;
+	if (level >= SIMD_SSE2)
+		return &kernels_sse2;
+#endif
+	return &kernels_c;
+}
+
+static GstFastColorspaceRowFunc select_row(const Kernels *kernels, GstVideoFormat format) {
+	switch (format) {
+		case GST_VIDEO_FORMAT_NV12:
+			return kernels->nv12;
+		case GST_VIDEO_FORMAT_YUY2:
+			return kernels->yuy2;
+		default:
+			return kernels->i420;
+	}
+}
+
+/* Element */
+
+#define gst_fast_colorspace_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE(GstFastColorspace, gst_fast_colorspace, GST_TYPE_VIDEO_FILTER,
+		GST_DEBUG_CATEGORY_INIT(gst_fast_colorspace_debug, "fastcolorspace", 0, "fastcolorspace element"));
+
+static void gst_fast_colorspace_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec) {
+	GstFastColorspace *convert = GST_FAST_COLORSPACE(object);
+
+	GST_OBJECT_LOCK(convert);
+	switch (prop_id) {
+		case PROP_N_THREADS:
+			/* used from the next start */
+			convert->n_threads = g_value_get_uint(value);
+			break;
+		case PROP_SIMD:
+			convert->simd = g_value_get_enum(value);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+	GST_OBJECT_UNLOCK(convert);
+}
+
+static void gst_fast_colorspace_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+	GstFastColorspace *convert = GST_FAST_COLORSPACE(object);
+
+	GST_OBJECT_LOCK(convert);
+	switch (prop_id) {
+		case PROP_N_THREADS:
+			g_value_set_uint(value, convert->n_threads);
+			break;
+		case PROP_SIMD:
+			g_value_set_enum(value, convert->simd);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+	GST_OBJECT_UNLOCK(convert);
+}
+
+static void gst_fast_colorspace_finalize(GObject *object) {
+	GstFastColorspace *convert = GST_FAST_COLORSPACE(object);
+
+	g_mutex_clear(&convert->lock);
+	g_cond_clear(&convert->cond);
+	G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+/* @brief copy the geometry of from into every structure of caps */
+static void copy_geometry(GstCaps *caps, const GstStructure *from) {
+	static const gchar *fields[] = { "width", "height", "framerate", "pixel-aspect-ratio", "interlace-mode" };
+	guint i, f;
+
+	for (i = 0; i < gst_caps_get_size(caps); i++) {
+		GstStructure *structure = gst_caps_get_structure(caps, i);
+
+		for (f = 0; f < G_N_ELEMENTS(fields); f++) {
+			const GValue *value = gst_structure_get_value(from, fields[f]);
+
+			if (value != NULL)
+				gst_structure_set_value(structure, fields[f], value);
+		}
+	}
+}
+
+static gboolean format_matches(const gchar *name, gboolean yuv) {
+	GstVideoFormat format = gst_video_format_from_string(name);
+
+	if (yuv)
+		return format == GST_VIDEO_FORMAT_I420 || format == GST_VIDEO_FORMAT_NV12 || format == GST_VIDEO_FORMAT_YUY2;
+	return format == GST_VIDEO_FORMAT_BGRx || format == GST_VIDEO_FORMAT_RGBx;
+}
+
+/* @brief could structure's format field (a string or a list) hold one of our YUV or RGB formats */
+static gboolean has_formats(const GstStructure *structure, gboolean yuv) {
+	const GValue *value = gst_structure_get_value(structure, "format");
+	guint i;
+
+	if (value == NULL)
+		return TRUE;
+	if (G_VALUE_HOLDS_STRING(value))
+		return format_matches(g_value_get_string(value), yuv);
+	if (GST_VALUE_HOLDS_LIST(value)) {
+		for (i = 0; i < gst_value_list_get_size(value); i++) {
+			const GValue *item = gst_value_list_get_value(value, i);
+
+			if (G_VALUE_HOLDS_STRING(item) && format_matches(g_value_get_string(item), yuv))
+				return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * @brief same caps first, so passthrough wins when both sides can do it,
+ *        then YUV -> RGB downstream or RGB <- YUV upstream
+ */
+static GstCaps *gst_fast_colorspace_transform_caps(GstBaseTransform *trans, GstPadDirection direction, GstCaps *caps,
+		GstCaps *filter) {
+	GstCaps *result = gst_caps_new_empty();
+	guint i;
+
+	for (i = 0; i < gst_caps_get_size(caps); i++) {
+		GstStructure *structure = gst_caps_get_structure(caps, i);
+		gboolean to_rgb = direction == GST_PAD_SINK;
+
+		result = gst_caps_merge_structure(result, gst_structure_copy(structure));
+		if (has_formats(structure, to_rgb)) {
+			GstCaps *other = gst_caps_from_string(to_rgb ? GST_VIDEO_CAPS_MAKE(RGB_FORMATS) :
+					GST_VIDEO_CAPS_MAKE(YUV_FORMATS));
+
+			copy_geometry(other, structure);
+			result = gst_caps_merge(result, other);
+		}
+	}
+	if (filter != NULL) {
+		GstCaps *intersection = gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+
+		gst_caps_unref(result);
+		result = intersection;
+	}
+	GST_LOG_OBJECT(trans, "%" GST_PTR_FORMAT " -> %" GST_PTR_FORMAT, caps, result);
+	return result;
+}
+
+static gboolean gst_fast_colorspace_set_info(GstVideoFilter *filter, GstCaps *incaps, GstVideoInfo *in_info,
+		GstCaps *outcaps, GstVideoInfo *out_info) {
+	GstFastColorspace *convert = GST_FAST_COLORSPACE(filter);
+	GstVideoFormat in_format = GST_VIDEO_INFO_FORMAT(in_info), out_format = GST_VIDEO_INFO_FORMAT(out_info);
+	gint width = GST_VIDEO_INFO_WIDTH(in_info), height = GST_VIDEO_INFO_HEIGHT(in_info);
+	gboolean hdtv;
+
+	if (width != GST_VIDEO_INFO_WIDTH(out_info) || height != GST_VIDEO_INFO_HEIGHT(out_info)) {
+		GST_DEBUG_OBJECT(convert, "no scaling: %dx%d -> %dx%d", width, height,
+				GST_VIDEO_INFO_WIDTH(out_info), GST_VIDEO_INFO_HEIGHT(out_info));
+		return FALSE;
+	}
+
+	if (in_format == out_format) {
+		gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(filter), TRUE);
+		return TRUE;
+	}
+	if (!GST_VIDEO_INFO_IS_YUV(in_info) || !GST_VIDEO_INFO_IS_RGB(out_info)) {
+		GST_DEBUG_OBJECT(convert, "only YUV -> RGB: %" GST_PTR_FORMAT " -> %" GST_PTR_FORMAT, incaps, outcaps);
+		return FALSE;
+	}
+	gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(filter), FALSE);
+
+	convert->in_format = in_format;
+	convert->out_format = out_format;
+	convert->width = width;
+	convert->height = height;
+
+	hdtv = in_info->colorimetry.matrix == GST_VIDEO_COLOR_MATRIX_BT709;
+	memcpy(convert->coefs, hdtv ? bt709 : bt601, sizeof(convert->coefs));
+	GST_DEBUG_OBJECT(convert, "%dx%d, %s -> %s, %s matrix", width, height, gst_video_format_to_string(in_format),
+			gst_video_format_to_string(out_format), hdtv ? "bt709" : "bt601");
+	return TRUE;
+}
+
+static void convert_slice(GstFastColorspaceSlice *slice) {
+	GstFastColorspace *convert = slice->convert;
+	GstVideoFrame *in = slice->in, *out = slice->out;
+	gint n_planes = GST_VIDEO_FRAME_N_PLANES(in), y;
+	/* packed formats have one plane, NV12 carries u & v in the second */
+	const guint8 *u_plane = n_planes > 1 ? GST_VIDEO_FRAME_PLANE_DATA(in, 1) : NULL;
+	const guint8 *v_plane = n_planes > 2 ? GST_VIDEO_FRAME_PLANE_DATA(in, 2) : NULL;
+
+	for (y = slice->first; y < slice->last; y++) {
+		const guint8 *luma = (const guint8 *)GST_VIDEO_FRAME_PLANE_DATA(in, 0) + y * GST_VIDEO_FRAME_PLANE_STRIDE(in, 0);
+		const guint8 *u = u_plane ? u_plane + y / 2 * GST_VIDEO_FRAME_PLANE_STRIDE(in, 1) : NULL;
+		const guint8 *v = v_plane ? v_plane + y / 2 * GST_VIDEO_FRAME_PLANE_STRIDE(in, 2) : NULL;
+
+		slice->row((guint8 *)GST_VIDEO_FRAME_PLANE_DATA(out, 0) + y * GST_VIDEO_FRAME_PLANE_STRIDE(out, 0),
+				luma, u, v, convert->width, convert->coefs, convert->out_format == GST_VIDEO_FORMAT_RGBx);
+	}
+}
+
+/* worker thread */
+static void slice_func(gpointer data, gpointer user_data) {
+	GstFastColorspace *convert = user_data;
+
+	convert_slice(data);
+	g_mutex_lock(&convert->lock);
+	if (--convert->pending == 0)
+		g_cond_signal(&convert->cond);
+	g_mutex_unlock(&convert->lock);
+}
+
+static GstFlowReturn gst_fast_colorspace_transform_frame(GstVideoFilter *filter, GstVideoFrame *in_frame,
+		GstVideoFrame *out_frame) {
+	GstFastColorspace *convert = GST_FAST_COLORSPACE(filter);
+	GstFastColorspaceRowFunc row;
+	SimdLevel simd;
+	guint n, i;
+
+	GST_OBJECT_LOCK(convert);
+	simd = convert->simd;
+	GST_OBJECT_UNLOCK(convert);
+	row = select_row(select_kernels(simd), convert->in_format);
+
+	/* even band boundaries, so no 4:2:0 chroma row is shared between bands */
+	n = CLAMP(convert->height / MIN_SLICE_ROWS, 1, (gint)convert->threads);
+	for (i = 0; i < n; i++) {
+		GstFastColorspaceSlice *slice = &convert->slices[i];
+
+		slice->convert = convert;
+		slice->row = row;
+		slice->in = in_frame;
+		slice->out = out_frame;
+		slice->first = (convert->height * i / n) & ~1;
+		slice->last = i == n - 1 ? convert->height : (convert->height * (i + 1) / n) & ~1;
+	}
+
+	convert->pending = n - 1;
+	for (i = 1; i < n; i++)
+		g_thread_pool_push(convert->pool, &convert->slices[i], NULL);
+	convert_slice(&convert->slices[0]);
+
+	g_mutex_lock(&convert->lock);
+	while (convert->pending > 0)
+		g_cond_wait(&convert->cond, &convert->lock);
+	g_mutex_unlock(&convert->lock);
+	return GST_FLOW_OK;
+}
+
+static gboolean gst_fast_colorspace_start(GstBaseTransform *trans) {
+	GstFastColorspace *convert = GST_FAST_COLORSPACE(trans);
+	GError *err = NULL;
+	guint threads;
+
+	GST_OBJECT_LOCK(convert);
+	threads = convert->n_threads;
+	GST_OBJECT_UNLOCK(convert);
+	if (threads == 0)
+		threads = g_get_num_processors();
+	convert->threads = CLAMP(threads, 1, GST_FAST_COLORSPACE_MAX_THREADS);
+
+	/* exclusive: threads stay around, no spawning while streaming */
+	if (convert->threads > 1) {
+		convert->pool = g_thread_pool_new(slice_func, convert, convert->threads - 1, TRUE, &err);
+		if (convert->pool == NULL) {
+			GST_WARNING_OBJECT(convert, "no worker threads, converting in one: %s", err->message);
+			g_clear_error(&err);
+			convert->threads = 1;
+		}
+	}
+	GST_DEBUG_OBJECT(convert, "%u threads, %s kernels", convert->threads,
+			simd_level_to_string(select_kernels(convert->simd)->level));
+	return TRUE;
+}
+
+static gboolean gst_fast_colorspace_stop(GstBaseTransform *trans) {
+	GstFastColorspace *convert = GST_FAST_COLORSPACE(trans);
+
+	if (convert->pool != NULL) {
+		g_thread_pool_free(convert->pool, FALSE, TRUE);
+		convert->pool = NULL;
+	}
+	return TRUE;
+}
+
+static void gst_fast_colorspace_class_init(GstFastColorspaceClass *klass) {
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS(klass);
+	GstVideoFilterClass *filter_class = GST_VIDEO_FILTER_CLASS(klass);
+
+	gobject_class->set_property = gst_fast_colorspace_set_property;
+	gobject_class->get_property = gst_fast_colorspace_get_property;
+	gobject_class->finalize = gst_fast_colorspace_finalize;
+
+	g_object_class_install_property(gobject_class, PROP_N_THREADS,
+			g_param_spec_uint("n-threads", "Threads", "Threads converting a frame, 0 for one per CPU",
+				0, GST_FAST_COLORSPACE_MAX_THREADS, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_SIMD,
+			g_param_spec_enum("simd", "SIMD", "Instruction set of the conversion kernels",
+				SIMD_TYPE_LEVEL, SIMD_AUTO, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	gst_element_class_set_static_metadata(element_class, "Fast colorspace converter", "Filter/Converter/Video",
+			"Converts YUV to RGB with SIMD kernels on several threads", "GStreamer tutorials");
+	gst_element_class_add_static_pad_template(element_class, &sink_template);
+	gst_element_class_add_static_pad_template(element_class, &src_template);
+
+	/* GstVideoFilter proposes and decides pools with video meta, unit size comes from the video info */
+	trans_class->transform_caps = GST_DEBUG_FUNCPTR(gst_fast_colorspace_transform_caps);
+	trans_class->start = GST_DEBUG_FUNCPTR(gst_fast_colorspace_start);
+	trans_class->stop = GST_DEBUG_FUNCPTR(gst_fast_colorspace_stop);
+	trans_class->passthrough_on_same_caps = TRUE;
+	filter_class->set_info = GST_DEBUG_FUNCPTR(gst_fast_colorspace_set_info);
+	filter_class->transform_frame = GST_DEBUG_FUNCPTR(gst_fast_colorspace_transform_frame);
+}
+
+static void gst_fast_colorspace_init(GstFastColorspace *convert) {
+	convert->simd = SIMD_AUTO;
+	convert->threads = 1;
+	g_mutex_init(&convert->lock);
+	g_cond_init(&convert->cond);
+}
+
+gboolean gst_fast_colorspace_register(guint rank) {
+	return gst_element_register(NULL, "fastcolorspace", rank, GST_TYPE_FAST_COLORSPACE);
+}
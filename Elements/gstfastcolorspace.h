@@ -0,0 +1,86 @@
+#ifndef __GST_FAST_COLORSPACE_H__
+#define __GST_FAST_COLORSPACE_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+#include "simd.h"
+
+G_BEGIN_DECLS
+
+/*
+ * fastcolorspace: YUV to RGB converter for video playback branches.
+ *
+ * Converts I420, NV12 and YUY2 to BGRx or RGBx (BT.601, or BT.709 when the
+ * caps' colorimetry says so) with SSE2/SSE4.1/AVX2 kernels picked at runtime, see
+ * simd.h. Frames are cut into bands of rows converted in parallel by a pool
+ * of n-threads threads, the streaming thread converting one band itself.
+ *
+ * Stands in for videoconvert in front of a sink: identical caps on both
+ * sides are passed through untouched, any other conversion (RGB to YUV, YUV
+ * to YUV, scaling) is refused during negotiation. Being a GstVideoFilter it
+ * reads and writes through video frames, so output buffers come from the
+ * pool downstream agreed to and padded strides (video meta) are converted
+ * directly, without intermediate copies.
+ */
+
+#define GST_TYPE_FAST_COLORSPACE (gst_fast_colorspace_get_type())
+#define GST_FAST_COLORSPACE(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_FAST_COLORSPACE, GstFastColorspace))
+#define GST_FAST_COLORSPACE_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_FAST_COLORSPACE, GstFastColorspaceClass))
+#define GST_IS_FAST_COLORSPACE(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_FAST_COLORSPACE))
+
+#define GST_FAST_COLORSPACE_MAX_THREADS 32
+
+typedef struct _GstFastColorspace GstFastColorspace;
+typedef struct _GstFastColorspaceClass GstFastColorspaceClass;
+
+/* converts one row; u & v unused for packed input, v unused for NV12 */
+typedef void (*GstFastColorspaceRowFunc)(guint8 *dst, const guint8 *y, const guint8 *u, const guint8 *v, gint width,
+		const gint16 *coefs, gboolean rgbx);
+
+/* a band of rows, converted by one thread */
+typedef struct _GstFastColorspaceSlice {
+	GstFastColorspace *convert;
+	GstFastColorspaceRowFunc row;
+	GstVideoFrame *in;
+	GstVideoFrame *out;
+	gint first;
+	gint last;
+} GstFastColorspaceSlice;
+
+struct _GstFastColorspace {
+	GstVideoFilter parent;
+
+	/* properties, object lock */
+	guint n_threads;		/* 0: one per CPU */
+	SimdLevel simd;
+
+	/* negotiated conversion */
+	GstVideoFormat in_format;
+	GstVideoFormat out_format;
+	gint width;
+	gint height;
+	gint16 coefs[5];		/* y, v->r, u->g, v->g, u->b in 1/64 */
+
+	/* workers, from start to stop */
+	GThreadPool *pool;
+	guint threads;			/* slices per frame at most, streaming thread included */
+	GstFastColorspaceSlice slices[GST_FAST_COLORSPACE_MAX_THREADS];
+	GMutex lock;
+	GCond cond;
+	gint pending;			/* slices still being converted by the pool */
+};
+
+struct _GstFastColorspaceClass {
+	GstVideoFilterClass parent_class;
+};
+
+GType gst_fast_colorspace_get_type(void);
+
+/* make "fastcolorspace" available to this process */
+gboolean gst_fast_colorspace_register(guint rank);
+
+G_END_DECLS
+
+#endif /* __GST_FAST_COLORSPACE_H__ */
@@ -0,0 +1,830 @@
+#include <math.h>
+#include <string.h>
+#include <gst/video/gstvideometa.h>
+#include <gst/video/gstvideopool.h>
+
+#include "gstfastvideosrc.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(gst_fast_video_src_debug);
+#define GST_CAT_DEFAULT gst_fast_video_src_debug
+
+#define DEFAULT_PATTERN GST_FAST_VIDEO_SRC_SMPTE
+#define DEFAULT_POOL_SIZE 4
+#define DEFAULT_WIDTH 320
+#define DEFAULT_HEIGHT 240
+#define DEFAULT_FPS_N 30
+#define DEFAULT_FPS_D 1
+
+/* AVX2 stores want 32 byte alignment */
+#define BUFFER_ALIGN 32
+/* frames larger than this are written with non-temporal stores, they'd only evict the cache */
+#define STREAM_THRESHOLD (4 * 1024 * 1024)
+
+enum {
+	PROP_0,
+	PROP_PATTERN,
+	PROP_STATIC_FRAME,
+	PROP_POOL_SIZE,
+	PROP_SIMD,
+	PROP_BUFFERS_ALLOCATED
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src",
+		GST_PAD_SRC, GST_PAD_ALWAYS,
+		GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("{ I420, YUY2, BGRx }")));
+
+/* Buffer pool */
+
+/*
+ * Our own pool, when downstream offers none: a video buffer pool that faults
+ * every buffer's pages in as it allocates them, that is while the pool is
+ * activated during negotiation, and counts allocations.
+ */
+struct _GstFastVideoPool {
+	GstVideoBufferPool parent;
+	gint allocated;		/* grows past pool-size only if downstream holds on */
+};
+
+typedef struct _GstFastVideoPoolClass {
+	GstVideoBufferPoolClass parent_class;
+} GstFastVideoPoolClass;
+
+static GType gst_fast_video_pool_get_type(void);
+G_DEFINE_TYPE(GstFastVideoPool, gst_fast_video_pool, GST_TYPE_VIDEO_BUFFER_POOL);
+
+static GstFlowReturn gst_fast_video_pool_alloc_buffer(GstBufferPool *pool, GstBuffer **buffer,
+		GstBufferPoolAcquireParams *params) {
+	GstFlowReturn ret;
+	GstMapInfo map;
+
+	ret = GST_BUFFER_POOL_CLASS(gst_fast_video_pool_parent_class)->alloc_buffer(pool, buffer, params);
+	if (ret != GST_FLOW_OK)
+		return ret;
+
+	/* fault the pages in now rather than while streaming */
+	if (gst_buffer_map(*buffer, &map, GST_MAP_WRITE)) {
+		memset(map.data, 0, map.size);
+		gst_buffer_unmap(*buffer, &map);
+	}
+	g_atomic_int_inc(&((GstFastVideoPool *)pool)->allocated);
+	return GST_FLOW_OK;
+}
+
+static void gst_fast_video_pool_class_init(GstFastVideoPoolClass *klass) {
+	GST_BUFFER_POOL_CLASS(klass)->alloc_buffer = gst_fast_video_pool_alloc_buffer;
+}
+
+static void gst_fast_video_pool_init(GstFastVideoPool *pool) {
+}
+
+/* Kernels, all take little endian 32 bit words */
+
+typedef void (*FillFunc)(guint32 *dst, guint32 value, gsize n);
+typedef void (*SnowFunc)(guint32 *dst, gsize n, guint32 *state, guint32 and_mask, guint32 or_mask, guint32 gray_mask);
+
+typedef struct _GstFastVideoKernels {
+	SimdLevel level;
+	FillFunc fill;		/* n words of value */
+	SnowFunc snow;		/* n random words, masked; gray_mask spreads the low byte to the next two */
+} GstFastVideoKernels;
+
+static void fill_c(guint32 *dst, guint32 value, gsize n) {
+	gsize i;
+
+	value = GUINT32_TO_LE(value);
+	for (i = 0; i < n; i++)
+		dst[i] = value;
+}
+
+/*
+ * Word i comes from xorshift32 lane i % 8 for every instruction set, so all
+ * kernels produce the same snow.
+ */
+static void snow_c(guint32 *dst, gsize n, guint32 *state, guint32 and_mask, guint32 or_mask, guint32 gray_mask) {
+	gsize i;
+
+	for (i = 0; i < n; i++) {
+		guint32 s = state[i & 7], v;
+
+		s ^= s << 13;
+		s ^= s >> 17;
+		s ^= s << 5;
+		state[i & 7] = s;
+		v = s & and_mask;
+		v |= (v << 8 | v << 16) & gray_mask;
+		dst[i] = GUINT32_TO_LE(v | or_mask);
+	}
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET("sse2") static void fill_sse2(guint32 *dst, guint32 value, gsize n) {
+	__m128i v = _mm_set1_epi32((gint)value);
+	gsize i = 0;
+
+	for (; i < n && ((guintptr)(dst + i) & 15) != 0; i++)
+		dst[i] = value;
+	if (n * 4 >= STREAM_THRESHOLD) {
+		for (; i + 16 <= n; i += 16) {
+			_mm_stream_si128((__m128i *)(dst + i), v);
+			_mm_stream_si128((__m128i *)(dst + i + 4), v);
+			_mm_stream_si128((__m128i *)(dst + i + 8), v);
+			_mm_stream_si128((__m128i *)(dst + i + 12), v);
+		}
+		_mm_sfence();
+	}
+	for (; i + 4 <= n; i += 4)
+		_mm_store_si128((__m128i *)(dst + i), v);
+	for (; i < n; i++)
+		dst[i] = value;
+}
+
+#define XORSHIFT128(s) \
+	s = _mm_xor_si128(s, _mm_slli_epi32(s, 13)); \
+	s = _mm_xor_si128(s, _mm_srli_epi32(s, 17)); \
+	s = _mm_xor_si128(s, _mm_slli_epi32(s, 5))
+
+SIMD_TARGET("sse2") static inline __m128i snow_finish_sse2(__m128i s, __m128i am, __m128i om, __m128i gm) {
+	__m128i v = _mm_and_si128(s, am);
+
+	v = _mm_or_si128(v, _mm_and_si128(_mm_or_si128(_mm_slli_epi32(v, 8), _mm_slli_epi32(v, 16)), gm));
+	return _mm_or_si128(v, om);
+}
+
+SIMD_TARGET("sse2") static void snow_sse2(guint32 *dst, gsize n, guint32 *state, guint32 and_mask, guint32 or_mask, guint32 gray_mask) {
+	__m128i s0 = _mm_loadu_si128((__m128i *)state), s1 = _mm_loadu_si128((__m128i *)(state + 4));
+	__m128i am = _mm_set1_epi32((gint)and_mask), om = _mm_set1_epi32((gint)or_mask), gm = _mm_set1_epi32((gint)gray_mask);
+	gsize i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		XORSHIFT128(s0);
+		XORSHIFT128(s1);
+		_mm_storeu_si128((__m128i *)(dst + i), snow_finish_sse2(s0, am, om, gm));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), snow_finish_sse2(s1, am, om, gm));
+	}
+	_mm_storeu_si128((__m128i *)state, s0);
+	_mm_storeu_si128((__m128i *)(state + 4), s1);
+	snow_c(dst + i, n - i, state, and_mask, or_mask, gray_mask);
+}
+
+SIMD_TARGET("avx2") static void fill_avx2(guint32 *dst, guint32 value, gsize n) {
+	__m256i v = _mm256_set1_epi32((gint)value);
+	gsize i = 0;
+
+	for (; i < n && ((guintptr)(dst + i) & 31) != 0; i++)
+		dst[i] = value;
+	if (n * 4 >= STREAM_THRESHOLD) {
+		for (; i + 32 <= n; i += 32) {
+			_mm256_stream_si256((__m256i *)(dst + i), v);
+			_mm256_stream_si256((__m256i *)(dst + i + 8), v);
+			_mm256_stream_si256((__m256i *)(dst + i + 16), v);
+			_mm256_stream_si256((__m256i *)(dst + i + 24), v);
+		}
+		_mm_sfence();
+	}
+	for (; i + 8 <= n; i += 8)
+		_mm256_store_si256((__m256i *)(dst + i), v);
+	for (; i < n; i++)
+		dst[i] = value;
+}
+
+SIMD_TARGET("avx2") static void snow_avx2(guint32 *dst, gsize n, guint32 *state, guint32 and_mask, guint32 or_mask, guint32 gray_mask) {
+	__m256i s = _mm256_loadu_si256((__m256i *)state);
+	__m256i am = _mm256_set1_epi32((gint)and_mask), om = _mm256_set1_epi32((gint)or_mask);
+	__m256i gm = _mm256_set1_epi32((gint)gray_mask);
+	gsize i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256i v;
+
+		s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 13));
+		s = _mm256_xor_si256(s, _mm256_srli_epi32(s, 17));
+		s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 5));
+		v = _mm256_and_si256(s, am);
+		v = _mm256_or_si256(v, _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi32(v, 8), _mm256_slli_epi32(v, 16)), gm));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(v, om));
+	}
+	_mm256_storeu_si256((__m256i *)state, s);
+	snow_c(dst + i, n - i, state, and_mask, or_mask, gray_mask);
+}
+
+#endif /* SIMD_X86 */
+
+static const GstFastVideoKernels kernels_c = { SIMD_NONE, fill_c, snow_c };
+#ifdef SIMD_X86
+static const GstFastVideoKernels kernels_sse2 = { SIMD_SSE2, fill_sse2, snow_sse2 };
+static const GstFastVideoKernels kernels_avx2 = { SIMD_AVX2, fill_avx2, snow_avx2 };
+#endif
+
+static const GstFastVideoKernels *select_kernels(SimdLevel requested) {
+#ifdef SIMD_X86
+	SimdLevel level = simd_resolve(requested);
+
+	if (level >= SIMD_AVX2)
+		return &kernels_avx2;
+	if (level >= SIMD_SSE2)
+		return &kernels_sse2;
+#endif
+	return &kernels_c;
+}
+
+/* Patterns */
+
+typedef struct {
+	guint8 y, u, v;
+	guint8 r, g, b;
+} Color;
+
+enum {
+	COLOR_WHITE,
+	COLOR_YELLOW,
+	COLOR_CYAN,
+	COLOR_GREEN,
+	COLOR_MAGENTA,
+	COLOR_RED,
+	COLOR_BLUE,
+	COLOR_BLACK,
+	COLOR_FULL_WHITE,
+	COLOR_FULL_RED,
+	COLOR_FULL_GREEN,
+	COLOR_FULL_BLUE
+};
+
+/* 75% bars, then the 100% colors of the solid patterns */
+static const Color colors[] = {
+	{ 180, 128, 128, 191, 191, 191 },
+	{ 162, 44, 142, 191, 191, 0 },
+	{ 131, 156, 44, 0, 191, 191 },
+	{ 112, 72, 58, 0, 191, 0 },
+	{ 84, 184, 198, 191, 0, 191 },
+	{ 65, 100, 212, 191, 0, 0 },
+	{ 35, 212, 114, 0, 0, 191 },
+	{ 16, 128, 128, 0, 0, 0 },
+	{ 235, 128, 128, 255, 255, 255 },
+	{ 81, 90, 240, 255, 0, 0 },
+	{ 145, 54, 34, 0, 255, 0 },
+	{ 41, 240, 110, 0, 0, 255 },
+};
+
+/* smpte bands, colors spread evenly over the width */
+static const guint8 smpte_bars[] = {
+	COLOR_WHITE, COLOR_YELLOW, COLOR_CYAN, COLOR_GREEN, COLOR_MAGENTA, COLOR_RED, COLOR_BLUE
+};
+static const guint8 smpte_castellations[] = {
+	COLOR_BLUE, COLOR_BLACK, COLOR_MAGENTA, COLOR_BLACK, COLOR_CYAN, COLOR_BLACK, COLOR_WHITE
+};
+static const guint8 smpte_bottom[] = {
+	COLOR_BLACK, COLOR_FULL_WHITE, COLOR_BLACK, COLOR_BLACK
+};
+
+static const GEnumValue patterns[] = {
+	{ GST_FAST_VIDEO_SRC_SMPTE, "SMPTE 100% color bars", "smpte" },
+	{ GST_FAST_VIDEO_SRC_SNOW, "Random (television snow)", "snow" },
+	{ GST_FAST_VIDEO_SRC_BLACK, "100% Black", "black" },
+	{ GST_FAST_VIDEO_SRC_WHITE, "100% White", "white" },
+	{ GST_FAST_VIDEO_SRC_RED, "Red", "red" },
+	{ GST_FAST_VIDEO_SRC_GREEN, "Green", "green" },
+	{ GST_FAST_VIDEO_SRC_BLUE, "Blue", "blue" },
+	{ GST_FAST_VIDEO_SRC_BALL, "Moving ball", "ball" },
+	{ 0, NULL, NULL }
+};
+
+#define GST_TYPE_FAST_VIDEO_SRC_PATTERN (gst_fast_video_src_pattern_get_type())
+static GType gst_fast_video_src_pattern_get_type(void) {
+	static gsize type = 0;
+
+	if (g_once_init_enter(&type))
+		g_once_init_leave(&type, g_enum_register_static("GstFastVideoSrcPattern", patterns));
+	return type;
+}
+
+/* @brief a pixel (YUY2: pixel pair) as little endian word */
+static guint32 color_word(GstVideoFormat format, const Color *c) {
+	switch (format) {
+		case GST_VIDEO_FORMAT_YUY2:
+			return c->y | c->u << 8 | c->y << 16 | (guint32)c->v << 24;
+		case GST_VIDEO_FORMAT_BGRx:
+			return c->b | c->g << 8 | c->r << 16 | 0xffu << 24;
+		default:
+			return c->y * 0x01010101u;
+	}
+}
+
+#define PLANE(frame, c) ((guint8 *)GST_VIDEO_FRAME_PLANE_DATA(frame, c))
+#define STRIDE(frame, c) GST_VIDEO_FRAME_PLANE_STRIDE(frame, c)
+
+/* @brief words in plane c, stride padding included: planes are painted in one go */
+static gsize plane_words(GstVideoFrame *frame, gint c) {
+	return (gsize)STRIDE(frame, c) * GST_VIDEO_FRAME_COMP_HEIGHT(frame, c) / 4;
+}
+
+static void paint_solid(GstFastVideoSrc *src, const GstFastVideoKernels *kernels, GstVideoFrame *frame, const Color *c) {
+	if (src->format == GST_VIDEO_FORMAT_I420) {
+		kernels->fill((guint32 *)PLANE(frame, 0), c->y * 0x01010101u, plane_words(frame, 0));
+		kernels->fill((guint32 *)PLANE(frame, 1), c->u * 0x01010101u, plane_words(frame, 1));
+		kernels->fill((guint32 *)PLANE(frame, 2), c->v * 0x01010101u, plane_words(frame, 2));
+	} else {
+		kernels->fill((guint32 *)PLANE(frame, 0), color_word(src->format, c), plane_words(frame, 0));
+	}
+}
+
+static void paint_snow(GstFastVideoSrc *src, const GstFastVideoKernels *kernels, GstVideoFrame *frame) {
+	switch (src->format) {
+		case GST_VIDEO_FORMAT_I420:
+			kernels->snow((guint32 *)PLANE(frame, 0), plane_words(frame, 0), src->snow_state, 0xffffffff, 0, 0);
+			kernels->fill((guint32 *)PLANE(frame, 1), 0x80808080, plane_words(frame, 1));
+			kernels->fill((guint32 *)PLANE(frame, 2), 0x80808080, plane_words(frame, 2));
+			break;
+		case GST_VIDEO_FORMAT_YUY2:
+			/* random luma, neutral chroma */
+			kernels->snow((guint32 *)PLANE(frame, 0), plane_words(frame, 0), src->snow_state, 0x00ff00ff, 0x80008000, 0);
+			break;
+		default:
+			/* random gray */
+			kernels->snow((guint32 *)PLANE(frame, 0), plane_words(frame, 0), src->snow_state, 0xff, 0xff000000, 0x00ffff00);
+			break;
+	}
+}
+
+/* @brief one line of a component, slots spread evenly over the width */
+static void render_line(GstFastVideoSrc *src, gint component, guint8 *line, const guint8 *slots, gint n_slots) {
+	gint x, width = src->width;
+
+	switch (src->format) {
+		case GST_VIDEO_FORMAT_I420:
+			if (component == 0) {
+				for (x = 0; x < width; x++)
+					line[x] = colors[slots[x * n_slots / width]].y;
+			} else {
+				for (x = 0; x < (width + 1) / 2; x++) {
+					const Color *c = &colors[slots[2 * x * n_slots / width]];
+
+					line[x] = component == 1 ? c->u : c->v;
+				}
+			}
+			break;
+		case GST_VIDEO_FORMAT_YUY2:
+			for (x = 0; x < (width + 1) / 2; x++)
+				((guint32 *)line)[x] = GUINT32_TO_LE(color_word(src->format, &colors[slots[2 * x * n_slots / width]]));
+			break;
+		default:
+			for (x = 0; x < width; x++)
+				((guint32 *)line)[x] = GUINT32_TO_LE(color_word(src->format, &colors[slots[x * n_slots / width]]));
+			break;
+	}
+}
+
+/* @brief lines first..last-1: render the first one, copy it down */
+static void paint_band(GstFastVideoSrc *src, GstVideoFrame *frame, gint first, gint last, const guint8 *slots, gint n_slots) {
+	gint c, y, n_components = GST_VIDEO_FRAME_N_PLANES(frame);
+
+	for (c = 0; c < n_components; c++) {
+		guint8 *plane = PLANE(frame, c);
+		gint stride = STRIDE(frame, c);
+		gint from = c == 0 ? first : first / 2, to = c == 0 ? last : (last + 1) / 2;
+
+		if (from >= to)
+			continue;
+		render_line(src, c, plane + from * stride, slots, n_slots);
+		for (y = from + 1; y < to; y++)
+			memcpy(plane + y * stride, plane + from * stride, stride);
+	}
+}
+
+static void paint_smpte(GstFastVideoSrc *src, GstVideoFrame *frame) {
+	gint h = src->height;
+
+	paint_band(src, frame, 0, h * 2 / 3, smpte_bars, G_N_ELEMENTS(smpte_bars));
+	paint_band(src, frame, h * 2 / 3, h * 3 / 4, smpte_castellations, G_N_ELEMENTS(smpte_castellations));
+	paint_band(src, frame, h * 3 / 4, h, smpte_bottom, G_N_ELEMENTS(smpte_bottom));
+}
+
+/* @brief pixels x0..x1 of line y */
+static void paint_span(GstFastVideoSrc *src, GstVideoFrame *frame, gint y, gint x0, gint x1, const Color *c) {
+	guint8 *line = PLANE(frame, 0) + y * STRIDE(frame, 0);
+	gint x;
+
+	switch (src->format) {
+		case GST_VIDEO_FORMAT_I420:
+			memset(line + x0, c->y, x1 - x0 + 1);
+			if ((y & 1) == 0) {
+				memset(PLANE(frame, 1) + y / 2 * STRIDE(frame, 1) + x0 / 2, c->u, x1 / 2 - x0 / 2 + 1);
+				memset(PLANE(frame, 2) + y / 2 * STRIDE(frame, 2) + x0 / 2, c->v, x1 / 2 - x0 / 2 + 1);
+			}
+			break;
+		case GST_VIDEO_FORMAT_YUY2:
+			for (x = x0; x <= x1; x++) {
+				line[x * 2] = c->y;
+				line[(x & ~1) * 2 + 1] = c->u;
+				line[(x & ~1) * 2 + 3] = c->v;
+			}
+			break;
+		default:
+			for (x = x0; x <= x1; x++)
+				((guint32 *)line)[x] = GUINT32_TO_LE(color_word(src->format, c));
+			break;
+	}
+}
+
+static void paint_ball(GstFastVideoSrc *src, const GstFastVideoKernels *kernels, GstVideoFrame *frame, guint64 n) {
+	gint w = src->width, h = src->height, radius = MAX(MIN(w, h) / 10, 1), y;
+	gdouble t = n * 0.05;
+	gint cx = w / 2 + (gint)((w / 2 - radius) * sin(t));
+	gint cy = h / 2 + (gint)((h / 2 - radius) * sin(t * 1.3));
+
+	paint_solid(src, kernels, frame, &colors[COLOR_BLACK]);
+	for (y = MAX(cy - radius, 0); y <= MIN(cy + radius, h - 1); y++) {
+		gint dx = (gint)sqrt((gdouble)(radius * radius - (y - cy) * (y - cy)));
+
+		paint_span(src, frame, y, MAX(cx - dx, 0), MIN(cx + dx, w - 1), &colors[COLOR_FULL_WHITE]);
+	}
+}
+
+static void paint(GstFastVideoSrc *src, const GstFastVideoKernels *kernels, GstFastVideoSrcPattern pattern, GstVideoFrame *frame) {
+	switch (pattern) {
+		case GST_FAST_VIDEO_SRC_SNOW:
+			paint_snow(src, kernels, frame);
+			break;
+		case GST_FAST_VIDEO_SRC_BLACK:
+			paint_solid(src, kernels, frame, &colors[COLOR_BLACK]);
+			break;
+		case GST_FAST_VIDEO_SRC_WHITE:
+			paint_solid(src, kernels, frame, &colors[COLOR_FULL_WHITE]);
+			break;
+		case GST_FAST_VIDEO_SRC_RED:
+			paint_solid(src, kernels, frame, &colors[COLOR_FULL_RED]);
+			break;
+		case GST_FAST_VIDEO_SRC_GREEN:
+			paint_solid(src, kernels, frame, &colors[COLOR_FULL_GREEN]);
+			break;
+		case GST_FAST_VIDEO_SRC_BLUE:
+			paint_solid(src, kernels, frame, &colors[COLOR_FULL_BLUE]);
+			break;
+		case GST_FAST_VIDEO_SRC_BALL:
+			paint_ball(src, kernels, frame, src->n_frames);
+			break;
+		default:
+			paint_smpte(src, frame);
+			break;
+	}
+}
+
+/* @brief paint into buf through a frame mapping, which knows the pool's strides */
+static gboolean paint_buffer(GstFastVideoSrc *src, const GstFastVideoKernels *kernels, GstFastVideoSrcPattern pattern,
+		GstBuffer *buf) {
+	GstVideoFrame frame;
+
+	if (!gst_video_frame_map(&frame, &src->info, buf, GST_MAP_WRITE))
+		return FALSE;
+	paint(src, kernels, pattern, &frame);
+	gst_video_frame_unmap(&frame);
+	return TRUE;
+}
+
+/* Element */
+
+#define gst_fast_video_src_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE(GstFastVideoSrc, gst_fast_video_src, GST_TYPE_PUSH_SRC,
+		GST_DEBUG_CATEGORY_INIT(gst_fast_video_src_debug, "fastvideosrc", 0, "fastvideosrc element"));
+
+static void gst_fast_video_src_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec) {
+	GstFastVideoSrc *src = GST_FAST_VIDEO_SRC(object);
+
+	GST_OBJECT_LOCK(src);
+	switch (prop_id) {
+		case PROP_PATTERN:
+			src->pattern = g_value_get_enum(value);
+			break;
+		case PROP_STATIC_FRAME:
+			src->static_frame = g_value_get_boolean(value);
+			break;
+		case PROP_POOL_SIZE:
+			/* used from the next allocation query */
+			src->pool_size = g_value_get_uint(value);
+			break;
+		case PROP_SIMD:
+			src->simd = g_value_get_enum(value);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+	GST_OBJECT_UNLOCK(src);
+}
+
+static void gst_fast_video_src_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+	GstFastVideoSrc *src = GST_FAST_VIDEO_SRC(object);
+
+	GST_OBJECT_LOCK(src);
+	switch (prop_id) {
+		case PROP_PATTERN:
+			g_value_set_enum(value, src->pattern);
+			break;
+		case PROP_STATIC_FRAME:
+			g_value_set_boolean(value, src->static_frame);
+			break;
+		case PROP_POOL_SIZE:
+			g_value_set_uint(value, src->pool_size);
+			break;
+		case PROP_SIMD:
+			g_value_set_enum(value, src->simd);
+			break;
+		case PROP_BUFFERS_ALLOCATED:
+			g_value_set_uint(value, src->pool ? (guint)g_atomic_int_get(&src->pool->allocated) : 0);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+	GST_OBJECT_UNLOCK(src);
+}
+
+static void drop_frame(GstFastVideoSrc *src) {
+	if (src->frame != NULL) {
+		gst_buffer_unref(src->frame);
+		src->frame = NULL;
+	}
+}
+
+static void set_own_pool(GstFastVideoSrc *src, GstFastVideoPool *pool) {
+	GstFastVideoPool *old;
+
+	GST_OBJECT_LOCK(src);
+	old = src->pool;
+	src->pool = pool ? g_object_ref(pool) : NULL;
+	GST_OBJECT_UNLOCK(src);
+	if (old != NULL)
+		g_object_unref(old);
+}
+
+static GstCaps *gst_fast_video_src_fixate(GstBaseSrc *basesrc, GstCaps *caps) {
+	GstStructure *structure;
+
+	caps = gst_caps_make_writable(caps);
+	structure = gst_caps_get_structure(caps, 0);
+	gst_structure_fixate_field_nearest_int(structure, "width", DEFAULT_WIDTH);
+	gst_structure_fixate_field_nearest_int(structure, "height", DEFAULT_HEIGHT);
+	gst_structure_fixate_field_nearest_fraction(structure, "framerate", DEFAULT_FPS_N, DEFAULT_FPS_D);
+	return GST_BASE_SRC_CLASS(parent_class)->fixate(basesrc, caps);
+}
+
+static gboolean gst_fast_video_src_set_caps(GstBaseSrc *basesrc, GstCaps *caps) {
+	GstFastVideoSrc *src = GST_FAST_VIDEO_SRC(basesrc);
+	GstVideoInfo info;
+
+	if (!gst_video_info_from_caps(&info, caps)) {
+		GST_DEBUG_OBJECT(src, "unusable caps %" GST_PTR_FORMAT, caps);
+		return FALSE;
+	}
+
+	/* the pool follows in decide_allocation */
+	drop_frame(src);
+	src->info = info;
+	src->format = GST_VIDEO_INFO_FORMAT(&info);
+	src->width = GST_VIDEO_INFO_WIDTH(&info);
+	src->height = GST_VIDEO_INFO_HEIGHT(&info);
+	src->fps_n = GST_VIDEO_INFO_FPS_N(&info);
+	src->fps_d = GST_VIDEO_INFO_FPS_D(&info);
+	return TRUE;
+}
+
+/*
+ * @brief pick the pool frames are painted into
+ *        A pool offered by downstream (a sink's own memory) is used as is,
+ *        with at least pool-size buffers; otherwise we bring our own,
+ *        allocated and faulted in when basesrc activates it.
+ */
+static gboolean gst_fast_video_src_decide_allocation(GstBaseSrc *basesrc, GstQuery *query) {
+	GstFastVideoSrc *src = GST_FAST_VIDEO_SRC(basesrc);
+	GstBufferPool *pool = NULL;
+	GstAllocator *allocator = NULL;
+	GstAllocationParams params;
+	GstStructure *config;
+	GstCaps *caps;
+	guint size = GST_VIDEO_INFO_SIZE(&src->info), min = 0, max = 0, pool_size;
+	gboolean offered = gst_query_get_n_allocation_pools(query) > 0;
+
+	GST_OBJECT_LOCK(src);
+	pool_size = src->pool_size;
+	GST_OBJECT_UNLOCK(src);
+
+	gst_query_parse_allocation(query, &caps, NULL);
+	if (offered) {
+		gst_query_parse_nth_allocation_pool(query, 0, &pool, &size, &min, &max);
+		size = MAX(size, GST_VIDEO_INFO_SIZE(&src->info));
+	}
+	if (gst_query_get_n_allocation_params(query) > 0)
+		gst_query_parse_nth_allocation_param(query, 0, &allocator, &params);
+	else
+		gst_allocation_params_init(&params);
+	params.align = MAX(params.align, BUFFER_ALIGN - 1);
+	min = MAX(min, pool_size);
+	if (max != 0)
+		max = MAX(max, min);
+
+	for (;;) {
+		if (pool == NULL)
+			pool = g_object_new(gst_fast_video_pool_get_type(), NULL);
+
+		config = gst_buffer_pool_get_config(pool);
+		gst_buffer_pool_config_set_params(config, caps, size, min, max);
+		gst_buffer_pool_config_set_allocator(config, allocator, &params);
+		if (gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL) &&
+				gst_buffer_pool_has_option(pool, GST_BUFFER_POOL_OPTION_VIDEO_META))
+			gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+		if (gst_buffer_pool_set_config(pool, config))
+			break;
+
+		if (G_TYPE_CHECK_INSTANCE_TYPE(pool, gst_fast_video_pool_get_type())) {
+			GST_ELEMENT_ERROR(src, RESOURCE, SETTINGS, (NULL), ("Could not configure the buffer pool"));
+			gst_object_unref(pool);
+			if (allocator != NULL)
+				gst_object_unref(allocator);
+			return FALSE;
+		}
+		/* downstream's pool can't do it, fall back to ours */
+		GST_DEBUG_OBJECT(src, "downstream pool refused the config, using our own");
+		gst_object_unref(pool);
+		pool = NULL;
+		max = 0;
+	}
+
+	set_own_pool(src, G_TYPE_CHECK_INSTANCE_TYPE(pool, gst_fast_video_pool_get_type()) ? (GstFastVideoPool *)pool : NULL);
+	GST_DEBUG_OBJECT(src, "%s pool, %u-%u buffers of %u bytes", src->pool ? "own" : "downstream", min, max, size);
+
+	if (offered)
+		gst_query_set_nth_allocation_pool(query, 0, pool, size, min, max);
+	else
+		gst_query_add_allocation_pool(query, pool, size, min, max);
+	gst_object_unref(pool);
+	if (allocator != NULL)
+		gst_object_unref(allocator);
+	return TRUE;
+}
+
+static gboolean gst_fast_video_src_start(GstBaseSrc *basesrc) {
+	GstFastVideoSrc *src = GST_FAST_VIDEO_SRC(basesrc);
+	gint i;
+
+	src->n_frames = 0;
+	for (i = 0; i < 8; i++)
+		src->snow_state[i] = 0x9e3779b9u * (i + 1);
+	return TRUE;
+}
+
+static gboolean gst_fast_video_src_stop(GstBaseSrc *basesrc) {
+	GstFastVideoSrc *src = GST_FAST_VIDEO_SRC(basesrc);
+
+	drop_frame(src);
+	set_own_pool(src, NULL);
+	return TRUE;
+}
+
+static gboolean gst_fast_video_src_is_seekable(GstBaseSrc *basesrc) {
+	return TRUE;
+}
+
+static gboolean gst_fast_video_src_do_seek(GstBaseSrc *basesrc, GstSegment *segment) {
+	GstFastVideoSrc *src = GST_FAST_VIDEO_SRC(basesrc);
+
+	if (src->fps_n > 0)
+		src->n_frames = gst_util_uint64_scale(segment->position, src->fps_n, src->fps_d * GST_SECOND);
+	else
+		src->n_frames = 0;
+	return TRUE;
+}
+
+static GstFlowReturn acquire(GstFastVideoSrc *src, GstBuffer **buf) {
+	GstBufferPool *pool = gst_base_src_get_buffer_pool(GST_BASE_SRC(src));
+	GstFlowReturn ret;
+
+	if (pool == NULL) {
+		GST_ELEMENT_ERROR(src, CORE, NEGOTIATION, (NULL), ("format wasn't negotiated before create function"));
+		return GST_FLOW_NOT_NEGOTIATED;
+	}
+	ret = gst_buffer_pool_acquire_buffer(pool, buf, NULL);
+	gst_object_unref(pool);
+	return ret;
+}
+
+static GstFlowReturn gst_fast_video_src_create(GstPushSrc *pushsrc, GstBuffer **buffer) {
+	GstFastVideoSrc *src = GST_FAST_VIDEO_SRC(pushsrc);
+	const GstFastVideoKernels *kernels;
+	GstFastVideoSrcPattern pattern;
+	gboolean static_frame;
+	GstFlowReturn ret;
+	GstBuffer *buf;
+
+	/* framerate 0/1 is a still picture: a single frame */
+	if (src->fps_n == 0 && src->n_frames == 1)
+		return GST_FLOW_EOS;
+
+	GST_OBJECT_LOCK(src);
+	pattern = src->pattern;
+	static_frame = src->static_frame;
+	kernels = select_kernels(src->simd);
+	GST_OBJECT_UNLOCK(src);
+
+	if (static_frame) {
+		if (src->frame == NULL || src->frame_pattern != pattern) {
+			drop_frame(src);
+			if ((ret = acquire(src, &src->frame)) != GST_FLOW_OK)
+				return ret;
+			if (!paint_buffer(src, kernels, pattern, src->frame))
+				goto map_failed;
+			src->frame_pattern = pattern;
+		}
+		/* shallow copy: the memory stays shared with our reference, so it is read only downstream */
+		buf = gst_buffer_copy(src->frame);
+	} else {
+		drop_frame(src);
+		if ((ret = acquire(src, &buf)) != GST_FLOW_OK)
+			return ret;
+		if (!paint_buffer(src, kernels, pattern, buf)) {
+			gst_buffer_unref(buf);
+			goto map_failed;
+		}
+	}
+
+	if (src->fps_n > 0) {
+		GST_BUFFER_PTS(buf) = gst_util_uint64_scale(src->n_frames, src->fps_d * GST_SECOND, src->fps_n);
+		GST_BUFFER_DURATION(buf) = gst_util_uint64_scale(src->n_frames + 1, src->fps_d * GST_SECOND, src->fps_n) -
+				GST_BUFFER_PTS(buf);
+	} else {
+		GST_BUFFER_PTS(buf) = 0;
+		GST_BUFFER_DURATION(buf) = GST_CLOCK_TIME_NONE;
+	}
+	GST_BUFFER_DTS(buf) = GST_CLOCK_TIME_NONE;
+	GST_BUFFER_OFFSET(buf) = src->n_frames;
+	GST_BUFFER_OFFSET_END(buf) = src->n_frames + 1;
+	src->n_frames++;
+
+	*buffer = buf;
+	return GST_FLOW_OK;
+
+map_failed:
+	drop_frame(src);
+	GST_ELEMENT_ERROR(src, RESOURCE, WRITE, ("Could not map a frame for writing."), (NULL));
+	return GST_FLOW_ERROR;
+}
+
+static void gst_fast_video_src_class_init(GstFastVideoSrcClass *klass) {
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS(klass);
+	GstPushSrcClass *pushsrc_class = GST_PUSH_SRC_CLASS(klass);
+
+	gobject_class->set_property = gst_fast_video_src_set_property;
+	gobject_class->get_property = gst_fast_video_src_get_property;
+
+	g_object_class_install_property(gobject_class, PROP_PATTERN,
+			g_param_spec_enum("pattern", "Pattern", "Type of test pattern to generate",
+				GST_TYPE_FAST_VIDEO_SRC_PATTERN, DEFAULT_PATTERN, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_STATIC_FRAME,
+			g_param_spec_boolean("static-frame", "Static frame",
+				"Paint once and push the same frame by reference", FALSE,
+				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_POOL_SIZE,
+			g_param_spec_uint("pool-size", "Pool size",
+				"Buffers allocated up front and recycled", 1, 64, DEFAULT_POOL_SIZE,
+				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_SIMD,
+			g_param_spec_enum("simd", "SIMD", "Instruction set of the painting kernels",
+				SIMD_TYPE_LEVEL, SIMD_AUTO, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_BUFFERS_ALLOCATED,
+			g_param_spec_uint("buffers-allocated", "Buffers allocated",
+				"Buffers allocated by our own pool, above pool-size when it had to grow; 0 while painting into downstream's pool",
+				0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	gst_element_class_set_static_metadata(element_class, "Fast video test source", "Source/Video",
+			"Paints test patterns with SIMD kernels into pooled buffers", "GStreamer tutorials");
+	gst_element_class_add_static_pad_template(element_class, &src_template);
+
+	basesrc_class->fixate = GST_DEBUG_FUNCPTR(gst_fast_video_src_fixate);
+	basesrc_class->set_caps = GST_DEBUG_FUNCPTR(gst_fast_video_src_set_caps);
+	basesrc_class->decide_allocation = GST_DEBUG_FUNCPTR(gst_fast_video_src_decide_allocation);
+	basesrc_class->start = GST_DEBUG_FUNCPTR(gst_fast_video_src_start);
+	basesrc_class->stop = GST_DEBUG_FUNCPTR(gst_fast_video_src_stop);
+	basesrc_class->is_seekable = GST_DEBUG_FUNCPTR(gst_fast_video_src_is_seekable);
+	basesrc_class->do_seek = GST_DEBUG_FUNCPTR(gst_fast_video_src_do_seek);
+	pushsrc_class->create = GST_DEBUG_FUNCPTR(gst_fast_video_src_create);
+}
+
+static void gst_fast_video_src_init(GstFastVideoSrc *src) {
+	src->pattern = DEFAULT_PATTERN;
+	src->pool_size = DEFAULT_POOL_SIZE;
+	src->simd = SIMD_AUTO;
+	gst_video_info_init(&src->info);
+	gst_base_src_set_format(GST_BASE_SRC(src), GST_FORMAT_TIME);
+}
+
+gboolean gst_fast_video_src_register(guint rank) {
+	if (!gst_element_register(NULL, "fastvideosrc", rank, GST_TYPE_FAST_VIDEO_SRC))
+		return FALSE;
+	GST_INFO("painting kernels: %s", simd_level_to_string(select_kernels(SIMD_AUTO)->level));
+	return TRUE;
+}
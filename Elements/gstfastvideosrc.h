@@ -0,0 +1,87 @@
+#ifndef __GST_FAST_VIDEO_SRC_H__
+#define __GST_FAST_VIDEO_SRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstpushsrc.h>
+#include <gst/video/video.h>
+
+#include "simd.h"
+
+G_BEGIN_DECLS
+
+/*
+ * fastvideosrc: test pattern source for load generation.
+ *
+ * Drop-in for videotestsrc where it is used as a load generator: same caps
+ * defaults and the same pattern property (values & nicks) for the patterns
+ * it implements. Frames are painted with SSE2/AVX2 kernels picked at runtime
+ * (see simd.h) into buffers of the pool agreed on in the allocation query: a
+ * pool offered downstream, typically a sink's own memory, is painted into
+ * directly; otherwise the element brings a pool of pool-size buffers that are
+ * allocated and faulted in when it is activated. Either way steady state
+ * streaming neither allocates nor page faults. If downstream holds more than
+ * pool-size buffers the pool grows.
+ *
+ * With static-frame the frame is painted once and the same memory is pushed
+ * again and again in shallow buffer copies, read only downstream, only
+ * timestamps change. Animated patterns (snow, ball) freeze in that mode.
+ */
+
+#define GST_TYPE_FAST_VIDEO_SRC (gst_fast_video_src_get_type())
+#define GST_FAST_VIDEO_SRC(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_FAST_VIDEO_SRC, GstFastVideoSrc))
+#define GST_FAST_VIDEO_SRC_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_FAST_VIDEO_SRC, GstFastVideoSrcClass))
+#define GST_IS_FAST_VIDEO_SRC(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_FAST_VIDEO_SRC))
+
+typedef struct _GstFastVideoSrc GstFastVideoSrc;
+typedef struct _GstFastVideoSrcClass GstFastVideoSrcClass;
+typedef struct _GstFastVideoPool GstFastVideoPool;
+
+/* values match videotestsrc's */
+typedef enum {
+	GST_FAST_VIDEO_SRC_SMPTE = 0,
+	GST_FAST_VIDEO_SRC_SNOW = 1,
+	GST_FAST_VIDEO_SRC_BLACK = 2,
+	GST_FAST_VIDEO_SRC_WHITE = 3,
+	GST_FAST_VIDEO_SRC_RED = 4,
+	GST_FAST_VIDEO_SRC_GREEN = 5,
+	GST_FAST_VIDEO_SRC_BLUE = 6,
+	GST_FAST_VIDEO_SRC_BALL = 18
+} GstFastVideoSrcPattern;
+
+struct _GstFastVideoSrc {
+	GstPushSrc parent;
+
+	/* properties, object lock */
+	GstFastVideoSrcPattern pattern;
+	gboolean static_frame;
+	guint pool_size;
+	SimdLevel simd;
+
+	/* negotiated format */
+	GstVideoInfo info;
+	GstVideoFormat format;
+	gint width;
+	gint height;
+	gint fps_n;
+	gint fps_d;
+	GstFastVideoPool *pool;		/* our own pool if we brought one, object lock */
+
+	/* streaming thread only */
+	GstBuffer *frame;		/* painted once in static-frame mode */
+	GstFastVideoSrcPattern frame_pattern;
+	guint64 n_frames;
+	guint32 snow_state[8];		/* xorshift32, one per vector lane */
+};
+
+struct _GstFastVideoSrcClass {
+	GstPushSrcClass parent_class;
+};
+
+GType gst_fast_video_src_get_type(void);
+
+/* make "fastvideosrc" available to this process */
+gboolean gst_fast_video_src_register(guint rank);
+
+G_END_DECLS
+
+#endif /* __GST_FAST_VIDEO_SRC_H__ */
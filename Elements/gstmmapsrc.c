@@ -0,0 +1,338 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gstmmapsrc.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_mmap_src_debug);
+#define GST_CAT_DEFAULT gst_mmap_src_debug
+
+#define DEFAULT_BLOCKSIZE (64 * 1024)
+#define DEFAULT_MIN_READAHEAD (256 * 1024)
+#define DEFAULT_MAX_READAHEAD (8 * 1024 * 1024)
+
+enum {
+	PROP_0,
+	PROP_LOCATION,
+	PROP_MIN_READAHEAD,
+	PROP_MAX_READAHEAD
+};
+
+/* the mapped file, shared by the element and every buffer it handed out */
+struct _GstMmapSrcMapping {
+	gint refcount;
+	guint8 *data;
+	gsize size;
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src",
+		GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+static void gst_mmap_src_uri_handler_init(gpointer g_iface, gpointer iface_data);
+
+#define gst_mmap_src_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE(GstMmapSrc, gst_mmap_src, GST_TYPE_BASE_SRC,
+		G_IMPLEMENT_INTERFACE(GST_TYPE_URI_HANDLER, gst_mmap_src_uri_handler_init);
+		GST_DEBUG_CATEGORY_INIT(gst_mmap_src_debug, "mmapsrc", 0, "mmapsrc element"));
+
+static GstMmapSrcMapping *mapping_ref(GstMmapSrcMapping *mapping) {
+	g_atomic_int_inc(&mapping->refcount);
+	return mapping;
+}
+
+/* also the buffers' memory notify, may run in any thread */
+static void mapping_unref(GstMmapSrcMapping *mapping) {
+	if (g_atomic_int_dec_and_test(&mapping->refcount)) {
+		munmap(mapping->data, mapping->size);
+		g_free(mapping);
+	}
+}
+
+static gboolean gst_mmap_src_set_location(GstMmapSrc *src, const gchar *location) {
+	GstState state;
+
+	GST_OBJECT_LOCK(src);
+	state = GST_STATE(src);
+	if (state != GST_STATE_NULL && state != GST_STATE_READY) {
+		GST_OBJECT_UNLOCK(src);
+		g_warning("Changing the location of mmapsrc while playing is not supported.");
+		return FALSE;
+	}
+
+	g_free(src->location);
+	g_free(src->uri);
+	src->location = g_strdup(location);
+	src->uri = location ? gst_filename_to_uri(location, NULL) : NULL;
+	GST_OBJECT_UNLOCK(src);
+	return TRUE;
+}
+
+static void gst_mmap_src_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec) {
+	GstMmapSrc *src = GST_MMAP_SRC(object);
+
+	switch (prop_id) {
+		case PROP_LOCATION:
+			gst_mmap_src_set_location(src, g_value_get_string(value));
+			break;
+		case PROP_MIN_READAHEAD:
+			src->min_window = g_value_get_uint64(value);
+			break;
+		case PROP_MAX_READAHEAD:
+			src->max_window = g_value_get_uint64(value);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+static void gst_mmap_src_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec) {
+	GstMmapSrc *src = GST_MMAP_SRC(object);
+
+	switch (prop_id) {
+		case PROP_LOCATION:
+			g_value_set_string(value, src->location);
+			break;
+		case PROP_MIN_READAHEAD:
+			g_value_set_uint64(value, src->min_window);
+			break;
+		case PROP_MAX_READAHEAD:
+			g_value_set_uint64(value, src->max_window);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+static void gst_mmap_src_finalize(GObject *object) {
+	GstMmapSrc *src = GST_MMAP_SRC(object);
+
+	g_free(src->location);
+	g_free(src->uri);
+	G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static gboolean gst_mmap_src_start(GstBaseSrc *basesrc) {
+	GstMmapSrc *src = GST_MMAP_SRC(basesrc);
+	struct stat st;
+	void *data;
+	int fd;
+
+	if (src->location == NULL || src->location[0] == '\0') {
+		GST_ELEMENT_ERROR(src, RESOURCE, NOT_FOUND, ("No file name specified for reading."), (NULL));
+		return FALSE;
+	}
+
+	fd = open(src->location, O_RDONLY);
+	if (fd < 0) {
+		GST_ELEMENT_ERROR(src, RESOURCE, OPEN_READ, ("Could not open file \"%s\" for reading.", src->location),
+				GST_ERROR_SYSTEM);
+		return FALSE;
+	}
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		GST_ELEMENT_ERROR(src, RESOURCE, OPEN_READ, ("\"%s\" is not a regular file.", src->location), (NULL));
+		close(fd);
+		return FALSE;
+	}
+
+	src->mapping = g_new0(GstMmapSrcMapping, 1);
+	src->mapping->refcount = 1;
+	src->mapping->size = st.st_size;
+	if (st.st_size > 0) {
+		/* buffers wrap it read-only, writers get a copy */
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			GST_ELEMENT_ERROR(src, RESOURCE, OPEN_READ, ("Could not map file \"%s\".", src->location),
+					GST_ERROR_SYSTEM);
+			g_free(src->mapping);
+			src->mapping = NULL;
+			close(fd);
+			return FALSE;
+		}
+		src->mapping->data = data;
+	}
+	/* the mapping keeps the file referenced */
+	close(fd);
+
+	src->next_offset = 0;
+	src->advised_end = 0;
+	src->window = src->min_window;
+	GST_DEBUG_OBJECT(src, "mapped %s, %" G_GUINT64_FORMAT " bytes", src->location, (guint64)st.st_size);
+	return TRUE;
+}
+
+static gboolean gst_mmap_src_stop(GstBaseSrc *basesrc) {
+	GstMmapSrc *src = GST_MMAP_SRC(basesrc);
+
+	/* buffers still out there keep the pages till they are freed */
+	if (src->mapping != NULL) {
+		if (src->mapping->data == NULL)
+			g_free(src->mapping);
+		else
+			mapping_unref(src->mapping);
+		src->mapping = NULL;
+	}
+	return TRUE;
+}
+
+static void advise(GstMmapSrc *src, guint64 start, guint64 stop) {
+	static gsize page_size = 0;
+
+	if (page_size == 0)
+		page_size = sysconf(_SC_PAGESIZE);
+	start &= ~(guint64)(page_size - 1);
+	if (stop > start && madvise(src->mapping->data + start, stop - start, MADV_WILLNEED) < 0)
+		GST_DEBUG_OBJECT(src, "madvise failed: %s", g_strerror(errno));
+}
+
+/*
+ * @brief keep a readahead window ahead of the consumer
+ *        Sequential reads grow the window each time half of it got consumed,
+ *        a jump starts over with the minimum window at the new position.
+ */
+static void readahead(GstMmapSrc *src, guint64 offset, guint64 length) {
+	guint64 end = offset + length, size = src->mapping->size, stop;
+
+	if (offset != src->next_offset) {
+		src->window = src->min_window;
+		src->advised_end = offset;
+	} else if (end + src->window / 2 > src->advised_end && src->advised_end > offset) {
+		src->window = MIN(src->window * 2, src->max_window);
+	}
+	src->next_offset = end;
+
+	if (end + src->window / 2 <= src->advised_end || src->advised_end >= size)
+		return;
+
+	stop = MIN(end + src->window, size);
+	advise(src, MAX(src->advised_end, offset), stop);
+	GST_LOG_OBJECT(src, "readahead %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT ", window %" G_GUINT64_FORMAT,
+			MAX(src->advised_end, offset), stop, src->window);
+	src->advised_end = stop;
+}
+
+static GstFlowReturn gst_mmap_src_create(GstBaseSrc *basesrc, guint64 offset, guint length, GstBuffer **buffer) {
+	GstMmapSrc *src = GST_MMAP_SRC(basesrc);
+	GstMmapSrcMapping *mapping = src->mapping;
+	GstBuffer *buf;
+
+	if (offset >= mapping->size)
+		return GST_FLOW_EOS;
+	length = MIN(length, mapping->size - offset);
+
+	readahead(src, offset, length);
+
+	/* no copy: the memory is a window on the mapping and holds a reference on it */
+	buf = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, mapping->data, mapping->size, offset, length,
+			mapping_ref(mapping), (GDestroyNotify)mapping_unref);
+	GST_BUFFER_OFFSET(buf) = offset;
+	GST_BUFFER_OFFSET_END(buf) = offset + length;
+
+	*buffer = buf;
+	return GST_FLOW_OK;
+}
+
+static gboolean gst_mmap_src_is_seekable(GstBaseSrc *basesrc) {
+	return TRUE;
+}
+
+static gboolean gst_mmap_src_get_size(GstBaseSrc *basesrc, guint64 *size) {
+	GstMmapSrc *src = GST_MMAP_SRC(basesrc);
+
+	if (src->mapping == NULL)
+		return FALSE;
+	*size = src->mapping->size;
+	return TRUE;
+}
+
+static void gst_mmap_src_class_init(GstMmapSrcClass *klass) {
+	GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+	GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS(klass);
+
+	gobject_class->set_property = gst_mmap_src_set_property;
+	gobject_class->get_property = gst_mmap_src_get_property;
+	gobject_class->finalize = gst_mmap_src_finalize;
+
+	g_object_class_install_property(gobject_class, PROP_LOCATION,
+			g_param_spec_string("location", "File Location", "Location of the file to read",
+				NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_MIN_READAHEAD,
+			g_param_spec_uint64("min-readahead", "Minimum readahead",
+				"Readahead window after a seek, in bytes", 0, G_MAXUINT64, DEFAULT_MIN_READAHEAD,
+				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(gobject_class, PROP_MAX_READAHEAD,
+			g_param_spec_uint64("max-readahead", "Maximum readahead",
+				"Largest readahead window for sequential reads, in bytes", 0, G_MAXUINT64, DEFAULT_MAX_READAHEAD,
+				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	gst_element_class_set_static_metadata(element_class, "Memory mapped file source", "Source/File",
+			"Reads a local file through mmap without copying", "GStreamer tutorials");
+	gst_element_class_add_static_pad_template(element_class, &src_template);
+
+	/* seekable, so basesrc answers the scheduling query with pull mode */
+	basesrc_class->start = GST_DEBUG_FUNCPTR(gst_mmap_src_start);
+	basesrc_class->stop = GST_DEBUG_FUNCPTR(gst_mmap_src_stop);
+	basesrc_class->create = GST_DEBUG_FUNCPTR(gst_mmap_src_create);
+	basesrc_class->is_seekable = GST_DEBUG_FUNCPTR(gst_mmap_src_is_seekable);
+	basesrc_class->get_size = GST_DEBUG_FUNCPTR(gst_mmap_src_get_size);
+}
+
+static void gst_mmap_src_init(GstMmapSrc *src) {
+	src->min_window = DEFAULT_MIN_READAHEAD;
+	src->max_window = DEFAULT_MAX_READAHEAD;
+	gst_base_src_set_blocksize(GST_BASE_SRC(src), DEFAULT_BLOCKSIZE);
+}
+
+/* GstURIHandler, file:// only */
+
+static GstURIType gst_mmap_src_uri_get_type(GType type) {
+	return GST_URI_SRC;
+}
+
+static const gchar *const *gst_mmap_src_uri_get_protocols(GType type) {
+	static const gchar *protocols[] = { "file", NULL };
+
+	return protocols;
+}
+
+static gchar *gst_mmap_src_uri_get_uri(GstURIHandler *handler) {
+	GstMmapSrc *src = GST_MMAP_SRC(handler);
+	gchar *uri;
+
+	GST_OBJECT_LOCK(src);
+	uri = g_strdup(src->uri);
+	GST_OBJECT_UNLOCK(src);
+	return uri;
+}
+
+static gboolean gst_mmap_src_uri_set_uri(GstURIHandler *handler, const gchar *uri, GError **error) {
+	gchar *location;
+	gboolean ret;
+
+	location = g_filename_from_uri(uri, NULL, error);
+	if (location == NULL)
+		return FALSE;
+	ret = gst_mmap_src_set_location(GST_MMAP_SRC(handler), location);
+	if (!ret)
+		g_set_error(error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE, "Changing the location while playing is not supported");
+	g_free(location);
+	return ret;
+}
+
+static void gst_mmap_src_uri_handler_init(gpointer g_iface, gpointer iface_data) {
+	GstURIHandlerInterface *iface = (GstURIHandlerInterface *)g_iface;
+
+	iface->get_type = gst_mmap_src_uri_get_type;
+	iface->get_protocols = gst_mmap_src_uri_get_protocols;
+	iface->get_uri = gst_mmap_src_uri_get_uri;
+	iface->set_uri = gst_mmap_src_uri_set_uri;
+}
+
+gboolean gst_mmap_src_register(guint rank) {
+	return gst_element_register(NULL, "mmapsrc", rank, GST_TYPE_MMAP_SRC);
+}
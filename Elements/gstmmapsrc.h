@@ -0,0 +1,65 @@
+#ifndef __GST_MMAP_SRC_H__
+#define __GST_MMAP_SRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+
+G_BEGIN_DECLS
+
+/*
+ * mmapsrc: memory mapped local file source.
+ *
+ * Maps the whole file once and hands out buffers pointing straight into the
+ * mapping, so reading costs page faults instead of read() syscalls and
+ * copies. Buffers keep the mapping alive, it is released when the last one
+ * is gone. Their memory is read-only: an element that wants to write into a
+ * buffer gets a copy, never the file.
+ *
+ * Readahead follows the consumer: sequential reads double a MADV_WILLNEED
+ * window ahead of the read position up to a limit, a jump (seek, demuxer
+ * index lookup) shrinks it back to the minimum.
+ *
+ * Handles file:// uris, gst_mmap_src_register() with a rank above
+ * GST_RANK_PRIMARY makes playbin prefer it over filesrc.
+ *
+ * Like every mmap reader it gets SIGBUS when the file is truncated while
+ * playing, use it for media libraries, not for files still being written.
+ */
+
+#define GST_TYPE_MMAP_SRC (gst_mmap_src_get_type())
+#define GST_MMAP_SRC(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_MMAP_SRC, GstMmapSrc))
+#define GST_MMAP_SRC_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_MMAP_SRC, GstMmapSrcClass))
+#define GST_IS_MMAP_SRC(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_MMAP_SRC))
+
+typedef struct _GstMmapSrc GstMmapSrc;
+typedef struct _GstMmapSrcClass GstMmapSrcClass;
+typedef struct _GstMmapSrcMapping GstMmapSrcMapping;
+
+struct _GstMmapSrc {
+	GstBaseSrc parent;
+
+	gchar *location;
+	gchar *uri;
+
+	GstMmapSrcMapping *mapping;	/* while started */
+
+	/* readahead state, streaming thread only */
+	guint64 next_offset;		/* where a sequential read continues */
+	guint64 advised_end;		/* WILLNEED given up to here */
+	guint64 window;			/* current readahead window, bytes */
+	guint64 min_window;
+	guint64 max_window;
+};
+
+struct _GstMmapSrcClass {
+	GstBaseSrcClass parent_class;
+};
+
+GType gst_mmap_src_get_type(void);
+
+/* make "mmapsrc" available to this process */
+gboolean gst_mmap_src_register(guint rank);
+
+G_END_DECLS
+
+#endif /* __GST_MMAP_SRC_H__ */
@@ -0,0 +1,51 @@
+#include "simd.h"
+
+static const GEnumValue simd_levels[] = {
+	{ SIMD_AUTO, "Best the CPU supports", "auto" },
+	{ SIMD_NONE, "Plain C", "none" },
+	{ SIMD_SSE2, "SSE2", "sse2" },
+	{ SIMD_SSE41, "SSE4.1", "sse4.1" },
+	{ SIMD_AVX2, "AVX2", "avx2" },
+	{ 0, NULL, NULL }
+};
+
+GType simd_level_get_type(void) {
+	static gsize type = 0;
+
+	if (g_once_init_enter(&type))
+		g_once_init_leave(&type, g_enum_register_static("SimdLevel", simd_levels));
+	return type;
+}
+
+SimdLevel simd_detect(void) {
+	static gsize level = 0;
+
+	if (g_once_init_enter(&level)) {
+		SimdLevel detected = SIMD_NONE;
+
+#ifdef SIMD_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			detected = SIMD_AVX2;
+		else if (__builtin_cpu_supports("sse4.1"))
+			detected = SIMD_SSE41;
+		else if (__builtin_cpu_supports("sse2"))
+			detected = SIMD_SSE2;
+#endif
+		/* g_once wants non-zero */
+		g_once_init_leave(&level, detected + 1);
+	}
+	return (SimdLevel)(level - 1);
+}
+
+SimdLevel simd_resolve(SimdLevel requested) {
+	SimdLevel best = simd_detect();
+
+	if (requested == SIMD_AUTO || requested > best)
+		return best;
+	return requested;
+}
+
+const gchar *simd_level_to_string(SimdLevel level) {
+	return simd_levels[level].value_nick;
+}
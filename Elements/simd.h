@@ -0,0 +1,41 @@
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Runtime instruction set selection for the elements' kernels.
+ *
+ * Kernels are compiled per instruction set with GCC target attributes, so the
+ * binary runs on any x86 CPU and picks the best kernels the CPU supports.
+ * Elements expose the choice as a "simd" property to benchmark the levels
+ * against each other; asking for more than the CPU has falls back to what
+ * it supports.
+ */
+typedef enum {
+	SIMD_AUTO = 0,	/* best the CPU supports */
+	SIMD_NONE,	/* plain C */
+	SIMD_SSE2,
+	SIMD_SSE41,
+	SIMD_AVX2
+} SimdLevel;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#define SIMD_TYPE_LEVEL (simd_level_get_type())
+GType simd_level_get_type(void);
+
+/* best level supported by this CPU */
+SimdLevel simd_detect(void);
+/* level to run with when asked for requested */
+SimdLevel simd_resolve(SimdLevel requested);
+const gchar *simd_level_to_string(SimdLevel level);
+
+G_END_DECLS
+
+#endif /* __SIMD_H__ */
@@ -0,0 +1,195 @@
+#include "audio-switcher.h"
+
+/* where we are with the switch in flight */
+enum {
+	SWITCH_IDLE = 0,
+	SWITCH_WAIT_SEGMENT,	/* requested, old track may still flow */
+	SWITCH_WAIT_BUFFER	/* new segment seen, next buffer is the new track */
+};
+
+struct _AudioSwitcher {
+	GstElement *playbin;
+	GstPad *pad;		/* audio sink pad */
+	gulong probe_id;
+	AudioSwitchMode mode;
+	AudioSwitchFunc func;
+	gpointer user_data;
+
+	GMutex lock;
+	GCond cond;
+	gint state;
+	gint index;		/* track switched to */
+	gboolean flushed;	/* sinks flushed since the request */
+	GstClockTime requested;	/* wall clock time of request */
+	GstClockTime latency;	/* of the last completed switch */
+	GstSegment segment;
+};
+
+static void handle_event(AudioSwitcher *switcher, GstEvent *event) {
+	g_mutex_lock(&switcher->lock);
+	switch (GST_EVENT_TYPE(event)) {
+		case GST_EVENT_FLUSH_STOP:
+			gst_segment_init(&switcher->segment, GST_FORMAT_TIME);
+			if (switcher->state != SWITCH_IDLE)
+				switcher->flushed = TRUE;
+			break;
+		case GST_EVENT_SEGMENT: {
+			const GstSegment *segment;
+
+			gst_event_parse_segment(event, &segment);
+			if (segment->format == GST_FORMAT_TIME)
+				gst_segment_copy_into(segment, &switcher->segment);
+			/* input-selector starts the newly selected stream with its own segment */
+			if (switcher->state == SWITCH_WAIT_SEGMENT)
+				switcher->state = SWITCH_WAIT_BUFFER;
+			break;
+		}
+		default:
+			break;
+	}
+	g_mutex_unlock(&switcher->lock);
+}
+
+/*
+ * @brief how long till a buffer arriving now gets rendered, 0 if unknown
+ *        Only meaningful when no flush happened, a flush redistributes base time.
+ */
+static GstClockTime render_delay(AudioSwitcher *switcher, GstBuffer *buffer) {
+	GstClockTime delay = 0;
+	GstClock *clock;
+	gint64 running;
+
+	if (!GST_BUFFER_PTS_IS_VALID(buffer))
+		return 0;
+	running = gst_segment_to_running_time(&switcher->segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+	if (running == GST_CLOCK_TIME_NONE)
+		return 0;
+	clock = gst_element_get_clock(switcher->playbin);
+	if (clock != NULL) {
+		gint64 now = GST_CLOCK_DIFF(gst_element_get_base_time(switcher->playbin), gst_clock_get_time(clock));
+		if (running > now)
+			delay = running - now;
+	}
+	if (clock != NULL)
+		gst_object_unref(clock);
+	return delay;
+}
+
+static void handle_buffer(AudioSwitcher *switcher, GstBuffer *buffer) {
+	GstClockTime latency;
+	gint index;
+
+	g_mutex_lock(&switcher->lock);
+	if (switcher->state != SWITCH_WAIT_BUFFER) {
+		g_mutex_unlock(&switcher->lock);
+		return;
+	}
+
+	latency = GST_CLOCK_DIFF(switcher->requested, gst_util_get_timestamp());
+	if (!switcher->flushed)
+		latency += render_delay(switcher, buffer);
+	switcher->latency = latency;
+	switcher->state = SWITCH_IDLE;
+	index = switcher->index;
+	g_cond_broadcast(&switcher->cond);
+	g_mutex_unlock(&switcher->lock);
+
+	if (switcher->func != NULL)
+		switcher->func(index, latency, switcher->user_data);
+}
+
+static GstPadProbeReturn probe_cb(GstPad *pad, GstPadProbeInfo *info, AudioSwitcher *switcher) {
+	if (info->type & GST_PAD_PROBE_TYPE_BUFFER)
+		handle_buffer(switcher, GST_PAD_PROBE_INFO_BUFFER(info));
+	else if (info->type & GST_PAD_PROBE_TYPE_EVENT_BOTH)
+		handle_event(switcher, GST_PAD_PROBE_INFO_EVENT(info));
+	return GST_PAD_PROBE_OK;
+}
+
+AudioSwitcher *audio_switcher_new(GstElement *playbin, GstElement *audio_sink, AudioSwitchMode mode,
+		AudioSwitchFunc func, gpointer user_data) {
+	AudioSwitcher *switcher;
+	GstPad *pad = gst_element_get_static_pad(audio_sink, "sink");
+
+	if (pad == NULL) {
+		g_printerr("Audio sink %s has no sink pad.\n", GST_ELEMENT_NAME(audio_sink));
+		return NULL;
+	}
+
+	switcher = g_new0(AudioSwitcher, 1);
+	switcher->playbin = gst_object_ref(playbin);
+	switcher->pad = pad;
+	switcher->mode = mode;
+	switcher->func = func;
+	switcher->user_data = user_data;
+	switcher->latency = GST_CLOCK_TIME_NONE;
+	g_mutex_init(&switcher->lock);
+	g_cond_init(&switcher->cond);
+	gst_segment_init(&switcher->segment, GST_FORMAT_TIME);
+
+	switcher->probe_id = gst_pad_add_probe(pad,
+			GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+			(GstPadProbeCallback)probe_cb, switcher, NULL);
+	return switcher;
+}
+
+void audio_switcher_free(AudioSwitcher *switcher) {
+	if (switcher == NULL)
+		return;
+
+	gst_pad_remove_probe(switcher->pad, switcher->probe_id);
+	gst_object_unref(switcher->pad);
+	gst_object_unref(switcher->playbin);
+	g_mutex_clear(&switcher->lock);
+	g_cond_clear(&switcher->cond);
+	g_free(switcher);
+}
+
+gboolean audio_switcher_mode_from_string(const gchar *str, AudioSwitchMode *mode) {
+	if (g_strcmp0(str, "plain") == 0) {
+		*mode = AUDIO_SWITCH_PLAIN;
+	} else if (g_strcmp0(str, "flush") == 0) {
+		*mode = AUDIO_SWITCH_FLUSH;
+	} else {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void audio_switcher_switch(AudioSwitcher *switcher, gint index) {
+	g_mutex_lock(&switcher->lock);
+	switcher->state = SWITCH_WAIT_SEGMENT;
+	switcher->index = index;
+	switcher->flushed = FALSE;
+	switcher->latency = GST_CLOCK_TIME_NONE;
+	switcher->requested = gst_util_get_timestamp();
+	g_mutex_unlock(&switcher->lock);
+
+	g_object_set(switcher->playbin, "current-audio", index, NULL);
+
+	if (switcher->mode == AUDIO_SWITCH_FLUSH) {
+		gint64 position;
+
+		/* drop old track audio queued downstream of the selector, stay where we are */
+		if (!gst_element_query_position(switcher->playbin, GST_FORMAT_TIME, &position) ||
+				!gst_element_seek_simple(switcher->playbin, GST_FORMAT_TIME,
+					GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, position)) {
+			g_printerr("Could not flush after switching audio, falling back to plain switch.\n");
+		}
+	}
+}
+
+GstClockTime audio_switcher_wait(AudioSwitcher *switcher, GstClockTime timeout) {
+	gint64 deadline = g_get_monotonic_time() + timeout / GST_USECOND;
+	GstClockTime latency;
+
+	g_mutex_lock(&switcher->lock);
+	while (switcher->state != SWITCH_IDLE) {
+		if (!g_cond_wait_until(&switcher->cond, &switcher->lock, deadline))
+			break;
+	}
+	latency = switcher->latency;
+	switcher->state = SWITCH_IDLE;
+	g_mutex_unlock(&switcher->lock);
+	return latency;
+}
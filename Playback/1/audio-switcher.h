@@ -0,0 +1,43 @@
+#ifndef __AUDIO_SWITCHER_H__
+#define __AUDIO_SWITCHER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Audio track switching on playbin with switch latency measurement.
+ *
+ * playbin decodes every audio track into its input-selector already, what
+ * makes a plain "current-audio" switch slow to hear is the old track's audio
+ * still queued in the sink. AUDIO_SWITCH_FLUSH follows the switch with a
+ * flushing seek to the current position, which drops that queue.
+ *
+ * Switch latency is measured on the audio sink pad given at creation: from
+ * the request to the moment the first sample of the new segment gets
+ * audible (arrival, plus how far ahead of the clock it was queued when no
+ * flush happened).
+ */
+typedef enum {
+	AUDIO_SWITCH_PLAIN = 0,	/* just set current-audio */
+	AUDIO_SWITCH_FLUSH	/* set current-audio, then flush the sinks */
+} AudioSwitchMode;
+
+typedef struct _AudioSwitcher AudioSwitcher;
+
+/* called from the streaming thread once a switch completed, latency in nsec */
+typedef void (*AudioSwitchFunc)(gint index, GstClockTime latency, gpointer user_data);
+
+AudioSwitcher *audio_switcher_new(GstElement *playbin, GstElement *audio_sink, AudioSwitchMode mode,
+		AudioSwitchFunc func, gpointer user_data);
+void audio_switcher_free(AudioSwitcher *switcher);
+
+gboolean audio_switcher_mode_from_string(const gchar *str, AudioSwitchMode *mode);
+
+void audio_switcher_switch(AudioSwitcher *switcher, gint index);
+/* block till the last switch completed, latency or GST_CLOCK_TIME_NONE on timeout */
+GstClockTime audio_switcher_wait(AudioSwitcher *switcher, GstClockTime timeout);
+
+G_END_DECLS
+
+#endif /* __AUDIO_SWITCHER_H__ */
@@ -0,0 +1,200 @@
+#include "bandwidth-estimator.h"
+
+/* weight of a new sample in the moving average */
+#define EWMA_ALPHA 0.3
+/* use this share of the estimate, leaves room for throughput dips */
+#define HEADROOM 0.8
+/* only change the connection speed if the target moved more than that */
+#define HYSTERESIS 0.15
+/* a window with less data than this says nothing about the link */
+#define MIN_SAMPLE_BYTES 4096
+
+struct _BandwidthEstimator {
+	GstElement *playbin;
+	guint interval;		/* msec */
+	guint timeout_id;
+	gulong notify_id;
+	BandwidthFunc func;
+	gpointer user_data;
+
+	/* protects everything below, written from the source's streaming thread */
+	GMutex lock;
+	GstPad *pad;		/* source src pad being counted */
+	gulong probe_id;
+	guint64 bytes;		/* since window_start */
+	GstClockTime window_start;
+	GstClockTime last_arrival;	/* of the last buffer in this window */
+
+	/* only touched from the main loop */
+	gdouble estimate;	/* bits per second, 0 if none yet */
+	guint64 speed;		/* applied connection speed, kbps */
+};
+
+/* @brief count bytes leaving the source, runs in streaming thread */
+static GstPadProbeReturn buffer_probe_cb(GstPad *pad, GstPadProbeInfo *info, BandwidthEstimator *estimator) {
+	g_mutex_lock(&estimator->lock);
+	estimator->bytes += gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info));
+	estimator->last_arrival = gst_util_get_timestamp();
+	g_mutex_unlock(&estimator->lock);
+	return GST_PAD_PROBE_OK;
+}
+
+static void detach_probe(BandwidthEstimator *estimator) {
+	if (estimator->pad != NULL) {
+		gst_pad_remove_probe(estimator->pad, estimator->probe_id);
+		gst_object_unref(estimator->pad);
+		estimator->pad = NULL;
+	}
+}
+
+/* @brief playbin created a new source, move the probe over */
+static void source_cb(GObject *playbin, GParamSpec *pspec, BandwidthEstimator *estimator) {
+	GstElement *source = NULL;
+
+	g_object_get(playbin, "source", &source, NULL);
+
+	g_mutex_lock(&estimator->lock);
+	detach_probe(estimator);
+	if (source != NULL) {
+		estimator->pad = gst_element_get_static_pad(source, "src");
+		if (estimator->pad != NULL)
+			estimator->probe_id = gst_pad_add_probe(estimator->pad, GST_PAD_PROBE_TYPE_BUFFER,
+					(GstPadProbeCallback)buffer_probe_cb, estimator, NULL);
+		else
+			g_printerr("Source %s has no src pad, can't measure bandwidth.\n", GST_ELEMENT_NAME(source));
+	}
+	estimator->bytes = 0;
+	estimator->window_start = gst_util_get_timestamp();
+	estimator->last_arrival = GST_CLOCK_TIME_NONE;
+	g_mutex_unlock(&estimator->lock);
+
+	if (source != NULL)
+		gst_object_unref(source);
+}
+
+static void set_speed(GObject *object, const GValue *value) {
+	if (g_object_class_find_property(G_OBJECT_GET_CLASS(object), "connection-speed") != NULL)
+		g_object_set_property(object, "connection-speed", value);
+}
+
+/*
+ * @brief apply speed (kbps) to playbin and everything inside it
+ *        playbin only hands its value to the next uri, the elements that are
+ *        already there have to be told directly.
+ */
+static void apply_speed(BandwidthEstimator *estimator, guint64 speed) {
+	GValue value = { 0 }, item = { 0 };
+	GstIterator *it;
+	gboolean done = FALSE;
+
+	g_value_init(&value, G_TYPE_UINT64);
+	g_value_set_uint64(&value, speed);
+	set_speed(G_OBJECT(estimator->playbin), &value);
+
+	it = gst_bin_iterate_recurse(GST_BIN(estimator->playbin));
+	while (!done) {
+		switch (gst_iterator_next(it, &item)) {
+			case GST_ITERATOR_OK:
+				set_speed(g_value_get_object(&item), &value);
+				g_value_reset(&item);
+				break;
+			case GST_ITERATOR_RESYNC:
+				/* setting the same value twice is harmless */
+				gst_iterator_resync(it);
+				break;
+			default:
+				done = TRUE;
+				break;
+		}
+	}
+	g_value_unset(&item);
+	gst_iterator_free(it);
+	g_value_unset(&value);
+}
+
+/* @brief close the current window, update estimate and connection speed */
+static gboolean sample_cb(BandwidthEstimator *estimator) {
+	GstClockTime now = gst_util_get_timestamp(), start, last, span;
+	guint64 bytes, measured, target, old_speed;
+
+	g_mutex_lock(&estimator->lock);
+	bytes = estimator->bytes;
+	start = estimator->window_start;
+	last = estimator->last_arrival;
+	estimator->bytes = 0;
+	estimator->window_start = now;
+	estimator->last_arrival = GST_CLOCK_TIME_NONE;
+	g_mutex_unlock(&estimator->lock);
+
+	/* source idle or blocked by full queues the whole window */
+	if (bytes < MIN_SAMPLE_BYTES || !GST_CLOCK_TIME_IS_VALID(last))
+		return TRUE;
+
+	/* data stopped early in the window: only count the time it was flowing */
+	span = now - start;
+	if (now - last > span / 2)
+		span = last - start;
+	if (span < GST_MSECOND)
+		return TRUE;
+
+	measured = gst_util_uint64_scale(bytes * 8, GST_SECOND, span);
+	if (estimator->estimate == 0)
+		estimator->estimate = measured;
+	else
+		estimator->estimate = EWMA_ALPHA * measured + (1.0 - EWMA_ALPHA) * estimator->estimate;
+
+	old_speed = estimator->speed;
+	target = MAX((guint64)(estimator->estimate * HEADROOM / 1000), 1);
+	if (old_speed == 0 || ABS((gdouble)target - (gdouble)old_speed) > HYSTERESIS * old_speed) {
+		apply_speed(estimator, target);
+		estimator->speed = target;
+	}
+
+	if (estimator->func != NULL) {
+		estimator->func(measured / 1000, (guint64)estimator->estimate / 1000, old_speed, estimator->speed,
+				estimator->user_data);
+	}
+	return TRUE;
+}
+
+BandwidthEstimator *bandwidth_estimator_new(GstElement *playbin, guint interval, guint64 initial_speed,
+		BandwidthFunc func, gpointer user_data) {
+	BandwidthEstimator *estimator = g_new0(BandwidthEstimator, 1);
+
+	estimator->playbin = gst_object_ref(playbin);
+	estimator->interval = interval;
+	estimator->func = func;
+	estimator->user_data = user_data;
+	estimator->speed = initial_speed;
+	estimator->last_arrival = GST_CLOCK_TIME_NONE;
+	g_mutex_init(&estimator->lock);
+
+	if (initial_speed > 0)
+		g_object_set(playbin, "connection-speed", initial_speed, NULL);
+
+	estimator->notify_id = g_signal_connect(playbin, "notify::source", G_CALLBACK(source_cb), estimator);
+	estimator->timeout_id = g_timeout_add(interval, (GSourceFunc)sample_cb, estimator);
+	return estimator;
+}
+
+void bandwidth_estimator_free(BandwidthEstimator *estimator) {
+	if (estimator == NULL)
+		return;
+
+	g_source_remove(estimator->timeout_id);
+	g_signal_handler_disconnect(estimator->playbin, estimator->notify_id);
+	g_mutex_lock(&estimator->lock);
+	detach_probe(estimator);
+	g_mutex_unlock(&estimator->lock);
+	gst_object_unref(estimator->playbin);
+	g_mutex_clear(&estimator->lock);
+	g_free(estimator);
+}
+
+guint64 bandwidth_estimator_get_estimate(BandwidthEstimator *estimator) {
+	return (guint64)estimator->estimate / 1000;
+}
+
+guint64 bandwidth_estimator_get_speed(BandwidthEstimator *estimator) {
+	return estimator->speed;
+}
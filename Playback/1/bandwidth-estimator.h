@@ -0,0 +1,40 @@
+#ifndef __BANDWIDTH_ESTIMATOR_H__
+#define __BANDWIDTH_ESTIMATOR_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Drives playbin's "connection-speed" from measured throughput.
+ *
+ * The bytes leaving playbin's source element are counted from a pad probe.
+ * Every interval the window's throughput is folded into an exponentially
+ * weighted moving average; windows where the source sat idle (downstream
+ * queues full) are skipped or shortened so backpressure does not read as a
+ * slow link. The smoothed estimate minus some headroom becomes the new
+ * connection speed once it moved far enough away from the current one.
+ *
+ * connection-speed is set on playbin (picked up by the next uri) and on
+ * every element inside it exposing the property (uridecodebin, network
+ * sources, adaptive demuxers), all in kbps.
+ */
+typedef struct _BandwidthEstimator BandwidthEstimator;
+
+/* called from the main loop after every sample, speeds in kbps */
+typedef void (*BandwidthFunc)(guint64 measured, guint64 estimate, guint64 old_speed, guint64 new_speed,
+		gpointer user_data);
+
+/* interval between samples in msec, initial_speed in kbps (0: unknown) */
+BandwidthEstimator *bandwidth_estimator_new(GstElement *playbin, guint interval, guint64 initial_speed,
+		BandwidthFunc func, gpointer user_data);
+void bandwidth_estimator_free(BandwidthEstimator *estimator);
+
+/* smoothed throughput in kbps, 0 before the first sample */
+guint64 bandwidth_estimator_get_estimate(BandwidthEstimator *estimator);
+/* connection speed currently applied, kbps */
+guint64 bandwidth_estimator_get_speed(BandwidthEstimator *estimator);
+
+G_END_DECLS
+
+#endif /* __BANDWIDTH_ESTIMATOR_H__ */
@@ -0,0 +1,138 @@
+/*
+ * Audio stream switch latency benchmark for the playback-tutorial1 pipeline.
+ *
+ * Plays a local file with several audio tracks into synchronized fakesinks
+ * and cycles "current-audio" N times per switch mode, recording the time from
+ * the request until the first sample of the new track gets audible.
+ * One JSON line is printed per mode.
+ *
+ * build: gcc playback-tutorial1-switch-bench.c audio-switcher.c ../../Common/latency-stats.c \
+ *            ../../Common/bench-util.c -o playback-tutorial1-switch-bench $(pkg-config --cflags --libs gstreamer-1.0)
+ */
+#include <gst/gst.h>
+
+#include "../../Common/bench-util.h"
+#include "../../Common/latency-stats.h"
+#include "audio-switcher.h"
+
+#define DEFAULT_SWITCHES 20
+#define DEFAULT_INTERVAL 500 /* msec of playback between two switches */
+#define SWITCH_TIMEOUT (5 * GST_SECOND)
+
+/*
+ * @brief play the file and switch audio tracks n_switches times in one mode
+ * */
+static gboolean run_mode(const gchar *uri, AudioSwitchMode mode, gint n_switches, gint interval, LatencyStats *stats) {
+	GstElement *playbin, *asink, *vsink;
+	AudioSwitcher *switcher = NULL;
+	GstBus *bus;
+	gint n_audio = 0, current = 0, i;
+	gboolean ok = FALSE;
+
+	playbin = gst_element_factory_make("playbin", "playbin");
+	asink = bench_sync_sink_new("asink", NULL, NULL);
+	vsink = bench_sync_sink_new("vsink", NULL, NULL);
+	if (!playbin || !asink || !vsink) {
+		g_printerr("Not all elements could be created.\n");
+		return FALSE;
+	}
+	g_object_set(playbin, "uri", uri, "audio-sink", asink, "video-sink", vsink, NULL);
+
+	bus = gst_element_get_bus(playbin);
+	if (gst_element_set_state(playbin, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE ||
+			!bench_wait_for(bus, GST_MESSAGE_ASYNC_DONE, SWITCH_TIMEOUT)) {
+		g_printerr("Unable to start playback.\n");
+		goto done;
+	}
+
+	g_object_get(playbin, "n-audio", &n_audio, "current-audio", &current, NULL);
+	if (n_audio < 2) {
+		g_printerr("Need a file with at least 2 audio streams, got %d.\n", n_audio);
+		goto done;
+	}
+
+	switcher = audio_switcher_new(playbin, asink, mode, NULL, NULL);
+	if (switcher == NULL)
+		goto done;
+
+	for (i = 0; i < n_switches; i++) {
+		GstClockTime latency;
+		GstMessage *msg;
+
+		/* let the current track play a bit, bail out on errors meanwhile */
+		msg = gst_bus_timed_pop_filtered(bus, interval * GST_MSECOND, GST_MESSAGE_ERROR | GST_MESSAGE_EOS);
+		if (msg != NULL) {
+			g_printerr("Playback stopped after %d switches.\n", i);
+			gst_message_unref(msg);
+			goto done;
+		}
+
+		current = (current + 1) % n_audio;
+		audio_switcher_switch(switcher, current);
+		latency = audio_switcher_wait(switcher, SWITCH_TIMEOUT);
+		if (GST_CLOCK_TIME_IS_VALID(latency)) {
+			latency_stats_add(stats, latency);
+		} else {
+			g_printerr("Switch to audio stream %d not completed.\n", current);
+		}
+	}
+	ok = TRUE;
+
+done:
+	audio_switcher_free(switcher);
+	gst_object_unref(bus);
+	gst_element_set_state(playbin, GST_STATE_NULL);
+	gst_object_unref(playbin);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	gint n_switches = DEFAULT_SWITCHES, interval = DEFAULT_INTERVAL, m, failures = 0;
+	gchar *modes_arg = NULL, *uri;
+	gchar **modes;
+	GOptionEntry entries[] = {
+		{ "switches", 'n', 0, G_OPTION_ARG_INT, &n_switches, "Switches per mode (default 20)", "N" },
+		{ "interval", 'i', 0, G_OPTION_ARG_INT, &interval, "Playback between switches in ms (default 500)", "MS" },
+		{ "modes", 'm', 0, G_OPTION_ARG_STRING, &modes_arg, "Comma separated switch modes (default plain,flush)", "LIST" },
+		{ NULL }
+	};
+
+	if (!bench_parse_options(&argc, &argv, "FILE - audio switch latency benchmark", entries))
+		return -1;
+
+	if (argc < 2) {
+		g_printerr("Usage: %s [OPTIONS] FILE\n", argv[0]);
+		return -1;
+	}
+
+	uri = bench_uri_from_arg(argv[1]);
+	if (uri == NULL)
+		return -1;
+
+	modes = g_strsplit(modes_arg ? modes_arg : "plain,flush", ",", -1);
+	for (m = 0; modes[m] != NULL; m++) {
+		AudioSwitchMode mode;
+		LatencyStats *stats;
+		gchar *json;
+
+		if (!audio_switcher_mode_from_string(modes[m], &mode)) {
+			g_printerr("Unknown switch mode '%s', expected plain or flush.\n", modes[m]);
+			failures++;
+			continue;
+		}
+
+		stats = latency_stats_new();
+		if (!run_mode(uri, mode, n_switches, interval, stats))
+			failures++;
+
+		json = latency_stats_to_json(stats);
+		g_print("{\"mode\":\"%s\",\"switches\":%d,\"latency\":%s}\n", modes[m], n_switches, json);
+		g_free(json);
+		latency_stats_free(stats);
+	}
+
+	g_strfreev(modes);
+	g_free(modes_arg);
+	g_free(uri);
+	return failures ? 1 : 0;
+}
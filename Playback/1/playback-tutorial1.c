@@ -1,7 +1,28 @@
+/*
+ * build: gcc playback-tutorial1.c audio-switcher.c bandwidth-estimator.c ../../Common/startup-profiler.c \
+ *            ../../Common/event-log.c ../../Common/buffering.c ../../Common/sched-policy.c -o playback-tutorial1 \
+ *            $(pkg-config --cflags --libs gstreamer-1.0)
+ *
+ * usage: playback-tutorial1 [OPTIONS] [URI]
+ *        Tools/throttled-httpd serves local files over a rate limited link.
+ */
 #include <gst/gst.h>
 
+#include "../../Common/startup-profiler.h"
+#include "../../Common/event-log.h"
+#include "../../Common/buffering.h"
+#include "../../Common/sched-policy.h"
+#include "audio-switcher.h"
+#include "bandwidth-estimator.h"
+
+#define DEFAULT_URI "http://docs.gstreamer.com/media/sintel_cropped_multilingual.webm"
+/* assume a modem till we measured something better, kbps */
+#define DEFAULT_CONNECTION_SPEED 56
+/* msec between two bandwidth samples */
+#define BANDWIDTH_INTERVAL 1000
+
 typedef struct _CustomData {
-	GstElement *playbin2;
+	GstElement *playbin;
 
 	gint n_video;               /* Number of video streams */
 	gint n_audio;               /* Number of audio streams */
@@ -11,10 +32,15 @@ typedef struct _CustomData {
 	gint current_audio;         /* Currently selected audio stream */
 	gint current_text;          /* Currently selected text stream */
 
+	AudioSwitcher *switcher;    /* switches audio streams, measures the gap */
+	BandwidthEstimator *bandwidth; /* feeds connection-speed, NULL if fixed */
+	Buffering *buffering;       /* pauses while the network catches up */
+	SchedPolicy *policy;        /* streaming thread placement, NULL leaves it to the OS */
+
 	GMainLoop *main_loop;       /* GLib's main loop */
 } CustomData;
 
-/* playbin2 flags */
+/* playbin flags */
 typedef enum {
 	GST_PLAY_FLAG_VIDEO = (1 << 0),
 	GST_PLAY_FLAG_AUDIO = (1 << 1),
@@ -23,37 +49,115 @@ typedef enum {
 
 static gboolean handle_message(GstBus* bus, GstMessage *msg, CustomData *data);
 static gboolean handle_keyboard(GIOChannel *source, GIOCondition cond, CustomData *data);
+static void switched_cb(gint index, GstClockTime latency, CustomData *data);
+static void bandwidth_cb(guint64 measured, guint64 estimate, guint64 old_speed, guint64 new_speed, CustomData *data);
 
 int main(int argc, char *argv[]) {
 	CustomData data;
-	GstBus *bus;
+	GstBus *bus = NULL;
 	GstStateChangeReturn ret;
 	gint flags;
-	GIOChannel *io_stdin;
+	GIOChannel *io_stdin = NULL;
+	GstElement *audio_sink;
+	AudioSwitchMode switch_mode = AUDIO_SWITCH_PLAIN;
+	gchar *switch_mode_arg = NULL;
+	gint connection_speed = 0;
+	gint ring_buffer = 0;
+	gchar *sched = NULL;
+	GOptionContext *ctx;
+	GError *err = NULL;
+	gint status = 0;
+	GOptionEntry entries[] = {
+		{ "switch-mode", 's', 0, G_OPTION_ARG_STRING, &switch_mode_arg, "Audio switch: plain or flush (default plain)", "MODE" },
+		{ "connection-speed", 'c', 0, G_OPTION_ARG_INT, &connection_speed, "Fixed connection speed in kbps (default: measured)", "KBPS" },
+		{ "ring-buffer", 0, 0, G_OPTION_ARG_INT, &ring_buffer, "Spool the stream to an on-disk ring buffer of this many MB (default off)", "MB" },
+		{ "sched", 0, 0, G_OPTION_ARG_STRING, &sched, "Pin and prioritize streaming threads, " SCHED_POLICY_SYNTAX, "RULES" },
+		{ NULL }
+	};
+
+	/* opt-in startup profiling, see startup-profiler.h */
+	startup_profiler_init();
+
+	ctx = g_option_context_new("[URI] - playbin stream selection tutorial");
+	g_option_context_add_main_entries(ctx, entries, NULL);
+	g_option_context_add_group(ctx, gst_init_get_option_group());
+	if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+		g_printerr("Failed to parse options: %s\n", err->message);
+		g_clear_error(&err);
+		g_option_context_free(ctx);
+		return -1;
+	}
+	g_option_context_free(ctx);
+	startup_profiler_mark("gst_init");
 
-	gst_init(&argc, &argv);
+	/* binary message log instead of printing every state change, see event-log.h */
+	event_log_open_from_env();
 
-	data.playbin2 = gst_element_factory_make("playbin2", "playbin2");
+	if (switch_mode_arg != NULL && !audio_switcher_mode_from_string(switch_mode_arg, &switch_mode)) {
+		g_printerr("Unknown switch mode '%s', expected plain or flush.\n", switch_mode_arg);
+		g_free(switch_mode_arg);
+		return -1;
+	}
+	g_free(switch_mode_arg);
 
-	if (!data.playbin2) {
+	/* everything the cleanup at the end frees, in case we bail out early */
+	data.switcher = NULL;
+	data.bandwidth = NULL;
+	data.buffering = NULL;
+	data.policy = NULL;
+	data.main_loop = NULL;
+
+	data.playbin = gst_element_factory_make("playbin", "playbin");
+	audio_sink = gst_element_factory_make("autoaudiosink", "audio-sink");
+	startup_profiler_mark("playbin created");
+
+	if (!data.playbin || !audio_sink) {
 		g_printerr("Not all elements could be created.\n");
 		return -1;
 	}
 
-	g_object_set(data.playbin2, "uri", "http://docs.gstreamer.com/media/sintel_cropped_multilingual.webm", NULL);
+	g_object_set(data.playbin, "uri", argc > 1 ? argv[1] : DEFAULT_URI, NULL);
 
+	/* our own audio sink, so the switcher can watch what reaches it */
+	g_object_set(data.playbin, "audio-sink", audio_sink, NULL);
+	data.switcher = audio_switcher_new(data.playbin, audio_sink, switch_mode, (AudioSwitchFunc)switched_cb, &data);
+	if (data.switcher == NULL) {
+		status = -1;
+		goto out;
+	}
 
 	/* show video, audio & ignore subtitles */
-	g_object_get(data.playbin2, "flags", &flags, NULL);
+	g_object_get(data.playbin, "flags", &flags, NULL);
 	flags |= GST_PLAY_FLAG_VIDEO | GST_PLAY_FLAG_AUDIO;
 	flags &= ~GST_PLAY_FLAG_TEXT;
-	g_object_set(data.playbin2, "flags", flags, NULL);
+	g_object_set(data.playbin, "flags", flags, NULL);
+
+	/* set connection speed, or keep adapting it to what the source delivers */
+	if (connection_speed > 0) {
+		g_object_set(data.playbin, "connection-speed", (guint64)connection_speed, NULL);
+	} else {
+		data.bandwidth = bandwidth_estimator_new(data.playbin, BANDWIDTH_INTERVAL, DEFAULT_CONNECTION_SPEED,
+				(BandwidthFunc)bandwidth_cb, &data);
+	}
+
+	startup_profiler_watch(data.playbin);
+
+	/* e.g. audio-sink=1/fifo:40 against underruns, see sched-policy.h */
+	if (sched != NULL) {
+		data.policy = sched_policy_new(sched);
+		if (data.policy == NULL) {
+			status = -1;
+			goto out;
+		}
+		sched_policy_watch(data.policy, data.playbin);
+	}
 
-	/* set connection speed*/
-	g_object_set(data.playbin2, "connection-speed", 56, NULL);
+	/* pause on buffering, optionally seek back into a disk cache, see buffering.h */
+	buffering_configure(data.playbin, (guint64)MAX(ring_buffer, 0) * 1024 * 1024);
+	data.buffering = buffering_new(data.playbin);
 
 	/* Add a bus watch */
-	bus = gst_element_get_bus(data.playbin2);
+	bus = gst_element_get_bus(data.playbin);
 	gst_bus_add_watch(bus, (GstBusFunc)handle_message, &data);
 
 	/* Add watch on stdin*/
@@ -65,11 +169,11 @@ int main(int argc, char *argv[]) {
 	g_io_add_watch(io_stdin, G_IO_IN, (GIOFunc)handle_keyboard, &data);
 
 	/* Start Playing */
-	ret = gst_element_set_state(data.playbin2, GST_STATE_PLAYING);
+	ret = buffering_set_state(data.buffering, GST_STATE_PLAYING);
 	if (ret == GST_STATE_CHANGE_FAILURE) {
 		g_printerr("Unable to set the pipeline to playing state.\n");
-		gst_object_unref(data.playbin2);
-		return -1;
+		status = -1;
+		goto out;
 	} else
 		g_print("Starting playback\n.");
 
@@ -77,13 +181,28 @@ int main(int argc, char *argv[]) {
 	data.main_loop = g_main_loop_new(NULL, FALSE);
 	g_main_loop_run(data.main_loop);
 
+	g_print("Rebuffered %u times, %.1f s stalled\n", buffering_rebuffer_count(data.buffering),
+			(gdouble)buffering_rebuffer_time(data.buffering) / GST_SECOND);
+
+out:
 	/* Free resources */
-	g_main_loop_unref(data.main_loop);
-	g_io_channel_unref(io_stdin);
-	gst_object_unref(bus);
-	gst_element_set_state(data.playbin2, GST_STATE_NULL);
-	gst_object_unref(data.playbin2);
-	return 0;
+	event_log_close();
+	buffering_free(data.buffering);
+	audio_switcher_free(data.switcher);
+	bandwidth_estimator_free(data.bandwidth);
+	if (data.main_loop != NULL)
+		g_main_loop_unref(data.main_loop);
+	if (io_stdin != NULL)
+		g_io_channel_unref(io_stdin);
+	if (bus != NULL)
+		gst_object_unref(bus);
+	gst_element_set_state(data.playbin, GST_STATE_NULL);
+	if (data.policy != NULL && status == 0)
+		sched_policy_print(data.policy);
+	sched_policy_free(data.policy);
+	g_free(sched);
+	gst_object_unref(data.playbin);
+	return status;
 }
 
 /* Extract some metadata from the streams and print it on the screen */
@@ -94,9 +213,9 @@ static void analyze_streams (CustomData *data) {
 	guint rate;
 
 	/* Read some properties */
-	g_object_get (data->playbin2, "n-video", &data->n_video, NULL);
-	g_object_get (data->playbin2, "n-audio", &data->n_audio, NULL);
-	g_object_get (data->playbin2, "n-text", &data->n_text, NULL);
+	g_object_get (data->playbin, "n-video", &data->n_video, NULL);
+	g_object_get (data->playbin, "n-audio", &data->n_audio, NULL);
+	g_object_get (data->playbin, "n-text", &data->n_text, NULL);
 
 	g_print ("%d video stream(s), %d audio stream(s), %d text stream(s)\n",
 			data->n_video, data->n_audio, data->n_text);
@@ -105,13 +224,13 @@ static void analyze_streams (CustomData *data) {
 	for (i = 0; i < data->n_video; i++) {
 		tags = NULL;
 		/* Retrieve the stream's video tags */
-		g_signal_emit_by_name (data->playbin2, "get-video-tags", i, &tags);
+		g_signal_emit_by_name (data->playbin, "get-video-tags", i, &tags);
 		if (tags) {
 			g_print ("video stream %d:\n", i);
 			gst_tag_list_get_string (tags, GST_TAG_VIDEO_CODEC, &str);
 			g_print ("  codec: %s\n", str ? str : "unknown");
 			g_free (str);
-			gst_tag_list_free (tags);
+			gst_tag_list_unref (tags);
 		}
 	}
 
@@ -119,7 +238,7 @@ static void analyze_streams (CustomData *data) {
 	for (i = 0; i < data->n_audio; i++) {
 		tags = NULL;
 		/* Retrieve the stream's audio tags */
-		g_signal_emit_by_name (data->playbin2, "get-audio-tags", i, &tags);
+		g_signal_emit_by_name (data->playbin, "get-audio-tags", i, &tags);
 		if (tags) {
 			g_print ("audio stream %d:\n", i);
 			if (gst_tag_list_get_string (tags, GST_TAG_AUDIO_CODEC, &str)) {
@@ -133,7 +252,7 @@ static void analyze_streams (CustomData *data) {
 			if (gst_tag_list_get_uint (tags, GST_TAG_BITRATE, &rate)) {
 				g_print ("  bitrate: %d\n", rate);
 			}
-			gst_tag_list_free (tags);
+			gst_tag_list_unref (tags);
 		}
 	}
 
@@ -141,20 +260,20 @@ static void analyze_streams (CustomData *data) {
 	for (i = 0; i < data->n_text; i++) {
 		tags = NULL;
 		/* Retrieve the stream's subtitle tags */
-		g_signal_emit_by_name (data->playbin2, "get-text-tags", i, &tags);
+		g_signal_emit_by_name (data->playbin, "get-text-tags", i, &tags);
 		if (tags) {
 			g_print ("subtitle stream %d:\n", i);
 			if (gst_tag_list_get_string (tags, GST_TAG_LANGUAGE_CODE, &str)) {
 				g_print ("  language: %s\n", str);
 				g_free (str);
 			}
-			gst_tag_list_free (tags);
+			gst_tag_list_unref (tags);
 		}
 	}
 
-	g_object_get (data->playbin2, "current-video", &data->current_video, NULL);
-	g_object_get (data->playbin2, "current-audio", &data->current_audio, NULL);
-	g_object_get (data->playbin2, "current-text", &data->current_text, NULL);
+	g_object_get (data->playbin, "current-video", &data->current_video, NULL);
+	g_object_get (data->playbin, "current-audio", &data->current_audio, NULL);
+	g_object_get (data->playbin, "current-text", &data->current_text, NULL);
 
 	g_print ("\n");
 	g_print ("Currently playing video stream %d, audio stream %d and text stream %d\n",
@@ -167,6 +286,13 @@ static gboolean handle_message (GstBus *bus, GstMessage *msg, CustomData *data)
 	GError *err;
 	gchar *debug_info;
 
+	event_log_message (msg);
+	if (buffering_handle_message (data->buffering, msg)) {
+		if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_BUFFERING)
+			g_print ("Buffering %3d%%\r", buffering_get_percent (data->buffering));
+		return TRUE;
+	}
+
 	switch (GST_MESSAGE_TYPE (msg)) {
 		case GST_MESSAGE_ERROR:
 			gst_message_parse_error (msg, &err, &debug_info);
@@ -181,18 +307,20 @@ static gboolean handle_message (GstBus *bus, GstMessage *msg, CustomData *data)
 			g_main_loop_quit (data->main_loop);
 			break;
 		case GST_MESSAGE_STATE_CHANGED: {
-																			GstState old_state, new_state, pending_state;
-																			gst_message_parse_state_changed (msg, &old_state, &new_state, &pending_state);
-						g_print("%s\tstate changed %s -> %s:\n",GST_MESSAGE_SRC_NAME(msg), gst_element_state_get_name(old_state), gst_element_state_get_name(new_state));
-																			if (GST_MESSAGE_SRC (msg) == GST_OBJECT (data->playbin2)) {
-																				if (new_state == GST_STATE_PLAYING) {
-																					/* Once we are in the playing state, analyze the streams */
-																					analyze_streams (data);
-																				}
-																			}
-																		} break;
-    default:
-      break;
+			GstState old_state, new_state, pending_state;
+
+			gst_message_parse_state_changed (msg, &old_state, &new_state, &pending_state);
+			if (!event_log_enabled ())
+				g_print("%s\tstate changed %s -> %s:\n",GST_MESSAGE_SRC_NAME(msg), gst_element_state_get_name(old_state), gst_element_state_get_name(new_state));
+			if (GST_MESSAGE_SRC (msg) == GST_OBJECT (data->playbin)) {
+				if (new_state == GST_STATE_PLAYING) {
+					/* Once we are in the playing state, analyze the streams */
+					analyze_streams (data);
+				}
+			}
+		} break;
+		default:
+			break;
 	}
 
 	/* We want to keep receiving messages */
@@ -209,10 +337,26 @@ static gboolean handle_keyboard(GIOChannel *source, GIOCondition cond, CustomDat
 			g_printerr("Index out of bounds.\n");
 		} else {
 			g_print("Setting audio stream to : %d.\n", index);
-			g_object_set(data->playbin2, "current-audio", index, NULL);
+			audio_switcher_switch(data->switcher, index);
 		}
 	}
 
 	g_free(str);
 	return TRUE;
 }
+
+/* Audio stream switch completed, called from the streaming thread */
+static void switched_cb(gint index, GstClockTime latency, CustomData *data) {
+	g_print("Audio stream %d audible after %.1f ms.\n", index, (gdouble)latency / GST_MSECOND);
+}
+
+/* One bandwidth sample taken, log what we did with connection-speed */
+static void bandwidth_cb(guint64 measured, guint64 estimate, guint64 old_speed, guint64 new_speed, CustomData *data) {
+	if (new_speed != old_speed) {
+		g_print("Bandwidth %" G_GUINT64_FORMAT " kbps (smoothed %" G_GUINT64_FORMAT "), connection-speed %"
+				G_GUINT64_FORMAT " -> %" G_GUINT64_FORMAT " kbps.\n", measured, estimate, old_speed, new_speed);
+	} else {
+		g_print("Bandwidth %" G_GUINT64_FORMAT " kbps (smoothed %" G_GUINT64_FORMAT "), keeping connection-speed %"
+				G_GUINT64_FORMAT " kbps.\n", measured, estimate, old_speed);
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ * Offline decoder for binary event logs written by Common/event-log.
+ *
+ * build: gcc event-log-decode.c -o event-log-decode $(pkg-config --cflags --libs gstreamer-1.0)
+ * usage: event-log-decode LOGFILE
+ */
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+
+#include "../Common/event-log.h"
+
+static void print_record(const EventLogHeader *header, const EventLogRecord *record) {
+	gchar source[EVENT_LOG_SOURCE_LEN + 1];
+
+	/* source is NUL padded, not necessarily terminated */
+	memcpy(source, record->source, EVENT_LOG_SOURCE_LEN);
+	source[EVENT_LOG_SOURCE_LEN] = '\0';
+
+	g_print("%12.6f  %-16s  %-16s", (gdouble)GST_CLOCK_DIFF(header->mono_start, record->timestamp) / GST_SECOND,
+			source, gst_message_type_get_name(record->type));
+	switch (record->type) {
+		case GST_MESSAGE_STATE_CHANGED:
+			g_print("  %s -> %s", gst_element_state_get_name(record->arg0), gst_element_state_get_name(record->arg1));
+			break;
+		case GST_MESSAGE_BUFFERING:
+			g_print("  %u%%", record->arg0);
+			break;
+		default:
+			break;
+	}
+	g_print("\n");
+}
+
+int main(int argc, char *argv[]) {
+	EventLogHeader header;
+	EventLogRecord record;
+	GDateTime *start;
+	gchar *start_str;
+	guint64 count = 0;
+	FILE *file;
+
+	gst_init(&argc, &argv);
+
+	if (argc < 2) {
+		g_printerr("Usage: %s LOGFILE\n", argv[0]);
+		return -1;
+	}
+
+	file = fopen(argv[1], "rb");
+	if (file == NULL) {
+		g_printerr("Could not open '%s'.\n", argv[1]);
+		return -1;
+	}
+
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+			memcmp(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic)) != 0) {
+		g_printerr("'%s' is not an event log.\n", argv[1]);
+		fclose(file);
+		return -1;
+	}
+	if (header.version != EVENT_LOG_VERSION || header.record_size != sizeof(EventLogRecord)) {
+		g_printerr("Unsupported event log version %u (record size %u).\n", header.version, header.record_size);
+		fclose(file);
+		return -1;
+	}
+
+	start = g_date_time_new_from_unix_local(header.wall_start / G_USEC_PER_SEC);
+	start_str = g_date_time_format(start, "%F %T");
+	g_print("# log started %s, seconds since start / source / message\n", start_str);
+	g_free(start_str);
+	g_date_time_unref(start);
+
+	while (fread(&record, sizeof(record), 1, file) == 1) {
+		print_record(&header, &record);
+		count++;
+	}
+	g_print("# %" G_GUINT64_FORMAT " records\n", count);
+
+	fclose(file);
+	return 0;
+}
@@ -0,0 +1,520 @@
+/*
+ * Offline network playback benchmark.
+ *
+ * Generates a test clip (VP8 video and two Vorbis tracks in WebM), serves it
+ * from a local throttled HTTP server and plays it through the pipelines of
+ * the network tutorials under a set of link profiles:
+ *   basic3     uridecodebin, one queue ! sink branch per stream (Basic/3)
+ *   basic4     playbin (Basic/4)
+ *   playback1  playbin with connection-speed set to the link rate (Playback/1)
+ * Sinks are synchronized fakesinks and every pipeline pauses on buffering
+ * through Common/buffering, like the tutorials do.
+ *
+ * One JSON line per profile and pipeline: startup time, rebuffers and stall
+ * time during --play seconds of playback, then the latency of --seeks key
+ * unit seeks till ASYNC_DONE and till playback resumed.
+ *
+ * build: gcc network-bench.c throttled-http-server.c ../Common/buffering.c ../Common/seek-modes.c \
+ *            ../Common/latency-stats.c ../Common/bench-util.c -o network-bench \
+ *            $(pkg-config --cflags --libs gstreamer-1.0 gio-2.0)
+ */
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include "throttled-http-server.h"
+#include "../Common/bench-util.h"
+#include "../Common/buffering.h"
+#include "../Common/latency-stats.h"
+#include "../Common/seek-modes.h"
+
+#define DEFAULT_DURATION 60	/* sec of generated media */
+#define DEFAULT_PLAY 10		/* sec of playback before seeking */
+#define DEFAULT_SEEKS 5
+#define STARTUP_TIMEOUT (60 * GST_SECOND)
+#define SEEK_TIMEOUT (30 * GST_SECOND)
+/* playback between two seeks */
+#define SEEK_INTERVAL (2 * GST_SECOND)
+
+typedef struct _Profile {
+	const gchar *name;
+	guint rate;		/* kbps, 0 unlimited */
+	guint latency;		/* round trip, msec */
+	gdouble loss;		/* chunk loss probability */
+} Profile;
+
+/* the test clip is about 1 Mbps */
+static const Profile profiles[] = {
+	{ "lan", 0, 0, 0.0 },
+	{ "cable", 20000, 20, 0.0 },
+	{ "dsl", 4000, 40, 0.001 },
+	{ "wifi-lossy", 8000, 30, 0.05 },
+	{ "3g", 1500, 150, 0.01 },
+	{ "edge", 300, 400, 0.02 },
+	{ NULL }
+};
+
+typedef enum {
+	PIPELINE_BASIC3 = 0,
+	PIPELINE_BASIC4,
+	PIPELINE_PLAYBACK1,
+	PIPELINE_LAST
+} PipelineKind;
+
+static const gchar *pipeline_names[PIPELINE_LAST] = { "basic3", "basic4", "playback1" };
+
+/* local server, living in its own thread & main context */
+typedef struct _ServerThread {
+	const gchar *root;
+	GThread *thread;
+	GMainLoop *loop;
+	ThrottledHttpServer *server;
+
+	GMutex lock;
+	GCond cond;
+	gboolean ready;
+} ServerThread;
+
+/* one pipeline being benchmarked */
+typedef struct _Run {
+	GstElement *pipeline;
+	GstBus *bus;
+	Buffering *buffering;
+	GstState state;		/* last state the pipeline reported */
+	gboolean async_done;	/* since last cleared */
+	gboolean eos;
+	gboolean error;
+} Run;
+
+typedef gboolean (*RunCondition)(Run *run);
+
+static gpointer server_thread_func(ServerThread *st) {
+	GMainContext *context = g_main_context_new();
+	GError *err = NULL;
+
+	/* the server's socket gets dispatched from our context */
+	g_main_context_push_thread_default(context);
+	st->server = throttled_http_server_new(st->root, 0, &err);
+	if (st->server == NULL) {
+		g_printerr("Could not start server: %s\n", err->message);
+		g_clear_error(&err);
+	}
+	st->loop = g_main_loop_new(context, FALSE);
+
+	g_mutex_lock(&st->lock);
+	st->ready = TRUE;
+	g_cond_signal(&st->cond);
+	g_mutex_unlock(&st->lock);
+
+	if (st->server != NULL) {
+		g_main_loop_run(st->loop);
+		throttled_http_server_free(st->server);
+	}
+	g_main_loop_unref(st->loop);
+	g_main_context_pop_thread_default(context);
+	g_main_context_unref(context);
+	return NULL;
+}
+
+static gboolean server_thread_start(ServerThread *st, const gchar *root) {
+	memset(st, 0, sizeof(*st));
+	st->root = root;
+	g_mutex_init(&st->lock);
+	g_cond_init(&st->cond);
+	st->thread = g_thread_new("http-server", (GThreadFunc)server_thread_func, st);
+
+	g_mutex_lock(&st->lock);
+	while (!st->ready)
+		g_cond_wait(&st->cond, &st->lock);
+	g_mutex_unlock(&st->lock);
+	return st->server != NULL;
+}
+
+static void server_thread_stop(ServerThread *st) {
+	if (st->server != NULL)
+		g_main_loop_quit(st->loop);
+	g_thread_join(st->thread);
+	g_mutex_clear(&st->lock);
+	g_cond_clear(&st->cond);
+}
+
+/* @brief encode the test clip, once per duration */
+static gboolean generate_media(const gchar *path, gint duration) {
+	GstElement *pipeline;
+	GstBus *bus;
+	GstMessage *msg;
+	GError *err = NULL;
+	gchar *tmp_path, *desc;
+	gboolean ok = FALSE;
+
+	if (g_file_test(path, G_FILE_TEST_EXISTS))
+		return TRUE;
+
+	g_printerr("Generating %d s test clip %s...\n", duration, path);
+	tmp_path = g_strconcat(path, ".part", NULL);
+	desc = g_strdup_printf("webmmux name=mux ! filesink location=\"%s\" "
+			"videotestsrc num-buffers=%d ! video/x-raw,format=I420,width=640,height=360,framerate=25/1 ! "
+			"vp8enc bitrate=800000 ! queue ! mux. "
+			"audiotestsrc num-buffers=%d samplesperbuffer=441 freq=440 ! audioconvert ! vorbisenc ! queue ! mux. "
+			"audiotestsrc num-buffers=%d samplesperbuffer=441 freq=660 ! audioconvert ! vorbisenc ! queue ! mux.",
+			tmp_path, duration * 25, duration * 100, duration * 100);
+	pipeline = gst_parse_launch(desc, &err);
+	g_free(desc);
+	if (pipeline == NULL) {
+		g_printerr("Could not build encoder: %s\n", err->message);
+		g_clear_error(&err);
+		g_free(tmp_path);
+		return FALSE;
+	}
+
+	bus = gst_element_get_bus(pipeline);
+	gst_element_set_state(pipeline, GST_STATE_PLAYING);
+	msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+	if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+		gchar *debug_info;
+
+		gst_message_parse_error(msg, &err, &debug_info);
+		g_printerr("Encoding failed in %s : %s\n", GST_OBJECT_NAME(msg->src), err->message);
+		g_clear_error(&err);
+		g_free(debug_info);
+	} else {
+		ok = TRUE;
+	}
+	gst_message_unref(msg);
+	gst_object_unref(bus);
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pipeline);
+
+	/* only complete clips get the final name */
+	if (ok && g_rename(tmp_path, path) != 0) {
+		g_printerr("Could not rename %s\n", tmp_path);
+		ok = FALSE;
+	}
+	if (!ok)
+		g_unlink(tmp_path);
+	g_free(tmp_path);
+	return ok;
+}
+
+/* @brief basic-tutorial3 style branch for every decoded stream */
+static void pad_added_cb(GstElement *src, GstPad *pad, GstElement *pipeline) {
+	GstElement *queue = gst_element_factory_make("queue", NULL);
+	GstElement *sink = bench_sync_sink_new(NULL, NULL, NULL);
+	GstPad *sink_pad;
+	GstPadLinkReturn ret;
+
+	if (queue == NULL || sink == NULL) {
+		g_printerr("Couldn't create branch elements\n");
+		if (queue)
+			gst_object_unref(queue);
+		if (sink)
+			gst_object_unref(sink);
+		return;
+	}
+	gst_bin_add_many(GST_BIN(pipeline), queue, sink, NULL);
+	if (!gst_element_link(queue, sink)) {
+		g_printerr("Couldn't link the branch for %s\n", GST_PAD_NAME(pad));
+		gst_bin_remove_many(GST_BIN(pipeline), queue, sink, NULL);
+		return;
+	}
+	gst_element_sync_state_with_parent(sink);
+	gst_element_sync_state_with_parent(queue);
+
+	sink_pad = gst_element_get_static_pad(queue, "sink");
+	ret = gst_pad_link(pad, sink_pad);
+	gst_object_unref(sink_pad);
+	if (GST_PAD_LINK_FAILED(ret)) {
+		/* an unlinked sink would never preroll and stall the whole run */
+		g_printerr("Couldn't link %s: %s\n", GST_PAD_NAME(pad), gst_pad_link_get_name(ret));
+		gst_element_set_state(sink, GST_STATE_NULL);
+		gst_element_set_state(queue, GST_STATE_NULL);
+		gst_bin_remove_many(GST_BIN(pipeline), queue, sink, NULL);
+	}
+}
+
+static GstElement *build_pipeline(PipelineKind kind, const gchar *uri, const Profile *profile, guint64 ring_buffer) {
+	GstElement *pipeline, *source;
+
+	if (kind == PIPELINE_BASIC3) {
+		pipeline = gst_pipeline_new("basic3");
+		source = gst_element_factory_make("uridecodebin", NULL);
+		if (!pipeline || !source) {
+			g_printerr("Not all elements could be created.\n");
+			return NULL;
+		}
+		gst_bin_add(GST_BIN(pipeline), source);
+		g_object_set(source, "uri", uri, NULL);
+		g_signal_connect(source, "pad-added", G_CALLBACK(pad_added_cb), pipeline);
+		buffering_configure(source, ring_buffer);
+		return pipeline;
+	}
+
+	pipeline = gst_element_factory_make("playbin", pipeline_names[kind]);
+	if (!pipeline) {
+		g_printerr("Not all elements could be created.\n");
+		return NULL;
+	}
+	g_object_set(pipeline, "uri", uri, "video-sink", bench_sync_sink_new("vsink", NULL, NULL),
+			"audio-sink", bench_sync_sink_new("asink", NULL, NULL), NULL);
+	if (kind == PIPELINE_PLAYBACK1)
+		g_object_set(pipeline, "connection-speed", (guint64)profile->rate, NULL);
+	buffering_configure(pipeline, ring_buffer);
+	return pipeline;
+}
+
+static void handle_message(Run *run, GstMessage *msg) {
+	if (buffering_handle_message(run->buffering, msg))
+		return;
+
+	switch (GST_MESSAGE_TYPE(msg)) {
+		case GST_MESSAGE_ERROR: {
+			GError *err;
+			gchar *debug_info;
+
+			gst_message_parse_error(msg, &err, &debug_info);
+			g_printerr("Error received from element %s : %s\n", GST_OBJECT_NAME(msg->src), err->message);
+			g_clear_error(&err);
+			g_free(debug_info);
+			run->error = TRUE;
+			break;
+		}
+		case GST_MESSAGE_EOS:
+			run->eos = TRUE;
+			break;
+		case GST_MESSAGE_STATE_CHANGED:
+			if (GST_MESSAGE_SRC(msg) == GST_OBJECT(run->pipeline))
+				gst_message_parse_state_changed(msg, NULL, &run->state, NULL);
+			break;
+		case GST_MESSAGE_ASYNC_DONE:
+			run->async_done = TRUE;
+			break;
+		default:
+			break;
+	}
+}
+
+static gboolean is_playing(Run *run) {
+	return run->state == GST_STATE_PLAYING && !buffering_is_buffering(run->buffering);
+}
+
+static gboolean is_async_done(Run *run) {
+	return run->async_done;
+}
+
+/*
+ * @brief handle bus messages till cond holds or deadline passed
+ * @return TRUE once cond holds, or on deadline when cond is NULL
+ *         FALSE on timeout, error or EOS
+ */
+static gboolean run_until(Run *run, RunCondition cond, GstClockTime deadline) {
+	while (cond == NULL || !cond(run)) {
+		GstClockTime now = gst_util_get_timestamp();
+		GstMessage *msg;
+
+		if (run->error || run->eos)
+			return FALSE;
+		if (now >= deadline)
+			return cond == NULL;
+
+		msg = gst_bus_timed_pop(run->bus, deadline - now);
+		if (msg != NULL) {
+			handle_message(run, msg);
+			gst_message_unref(msg);
+		}
+	}
+	return TRUE;
+}
+
+static gboolean run_seeks(Run *run, gint n_seeks, gint duration, GRand *rand,
+		LatencyStats *async_done, LatencyStats *resume) {
+	gint i;
+
+	for (i = 0; i < n_seeks; i++) {
+		gint64 target = (gint64)(g_rand_double_range(rand, 0, duration * 0.9) * GST_SECOND);
+		GstClockTime start;
+
+		run->async_done = FALSE;
+		run->eos = FALSE;
+		start = gst_util_get_timestamp();
+		if (!seek_mode_seek(run->pipeline, SEEK_MODE_KEY_UNIT, target)) {
+			g_printerr("Seek to %" GST_TIME_FORMAT " failed\n", GST_TIME_ARGS(target));
+			return FALSE;
+		}
+
+		if (!run_until(run, is_async_done, start + SEEK_TIMEOUT)) {
+			g_printerr("Seek to %" GST_TIME_FORMAT " did not complete\n", GST_TIME_ARGS(target));
+			return FALSE;
+		}
+		latency_stats_add(async_done, GST_CLOCK_DIFF(start, gst_util_get_timestamp()));
+
+		/* prerolled, now until data flows & the clock runs again */
+		gst_element_get_state(run->pipeline, &run->state, NULL, 0);
+		if (!run_until(run, is_playing, start + SEEK_TIMEOUT)) {
+			g_printerr("Playback did not resume after seek to %" GST_TIME_FORMAT "\n", GST_TIME_ARGS(target));
+			return FALSE;
+		}
+		latency_stats_add(resume, GST_CLOCK_DIFF(start, gst_util_get_timestamp()));
+
+		run_until(run, NULL, gst_util_get_timestamp() + SEEK_INTERVAL);
+		if (run->error)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* @brief one pipeline under one profile, prints its JSON line */
+static gboolean run_pipeline(PipelineKind kind, const gchar *uri, const Profile *profile, guint64 ring_buffer,
+		gint play, gint n_seeks, gint duration, GRand *rand) {
+	Run run;
+	LatencyStats *async_done, *resume;
+	gchar *async_json, *resume_json, *startup = NULL, *stall = NULL;
+	guint rebuffers = 0;
+	gboolean ok = FALSE;
+
+	memset(&run, 0, sizeof(run));
+	run.pipeline = build_pipeline(kind, uri, profile, ring_buffer);
+	if (run.pipeline == NULL)
+		return FALSE;
+	run.bus = gst_element_get_bus(run.pipeline);
+	run.buffering = buffering_new(run.pipeline);
+	async_done = latency_stats_new();
+	resume = latency_stats_new();
+
+	if (buffering_set_state(run.buffering, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE ||
+			!run_until(&run, is_playing, gst_util_get_timestamp() + STARTUP_TIMEOUT)) {
+		g_printerr("%s did not start playing under profile %s\n", pipeline_names[kind], profile->name);
+		goto done;
+	}
+	startup = g_strdup_printf("%.1f", (gdouble)buffering_startup_time(run.buffering) / GST_MSECOND);
+
+	/* rebuffers of plain playback, seeks cause their own */
+	if (!run_until(&run, NULL, gst_util_get_timestamp() + play * GST_SECOND) && run.error)
+		goto done;
+	rebuffers = buffering_rebuffer_count(run.buffering);
+	stall = g_strdup_printf("%.1f", (gdouble)buffering_rebuffer_time(run.buffering) / GST_MSECOND);
+
+	ok = run_seeks(&run, n_seeks, duration, rand, async_done, resume);
+
+done:
+	async_json = latency_stats_to_json(async_done);
+	resume_json = latency_stats_to_json(resume);
+	g_print("{\"profile\":\"%s\",\"rate_kbps\":%u,\"latency_ms\":%u,\"loss\":%.3f,\"pipeline\":\"%s\","
+			"\"startup_ms\":%s,\"rebuffers\":%u,\"stall_ms\":%s,\"seek_async_done\":%s,\"seek_resume\":%s}\n",
+			profile->name, profile->rate, profile->latency, profile->loss, pipeline_names[kind],
+			startup ? startup : "null", rebuffers, stall ? stall : "null", async_json, resume_json);
+	g_free(async_json);
+	g_free(resume_json);
+	g_free(startup);
+	g_free(stall);
+	latency_stats_free(async_done);
+	latency_stats_free(resume);
+
+	buffering_set_state(run.buffering, GST_STATE_NULL);
+	buffering_free(run.buffering);
+	gst_object_unref(run.bus);
+	gst_object_unref(run.pipeline);
+	return ok;
+}
+
+static const Profile *find_profile(const gchar *name) {
+	const Profile *profile;
+
+	for (profile = profiles; profile->name != NULL; profile++) {
+		if (g_strcmp0(profile->name, name) == 0)
+			return profile;
+	}
+	return NULL;
+}
+
+static gboolean find_pipeline(const gchar *name, PipelineKind *kind) {
+	gint i;
+
+	for (i = 0; i < PIPELINE_LAST; i++) {
+		if (g_strcmp0(pipeline_names[i], name) == 0) {
+			*kind = i;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+int main(int argc, char *argv[]) {
+	ServerThread st;
+	GRand *rand;
+	gint duration = DEFAULT_DURATION, play = DEFAULT_PLAY, n_seeks = DEFAULT_SEEKS, ring_buffer = 0, seed = 0;
+	gint p, k, failures = 0;
+	gchar *profiles_arg = NULL, *pipelines_arg = NULL, *media_dir = NULL, *media_name, *media_path;
+	gchar **profile_names, **pipeline_args;
+	GOptionEntry entries[] = {
+		{ "profiles", 'p', 0, G_OPTION_ARG_STRING, &profiles_arg, "Comma separated link profiles (default all: lan, cable, dsl, wifi-lossy, 3g, edge)", "LIST" },
+		{ "pipelines", 0, 0, G_OPTION_ARG_STRING, &pipelines_arg, "Comma separated pipelines (default all: basic3, basic4, playback1)", "LIST" },
+		{ "play", 0, 0, G_OPTION_ARG_INT, &play, "Seconds of playback before seeking (default 10)", "SEC" },
+		{ "seeks", 'n', 0, G_OPTION_ARG_INT, &n_seeks, "Seeks per run (default 5)", "N" },
+		{ "duration", 'd', 0, G_OPTION_ARG_INT, &duration, "Length of the generated clip in seconds (default 60)", "SEC" },
+		{ "media-dir", 0, 0, G_OPTION_ARG_FILENAME, &media_dir, "Where to keep the generated clip (default: temp dir)", "DIR" },
+		{ "ring-buffer", 0, 0, G_OPTION_ARG_INT, &ring_buffer, "Spool to an on-disk ring buffer of this many MB (default off)", "MB" },
+		{ "seed", 0, 0, G_OPTION_ARG_INT, &seed, "Random seed for seek targets (default 0)", "SEED" },
+		{ NULL }
+	};
+
+	if (!bench_parse_options(&argc, &argv, "- network playback benchmark against a local throttled server", entries))
+		return -1;
+
+	if (duration <= 0) {
+		g_printerr("Duration must be positive.\n");
+		return -1;
+	}
+	if (media_dir == NULL)
+		media_dir = g_strdup(g_get_tmp_dir());
+	media_name = g_strdup_printf("network-bench-%ds.webm", duration);
+	media_path = g_build_filename(media_dir, media_name, NULL);
+	if (!generate_media(media_path, duration) || !server_thread_start(&st, media_dir)) {
+		g_free(media_path);
+		g_free(media_name);
+		g_free(media_dir);
+		return -1;
+	}
+
+	rand = g_rand_new_with_seed(seed);
+	profile_names = g_strsplit(profiles_arg ? profiles_arg : "lan,cable,dsl,wifi-lossy,3g,edge", ",", -1);
+	pipeline_args = g_strsplit(pipelines_arg ? pipelines_arg : "basic3,basic4,playback1", ",", -1);
+	for (p = 0; profile_names[p] != NULL; p++) {
+		const Profile *profile = find_profile(profile_names[p]);
+		gchar *uri;
+
+		if (profile == NULL) {
+			g_printerr("Unknown profile '%s'\n", profile_names[p]);
+			failures++;
+			continue;
+		}
+		throttled_http_server_set_rate(st.server, profile->rate);
+		throttled_http_server_set_latency(st.server, profile->latency);
+		throttled_http_server_set_loss(st.server, profile->loss);
+		uri = g_strdup_printf("http://127.0.0.1:%u/%s", throttled_http_server_get_port(st.server), media_name);
+
+		for (k = 0; pipeline_args[k] != NULL; k++) {
+			PipelineKind kind;
+
+			if (!find_pipeline(pipeline_args[k], &kind)) {
+				g_printerr("Unknown pipeline '%s'\n", pipeline_args[k]);
+				failures++;
+				continue;
+			}
+			if (!run_pipeline(kind, uri, profile, (guint64)MAX(ring_buffer, 0) * 1024 * 1024,
+						play, n_seeks, duration, rand))
+				failures++;
+		}
+		g_free(uri);
+	}
+
+	g_strfreev(profile_names);
+	g_strfreev(pipeline_args);
+	g_rand_free(rand);
+	server_thread_stop(&st);
+	g_free(profiles_arg);
+	g_free(pipelines_arg);
+	g_free(media_path);
+	g_free(media_name);
+	g_free(media_dir);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,363 @@
+#include <string.h>
+
+#include "throttled-http-server.h"
+
+/* largest write, and how much time one paced write may cover at most */
+#define CHUNK_SIZE 16384
+#define CHUNK_TIME 20000 /* usec */
+/* falling this far behind schedule resets pacing instead of bursting */
+#define MAX_LAG 200000 /* usec */
+#define MAX_CONNECTIONS 16
+/* Linux' minimum TCP retransmission timeout, usec */
+#define MIN_RTO 200000
+
+struct _ThrottledHttpServer {
+	GSocketService *service;
+	gulong run_id;
+	gchar *root;
+	guint16 port;
+	gint rate;		/* kbps, 0 unlimited */
+	gint latency;		/* round trip time, msec */
+	gint loss;		/* chunk loss probability, parts per million */
+	gint verbose;
+
+	/* connections in flight, free() waits for them */
+	GMutex lock;
+	GCond cond;
+	gint active;
+	gint stopping;
+};
+
+typedef struct _Request {
+	gchar *method;
+	gchar *path;		/* decoded, without query */
+	gboolean has_range;
+	gint64 range_start;	/* -1: suffix range of range_end bytes */
+	gint64 range_end;	/* inclusive, -1: till end of file */
+} Request;
+
+static void request_clear(Request *req) {
+	g_free(req->method);
+	g_free(req->path);
+}
+
+/* @brief "bytes=a-b", "bytes=a-" or "bytes=-n", single ranges only */
+static gboolean parse_range(const gchar *value, Request *req) {
+	gchar *end;
+
+	value += strspn(value, " \t");
+	if (!g_str_has_prefix(value, "bytes="))
+		return FALSE;
+	value += strlen("bytes=");
+	if (strchr(value, ',') != NULL)
+		return FALSE;
+
+	if (*value == '-') {
+		req->range_start = -1;
+		req->range_end = g_ascii_strtoll(value + 1, &end, 10);
+		return end != value + 1 && req->range_end > 0;
+	}
+
+	req->range_start = g_ascii_strtoll(value, &end, 10);
+	if (end == value || *end != '-' || req->range_start < 0)
+		return FALSE;
+	value = end + 1;
+	if (*value == '\0' || g_ascii_isspace(*value)) {
+		req->range_end = -1;
+		return TRUE;
+	}
+	req->range_end = g_ascii_strtoll(value, &end, 10);
+	return end != value && req->range_end >= req->range_start;
+}
+
+/* @brief read request line & headers, FALSE if the request is malformed */
+static gboolean read_request(GDataInputStream *in, Request *req) {
+	gchar *line, **parts, *query;
+	gboolean ok = TRUE;
+
+	line = g_data_input_stream_read_line(in, NULL, NULL, NULL);
+	if (line == NULL)
+		return FALSE;
+	parts = g_strsplit(g_strchomp(line), " ", 3);
+	g_free(line);
+	if (g_strv_length(parts) != 3 || !g_str_has_prefix(parts[2], "HTTP/1.")) {
+		g_strfreev(parts);
+		return FALSE;
+	}
+	req->method = g_strdup(parts[0]);
+	query = strchr(parts[1], '?');
+	if (query != NULL)
+		*query = '\0';
+	req->path = g_uri_unescape_string(parts[1], NULL);
+	g_strfreev(parts);
+	if (req->path == NULL)
+		return FALSE;
+
+	/* headers, only Range matters to us */
+	while ((line = g_data_input_stream_read_line(in, NULL, NULL, NULL)) != NULL) {
+		g_strchomp(line);
+		if (*line == '\0') {
+			g_free(line);
+			return ok;
+		}
+		if (g_ascii_strncasecmp(line, "Range:", strlen("Range:")) == 0) {
+			req->has_range = TRUE;
+			ok = parse_range(line + strlen("Range:"), req);
+		}
+		g_free(line);
+	}
+	return FALSE; /* connection closed inside the header */
+}
+
+static gboolean write_str(GOutputStream *out, const gchar *str) {
+	return g_output_stream_write_all(out, str, strlen(str), NULL, NULL, NULL);
+}
+
+static void write_status(GOutputStream *out, guint code, const gchar *reason) {
+	gchar *str = g_strdup_printf("HTTP/1.1 %u %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", code, reason);
+
+	write_str(out, str);
+	g_free(str);
+}
+
+/*
+ * @brief send length bytes of stream, paced to the server's rate
+ *        The rate is re-read every chunk so changes apply immediately.
+ *        A lost chunk stalls the connection for one retransmission timeout,
+ *        which is what packet loss looks like to the reader of a TCP socket.
+ */
+static guint64 send_body(ThrottledHttpServer *server, GInputStream *file, GOutputStream *out, guint64 length) {
+	gchar buf[CHUNK_SIZE];
+	guint64 sent = 0;
+	gint64 deadline = g_get_monotonic_time();
+
+	while (sent < length && !g_atomic_int_get(&server->stopping)) {
+		guint rate = g_atomic_int_get(&server->rate);
+		gsize chunk = MIN(sizeof(buf), length - sent);
+		gssize n;
+		gint64 now;
+
+		/* keep writes small enough that low rates still flow smoothly */
+		if (rate > 0)
+			chunk = MIN(chunk, MAX((gsize)rate * 1000 / 8 * CHUNK_TIME / G_USEC_PER_SEC, 512));
+
+		n = g_input_stream_read(file, buf, chunk, NULL, NULL);
+		if (n <= 0 || !g_output_stream_write_all(out, buf, n, NULL, NULL, NULL))
+			break;
+		sent += n;
+
+		if ((gint)g_random_int_range(0, 1000000) < g_atomic_int_get(&server->loss)) {
+			g_usleep(MAX(MIN_RTO, (gint64)g_atomic_int_get(&server->latency) * 2 * 1000));
+			deadline = g_get_monotonic_time();
+		}
+
+		if (rate > 0) {
+			now = g_get_monotonic_time();
+			if (deadline < now - MAX_LAG)
+				deadline = now;
+			deadline += (gint64)n * 8 * G_USEC_PER_SEC / ((gint64)rate * 1000);
+			if (deadline > now)
+				g_usleep(deadline - now);
+		}
+	}
+	return sent;
+}
+
+static void serve(ThrottledHttpServer *server, GSocketConnection *connection) {
+	GInputStream *in = g_io_stream_get_input_stream(G_IO_STREAM(connection));
+	GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+	GDataInputStream *din = g_data_input_stream_new(in);
+	Request req = { NULL, NULL, FALSE, 0, -1 };
+	GFile *file = NULL;
+	GFileInfo *info = NULL;
+	GFileInputStream *stream = NULL;
+	gchar *filename = NULL, *content_type, *mime, *header;
+	guint64 size, start, end, sent = 0;
+	guint code = 200;
+
+	g_data_input_stream_set_newline_type(din, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+	g_filter_input_stream_set_close_base_stream(G_FILTER_INPUT_STREAM(din), FALSE);
+
+	if (!read_request(din, &req)) {
+		if (req.has_range)
+			write_status(out, 416, "Range Not Satisfiable");
+		else
+			write_status(out, 400, "Bad Request");
+		goto done;
+	}
+	if (g_strcmp0(req.method, "GET") != 0 && g_strcmp0(req.method, "HEAD") != 0) {
+		write_status(out, 405, "Method Not Allowed");
+		goto done;
+	}
+	if (req.path[0] != '/' || strstr(req.path, "..") != NULL) {
+		write_status(out, 403, "Forbidden");
+		goto done;
+	}
+
+	/* request travelling up & first response byte travelling down */
+	if (g_atomic_int_get(&server->latency) > 0)
+		g_usleep((gulong)g_atomic_int_get(&server->latency) * 1000);
+
+	filename = g_build_filename(server->root, req.path, NULL);
+	file = g_file_new_for_path(filename);
+	info = g_file_query_info(file, G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_STANDARD_TYPE,
+			G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (info == NULL || g_file_info_get_file_type(info) != G_FILE_TYPE_REGULAR ||
+			(stream = g_file_read(file, NULL, NULL)) == NULL) {
+		write_status(out, 404, "Not Found");
+		goto done;
+	}
+
+	size = g_file_info_get_size(info);
+	start = 0;
+	end = size - 1;
+	if (req.has_range) {
+		if (req.range_start < 0) {
+			start = size > (guint64)req.range_end ? size - req.range_end : 0;
+		} else {
+			start = req.range_start;
+			if (req.range_end >= 0 && (guint64)req.range_end < end)
+				end = req.range_end;
+		}
+		if (start >= size) {
+			write_status(out, 416, "Range Not Satisfiable");
+			goto done;
+		}
+		code = 206;
+	}
+
+	content_type = g_content_type_guess(filename, NULL, 0, NULL);
+	mime = g_content_type_get_mime_type(content_type);
+	header = g_strdup_printf("HTTP/1.1 %s\r\n"
+			"Content-Type: %s\r\n"
+			"Content-Length: %" G_GUINT64_FORMAT "\r\n"
+			"Accept-Ranges: bytes\r\n",
+			code == 206 ? "206 Partial Content" : "200 OK",
+			mime ? mime : "application/octet-stream", size > 0 ? end - start + 1 : 0);
+	g_free(content_type);
+	g_free(mime);
+	if (code == 206) {
+		gchar *tmp = header;
+
+		header = g_strdup_printf("%sContent-Range: bytes %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT "/%"
+				G_GUINT64_FORMAT "\r\n", tmp, start, end, size);
+		g_free(tmp);
+	}
+
+	if (write_str(out, header) && write_str(out, "Connection: close\r\n\r\n") &&
+			g_strcmp0(req.method, "GET") == 0 && size > 0 &&
+			g_seekable_seek(G_SEEKABLE(stream), start, G_SEEK_SET, NULL, NULL)) {
+		sent = send_body(server, G_INPUT_STREAM(stream), out, end - start + 1);
+	}
+	g_free(header);
+
+	if (g_atomic_int_get(&server->verbose)) {
+		g_print("%s %s %u, %" G_GUINT64_FORMAT " bytes from %" G_GUINT64_FORMAT "\n",
+				req.method, req.path, code, sent, start);
+	}
+
+done:
+	if (stream != NULL)
+		g_object_unref(stream);
+	if (info != NULL)
+		g_object_unref(info);
+	if (file != NULL)
+		g_object_unref(file);
+	g_free(filename);
+	request_clear(&req);
+	g_object_unref(din);
+}
+
+/* @brief GThreadedSocketService::run, one thread per connection */
+static gboolean run_cb(GThreadedSocketService *service, GSocketConnection *connection,
+		GObject *source_object, ThrottledHttpServer *server) {
+	g_mutex_lock(&server->lock);
+	if (server->stopping) {
+		g_mutex_unlock(&server->lock);
+		return TRUE;
+	}
+	server->active++;
+	g_mutex_unlock(&server->lock);
+
+	serve(server, connection);
+	g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+
+	g_mutex_lock(&server->lock);
+	server->active--;
+	g_cond_broadcast(&server->cond);
+	g_mutex_unlock(&server->lock);
+	return TRUE;
+}
+
+ThrottledHttpServer *throttled_http_server_new(const gchar *root, guint16 port, GError **error) {
+	ThrottledHttpServer *server;
+	GSocketService *service = g_threaded_socket_service_new(MAX_CONNECTIONS);
+
+	if (port == 0) {
+		port = g_socket_listener_add_any_inet_port(G_SOCKET_LISTENER(service), NULL, error);
+		if (port == 0) {
+			g_object_unref(service);
+			return NULL;
+		}
+	} else if (!g_socket_listener_add_inet_port(G_SOCKET_LISTENER(service), port, NULL, error)) {
+		g_object_unref(service);
+		return NULL;
+	}
+
+	server = g_new0(ThrottledHttpServer, 1);
+	server->service = service;
+	server->root = g_strdup(root);
+	server->port = port;
+	g_mutex_init(&server->lock);
+	g_cond_init(&server->cond);
+
+	server->run_id = g_signal_connect(service, "run", G_CALLBACK(run_cb), server);
+	g_socket_service_start(service);
+	return server;
+}
+
+void throttled_http_server_free(ThrottledHttpServer *server) {
+	if (server == NULL)
+		return;
+
+	g_socket_service_stop(server->service);
+	g_socket_listener_close(G_SOCKET_LISTENER(server->service));
+
+	/* running connections notice and bail out after their current chunk */
+	g_mutex_lock(&server->lock);
+	g_atomic_int_set(&server->stopping, TRUE);
+	while (server->active > 0)
+		g_cond_wait(&server->cond, &server->lock);
+	g_mutex_unlock(&server->lock);
+
+	g_signal_handler_disconnect(server->service, server->run_id);
+	g_object_unref(server->service);
+	g_mutex_clear(&server->lock);
+	g_cond_clear(&server->cond);
+	g_free(server->root);
+	g_free(server);
+}
+
+guint16 throttled_http_server_get_port(ThrottledHttpServer *server) {
+	return server->port;
+}
+
+void throttled_http_server_set_rate(ThrottledHttpServer *server, guint rate) {
+	g_atomic_int_set(&server->rate, rate);
+}
+
+guint throttled_http_server_get_rate(ThrottledHttpServer *server) {
+	return g_atomic_int_get(&server->rate);
+}
+
+void throttled_http_server_set_verbose(ThrottledHttpServer *server, gboolean verbose) {
+	g_atomic_int_set(&server->verbose, verbose);
+}
+
+void throttled_http_server_set_latency(ThrottledHttpServer *server, guint latency) {
+	g_atomic_int_set(&server->latency, latency);
+}
+
+void throttled_http_server_set_loss(ThrottledHttpServer *server, gdouble loss) {
+	g_atomic_int_set(&server->loss, (gint)(CLAMP(loss, 0.0, 1.0) * 1000000));
+}
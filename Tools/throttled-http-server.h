@@ -0,0 +1,44 @@
+#ifndef __THROTTLED_HTTP_SERVER_H__
+#define __THROTTLED_HTTP_SERVER_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Minimal HTTP/1.1 file server with a bandwidth limit, a local stand-in for
+ * the remote media hosts the network tutorials stream from.
+ *
+ * Serves GET and HEAD for files below a root directory, including single
+ * byte ranges so sources can seek, one connection per request. Every
+ * connection is handled on its own thread and paced to the current rate,
+ * which can be changed at any time to emulate a link getting faster or
+ * slower. Latency delays every response by one round trip; loss is
+ * emulated above TCP as a retransmission stall after a random chunk.
+ *
+ * The listening socket is dispatched from the thread-default main context
+ * at creation time, so a main loop has to run there.
+ */
+typedef struct _ThrottledHttpServer ThrottledHttpServer;
+
+/* port 0 picks a free one, see throttled_http_server_get_port() */
+ThrottledHttpServer *throttled_http_server_new(const gchar *root, guint16 port, GError **error);
+void throttled_http_server_free(ThrottledHttpServer *server);
+
+guint16 throttled_http_server_get_port(ThrottledHttpServer *server);
+
+/* per connection rate limit in kbps, 0 for unlimited */
+void throttled_http_server_set_rate(ThrottledHttpServer *server, guint rate);
+guint throttled_http_server_get_rate(ThrottledHttpServer *server);
+
+/* round trip time in msec, added before every response */
+void throttled_http_server_set_latency(ThrottledHttpServer *server, guint latency);
+/* probability of a chunk being "lost", 0.0 - 1.0 */
+void throttled_http_server_set_loss(ThrottledHttpServer *server, gdouble loss);
+
+/* print one line per request */
+void throttled_http_server_set_verbose(ThrottledHttpServer *server, gboolean verbose);
+
+G_END_DECLS
+
+#endif /* __THROTTLED_HTTP_SERVER_H__ */
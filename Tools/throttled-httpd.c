@@ -0,0 +1,124 @@
+/*
+ * Rate limited HTTP file server for testing the network tutorials offline.
+ *
+ * build: gcc throttled-httpd.c throttled-http-server.c -o throttled-httpd \
+ *            $(pkg-config --cflags --libs gio-2.0)
+ * usage: throttled-httpd [OPTIONS] [ROOT]
+ *        e.g. throttled-httpd --rate 800 ~/media &
+ *             playback-tutorial1 http://localhost:8080/sintel_cropped_multilingual.webm
+ *
+ * --steps cycles through rates, "2000:10,300:10" serves 10 s at 2000 kbps,
+ * then 10 s at 300 kbps and starts over, to watch adaptive code follow.
+ */
+#include <stdlib.h>
+#include <gio/gio.h>
+
+#include "throttled-http-server.h"
+
+typedef struct _Step {
+	guint rate;		/* kbps */
+	guint duration;		/* sec */
+} Step;
+
+typedef struct _StepData {
+	ThrottledHttpServer *server;
+	GArray *steps;
+	guint current;
+} StepData;
+
+/* @brief "kbps:sec,kbps:sec,..." */
+static GArray *parse_steps(const gchar *arg) {
+	GArray *steps = g_array_new(FALSE, FALSE, sizeof(Step));
+	gchar **items = g_strsplit(arg, ",", -1);
+	gint i;
+
+	for (i = 0; items[i] != NULL; i++) {
+		Step step;
+		gchar *end;
+
+		step.rate = strtoul(items[i], &end, 10);
+		if (*end != ':' || (step.duration = strtoul(end + 1, &end, 10)) == 0 || *end != '\0') {
+			g_printerr("Bad step '%s', expected KBPS:SECONDS.\n", items[i]);
+			g_array_free(steps, TRUE);
+			steps = NULL;
+			break;
+		}
+		g_array_append_val(steps, step);
+	}
+	g_strfreev(items);
+	return steps;
+}
+
+static gboolean next_step_cb(StepData *data) {
+	Step *step = &g_array_index(data->steps, Step, data->current);
+
+	throttled_http_server_set_rate(data->server, step->rate);
+	g_print("Rate %u kbps for %u s\n", step->rate, step->duration);
+
+	data->current = (data->current + 1) % data->steps->len;
+	g_timeout_add_seconds(step->duration, (GSourceFunc)next_step_cb, data);
+	return FALSE;
+}
+
+int main(int argc, char *argv[]) {
+	StepData data = { NULL, NULL, 0 };
+	GMainLoop *main_loop;
+	GOptionContext *ctx;
+	GError *err = NULL;
+	gint port = 8080, rate = 0, latency = 0;
+	gdouble loss = 0.0;
+	gboolean verbose = FALSE;
+	gchar *steps_arg = NULL;
+	const gchar *root;
+	GOptionEntry entries[] = {
+		{ "port", 'p', 0, G_OPTION_ARG_INT, &port, "Port to listen on (default 8080, 0 picks one)", "PORT" },
+		{ "rate", 'r', 0, G_OPTION_ARG_INT, &rate, "Bandwidth per connection in kbps (default unlimited)", "KBPS" },
+		{ "latency", 'l', 0, G_OPTION_ARG_INT, &latency, "Round trip time added to every response in ms (default 0)", "MS" },
+		{ "loss", 0, 0, G_OPTION_ARG_DOUBLE, &loss, "Probability of a chunk stalling like a lost packet (default 0)", "P" },
+		{ "steps", 's', 0, G_OPTION_ARG_STRING, &steps_arg, "Cycle through rates, overrides --rate", "KBPS:SEC,..." },
+		{ "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Print every request", NULL },
+		{ NULL }
+	};
+
+	ctx = g_option_context_new("[ROOT] - rate limited HTTP file server");
+	g_option_context_add_main_entries(ctx, entries, NULL);
+	if (!g_option_context_parse(ctx, &argc, &argv, &err)) {
+		g_printerr("Failed to parse options: %s\n", err->message);
+		g_clear_error(&err);
+		g_option_context_free(ctx);
+		return -1;
+	}
+	g_option_context_free(ctx);
+	root = argc > 1 ? argv[1] : ".";
+
+	if (steps_arg != NULL) {
+		data.steps = parse_steps(steps_arg);
+		g_free(steps_arg);
+		if (data.steps == NULL)
+			return -1;
+	}
+
+	data.server = throttled_http_server_new(root, port, &err);
+	if (data.server == NULL) {
+		g_printerr("Could not start server: %s\n", err->message);
+		g_clear_error(&err);
+		return -1;
+	}
+	throttled_http_server_set_rate(data.server, rate);
+	throttled_http_server_set_latency(data.server, MAX(latency, 0));
+	throttled_http_server_set_loss(data.server, loss);
+	throttled_http_server_set_verbose(data.server, verbose);
+	g_print("Serving %s on http://localhost:%u/\n", root, throttled_http_server_get_port(data.server));
+
+	if (data.steps != NULL && data.steps->len > 0)
+		next_step_cb(&data);
+
+	main_loop = g_main_loop_new(NULL, FALSE);
+	g_main_loop_run(main_loop);
+
+	g_main_loop_unref(main_loop);
+	throttled_http_server_free(data.server);
+	if (data.steps != NULL)
+		g_array_free(data.steps, TRUE);
+	return 0;
+}